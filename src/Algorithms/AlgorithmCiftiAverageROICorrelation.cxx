@@ -23,6 +23,7 @@
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "CiftiFile.h"
+#include "CiftiRowCache.h"
 #include "FileInformation.h"
 #include "MetricFile.h"
 #include "SurfaceFile.h"
@@ -436,46 +437,45 @@ void AlgorithmCiftiAverageROICorrelation::processCifti(const CiftiFile* myCifti,
         }
         rrs[myMap] = sqrt(accum);//compute this only once
     }
-    int curRow = 0;
-#pragma omp CARET_PAR
+    CiftiRowCache rowStream(myCifti);//reads rows in the background, so IO overlaps the correlations
+    vector<int64_t> rowOrder(colSize);
+    for (int i = 0; i < colSize; ++i)
     {
-        vector<float> rowscratch(rowSize);
-#pragma omp CARET_FOR schedule(dynamic)
-        for (int i = 0; i < colSize; ++i)
+        rowOrder[i] = i;
+    }
+    rowStream.startRows(rowOrder);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int i = 0; i < colSize; ++i)
+    {
+        float* rowscratch;
+        int64_t myRow, ticket;
+        rowStream.acquireRow(rowscratch, myRow, ticket);//rows come out in file order, whichever thread asks
+        double tempaccum = 0.0;//compute mean of new row
+        for (int j = 0; j < rowSize; ++j)
         {
-            int myRow;
-#pragma omp critical
-            {
-                myRow = curRow;//force sequential reading
-                ++curRow;
-                myCifti->getRow(rowscratch.data(), myRow);//and never read multiple rows at once from the same file
-            }
-            double tempaccum = 0.0;//compute mean of new row
-            for (int j = 0; j < rowSize; ++j)
-            {
-                tempaccum += rowscratch[j];
-            }
-            float thismean = tempaccum / rowSize;
-            tempaccum = 0.0;
+            tempaccum += rowscratch[j];
+        }
+        float thismean = tempaccum / rowSize;
+        tempaccum = 0.0;
+        for (int j = 0; j < rowSize; ++j)
+        {
+            rowscratch[j] -= thismean;//demean
+            tempaccum += rowscratch[j] * rowscratch[j];//precompute rrs
+        }
+        float thisrrs = sqrt(tempaccum);
+        for (int myMap = 0; myMap < numMaps; ++myMap)
+        {
+            double corraccum = 0.0;//correlate
             for (int j = 0; j < rowSize; ++j)
             {
-                rowscratch[j] -= thismean;//demean
-                tempaccum += rowscratch[j] * rowscratch[j];//precompute rrs
-            }
-            float thisrrs = sqrt(tempaccum);
-            for (int myMap = 0; myMap < numMaps; ++myMap)
-            {
-                double corraccum = 0.0;//correlate
-                for (int j = 0; j < rowSize; ++j)
-                {
-                    corraccum += rowscratch[j] * average[myMap][j];//gather the correlation
-                }
-                corraccum /= rrs[myMap] * thisrrs;
-                if (corraccum > 0.999999) corraccum = 0.999999;
-                if (corraccum < -0.999999) corraccum = -0.999999;
-                output[myRow][myMap] = 0.5 * log((1 + corraccum) / (1 - corraccum));//fisher z transform, needed for averaging
+                corraccum += rowscratch[j] * average[myMap][j];//gather the correlation
             }
+            corraccum /= rrs[myMap] * thisrrs;
+            if (corraccum > 0.999999) corraccum = 0.999999;
+            if (corraccum < -0.999999) corraccum = -0.999999;
+            output[myRow][myMap] = 0.5 * log((1 + corraccum) / (1 - corraccum));//fisher z transform, needed for averaging
         }
+        rowStream.releaseRow(ticket);
     }
 }
 
@@ -580,46 +580,45 @@ void AlgorithmCiftiAverageROICorrelation::processCifti(const CiftiFile* myCifti,
             rrs[i] = sqrt(accum);
         }
     }
-    int curRow = 0;
-#pragma omp CARET_PAR
+    CiftiRowCache rowStream(myCifti);//reads rows in the background, so IO overlaps the correlations
+    vector<int64_t> rowOrder(colSize);
+    for (int i = 0; i < colSize; ++i)
     {
-        vector<float> rowscratch(rowSize);
-#pragma omp CARET_FOR schedule(dynamic)
-        for (int i = 0; i < colSize; ++i)
+        rowOrder[i] = i;
+    }
+    rowStream.startRows(rowOrder);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int i = 0; i < colSize; ++i)
+    {
+        float* rowscratch;
+        int64_t myRow, ticket;
+        rowStream.acquireRow(rowscratch, myRow, ticket);//rows come out in file order, whichever thread asks
+        double tempaccum = 0.0;//compute mean of new row
+        for (int j = 0; j < rowSize; ++j)
         {
-            int myRow;
-#pragma omp critical
-            {
-                myRow = curRow;//force sequential reading
-                ++curRow;
-                myCifti->getRow(rowscratch.data(), myRow);//and never read multiple rows at once from the same file
-            }
-            double tempaccum = 0.0;//compute mean of new row
-            for (int j = 0; j < rowSize; ++j)
-            {
-                tempaccum += rowscratch[j];
-            }
-            float thismean = tempaccum / rowSize;
-            tempaccum = 0.0;
+            tempaccum += rowscratch[j];
+        }
+        float thismean = tempaccum / rowSize;
+        tempaccum = 0.0;
+        for (int j = 0; j < rowSize; ++j)
+        {
+            rowscratch[j] -= thismean;//demean
+            tempaccum += rowscratch[j] * rowscratch[j];//precompute rrs
+        }
+        float thisrrs = sqrt(tempaccum);
+        for (int myMap = 0; myMap < numMaps; ++myMap)
+        {
+            double corraccum = 0.0;//correlate
             for (int j = 0; j < rowSize; ++j)
             {
-                rowscratch[j] -= thismean;//demean
-                tempaccum += rowscratch[j] * rowscratch[j];//precompute rrs
-            }
-            float thisrrs = sqrt(tempaccum);
-            for (int myMap = 0; myMap < numMaps; ++myMap)
-            {
-                double corraccum = 0.0;//correlate
-                for (int j = 0; j < rowSize; ++j)
-                {
-                    corraccum += rowscratch[j] * average[myMap][j];//gather the correlation
-                }
-                corraccum /= rrs[myMap] * thisrrs;
-                if (corraccum > 0.999999) corraccum = 0.999999;
-                if (corraccum < -0.999999) corraccum = -0.999999;
-                output[myRow][myMap] = 0.5 * log((1 + corraccum) / (1 - corraccum));//fisher z transform, needed for averaging
+                corraccum += rowscratch[j] * average[myMap][j];//gather the correlation
             }
+            corraccum /= rrs[myMap] * thisrrs;
+            if (corraccum > 0.999999) corraccum = 0.999999;
+            if (corraccum < -0.999999) corraccum = -0.999999;
+            output[myRow][myMap] = 0.5 * log((1 + corraccum) / (1 - corraccum));//fisher z transform, needed for averaging
         }
+        rowStream.releaseRow(ticket);
     }
 }
 
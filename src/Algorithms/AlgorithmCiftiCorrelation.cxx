@@ -23,6 +23,7 @@
 
 #include "AlgorithmCiftiSeparate.h"
 #include "CiftiFile.h"
+#include "CiftiRowCache.h"
 #include "MetricFile.h"
 #include "VolumeFile.h"
 #include "CaretLogger.h"
@@ -33,10 +34,61 @@
 #include <fstream>
 #include <utility>
 #include <algorithm>
+#include <cstring>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{//tile sizes for -blocked, a panel of moving rows is packed so the kernel's inner loop is contiguous and fixed-length, so the compiler can vectorize it
+    const int PANEL_ROWS = 256;//moving rows per panel, the packed panel stays in L2/L3 while every output row in the chunk streams past it
+    const int KERNEL_ROWS = 4;//output rows per kernel call, to reuse each load of the packed panel
+    const int KERNEL_WIDTH = 16;//moving rows per kernel call, 4x16 float accumulators fit in vector registers
+    const int K_CHUNK = 256;//timepoints summed in float before adding to double, for precision
+    
+    void correlationKernel(const float* const* aRows, const float* packedSub, const int& rowLength, double accOut[KERNEL_ROWS][KERNEL_WIDTH])
+    {
+        for (int r = 0; r < KERNEL_ROWS; ++r)
+        {
+            for (int w = 0; w < KERNEL_WIDTH; ++w)
+            {
+                accOut[r][w] = 0.0;
+            }
+        }
+        for (int k0 = 0; k0 < rowLength; k0 += K_CHUNK)
+        {
+            int kend = min(rowLength, k0 + K_CHUNK);
+            float acc[KERNEL_ROWS][KERNEL_WIDTH];
+            for (int r = 0; r < KERNEL_ROWS; ++r)
+            {
+                for (int w = 0; w < KERNEL_WIDTH; ++w)
+                {
+                    acc[r][w] = 0.0f;
+                }
+            }
+            for (int k = k0; k < kend; ++k)
+            {
+                const float* packedK = packedSub + k * KERNEL_WIDTH;
+                for (int r = 0; r < KERNEL_ROWS; ++r)
+                {
+                    const float aVal = aRows[r][k];
+                    for (int w = 0; w < KERNEL_WIDTH; ++w)
+                    {
+                        acc[r][w] += aVal * packedK[w];
+                    }
+                }
+            }
+            for (int r = 0; r < KERNEL_ROWS; ++r)
+            {
+                for (int w = 0; w < KERNEL_WIDTH; ++w)
+                {
+                    accOut[r][w] += acc[r][w];
+                }
+            }
+        }
+    }
+}
+
 AString AlgorithmCiftiCorrelation::getCommandSwitch()
 {
     return "-cifti-correlation";
@@ -74,13 +126,17 @@ OperationParameters* AlgorithmCiftiCorrelation::getParameters()
     OptionalParameter* memLimitOpt = ret->createOptionalParameter(6, "-mem-limit", "restrict memory usage");
     memLimitOpt->addDoubleParameter(1, "limit-GB", "memory limit in gigabytes");
     
+    ret->createOptionalParameter(7, "-blocked", "compute with a cache-blocked matrix multiply (faster, may differ slightly due to rounding)");
+    
     ret->setHelpText(
         AString("For each row (or each row inside an roi if -roi-override is specified), correlate to all other rows.  ") +
         "The -cifti-roi suboption to -roi-override may not be specified with any other -*-roi suboption, but you may specify the other -*-roi suboptions together.\n\n" +
         "When using the -fisher-z option, the output is NOT a Z-score, it is artanh(r), to do further math on this output, consider using -cifti-math.\n\n" +
         "Restricting the memory usage will make it calculate the output in chunks, and if the input file size is more than 70% of the memory limit, " +
         "it will also read through the input file as rows are required, resulting in several passes through the input file (once per chunk).  " +
-        "Memory limit does not need to be an integer, you may also specify 0 to calculate a single output row at a time (this may be very slow)."
+        "Memory limit does not need to be an integer, you may also specify 0 to calculate a single output row at a time (this may be very slow).\n\n" +
+        "The -blocked option normalizes each row once, and then computes the output as tiles of a matrix multiply, which is much faster for large inputs.  " +
+        "It uses somewhat more memory per thread, which is counted against -mem-limit."
     );
     return ret;
 }
@@ -167,24 +223,25 @@ void AlgorithmCiftiCorrelation::useParameters(OperationParameters* myParams, Pro
             throw AlgorithmException("memory limit cannot be negative");
         }
     }
+    bool blockedMode = myParams->getOptionalParameter(7)->m_present;
     if (roiOverrideMode)
     {
         if (ciftiRoiMode)
         {
-            AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, ciftiRoi, weights, fisherZ, memLimitGB);
+            AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, ciftiRoi, weights, fisherZ, memLimitGB, blockedMode);
         } else {
-            AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, leftRoi, rightRoi, cerebRoi, volRoi, weights, fisherZ, memLimitGB);
+            AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, leftRoi, rightRoi, cerebRoi, volRoi, weights, fisherZ, memLimitGB, blockedMode);
         }
     } else {
-        AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, weights, fisherZ, memLimitGB);
+        AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, weights, fisherZ, memLimitGB, blockedMode);
     }
 }
 
 AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj, const CiftiFile* myCifti, CiftiFile* myCiftiOut, const vector<float>* weights,
-                                                     const bool& fisherZ, const float& memLimitGB) : AbstractAlgorithm(myProgObj)
+                                                     const bool& fisherZ, const float& memLimitGB, const bool& blockedMode) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
-    init(myCifti, weights);
+    init(myCifti, weights, blockedMode);
     int numRows = myCifti->getNumberOfRows();
     CiftiXMLOld newXML = myCifti->getCiftiXMLOld();
     newXML.applyColumnMapToRows();
@@ -212,6 +269,7 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             cacheRow(i);
         }
     }
+    CiftiRowCache rowStream(myCifti, CiftiRowCache::getRingBytesForMemLimit(m_numCols, memLimitGB));//reads the moving rows in the background, so IO overlaps the correlations
     for (int startrow = 0; startrow < numRows; startrow += numCacheRows)
     {
         int endrow = startrow + numCacheRows;
@@ -228,35 +286,43 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
                 outRows[i - startrow] = CaretArray<float>(numRows);
             }
         }
-        int curRow = 0;//because we can't trust the order threads hit the critical section
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
+        if (m_blockedMode)
         {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
+            vector<int> blockIndices(endrow - startrow);
+            for (int i = startrow; i < endrow; ++i)
+            {
+                blockIndices[i - startrow] = i;
             }
-            for (int j = startrow; j < endrow; ++j)
+            computeBlocked(blockIndices, outRows, fisherZ, true, rowStream);
+        } else {
+            startRowStream(rowStream);
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int i = 0; i < numRows; ++i)
             {
-                if (myrow >= startrow && myrow < endrow)//check whether we are in the output memory area
+                float movingRrs;
+                float* rawRow;
+                int64_t myrow64, ticket;
+                rowStream.acquireRow(rawRow, myrow64, ticket);//rows come out in file order, whichever thread asks
+                int myrow = (int)myrow64;
+                const float* movingRow = prepareRow(myrow, rawRow, movingRrs);
+                for (int j = startrow; j < endrow; ++j)
                 {
-                    if (j >= myrow)//if so, only compute one half, and store both places
+                    if (myrow >= startrow && myrow < endrow)//check whether we are in the output memory area
                     {
+                        if (j >= myrow)//if so, only compute one half, and store both places
+                        {
+                            float cacheRrs;
+                            const float* cacheRow = getRow(j, cacheRrs, true);
+                            outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
+                            outRows[myrow - startrow][j] = outRows[j - startrow][myrow];
+                        }
+                    } else {
                         float cacheRrs;
                         const float* cacheRow = getRow(j, cacheRrs, true);
                         outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[myrow - startrow][j] = outRows[j - startrow][myrow];
                     }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(j, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
                 }
+                rowStream.releaseRow(ticket);
             }
         }
         for (int i = startrow; i < endrow; ++i)
@@ -276,10 +342,11 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
 
 AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj, const CiftiFile* myCifti, CiftiFile* myCiftiOut,
                                                      const MetricFile* leftRoi, const MetricFile* rightRoi, const MetricFile* cerebRoi,
-                                                     const VolumeFile* volRoi, const vector<float>* weights, const bool& fisherZ, const float& memLimitGB) : AbstractAlgorithm(myProgObj)
+                                                     const VolumeFile* volRoi, const vector<float>* weights, const bool& fisherZ, const float& memLimitGB,
+                                                     const bool& blockedMode) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
-    init(myCifti, weights);
+    init(myCifti, weights, blockedMode);
     const CiftiXMLOld& origXML = myCifti->getCiftiXMLOld();
     if (origXML.getColumnMappingType() != CIFTI_INDEX_TYPE_BRAIN_MODELS)
     {
@@ -394,12 +461,12 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
         }
     }
     CaretArray<int> indexReverse(numRows, -1);
+    CiftiRowCache rowStream(myCifti, CiftiRowCache::getRingBytesForMemLimit(m_numCols, memLimitGB));//reads the moving rows in the background, so IO overlaps the correlations
     for (int startrow = 0; startrow < numSelected; startrow += numCacheRows)
     {
         int endrow = startrow + numCacheRows;
         if (endrow > numSelected) endrow = numSelected;
         outRows.resize(endrow - startrow);
-        int curRow = 0;//because we can't trust the order threads hit the critical section
         for (int i = startrow; i < endrow; ++i)
         {
             if (!cacheFullInput)
@@ -412,34 +479,43 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             }
             indexReverse[ciftiIndexList[i].first] = i;
         }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
+        if (m_blockedMode)
         {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
+            vector<int> blockIndices(endrow - startrow);
+            for (int i = startrow; i < endrow; ++i)
+            {
+                blockIndices[i - startrow] = ciftiIndexList[i].first;
             }
-            for (int j = startrow; j < endrow; ++j)
+            computeBlocked(blockIndices, outRows, fisherZ, false, rowStream);//rows aren't a contiguous range, so don't bother with symmetry
+        } else {
+            startRowStream(rowStream);
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int i = 0; i < numRows; ++i)
             {
-                if (indexReverse[myrow] != -1)//check if we are on a row that is in the output memory range
+                float movingRrs;
+                float* rawRow;
+                int64_t myrow64, ticket;
+                rowStream.acquireRow(rawRow, myrow64, ticket);//rows come out in file order, whichever thread asks
+                int myrow = (int)myrow64;
+                const float* movingRow = prepareRow(myrow, rawRow, movingRrs);
+                for (int j = startrow; j < endrow; ++j)
                 {
-                    if (indexReverse[myrow] <= j)//if so, only compute one of the elements, then store it both places
+                    if (indexReverse[myrow] != -1)//check if we are on a row that is in the output memory range
                     {
+                        if (indexReverse[myrow] <= j)//if so, only compute one of the elements, then store it both places
+                        {
+                            float cacheRrs;
+                            const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
+                            outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
+                            outRows[indexReverse[myrow] - startrow][ciftiIndexList[j].first] = outRows[j - startrow][myrow];
+                        }
+                    } else {
                         float cacheRrs;
                         const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
                         outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[indexReverse[myrow] - startrow][ciftiIndexList[j].first] = outRows[j - startrow][myrow];
                     }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
                 }
+                rowStream.releaseRow(ticket);
             }
         }
         for (int i = startrow; i < endrow; ++i)
@@ -459,7 +535,7 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
 }
 
 AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj, const CiftiFile* myCifti, CiftiFile* myCiftiOut, const CiftiFile* ciftiRoi,
-                                                     const vector<float>* weights, const bool& fisherZ, const float& memLimitGB): AbstractAlgorithm(NULL)//HACK: get around the sentinel by passing a null, because this implementation calls another
+                                                     const vector<float>* weights, const bool& fisherZ, const float& memLimitGB, const bool& blockedMode): AbstractAlgorithm(NULL)//HACK: get around the sentinel by passing a null, because this implementation calls another
 {
     const CiftiXML& roiXML = ciftiRoi->getCiftiXML();//roi is not optional in this variant
     if (roiXML.getMappingType(CiftiXML::ALONG_COLUMN) != CiftiMappingType::BRAIN_MODELS) throw AlgorithmException("cifti roi does not have brain models mapping along column");
@@ -497,7 +573,7 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
         AlgorithmCiftiSeparate(NULL, ciftiRoi, CiftiXML::ALONG_COLUMN, &volRoi, offsetOut, NULL, false);//don't crop, because it needs to match the original volume space in the input
         volRoiPtr = &volRoi;
     }
-    AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, leftRoiPtr, rightRoiPtr, cerebRoiPtr, volRoiPtr, weights, fisherZ, memLimitGB);//HACK: pass through our progress object
+    AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, leftRoiPtr, rightRoiPtr, cerebRoiPtr, volRoiPtr, weights, fisherZ, memLimitGB, blockedMode);//HACK: pass through our progress object
 }
 
 float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ)
@@ -525,6 +601,11 @@ float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1,
             r = accum / (rrs1 * rrs2);
         }
     }
+    return adjustCorrelation(r, fisherZ);
+}
+
+float AlgorithmCiftiCorrelation::adjustCorrelation(double r, const bool& fisherZ)
+{
     if (fisherZ)
     {
         if (r > 0.999999) r = 0.999999;//prevent inf
@@ -537,8 +618,144 @@ float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1,
     }
 }
 
-void AlgorithmCiftiCorrelation::init(const CiftiFile* input, const vector<float>* weights)
+void AlgorithmCiftiCorrelation::computeBlocked(const vector<int>& blockIndices, vector<CaretArray<float> >& outRows, const bool& fisherZ, const bool& useSymmetryIn,
+                                               CiftiRowCache& rowStream)
+{//rows are already demeaned and scaled by 1/rootResidSqr, so each output element is just a dot product
+    const int numRows = (int)m_rowInfo.size(), numBlock = (int)blockIndices.size(), rowLength = getCompactedLength();
+    const bool allCached = (m_cacheUsed == numRows);//otherwise, panels are filled from the row stream in whatever order threads ask, so they aren't contiguous
+    const bool useSymmetry = useSymmetryIn && allCached;
+    int blockStart = -1, blockEnd = -1;//when useSymmetry, blockIndices is a contiguous range
+    if (useSymmetry && numBlock > 0)
+    {
+        blockStart = blockIndices[0];
+        blockEnd = blockStart + numBlock;
+    }
+    if (!allCached) startRowStream(rowStream);
+    int curPanel = 0;
+#pragma omp CARET_PAR
+    {
+        vector<float> rawRows, packed(PANEL_ROWS * rowLength);
+        vector<const float*> panelRows(PANEL_ROWS);
+        vector<int> panelIndices(PANEL_ROWS);
+        while (true)
+        {
+            int panelSize = 0, panelStart = -1, panelEnd = -1;
+            if (allCached)
+            {
+#pragma omp critical
+                {
+                    panelStart = curPanel * PANEL_ROWS;
+                    ++curPanel;
+                }
+                if (panelStart >= numRows) break;
+                panelEnd = min(panelStart + PANEL_ROWS, numRows);
+                panelSize = panelEnd - panelStart;
+                for (int jj = 0; jj < panelSize; ++jj)
+                {
+                    panelIndices[jj] = panelStart + jj;
+                    panelRows[jj] = m_rowCache[m_rowInfo[panelStart + jj].m_cacheIndex].m_row.data();
+                }
+            } else {
+                float* rawRow;
+                int64_t row, ticket;
+                while (panelSize < PANEL_ROWS && rowStream.acquireRow(rawRow, row, ticket))
+                {
+                    panelIndices[panelSize] = (int)row;
+                    if (rawRow == NULL)
+                    {
+                        panelRows[panelSize] = m_rowCache[m_rowInfo[row].m_cacheIndex].m_row.data();
+                    } else {//copy it out, so this thread never holds more than one ring slot
+                        float rrs;
+                        if (rawRows.empty()) rawRows.resize(PANEL_ROWS * rowLength);
+                        float* myRow = rawRows.data() + panelSize * rowLength;
+                        memcpy(myRow, prepareRow((int)row, rawRow, rrs), rowLength * sizeof(float));
+                        panelRows[panelSize] = myRow;
+                    }
+                    rowStream.releaseRow(ticket);
+                    ++panelSize;
+                }
+                if (panelSize == 0) break;
+            }
+            for (int jj = 0; jj < PANEL_ROWS; ++jj)//pack as [subpanel][timepoint][KERNEL_WIDTH], zero padded
+            {
+                float* packedBase = packed.data() + (jj / KERNEL_WIDTH) * rowLength * KERNEL_WIDTH + (jj % KERNEL_WIDTH);
+                if (jj < panelSize)
+                {
+                    const float* source = panelRows[jj];
+                    for (int k = 0; k < rowLength; ++k)
+                    {
+                        packedBase[k * KERNEL_WIDTH] = source[k];
+                    }
+                } else {
+                    for (int k = 0; k < rowLength; ++k)
+                    {
+                        packedBase[k * KERNEL_WIDTH] = 0.0f;
+                    }
+                }
+            }
+            const int numSub = (panelSize + KERNEL_WIDTH - 1) / KERNEL_WIDTH;
+            const bool panelInBlock = useSymmetry && panelStart >= blockStart && panelEnd <= blockEnd;
+            for (int b = 0; b < numBlock; b += KERNEL_ROWS)
+            {
+                if (panelInBlock && panelEnd <= blockIndices[b]) continue;//lower triangle, copied from the upper triangle afterwards
+                const int numA = min(KERNEL_ROWS, numBlock - b);
+                const float* aRows[KERNEL_ROWS];
+                for (int r = 0; r < KERNEL_ROWS; ++r)
+                {
+                    int blockRow = blockIndices[b + min(r, numA - 1)];//pad by repeating the last row, and ignore the extra results
+                    aRows[r] = m_rowCache[m_rowInfo[blockRow].m_cacheIndex].m_row.data();
+                }
+                for (int sub = 0; sub < numSub; ++sub)
+                {
+                    double acc[KERNEL_ROWS][KERNEL_WIDTH];
+                    correlationKernel(aRows, packed.data() + sub * rowLength * KERNEL_WIDTH, rowLength, acc);
+                    const int subStart = sub * KERNEL_WIDTH, subEnd = min(subStart + KERNEL_WIDTH, panelSize);
+                    for (int r = 0; r < numA; ++r)
+                    {
+                        for (int jj = subStart; jj < subEnd; ++jj)
+                        {
+                            const int j = panelIndices[jj];
+                            if (j == blockIndices[b + r])
+                            {
+                                outRows[b + r][j] = adjustCorrelation(1.0, fisherZ);//short circuit for same row
+                            } else {
+                                outRows[b + r][j] = adjustCorrelation(acc[r][jj - subStart], fisherZ);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (useSymmetry)
+    {
+        for (int b = 0; b < numBlock; ++b)
+        {
+            const int groupStart = blockIndices[(b / KERNEL_ROWS) * KERNEL_ROWS];
+            for (int panelStart = 0; panelStart < numRows; panelStart += PANEL_ROWS)
+            {
+                const int panelEnd = min(panelStart + PANEL_ROWS, numRows);
+                if (panelStart >= blockStart && panelEnd <= blockEnd && panelEnd <= groupStart)//same test as the skip above
+                {
+                    for (int j = panelStart; j < panelEnd; ++j)
+                    {
+                        outRows[b][j] = outRows[j - blockStart][blockIndices[b]];
+                    }
+                }
+            }
+        }
+    }
+}
+
+int AlgorithmCiftiCorrelation::getCompactedLength()
 {
+    if (m_weightedMode) return (int)m_weightIndexes.size();
+    return m_numCols;
+}
+
+void AlgorithmCiftiCorrelation::init(const CiftiFile* input, const vector<float>* weights, const bool& blockedMode)
+{
+    m_blockedMode = blockedMode;
     m_inputCifti = input;
     m_rowInfo.resize(m_inputCifti->getNumberOfRows());
     m_cacheUsed = 0;
@@ -596,6 +813,10 @@ void AlgorithmCiftiCorrelation::cacheRow(const int& ciftiIndex)
         m_rowInfo[ciftiIndex].m_haveCalculated = true;
     }
     doSubtract(myPtr, m_rowInfo[ciftiIndex].m_mean);
+    if (m_blockedMode)
+    {
+        doScale(myPtr, m_rowInfo[ciftiIndex].m_rootResidSqr);
+    }
     m_rowInfo[ciftiIndex].m_cacheIndex = m_cacheUsed;
     ++m_cacheUsed;
 }
@@ -635,6 +856,37 @@ const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& roo
     return ret;
 }
 
+const float* AlgorithmCiftiCorrelation::prepareRow(const int& ciftiIndex, float* rawRow, float& rootResidSqr)
+{
+    if (rawRow == NULL) return getRow(ciftiIndex, rootResidSqr, true);//the row stream skips rows that are in the cache
+    CaretAssertVectorIndex(m_rowInfo, ciftiIndex);
+    if (!m_rowInfo[ciftiIndex].m_haveCalculated)
+    {
+        computeRowStats(rawRow, m_rowInfo[ciftiIndex].m_mean, m_rowInfo[ciftiIndex].m_rootResidSqr);
+        m_rowInfo[ciftiIndex].m_haveCalculated = true;
+    }
+    doSubtract(rawRow, m_rowInfo[ciftiIndex].m_mean);
+    if (m_blockedMode)
+    {
+        doScale(rawRow, m_rowInfo[ciftiIndex].m_rootResidSqr);
+    }
+    rootResidSqr = m_rowInfo[ciftiIndex].m_rootResidSqr;
+    return rawRow;
+}
+
+void AlgorithmCiftiCorrelation::startRowStream(CiftiRowCache& rowStream)
+{
+    int numRows = (int)m_rowInfo.size();
+    vector<int64_t> rowOrder(numRows);
+    vector<bool> skipRows(numRows);
+    for (int i = 0; i < numRows; ++i)
+    {
+        rowOrder[i] = i;
+        skipRows[i] = (m_rowInfo[i].m_cacheIndex != -1);
+    }
+    rowStream.startRows(rowOrder, &skipRows);
+}
+
 void AlgorithmCiftiCorrelation::computeRowStats(const float* row, float& mean, float& rootResidSqr)
 {
     double accum = 0.0;//double, for numerical stability
@@ -720,6 +972,16 @@ void AlgorithmCiftiCorrelation::doSubtract(float* row, const float& mean)
     }
 }
 
+void AlgorithmCiftiCorrelation::doScale(float* row, const float& rootResidSqr)
+{
+    const float scale = 1.0f / rootResidSqr;//zero variance gives inf, and therefore nan correlations, same as the unblocked mode
+    const int rowLength = getCompactedLength();
+    for (int i = 0; i < rowLength; ++i)
+    {
+        row[i] *= scale;
+    }
+}
+
 float* AlgorithmCiftiCorrelation::getTempRow()
 {
 #ifdef CARET_OMP
@@ -750,12 +1012,17 @@ int AlgorithmCiftiCorrelation::numRowsForMem(const float& memLimitGB, bool& cach
     int inrowBytes = m_numCols * sizeof(float), outrowBytes = numRows * sizeof(float);
     int64_t targetBytes = (int64_t)(memLimitGB * 1024 * 1024 * 1024);
     if (m_inputCifti->isInMemory()) targetBytes -= numRows * m_numCols * 4;//count in-memory input against the total too
+    targetBytes -= CiftiRowCache::getRingBytesForMemLimit(m_numCols, memLimitGB);//ring of rows being read ahead
+    targetBytes -= numRows * sizeof(RowInfo);//storage for mean, stdev, and info about caching
+    if (m_blockedMode)
+    {
+        int64_t panelBytes = (int64_t)PANEL_ROWS * (inrowBytes + getCompactedLength() * sizeof(float));//raw rows and packed panel
 #ifdef CARET_OMP
-    targetBytes -= inrowBytes * omp_get_max_threads();
+        targetBytes -= panelBytes * omp_get_max_threads();
 #else
-    targetBytes -= inrowBytes;//1 row in memory that isn't a reference to cache
+        targetBytes -= panelBytes;
 #endif
-    targetBytes -= numRows * sizeof(RowInfo);//storage for mean, stdev, and info about caching
+    }
     int64_t perRowBytes = inrowBytes + outrowBytes;//cache and memory collation for output rows
     if (numRows * m_numCols * 4 < targetBytes * 0.7f)//if caching the entire input file would take less than 70% of remaining allotted memory, do it to reduce IO
     {
@@ -27,6 +27,8 @@
 
 namespace caret {
     
+    class CiftiRowCache;
+    
     class AlgorithmCiftiCorrelation : public AbstractAlgorithm
     {
         AlgorithmCiftiCorrelation();
@@ -51,32 +53,40 @@ namespace caret {
         std::vector<CaretArray<float> > m_tempRows;//reuse return values in getRow instead of reallocating
         std::vector<float> m_weights;
         std::vector<int> m_weightIndexes;
-        bool m_binaryWeights, m_weightedMode;
+        bool m_binaryWeights, m_weightedMode, m_blockedMode;
         int m_cacheUsed;//reuse cache entries instead of reallocating them
         int m_numCols;
         const CiftiFile* m_inputCifti;//so that accesses work through the cache functions
         void cacheRow(const int& ciftiIndex);
         void computeRowStats(const float* row, float& mean, float& rootResidSqr);
         void doSubtract(float* row, const float& mean);
+        void doScale(float* row, const float& rootResidSqr);
         void clearCache();
         const float* getRow(const int& ciftiIndex, float& rootResidSqr, const bool& mustBeCached = false);
         float* getTempRow();
         float correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ);
-        void init(const CiftiFile* input, const std::vector<float>* weights);
+        float adjustCorrelation(double r, const bool& fisherZ);
+        const float* prepareRow(const int& ciftiIndex, float* rawRow, float& rootResidSqr);
+        void startRowStream(CiftiRowCache& rowStream);
+        void computeBlocked(const std::vector<int>& blockIndices, std::vector<CaretArray<float> >& outRows, const bool& fisherZ, const bool& useSymmetryIn,
+                            CiftiRowCache& rowStream);
+        int getCompactedLength();
+        void init(const CiftiFile* input, const std::vector<float>* weights, const bool& blockedMode);
         int numRowsForMem(const float& memLimitGB, bool& cacheFullInput);
     protected:
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
     public:
         AlgorithmCiftiCorrelation(ProgressObject* myProgObj, const CiftiFile* myCifti, CiftiFile* myCiftiOut, const std::vector<float>* weights = NULL,
-                                  const bool& fisherZ = false, const float& memLimitGB = -1.0f);
+                                  const bool& fisherZ = false, const float& memLimitGB = -1.0f, const bool& blockedMode = false);
         AlgorithmCiftiCorrelation(ProgressObject* myProgObj, const CiftiFile* myCifti, CiftiFile* myCiftiOut,
                                   const MetricFile* leftRoi, const MetricFile* rightRoi = NULL, const MetricFile* cerebRoi = NULL,
                                   const VolumeFile* volRoi = NULL, const std::vector<float>* weights = NULL, const bool& fisherZ = false,
-                                  const float& memLimitGB = -1.0f);
+                                  const float& memLimitGB = -1.0f, const bool& blockedMode = false);
         AlgorithmCiftiCorrelation(ProgressObject* myProgObj, const CiftiFile* myCifti, CiftiFile* myCiftiOut,
                                   const CiftiFile* ciftiRoi,
-                                  const std::vector<float>* weights = NULL, const bool& fisherZ = false, const float& memLimitGB = -1.0f);
+                                  const std::vector<float>* weights = NULL, const bool& fisherZ = false, const float& memLimitGB = -1.0f,
+                                  const bool& blockedMode = false);
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
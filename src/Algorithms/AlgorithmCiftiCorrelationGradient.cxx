@@ -26,12 +26,15 @@
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "CiftiFile.h"
+#include "CiftiRowCache.h"
 #include "GeodesicHelper.h"
 #include "MetricFile.h"
+#include "PerformanceStatistics.h"
 #include "SurfaceFile.h"
 #include "Vector3D.h"
 #include "VolumeFile.h"
 #include <cmath>
+#include <cstring>
 
 using namespace caret;
 using namespace std;
@@ -189,7 +192,7 @@ AlgorithmCiftiCorrelationGradient::AlgorithmCiftiCorrelationGradient(ProgressObj
                                                                      const float& surfaceExclude, const float& volumeExclude, const float& memLimitGB) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
-    init(myCifti, undoFisherInput, applyFisher);
+    init(myCifti, undoFisherInput, applyFisher, memLimitGB);
     const CiftiXMLOld& myXML = myCifti->getCiftiXMLOld();
     CiftiXMLOld myNewXML = myXML;
     myNewXML.resetDirectionToScalars(CiftiXMLOld::ALONG_ROW, 1);
@@ -257,6 +260,7 @@ AlgorithmCiftiCorrelationGradient::AlgorithmCiftiCorrelationGradient(ProgressObj
             default:
                 break;
         }
+        PerformancePhaseTimer phaseTimer("correlation gradient surfaces");
         if (surfaceExclude > 0.0f)
         {
             processSurfaceComponent(surfaceList[whichStruct], surfKern, surfaceExclude, memLimitGB, mySurf, myAreas);
@@ -266,6 +270,7 @@ AlgorithmCiftiCorrelationGradient::AlgorithmCiftiCorrelationGradient(ProgressObj
     }
     for (int whichStruct = 0; whichStruct < (int)volumeList.size(); ++whichStruct)
     {
+        PerformancePhaseTimer phaseTimer("correlation gradient volumes");
         if (volumeExclude > 0.0f)
         {
             processVolumeComponent(volumeList[whichStruct], volKern, volumeExclude, memLimitGB);
@@ -282,6 +287,11 @@ void AlgorithmCiftiCorrelationGradient::processSurfaceComponent(StructureEnum::E
     vector<CiftiSurfaceMap> myMap;
     myXML.getSurfaceMapForColumns(myMap, myStructure);
     int mapSize = (int)myMap.size();
+    vector<int64_t> movingOrder(mapSize);//the order the moving rows are read in
+    for (int i = 0; i < mapSize; ++i)
+    {
+        movingOrder[i] = myMap[i].m_ciftiIndex;
+    }
     vector<double> accum(mapSize, 0.0);
     int numCacheRows = mapSize;
     bool cacheFullInput = true;
@@ -339,21 +349,16 @@ void AlgorithmCiftiCorrelationGradient::processSurfaceComponent(StructureEnum::E
             }
             cacheRows(rowsToCache);
         }
-        int curRow = 0;//because we can't trust the order threads hit the critical section
+        startRowStream(movingOrder);
         MetricFile computeMetric;
         computeMetric.setNumberOfNodesAndColumns(mySurf->getNumberOfNodes(), endpos - startpos);
 #pragma omp CARET_PARFOR schedule(dynamic)
         for (int i = 0; i < mapSize; ++i)
         {
             float movingRrs;
-            const float* movingRow;
-            int myrow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myMap[myrow].m_ciftiIndex, movingRrs);
-            }
+            int64_t ticket;
+            const float* movingRow = getStreamedRow(ticket, movingRrs);//rows come out in map order, whichever thread asks
+            int myrow = (int)ticket;
             for (int j = startpos; j < endpos; ++j)
             {
                 if (myrow >= startpos && myrow < endpos)
@@ -373,6 +378,7 @@ void AlgorithmCiftiCorrelationGradient::processSurfaceComponent(StructureEnum::E
                     computeMetric.setValue(myMap[myrow].m_surfaceNode, j - startpos, result);
                 }
             }
+            m_rowStream->releaseRow(ticket);
         }
         int numMetricCols = endpos - startpos;
         MetricFile outputMetric, outputMetric2;
@@ -410,6 +416,11 @@ void AlgorithmCiftiCorrelationGradient::processSurfaceComponent(StructureEnum::E
     vector<CiftiSurfaceMap> myMap;
     myXML.getSurfaceMapForColumns(myMap, myStructure);
     int mapSize = (int)myMap.size();
+    vector<int64_t> movingOrder(mapSize);//the order the moving rows are read in
+    for (int i = 0; i < mapSize; ++i)
+    {
+        movingOrder[i] = myMap[i].m_ciftiIndex;
+    }
     vector<double> accum(mapSize, 0.0);
     vector<int32_t> accumCount(mapSize, 0);
     int numCacheRows = mapSize;
@@ -495,21 +506,16 @@ void AlgorithmCiftiCorrelationGradient::processSurfaceComponent(StructureEnum::E
                 }
             }
         }
-        int curRow = 0;//because we can't trust the order threads hit the critical section
+        startRowStream(movingOrder);
         MetricFile computeMetric;
         computeMetric.setNumberOfNodesAndColumns(mySurf->getNumberOfNodes(), endpos - startpos);
 #pragma omp CARET_PARFOR schedule(dynamic)
         for (int i = 0; i < mapSize; ++i)
         {
             float movingRrs;
-            const float* movingRow;
-            int myrow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myMap[myrow].m_ciftiIndex, movingRrs);
-            }
+            int64_t ticket;
+            const float* movingRow = getStreamedRow(ticket, movingRrs);//rows come out in map order, whichever thread asks
+            int myrow = (int)ticket;
             for (int j = startpos; j < endpos; ++j)
             {
                 if (roiLookup[j - startpos][myMap[myrow].m_surfaceNode])
@@ -532,6 +538,7 @@ void AlgorithmCiftiCorrelationGradient::processSurfaceComponent(StructureEnum::E
                     }
                 }
             }
+            m_rowStream->releaseRow(ticket);
         }
         int numMetricCols = endpos - startpos;
         MetricFile outputMetric, outputMetric2;
@@ -585,6 +592,11 @@ void AlgorithmCiftiCorrelationGradient::processVolumeComponent(StructureEnum::En
     vector<CiftiVolumeMap> myMap;
     myXML.getVolumeStructureMapForColumns(myMap, myStructure);
     int mapSize = (int)myMap.size();
+    vector<int64_t> movingOrder(mapSize);//the order the moving rows are read in
+    for (int i = 0; i < mapSize; ++i)
+    {
+        movingOrder[i] = myMap[i].m_ciftiIndex;
+    }
     vector<double> accum(mapSize, 0.0);
     int numCacheRows = mapSize;
     bool cacheFullInput = true;
@@ -663,7 +675,7 @@ void AlgorithmCiftiCorrelationGradient::processVolumeComponent(StructureEnum::En
             }
             cacheRows(rowsToCache);
         }
-        int curRow = 0;//because we can't trust the order threads hit the critical section
+        startRowStream(movingOrder);
         vector<int64_t> computeDims = newdims;
         computeDims.push_back(endpos - startpos);
         VolumeFile computeVol(computeDims, ciftiSform);
@@ -671,14 +683,9 @@ void AlgorithmCiftiCorrelationGradient::processVolumeComponent(StructureEnum::En
         for (int i = 0; i < mapSize; ++i)
         {
             float movingRrs;
-            const float* movingRow;
-            int myrow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myMap[myrow].m_ciftiIndex, movingRrs);
-            }
+            int64_t ticket;
+            const float* movingRow = getStreamedRow(ticket, movingRrs);//rows come out in map order, whichever thread asks
+            int myrow = (int)ticket;
             for (int j = startpos; j < endpos; ++j)
             {
                 if (myrow >= startpos && myrow < endpos)
@@ -698,6 +705,7 @@ void AlgorithmCiftiCorrelationGradient::processVolumeComponent(StructureEnum::En
                     computeVol.setValue(result, myMap[myrow].m_ijk[0] - offset[0], myMap[myrow].m_ijk[1] - offset[1], myMap[myrow].m_ijk[2] - offset[2], j - startpos);
                 }
             }
+            m_rowStream->releaseRow(ticket);
         }
         VolumeFile outputVol;
         int numSubvols = endpos - startpos;
@@ -722,6 +730,11 @@ void AlgorithmCiftiCorrelationGradient::processVolumeComponent(StructureEnum::En
     vector<CiftiVolumeMap> myMap;
     myXML.getVolumeStructureMapForColumns(myMap, myStructure);
     int mapSize = (int)myMap.size();
+    vector<int64_t> movingOrder(mapSize);//the order the moving rows are read in
+    for (int i = 0; i < mapSize; ++i)
+    {
+        movingOrder[i] = myMap[i].m_ciftiIndex;
+    }
     vector<double> accum(mapSize, 0.0);
     vector<int32_t> accumCount(mapSize, 0);
     int numCacheRows = mapSize;
@@ -801,7 +814,7 @@ void AlgorithmCiftiCorrelationGradient::processVolumeComponent(StructureEnum::En
             }
             cacheRows(rowsToCache);
         }
-        int curRow = 0;//because we can't trust the order threads hit the critical section
+        startRowStream(movingOrder);
         vector<int64_t> computeDims = newdims;
         computeDims.push_back(endpos - startpos);
         VolumeFile computeVol(computeDims, ciftiSform);
@@ -809,14 +822,9 @@ void AlgorithmCiftiCorrelationGradient::processVolumeComponent(StructureEnum::En
         for (int i = 0; i < mapSize; ++i)
         {
             float movingRrs;
-            const float* movingRow;
-            int myrow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myMap[myrow].m_ciftiIndex, movingRrs);
-            }
+            int64_t ticket;
+            const float* movingRow = getStreamedRow(ticket, movingRrs);//rows come out in map order, whichever thread asks
+            int myrow = (int)ticket;
             Vector3D movingLoc;
             volRoi.indexToSpace(myMap[myrow].m_ijk, movingLoc);//NOTE: this is outside the cropped volume, but matches the real location in the full volume, because we didn't fix the center
             for (int j = startpos; j < endpos; ++j)
@@ -843,6 +851,7 @@ void AlgorithmCiftiCorrelationGradient::processVolumeComponent(StructureEnum::En
                     }
                 }
             }
+            m_rowStream->releaseRow(ticket);
         }
         VolumeFile outputVol, excludeRoi(newdims, ciftiSform);
         excludeRoi.setFrame(volRoi.getFrame());
@@ -1080,7 +1089,7 @@ float AlgorithmCiftiCorrelationGradient::correlate(const float* row1, const floa
     }
 }
 
-void AlgorithmCiftiCorrelationGradient::init(const CiftiFile* input, const bool& undoFisherInput, const bool& applyFisher)
+void AlgorithmCiftiCorrelationGradient::init(const CiftiFile* input, const bool& undoFisherInput, const bool& applyFisher, const float& memLimitGB)
 {
     if (input->getCiftiXML().getMappingType(CiftiXML::ALONG_COLUMN) != CiftiMappingType::BRAIN_MODELS) throw AlgorithmException("input cifti file must have brain models mapping along column");
     m_undoFisherInput = undoFisherInput;
@@ -1090,46 +1099,44 @@ void AlgorithmCiftiCorrelationGradient::init(const CiftiFile* input, const bool&
     m_cacheUsed = 0;
     m_numCols = m_inputCifti->getNumberOfColumns();
     m_outColumn.resize(m_inputCifti->getNumberOfRows());
+    m_rowStream.grabNew(new CiftiRowCache(m_inputCifti, CiftiRowCache::getRingBytesForMemLimit(m_numCols, memLimitGB)));
 }
 
 void AlgorithmCiftiCorrelationGradient::cacheRows(const vector<int>& ciftiIndices)
 {
     clearCache();//clear first, to be sure we never keep a cache around too long
-    int curIndex = 0, numIndices = (int)ciftiIndices.size();//manually in-order
+    int numIndices = (int)ciftiIndices.size();
     m_rowCache.reserve(m_cacheUsed + numIndices);//so that pointers to members don't change
-#pragma omp CARET_PAR
+    vector<int64_t> toRead;
+    for (int i = 0; i < numIndices; ++i)
     {
-        int myIndex;
-        float* myPtr;
-#pragma omp CARET_FOR schedule(dynamic)
-        for (int i = 0; i < numIndices; ++i)
+        CaretAssertVectorIndex(m_rowInfo, ciftiIndices[i]);
+        if (m_rowInfo[ciftiIndices[i]].m_cacheIndex == -1)
         {
-            myPtr = NULL;
-#pragma omp critical
-            {
-                myIndex = curIndex;
-                ++curIndex;
-                CaretAssertVectorIndex(m_rowInfo, ciftiIndices[myIndex]);
-                if (m_rowInfo[ciftiIndices[myIndex]].m_cacheIndex == -1)
-                {
-                    if (m_cacheUsed >= (int)m_rowCache.size())
-                    {
-                        m_rowCache.push_back(CacheRow());
-                        m_rowCache[m_cacheUsed].m_row.resize(m_numCols);
-                    }
-                    m_rowCache[m_cacheUsed].m_ciftiIndex = ciftiIndices[myIndex];
-                    myPtr = m_rowCache[m_cacheUsed].m_row.data();
-                    m_inputCifti->getRow(myPtr, ciftiIndices[myIndex]);
-                    m_rowInfo[ciftiIndices[myIndex]].m_cacheIndex = m_cacheUsed;
-                    ++m_cacheUsed;
-                }
-            }//end critical, now compute while the next thread reads
-            if (myPtr != NULL)
+            if (m_cacheUsed >= (int)m_rowCache.size())
             {
-                adjustRow(myPtr, ciftiIndices[myIndex]);
+                m_rowCache.push_back(CacheRow());
+                m_rowCache[m_cacheUsed].m_row.resize(m_numCols);
             }
+            m_rowCache[m_cacheUsed].m_ciftiIndex = ciftiIndices[i];
+            m_rowInfo[ciftiIndices[i]].m_cacheIndex = m_cacheUsed;
+            ++m_cacheUsed;
+            toRead.push_back(ciftiIndices[i]);
         }
     }
+    int numToRead = (int)toRead.size();
+    m_rowStream->startRows(toRead);//no skip list, the cache slots are already assigned
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int i = 0; i < numToRead; ++i)
+    {
+        float* rawRow;
+        int64_t row, ticket;
+        m_rowStream->acquireRow(rawRow, row, ticket);
+        float* myPtr = m_rowCache[m_rowInfo[row].m_cacheIndex].m_row.data();
+        memcpy(myPtr, rawRow, m_numCols * sizeof(float));
+        m_rowStream->releaseRow(ticket);//let the reader move on while we adjust
+        adjustRow(myPtr, (int)row);
+    }
 }
 
 void AlgorithmCiftiCorrelationGradient::clearCache()
@@ -1162,6 +1169,30 @@ const float* AlgorithmCiftiCorrelationGradient::getRow(const int& ciftiIndex, fl
     return ret;
 }
 
+void AlgorithmCiftiCorrelationGradient::startRowStream(const vector<int64_t>& rowOrder)
+{
+    int numRows = (int)m_rowInfo.size();
+    vector<bool> skipRows(numRows);
+    for (int i = 0; i < numRows; ++i)
+    {
+        skipRows[i] = (m_rowInfo[i].m_cacheIndex != -1);
+    }
+    m_rowStream->startRows(rowOrder, &skipRows);
+}
+
+const float* AlgorithmCiftiCorrelationGradient::getStreamedRow(int64_t& ticketOut, float& rootResidSqr)
+{
+    float* rawRow;
+    int64_t ciftiIndex;
+    bool valid = m_rowStream->acquireRow(rawRow, ciftiIndex, ticketOut);
+    CaretAssert(valid);//callers loop over exactly the number of rows in the order
+    if (!valid) throw AlgorithmException("something very bad happened, notify the developers");
+    if (rawRow == NULL) return getRow((int)ciftiIndex, rootResidSqr, true);//cached rows are skipped by the reader
+    adjustRow(rawRow, (int)ciftiIndex);
+    rootResidSqr = m_rowInfo[ciftiIndex].m_rootResidSqr;
+    return rawRow;
+}
+
 void AlgorithmCiftiCorrelationGradient::adjustRow(float* rowOut, const int& ciftiIndex)
 {
     if (m_undoFisherInput)
@@ -1239,11 +1270,7 @@ int AlgorithmCiftiCorrelationGradient::numRowsForMem(const float& memLimitGB, co
         if (numRowsFull < 1) numRowsFull = 1;
         int64_t fullPasses = numRows / numRowsFull;
         int64_t fullCorrSkip = (fullPasses * numRowsFull * (numRowsFull - 1) + (numRows - fullPasses * numRowsFull) * (numRows - fullPasses * numRowsFull - 1)) / 2;
-#ifdef CARET_OMP
-        targetBytes -= inrowBytes * omp_get_max_threads();
-#else
-        targetBytes -= inrowBytes;//1 row in memory that isn't a reference to cache
-#endif
+        targetBytes -= CiftiRowCache::getRingBytesForMemLimit(m_numCols, memLimitGB);//ring of rows being read ahead
         int64_t numPassesPartial = ((outrowBytes + inrowBytes) * numRows + targetBytes - 1) / targetBytes;//break the partial cached passes up equally, to use less memory, and so we don't get an anemic pass at the end
         if (numPassesPartial < 1)
         {
@@ -1268,11 +1295,7 @@ int AlgorithmCiftiCorrelationGradient::numRowsForMem(const float& memLimitGB, co
     } else {//if we can't cache the whole thing, split passes evenly
         cacheFullInput = false;
         int64_t div = max((int64_t)1, (outrowBytes + inrowBytes) * numRows);
-#ifdef CARET_OMP
-        targetBytes -= inrowBytes * omp_get_max_threads();
-#else
-        targetBytes -= inrowBytes;//1 row in memory that isn't a reference to cache
-#endif
+        targetBytes -= CiftiRowCache::getRingBytesForMemLimit(m_numCols, memLimitGB);//ring of rows being read ahead
         int64_t numPassesPartial = (targetBytes + div - 1) / targetBytes;
         int ret = (numRows + numPassesPartial - 1) / numPassesPartial;
         if (ret < 1) ret = 1;//sanitize, just in case
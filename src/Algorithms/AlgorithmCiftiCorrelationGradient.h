@@ -27,6 +27,8 @@
 
 namespace caret {
     
+    class CiftiRowCache;
+    
     class AlgorithmCiftiCorrelationGradient : public AbstractAlgorithm
     {
         AlgorithmCiftiCorrelationGradient();
@@ -54,13 +56,16 @@ namespace caret {
         int m_numCols;
         bool m_undoFisherInput, m_applyFisher;
         const CiftiFile* m_inputCifti;//so that accesses work through the cache functions
+        CaretPointer<CiftiRowCache> m_rowStream;//reads the moving rows in the background, so IO overlaps the correlations
         void cacheRows(const std::vector<int>& ciftiIndices);//grabs the rows and does whatever it needs to, using as much IO bandwidth and CPU resources as available/needed
         void clearCache();
         const float* getRow(const int& ciftiIndex, float& rootResidSqr, const bool& mustBeCached = false);
         void adjustRow(float* rowOut, const int& ciftiIndex);//does the reverse fisher transform, computes stuff, subtracts mean
+        void startRowStream(const std::vector<int64_t>& rowOrder);//skips rows that are cached
+        const float* getStreamedRow(int64_t& ticketOut, float& rootResidSqr);//next moving row, release the ticket when done with it
         float* getTempRow();
         float correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2);
-        void init(const CiftiFile* input, const bool& undoFisherInput, const bool& applyFisher);
+        void init(const CiftiFile* input, const bool& undoFisherInput, const bool& applyFisher, const float& memLimitGB);
         int numRowsForMem(const float& memLimitGB, const int64_t& inrowBytes, const int64_t& outrowBytes, const int& numRows, bool& cacheFullInput);
         //void processSurfaceComponentLocal(StructureEnum::Enum& myStructure, const float& surfKern, const float& memLimitGB, SurfaceFile* mySurf);
         void processSurfaceComponent(StructureEnum::Enum& myStructure, const float& surfKern, const float& memLimitGB, SurfaceFile* mySurf, const MetricFile* myAreas);
@@ -134,10 +134,11 @@ AlgorithmFiberDotProducts::AlgorithmFiberDotProducts(ProgressObject* myProgObj,
         myDotProdOut->setColumnName(i, "Fiber " + AString::number(i + 1) + " dot products");
         myFSampOut->setColumnName(i, "Fiber " + AString::number(i + 1) + " population mean f");
     }
-    const float* coordData = mySurf->getCoordinateData();
+    vector<int32_t> closestSamples(numNodes);
+    myLocator.closestPoints(mySurf->getCoordinateData(), numNodes, closestSamples.data());
     for (int i = 0; i < numNodes; ++i)
     {
-        int closest = myLocator.closestPoint(coordData + i * 3);
+        int closest = closestSamples[i];
         if (closest != -1)
         {
             myFibers->getRow(rowScratch.data(), coordIndices[closest]);
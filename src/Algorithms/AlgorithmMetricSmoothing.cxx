@@ -25,8 +25,10 @@
 #include "GeodesicHelper.h"
 #include "MetricFile.h"
 #include "PaletteColorMapping.h"
+#include "PerformanceStatistics.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
@@ -190,29 +192,43 @@ AlgorithmMetricSmoothing::AlgorithmMetricSmoothing(ProgressObject* myProgObj, co
         areaData = corrAreaMetric->getValuePointerForColumn(0);
     }
     myProgress.setTask("Precomputing Smoothing Weights");
-    if (matchRoiColumns)
     {
-        mySmoothObj.grabNew(new MetricSmoothingObject(mySurf, myKernel, NULL, myMethod, areaData));//don't use an ROI to build weights when the ROI changes each time
-    } else {
-        mySmoothObj.grabNew(new MetricSmoothingObject(mySurf, myKernel, myRoi, myMethod, areaData));
+        PerformancePhaseTimer phaseTimer("metric smoothing weights");
+        if (matchRoiColumns)
+        {
+            mySmoothObj.grabNew(new MetricSmoothingObject(mySurf, myKernel, NULL, myMethod, areaData));//don't use an ROI to build weights when the ROI changes each time
+        } else {
+            mySmoothObj.grabNew(new MetricSmoothingObject(mySurf, myKernel, myRoi, myMethod, areaData));
+        }
     }
     myProgress.reportProgress(precomputeWeightWork);
+    PerformancePhaseTimer phaseTimer("metric smoothing columns");
     if (columnNum == -1)
     {
         myMetricOut->setNumberOfNodesAndColumns(numNodes, myMetric->getNumberOfColumns());
         myMetricOut->setStructure(mySurf->getStructure());
         for (int32_t col = 0; col < numCols; ++col)
         {
-            myProgress.setTask("Smoothing Column " + AString::number(col));
             myMetricOut->setColumnName(col, myMetric->getColumnName(col) + ", smooth " + AString::number(myKernel));
             *(myMetricOut->getPaletteColorMapping(col)) = *(myMetric->getPaletteColorMapping(col));//copy the palette settings
-            if (myRoi != NULL && matchRoiColumns)
+        }
+        if (myRoi != NULL && matchRoiColumns)
+        {//roi differs per column, so they can't share a pass over the weights
+            for (int32_t col = 0; col < numCols; ++col)
             {
+                myProgress.setTask("Smoothing Column " + AString::number(col));
                 mySmoothObj->smoothColumn(myMetric, col, myMetricOut, col, myRoi, col, fixZeros);
-            } else {
-                mySmoothObj->smoothColumn(myMetric, col, myMetricOut, col, myRoi, 0, fixZeros);
+                myProgress.reportProgress(precomputeWeightWork + ((float)col + 1) / numCols);
+            }
+        } else {
+            const int32_t COLUMNS_PER_PASS = 64;//smoothColumns blocks internally, this is just for progress reporting
+            for (int32_t col = 0; col < numCols; col += COLUMNS_PER_PASS)
+            {
+                int32_t passColumns = min(COLUMNS_PER_PASS, numCols - col);
+                myProgress.setTask("Smoothing Columns " + AString::number(col) + " to " + AString::number(col + passColumns - 1));
+                mySmoothObj->smoothColumns(myMetric, col, passColumns, myMetricOut, col, myRoi, 0, fixZeros);
+                myProgress.reportProgress(precomputeWeightWork + ((float)col + passColumns) / numCols);
             }
-            myProgress.reportProgress(precomputeWeightWork + ((float)col + 1) / numCols);
         }
     } else {
         myMetricOut->setNumberOfNodesAndColumns(numNodes, 1);
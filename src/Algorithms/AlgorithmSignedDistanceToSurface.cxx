@@ -92,15 +92,10 @@ AlgorithmSignedDistanceToSurface::AlgorithmSignedDistanceToSurface(ProgressObjec
     int numNodes = testSurf->getNumberOfNodes();
     myMetricOut->setNumberOfNodesAndColumns(numNodes, 1);
     myMetricOut->setStructure(testSurf->getStructure());
-#pragma omp CARET_PAR
-    {
-        CaretPointer<SignedDistanceHelper> myHelp = levelSetSurf->getSignedDistanceHelper();
-#pragma omp CARET_FOR schedule(dynamic)
-        for (int i = 0; i < numNodes; ++i)
-        {
-            myMetricOut->setValue(i, 0, myHelp->dist(testSurf->getCoordinate(i), myWinding));
-        }
-    }
+    CaretPointer<SignedDistanceHelper> myHelp = levelSetSurf->getSignedDistanceHelper();
+    vector<float> distances(numNodes);
+    myHelp->dist(testSurf->getCoordinateData(), numNodes, myWinding, distances.data());//runs in parallel
+    myMetricOut->setValuesForColumn(0, distances.data());
 }
 
 float AlgorithmSignedDistanceToSurface::getAlgorithmInternalWeight()
@@ -24,6 +24,9 @@
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "Vector3D.h"
+#include "VolumeResamplingHelper.h"
+
+#include <QCryptographicHash>
 
 using namespace caret;
 using namespace std;
@@ -56,9 +59,13 @@ OperationParameters* AlgorithmVolumeAffineResample::getParameters()
     flirtOpt->addStringParameter(1, "source-volume", "the source volume used when generating the affine");
     flirtOpt->addStringParameter(2, "target-volume", "the target volume used when generating the affine");
     
+    OptionalParameter* planOpt = ret->createOptionalParameter(7, "-plan-file", "reuse the resampling weights across runs");
+    planOpt->addStringParameter(1, "file", "file to load the weights from, or save them to");
+    
     ret->setHelpText(
         AString("Resample a volume file with an affine transformation.  The parameter <method> must be one of:\n\n") +
-        "CUBIC\nENCLOSING_VOXEL\nTRILINEAR"
+        "CUBIC\nENCLOSING_VOXEL\nTRILINEAR\n\n" +
+        VolumeResamplingHelper::getHelpText("affine")
     );
     return ret;
 }
@@ -71,6 +78,12 @@ void AlgorithmVolumeAffineResample::useParameters(OperationParameters* myParams,
     AString method = myParams->getString(4);
     VolumeFile* outVol = myParams->getOutputVolume(5);
     OptionalParameter* flirtOpt = myParams->getOptionalParameter(6);
+    AString planFile;
+    OptionalParameter* planOpt = myParams->getOptionalParameter(7);
+    if (planOpt->m_present)
+    {
+        planFile = planOpt->getString(1);
+    }
     AffineFile myAffine;
     if (flirtOpt->m_present)
     {
@@ -92,11 +105,68 @@ void AlgorithmVolumeAffineResample::useParameters(OperationParameters* myParams,
     FloatMatrix affMat = FloatMatrix(myAffine.getMatrix());
     vector<int64_t> refDims;
     refSpace->getDimensions(refDims);
-    AlgorithmVolumeAffineResample(myProgObj, inVol, affMat, refDims.data(), refSpace->getSform(), myMethod, outVol);
+    AlgorithmVolumeAffineResample(myProgObj, inVol, affMat, refDims.data(), refSpace->getSform(), myMethod, outVol, planFile);
+}
+
+namespace
+{
+    class AffineCoordinates : public VolumeResamplingHelper::CoordinateSource
+    {
+        const VolumeFile* m_outVol;
+        FloatMatrix m_targetToSource;
+        Vector3D m_xvec, m_yvec, m_zvec, m_offset;
+    public:
+        AffineCoordinates(const VolumeFile* outVol, const FloatMatrix& targetToSource)
+        {
+            m_outVol = outVol;
+            m_targetToSource = targetToSource;
+            m_xvec[0] = targetToSource[0][0]; m_xvec[1] = targetToSource[1][0]; m_xvec[2] = targetToSource[2][0];
+            m_yvec[0] = targetToSource[0][1]; m_yvec[1] = targetToSource[1][1]; m_yvec[2] = targetToSource[2][1];
+            m_zvec[0] = targetToSource[0][2]; m_zvec[1] = targetToSource[1][2]; m_zvec[2] = targetToSource[2][2];
+            m_offset[0] = targetToSource[0][3]; m_offset[1] = targetToSource[1][3]; m_offset[2] = targetToSource[2][3];
+        }
+        
+        void getSourceCoordinates(const int64_t& kStart, const int64_t& kEnd, float* coordsOut, char*) const
+        {
+            const int64_t* outDims = m_outVol->getDimensionsPtr();
+            int64_t planeSize = outDims[0] * outDims[1];
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int64_t k = kStart; k < kEnd; ++k)
+            {
+                for (int64_t j = 0; j < outDims[1]; ++j)
+                {
+                    for (int64_t i = 0; i < outDims[0]; ++i)
+                    {
+                        Vector3D outCoord, inCoord;
+                        m_outVol->indexToSpace(i, j, k, outCoord);
+                        inCoord = m_xvec * outCoord[0] + m_yvec * outCoord[1] + m_zvec * outCoord[2] + m_offset;
+                        float* coord = coordsOut + (m_outVol->getIndex(i, j, k) - kStart * planeSize) * 3;
+                        coord[0] = inCoord[0];
+                        coord[1] = inCoord[1];
+                        coord[2] = inCoord[2];
+                    }
+                }
+            }
+        }
+        
+        void addToIdentifier(QCryptographicHash& hash) const
+        {
+            hash.addData("affine", 7);
+            for (int i = 0; i < 3; ++i)
+            {
+                for (int j = 0; j < 4; ++j)
+                {
+                    float value = m_targetToSource[i][j];
+                    hash.addData((const char*)&value, sizeof(float));
+                }
+            }
+        }
+    };
 }
 
 AlgorithmVolumeAffineResample::AlgorithmVolumeAffineResample(ProgressObject* myProgObj, const VolumeFile* inVol, const FloatMatrix& myAffine,
-                                                             const int64_t refDims[3], const vector<vector<float> >& refSform, const VolumeFile::InterpType& myMethod, VolumeFile* outVol) : AbstractAlgorithm(myProgObj)
+                                                             const int64_t refDims[3], const vector<vector<float> >& refSform, const VolumeFile::InterpType& myMethod, VolumeFile* outVol,
+                                                             const AString& planFile) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     int64_t affRows, affColumns;
@@ -116,11 +186,6 @@ AlgorithmVolumeAffineResample::AlgorithmVolumeAffineResample(ProgressObject* myP
     targetToSource[3][2] = 0.0f;
     targetToSource[3][3] = 1.0f;
     targetToSource = targetToSource.inverse();
-    Vector3D xvec, yvec, zvec, offset;
-    xvec[0] = targetToSource[0][0]; xvec[1] = targetToSource[1][0]; xvec[2] = targetToSource[2][0];
-    yvec[0] = targetToSource[0][1]; yvec[1] = targetToSource[1][1]; yvec[2] = targetToSource[2][1];
-    zvec[0] = targetToSource[0][2]; zvec[1] = targetToSource[1][2]; zvec[2] = targetToSource[2][2];
-    offset[0] = targetToSource[0][3]; offset[1] = targetToSource[1][3]; offset[2] = targetToSource[2][3];
     if (inVol->isMappedWithLabelTable())
     {
         if (myMethod != VolumeFile::ENCLOSING_VOXEL)
@@ -132,35 +197,7 @@ AlgorithmVolumeAffineResample::AlgorithmVolumeAffineResample(ProgressObject* myP
             *(outVol->getMapLabelTable(i)) = *(inVol->getMapLabelTable(i));
         }
     }
-    for (int64_t c = 0; c < numComponents; ++c)
-    {
-        for (int64_t b = 0; b < numMaps; ++b)
-        {
-            if (myMethod == VolumeFile::CUBIC)
-            {
-                inVol->validateSpline(b, c);//because deconvolve is parallel, but won't execute parallel if we are already in a parallel section
-            }
-#pragma omp CARET_PARFOR schedule(dynamic)
-            for (int64_t k = 0; k < outDims[2]; ++k)
-            {
-                for (int64_t j = 0; j < outDims[1]; ++j)
-                {
-                    for (int64_t i = 0; i < outDims[0]; ++i)
-                    {
-                        Vector3D outCoord, inCoord;
-                        outVol->indexToSpace(i, j, k, outCoord);
-                        inCoord = xvec * outCoord[0] + yvec * outCoord[1] + zvec * outCoord[2] + offset;
-                        float interpVal = inVol->interpolateValue(inCoord, myMethod, NULL, b, c);
-                        outVol->setValue(interpVal, i, j, k, b, c);
-                    }
-                }
-            }
-            if (myMethod == VolumeFile::CUBIC)
-            {
-                inVol->freeSpline(b, c);//release memory we no longer need, if we allocated it
-            }
-        }
-    }
+    VolumeResamplingHelper::resample(inVol, outVol, myMethod, AffineCoordinates(outVol, targetToSource), planFile);
 }
 
 float AlgorithmVolumeAffineResample::getAlgorithmInternalWeight()
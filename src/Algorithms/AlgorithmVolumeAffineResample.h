@@ -35,7 +35,8 @@ namespace caret {
         static float getAlgorithmInternalWeight();
     public:
         AlgorithmVolumeAffineResample(ProgressObject* myProgObj, const VolumeFile* inVol, const FloatMatrix& myAffine,
-                                      const int64_t refDims[3], const std::vector<std::vector<float> >& refSform, const VolumeFile::InterpType& myMethod, VolumeFile* outVol);
+                                      const int64_t refDims[3], const std::vector<std::vector<float> >& refSform, const VolumeFile::InterpType& myMethod, VolumeFile* outVol,
+                                      const AString& planFile = "");
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
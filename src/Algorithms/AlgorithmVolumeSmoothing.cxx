@@ -25,6 +25,7 @@
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "CaretAssert.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
@@ -157,24 +158,60 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
             float tempf = kspace * (k - krange) / kernel;
             kweights[k] = exp(-tempf * tempf / 2.0f);
         }
+        CaretArray<float> iweightSums(myDims[0]);//without -fix-zeros, the i pass weight sum depends only on i, accumulate in the same order as the kernel loop
+        for (int64_t i = 0; i < myDims[0]; ++i)
+        {
+            int64_t imin = max(i - irange, (int64_t)0), imax = min(i + irange + 1, myDims[0]);
+            float weightsum = 0.0f;
+            for (int64_t ikern = imin; ikern < imax; ++ikern)
+            {
+                weightsum += iweights[ikern - i + irange];
+            }
+            iweightSums[i] = weightsum;
+        }
         if (subvol == -1)
         {
             vector<int64_t> origDims = inVol->getOriginalDimensions();
             outVol->reinitialize(origDims, volSpace, myDims[4]);
-            vector<int> lists[3];
             for (int s = 0; s < myDims[3]; ++s)
             {
                 outVol->setMapName(s, inVol->getMapName(s) + ", smooth " + AString::number(kernel));
-                for (int c = 0; c < myDims[4]; ++c)
+            }
+            int64_t numFrames = myDims[3] * myDims[4];
+            bool parallelFrames = false;
+#ifdef CARET_OMP
+            parallelFrames = (roiVol == NULL && numFrames >= omp_get_max_threads() && numFrames > 1);//one frame per thread keeps every core busy even when frames are small
+#endif
+            if (parallelFrames)
+            {
+#pragma omp CARET_PAR
                 {
-                    const float* inFrame = inVol->getFrame(s, c);
-                    if (roiVol == NULL)
+                    int64_t frameSize = myDims[0] * myDims[1] * myDims[2];
+                    vector<float> threadFrame(frameSize), threadFrame2(frameSize), threadWeights(frameSize), threadWeights2(frameSize);
+#pragma omp CARET_FOR schedule(dynamic)
+                    for (int64_t frame = 0; frame < numFrames; ++frame)
                     {
-                        smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
-                    } else {
-                        smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
+                        int64_t s = frame % myDims[3], c = frame / myDims[3];
+                        smoothFrame(inVol->getFrame(s, c), myDims, threadFrame.data(), threadFrame2.data(), threadWeights.data(), threadWeights2.data(),
+                                    iweights, jweights, kweights, iweightSums, irange, jrange, krange, fixZeros, false);
+                        outVol->setFrame(threadFrame.data(), s, c);
+                    }
+                }
+            } else {
+                vector<int> lists[3];
+                for (int s = 0; s < myDims[3]; ++s)
+                {
+                    for (int c = 0; c < myDims[4]; ++c)
+                    {
+                        const float* inFrame = inVol->getFrame(s, c);
+                        if (roiVol == NULL)
+                        {
+                            smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, iweights, jweights, kweights, iweightSums, irange, jrange, krange, fixZeros, true);
+                        } else {
+                            smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
+                        }
+                        outVol->setFrame(scratchFrame, s, c);
                     }
-                    outVol->setFrame(scratchFrame, s, c);
                 }
             }
         } else {
@@ -191,7 +228,7 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
                 const float* inFrame = inVol->getFrame(subvol, c);
                 if (roiVol == NULL)
                 {
-                    smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
+                    smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, iweights, jweights, kweights, iweightSums, irange, jrange, krange, fixZeros, true);
                 } else {
                     smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
                 }
@@ -273,86 +310,118 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
     }
 }
 
-void AlgorithmVolumeSmoothing::smoothFrame(const float* inFrame, vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchWeights, CaretArray<float> scratchWeights2, const VolumeFile* inVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights, int irange, int jrange, int krange, const bool& fixZeros)
+void AlgorithmVolumeSmoothing::smoothFrame(const float* inFrame, const vector<int64_t>& myDims, float* scratchFrame, float* scratchFrame2, float* scratchWeights, float* scratchWeights2,
+                                           const float* iweights, const float* jweights, const float* kweights, const float* iweightSums, int irange, int jrange, int krange, const bool& fixZeros,
+                                           const bool& parallelSlices)
 {//this function should ONLY get invoked when the volume is orthogonal (axes are perpendicular, not necessarily aligned with x, y, z, and not necessarily equal spacing)
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int k = 0; k < myDims[2]; ++k)//smooth along i axis
+    //every pass works on whole rows along i, so the inner loops are contiguous and vectorizable - each voxel still accumulates its kernel in ascending order, so results are unchanged
+    const int64_t isize = myDims[0], jsize = myDims[1], ksize = myDims[2], sliceSize = isize * jsize;
+#pragma omp CARET_PARFOR schedule(dynamic) if(parallelSlices)
+    for (int64_t k = 0; k < ksize; ++k)//smooth along i axis
     {
-        for (int j = 0; j < myDims[1]; ++j)
+        for (int64_t j = 0; j < jsize; ++j)
         {
-            for (int i = 0; i < myDims[0]; ++i)
+            int64_t baseInd = k * sliceSize + j * isize;
+            const float* inRow = inFrame + baseInd;
+            float* sumRow = scratchFrame + baseInd;
+            float* weightRow = scratchWeights + baseInd;
+            if (fixZeros)
             {
-                int imin = i - irange, imax = i + irange + 1;//one-after array size convention
-                if (imin < 0) imin = 0;
-                if (imax > myDims[0]) imax = myDims[0];
-                float sum = 0.0f, weightsum = 0.0f;
-                int64_t baseInd = inVol->getIndex(0, j, k, 0);//extra 0 on a default parameter is to prevent int->pointer vs int->int64 conversion ambiguity
-                int64_t curInd = baseInd + i;
-                for (int ikern = imin; ikern < imax; ++ikern)
+                for (int64_t i = 0; i < isize; ++i)
                 {
-                    int64_t thisIndex = baseInd + ikern;
-                    if ((!fixZeros || inFrame[thisIndex] != 0.0f))
+                    int64_t imin = max(i - irange, (int64_t)0), imax = min(i + irange + 1, isize);//one-after array size convention
+                    float sum = 0.0f, weightsum = 0.0f;
+                    for (int64_t ikern = imin; ikern < imax; ++ikern)
                     {
-                        float weight = iweights[ikern - i + irange];
-                        weightsum += weight;
-                        sum += weight * inFrame[thisIndex];
+                        if (inRow[ikern] != 0.0f)
+                        {
+                            float weight = iweights[ikern - i + irange];
+                            weightsum += weight;
+                            sum += weight * inRow[ikern];
+                        }
+                    }
+                    weightRow[i] = weightsum;
+                    sumRow[i] = sum;//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
+                }
+            } else {//no zero test, so use the precomputed weight sums and sweep the kernel across the whole row
+                for (int64_t i = 0; i < isize; ++i)
+                {
+                    sumRow[i] = 0.0f;
+                    weightRow[i] = iweightSums[i];
+                }
+                for (int64_t offset = -irange; offset <= irange; ++offset)
+                {
+                    float weight = iweights[offset + irange];
+                    int64_t istart = max(-offset, (int64_t)0), iend = min(isize - offset, isize);
+                    const float* shiftedRow = inRow + offset;
+                    for (int64_t i = istart; i < iend; ++i)
+                    {
+                        sumRow[i] += weight * shiftedRow[i];
                     }
                 }
-                scratchWeights[curInd] = weightsum;
-                scratchFrame[curInd] = sum;//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
             }
         }
     }
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int k = 0; k < myDims[2]; ++k)//now j
+#pragma omp CARET_PARFOR schedule(dynamic) if(parallelSlices)
+    for (int64_t k = 0; k < ksize; ++k)//now j
     {
-        for (int i = 0; i < myDims[0]; ++i)
+        for (int64_t j = 0; j < jsize; ++j)
         {
-            for (int j = 0; j < myDims[1]; ++j)//step along the dimension being smoothed last for best cache coherence
+            int64_t jmin = max(j - jrange, (int64_t)0), jmax = min(j + jrange + 1, jsize);//one-after array size convention
+            float* sumRow = scratchFrame2 + k * sliceSize + j * isize;
+            float* weightRow = scratchWeights2 + k * sliceSize + j * isize;
+            for (int64_t i = 0; i < isize; ++i)
+            {
+                sumRow[i] = 0.0f;
+                weightRow[i] = 0.0f;
+            }
+            for (int64_t jkern = jmin; jkern < jmax; ++jkern)
             {
-                int jmin = j - jrange, jmax = j + jrange + 1;//one-after array size convention
-                if (jmin < 0) jmin = 0;
-                if (jmax > myDims[1]) jmax = myDims[1];
-                float sum = 0.0f, weightsum = 0.0f;
-                int64_t baseInd = inVol->getIndex(i, 0, k);
-                int64_t curInd = baseInd + j * myDims[0];
-                for (int jkern = jmin; jkern < jmax; ++jkern)
+                float weight = jweights[jkern - j + jrange];
+                const float* inSumRow = scratchFrame + k * sliceSize + jkern * isize;
+                const float* inWeightRow = scratchWeights + k * sliceSize + jkern * isize;
+                for (int64_t i = 0; i < isize; ++i)
                 {
-                    int64_t thisIndex = baseInd + jkern * myDims[0];
-                    float weight = jweights[jkern - j + jrange];
-                    weightsum += weight * scratchWeights[thisIndex];
-                    sum += weight * scratchFrame[thisIndex];
+                    weightRow[i] += weight * inWeightRow[i];
+                    sumRow[i] += weight * inSumRow[i];//we now have the weighted sum of the weight sums
                 }
-                scratchWeights2[curInd] = weightsum;
-                scratchFrame2[curInd] = sum;//we now have the weighted sum of the weight sums
             }
         }
     }
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int j = 0; j < myDims[1]; ++j)//and finally k
+#pragma omp CARET_PAR if(parallelSlices)
     {
-        for (int i = 0; i < myDims[0]; ++i)
+        vector<float> sumRow(isize), weightRow(isize);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t k = 0; k < ksize; ++k)//and finally k
         {
-            for (int k = 0; k < myDims[2]; ++k)//ditto
+            int64_t kmin = max(k - krange, (int64_t)0), kmax = min(k + krange + 1, ksize);//one-after array size convention
+            for (int64_t j = 0; j < jsize; ++j)
             {
-                int64_t baseInd = inVol->getIndex(i, j, 0);
-                int64_t curInd = baseInd + k * myDims[0] * myDims[1];
-                int kmin = k - krange, kmax = k + krange + 1;//one-after array size convention
-                if (kmin < 0) kmin = 0;
-                if (kmax > myDims[2]) kmax = myDims[2];
-                float sum = 0.0f, weightsum = 0.0f;
-                for (int kkern = kmin; kkern < kmax; ++kkern)
+                for (int64_t i = 0; i < isize; ++i)
+                {
+                    sumRow[i] = 0.0f;
+                    weightRow[i] = 0.0f;
+                }
+                for (int64_t kkern = kmin; kkern < kmax; ++kkern)
                 {
-                    int64_t thisIndex = baseInd + kkern * myDims[0] * myDims[1];
                     float weight = kweights[kkern - k + krange];
-                    weightsum += weight * scratchWeights2[thisIndex];
-                    sum += weight * scratchFrame2[thisIndex];
+                    const float* inSumRow = scratchFrame2 + kkern * sliceSize + j * isize;
+                    const float* inWeightRow = scratchWeights2 + kkern * sliceSize + j * isize;
+                    for (int64_t i = 0; i < isize; ++i)
+                    {
+                        weightRow[i] += weight * inWeightRow[i];
+                        sumRow[i] += weight * inSumRow[i];
+                    }
                 }
-                if (weightsum != 0.0f)
+                float* outRow = scratchFrame + k * sliceSize + j * isize;//the i pass results are no longer needed
+                for (int64_t i = 0; i < isize; ++i)
                 {
-                    scratchFrame[curInd] = sum / weightsum;//NOW we can divide
-                } else {
-                    scratchFrame[curInd] = 0.0f;
+                    if (weightRow[i] != 0.0f)
+                    {
+                        outRow[i] = sumRow[i] / weightRow[i];//NOW we can divide
+                    } else {
+                        outRow[i] = 0.0f;
+                    }
                 }
             }
         }
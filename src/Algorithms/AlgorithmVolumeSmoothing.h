@@ -32,9 +32,9 @@ namespace caret {
     protected:
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
-        void smoothFrame(const float* inFrame, std::vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchWeights,
-                         CaretArray<float> scratchWeights2, const VolumeFile* inVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights,
-                         int irange, int jrange, int krange, const bool& fixZeros);
+        void smoothFrame(const float* inFrame, const std::vector<int64_t>& myDims, float* scratchFrame, float* scratchFrame2, float* scratchWeights, float* scratchWeights2,
+                         const float* iweights, const float* jweights, const float* kweights, const float* iweightSums, int irange, int jrange, int krange, const bool& fixZeros,
+                         const bool& parallelSlices);
         void smoothFrameROI(const float* inFrame, std::vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchFrame3,
                                               CaretArray<float> scratchWeights, CaretArray<float> scratchWeights2, std::vector<int> lists[3],
                                               const VolumeFile* inVol, const VolumeFile* roiVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights,
@@ -56,6 +56,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "TopologyHelper.h"
 #include "Vector3D.h"
 #include "VolumeFile.h"
+#include "VolumeInterpolationTable.h"
 
 #include <cmath>
 
@@ -279,16 +280,13 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
             methodName = " enclosing voxel";
             break;
     }
+    VolumeInterpolationTable myTable(myVolume->getVolumeSpace(), mySurface->getCoordinateData(), numNodes, myMethod);//the vertices are the same for every frame, so compute weights once
     if (mySubVol == -1)
     {
         for (int64_t i = 0; i < myVolDims[3]; ++i)
         {
             for (int64_t j = 0; j < myVolDims[4]; ++j)
             {
-                if (myMethod == VolumeFile::CUBIC)
-                {
-                    myVolume->validateSpline(i, j);//to do spline deconvolution in parallel
-                }
                 AString metricLabel = myVolume->getMapName(i);
                 if (myVolDims[4] != 1)
                 {
@@ -297,11 +295,7 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
                 metricLabel += methodName;
                 int64_t thisCol = i * myVolDims[4] + j;
                 myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR
-                for (int64_t node = 0; node < numNodes; ++node)
-                {
-                    myArray[node] = myVolume->interpolateValue(mySurface->getCoordinate(node), myMethod, NULL, i, j);
-                }
+                myVolume->interpolateValues(myTable, myArray.data(), i, j);
                 if (myMethod == VolumeFile::CUBIC)
                 {
                     myVolume->freeSpline(i, j);//release memory we no longer need, if we allocated it
@@ -312,10 +306,6 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
     } else {
         for (int64_t j = 0; j < myVolDims[4]; ++j)
         {
-            if (myMethod == VolumeFile::CUBIC)
-            {
-                myVolume->validateSpline(mySubVol, j);//to do spline deconvolution in parallel
-            }
             AString metricLabel = myVolume->getMapName(mySubVol);
             if (myVolDims[4] != 1)
             {
@@ -324,11 +314,7 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
             metricLabel += methodName;
             int64_t thisCol = j;
             myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR
-            for (int64_t node = 0; node < numNodes; ++node)
-            {
-                myArray[node] = myVolume->interpolateValue(mySurface->getCoordinate(node), myMethod, NULL, mySubVol, j);
-            }
+            myVolume->interpolateValues(myTable, myArray.data(), mySubVol, j);
             if (myMethod == VolumeFile::CUBIC)
             {
                 myVolume->freeSpline(mySubVol, j);//release memory we no longer need, if we allocated it
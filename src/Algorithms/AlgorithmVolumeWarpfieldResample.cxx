@@ -24,8 +24,12 @@
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "Vector3D.h"
+#include "VolumeInterpolationTable.h"
+#include "VolumeResamplingHelper.h"
 #include "WarpfieldFile.h"
 
+#include <QCryptographicHash>
+
 using namespace caret;
 using namespace std;
 
@@ -55,9 +59,13 @@ OperationParameters* AlgorithmVolumeWarpfieldResample::getParameters()
     OptionalParameter* fnirtOpt = ret->createOptionalParameter(6, "-fnirt", "MUST be used if using a fnirt warpfield");
     fnirtOpt->addStringParameter(1, "source-volume", "the source volume used when generating the warpfield");
     
+    OptionalParameter* planOpt = ret->createOptionalParameter(7, "-plan-file", "reuse the resampling weights across runs");
+    planOpt->addStringParameter(1, "file", "file to load the weights from, or save them to");
+    
     ret->setHelpText(
         AString("Resample a volume file with a warpfield.  The parameter <method> must be one of:\n\n") +
-        "CUBIC\nENCLOSING_VOXEL\nTRILINEAR"
+        "CUBIC\nENCLOSING_VOXEL\nTRILINEAR\n\n" +
+        VolumeResamplingHelper::getHelpText("warpfield")
     );
     return ret;
 }
@@ -70,6 +78,12 @@ void AlgorithmVolumeWarpfieldResample::useParameters(OperationParameters* myPara
     AString method = myParams->getString(4);
     VolumeFile* outVol = myParams->getOutputVolume(5);
     OptionalParameter* fnirtOpt = myParams->getOptionalParameter(6);
+    AString planFile;
+    OptionalParameter* planOpt = myParams->getOptionalParameter(7);
+    if (planOpt->m_present)
+    {
+        planFile = planOpt->getString(1);
+    }
     WarpfieldFile myWarpfield;
     if (fnirtOpt->m_present)
     {
@@ -90,11 +104,74 @@ void AlgorithmVolumeWarpfieldResample::useParameters(OperationParameters* myPara
     }
     vector<int64_t> refDims;
     refSpace->getDimensions(refDims);
-    AlgorithmVolumeWarpfieldResample(myProgObj, inVol, myWarpfield.getWarpfield(), refDims.data(), refSpace->getSform(), myMethod, outVol);
+    AlgorithmVolumeWarpfieldResample(myProgObj, inVol, myWarpfield.getWarpfield(), refDims.data(), refSpace->getSform(), myMethod, outVol, planFile);
+}
+
+namespace
+{
+    class WarpfieldCoordinates : public VolumeResamplingHelper::CoordinateSource
+    {
+        const VolumeFile* m_outVol;
+        const VolumeFile* m_warpfield;
+    public:
+        WarpfieldCoordinates(const VolumeFile* outVol, const VolumeFile* warpfield)
+        {
+            m_outVol = outVol;
+            m_warpfield = warpfield;
+        }
+        
+        void getSourceCoordinates(const int64_t& kStart, const int64_t& kEnd, float* coordsOut, char* validOut) const
+        {
+            const int64_t* outDims = m_outVol->getDimensionsPtr();
+            int64_t planeSize = outDims[0] * outDims[1], numPoints = (kEnd - kStart) * planeSize;
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int64_t k = kStart; k < kEnd; ++k)
+            {
+                for (int64_t j = 0; j < outDims[1]; ++j)
+                {
+                    for (int64_t i = 0; i < outDims[0]; ++i)
+                    {
+                        m_outVol->indexToSpace(i, j, k, coordsOut + (m_outVol->getIndex(i, j, k) - kStart * planeSize) * 3);
+                    }
+                }
+            }
+            VolumeInterpolationTable warpTable(m_warpfield->getVolumeSpace(), coordsOut, numPoints, VolumeFile::TRILINEAR);
+            vector<float> displacement(numPoints);
+            for (int i = 0; i < 3; ++i)
+            {
+                m_warpfield->interpolateValues(warpTable, displacement.data(), i);
+                for (int64_t point = 0; point < numPoints; ++point)
+                {
+                    coordsOut[point * 3 + i] = (warpTable.isValid(point) ? coordsOut[point * 3 + i] + displacement[point] : 0.0f);//displace the coordinates in place
+                }
+            }
+            for (int64_t point = 0; point < numPoints; ++point)
+            {
+                validOut[point] = (warpTable.isValid(point) ? 1 : 0);
+            }
+        }
+        
+        void addToIdentifier(QCryptographicHash& hash) const
+        {
+            hash.addData("warpfield", 10);
+            hash.addData((const char*)m_warpfield->getDimensionsPtr(), 3 * sizeof(int64_t));
+            const vector<vector<float> >& warpSform = m_warpfield->getSform();
+            for (int i = 0; i < 3; ++i)
+            {
+                hash.addData((const char*)warpSform[i].data(), 4 * sizeof(float));
+            }
+            const int64_t* warpDims = m_warpfield->getDimensionsPtr();
+            for (int i = 0; i < 3; ++i)
+            {
+                VolumeResamplingHelper::addToHash(hash, m_warpfield->getFrame(i), warpDims[0] * warpDims[1] * warpDims[2] * sizeof(float));
+            }
+        }
+    };
 }
 
 AlgorithmVolumeWarpfieldResample::AlgorithmVolumeWarpfieldResample(ProgressObject* myProgObj, const VolumeFile* inVol, const VolumeFile* warpfield,
-                                                                   const int64_t refDims[3], const vector<vector<float> >& refSform, const VolumeFile::InterpType& myMethod, VolumeFile* outVol) : AbstractAlgorithm(myProgObj)
+                                                                   const int64_t refDims[3], const vector<vector<float> >& refSform, const VolumeFile::InterpType& myMethod, VolumeFile* outVol,
+                                                                   const AString& planFile) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     vector<int64_t> warpDims;
@@ -118,44 +195,7 @@ AlgorithmVolumeWarpfieldResample::AlgorithmVolumeWarpfieldResample(ProgressObjec
             *(outVol->getMapLabelTable(i)) = *(inVol->getMapLabelTable(i));
         }
     }
-    for (int64_t c = 0; c < numComponents; ++c)
-    {
-        for (int64_t b = 0; b < numMaps; ++b)
-        {
-            if (myMethod == VolumeFile::CUBIC)
-            {
-                inVol->validateSpline(b, c);//because deconvolve is parallel, but won't execute parallel if we are already in a parallel section
-            }
-#pragma omp CARET_PARFOR schedule(dynamic)
-            for (int64_t k = 0; k < outDims[2]; ++k)
-            {
-                for (int64_t j = 0; j < outDims[1]; ++j)
-                {
-                    for (int64_t i = 0; i < outDims[0]; ++i)
-                    {
-                        Vector3D outCoord, inCoord, displacement;
-                        outVol->indexToSpace(i, j, k, outCoord);
-                        bool validDisplacement = false;
-                        displacement[0] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, &validDisplacement, 0);
-                        if (validDisplacement)
-                        {
-                            displacement[1] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 1);
-                            displacement[2] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 2);
-                            inCoord = outCoord + displacement;
-                            float interpVal = inVol->interpolateValue(inCoord, myMethod, NULL, b, c);
-                            outVol->setValue(interpVal, i, j, k, b, c);
-                        } else {
-                            outVol->setValue(VolumeFile::INVALID_INTERP_VALUE, i, j, k, b, c);
-                        }
-                    }
-                }
-            }
-            if (myMethod == VolumeFile::CUBIC)
-            {
-                inVol->freeSpline(b, c);//release memory we no longer need, if we allocated it
-            }
-        }
-    }
+    VolumeResamplingHelper::resample(inVol, outVol, myMethod, WarpfieldCoordinates(outVol, warpfield), planFile);
 }
 
 float AlgorithmVolumeWarpfieldResample::getAlgorithmInternalWeight()
@@ -29,6 +29,7 @@
 #include "BorderFile.h"
 #include "BorderPointFromSearch.h"
 #include "Brain.h"
+#include "BrainConstants.h"
 #include "BrainStructure.h"
 #include "BrowserTabContent.h"
 #include "CaretDataFileHelper.h"
@@ -170,6 +171,8 @@ Brain::Brain()
     
     m_isSpecFileBeingRead = false;
     
+    m_resetFilesToLoadedStateInGenericScenes = false;
+    
     m_sceneAssistant = new SceneClassAssistant();
     
     m_sceneAssistant->add("displayPropertiesBorders", 
@@ -216,6 +219,8 @@ Brain::~Brain()
 
     delete m_sceneAssistant;
     
+    clearLoadedDataFileStates();
+    
     for (std::vector<DisplayProperties*>::iterator iter = m_displayProperties.begin();
          iter != m_displayProperties.end();
          iter++) {
@@ -6507,6 +6512,17 @@ Brain::restoreFromScene(const SceneAttributes* sceneAttributes,
                               &specFile, 
                            RESET_BRAIN_KEEP_SCENE_FILES_YES,
                            RESET_BRAIN_KEEP_SPEC_FILE_YES);
+        
+        if (m_resetFilesToLoadedStateInGenericScenes) {
+            saveLoadedDataFileStates();
+        }
+    }
+    else if (m_resetFilesToLoadedStateInGenericScenes) {
+        /*
+         * A generic scene restores only the file state saved in the scene,
+         * anything else would carry over from the previous scene.
+         */
+        restoreLoadedDataFileStates();
     }
     
     /*
@@ -6651,6 +6667,106 @@ Brain::restoreFromScene(const SceneAttributes* sceneAttributes,
                                               sceneClass->getClass("m_identificationManager"));
 }
 
+/**
+ * When restoring scenes, should a generic scene first put the data files
+ * back in the state they had right after a full scene loaded them?  This
+ * lets a generic scene that reuses loaded files display the same as a
+ * full scene that loads them.  The state is saved only while this is on.
+ *
+ * @param status
+ *    New status.
+ */
+void
+Brain::setResetFilesToLoadedStateInGenericScenes(const bool status)
+{
+    m_resetFilesToLoadedStateInGenericScenes = status;
+    if ( ! status) {
+        clearLoadedDataFileStates();
+    }
+}
+
+/**
+ * Set attributes so that all of a data file's state is saved and restored.
+ *
+ * @param attributes
+ *    Attributes that are modified.
+ */
+static void
+setLoadedDataFileStateAttributes(SceneAttributes& attributes)
+{
+    std::vector<int32_t> allTabIndices;
+    for (int32_t i = 0; i < BrainConstants::MAXIMUM_NUMBER_OF_BROWSER_TABS; i++) {
+        allTabIndices.push_back(i);
+    }
+    attributes.setIndicesOfTabsForSavingToScene(allTabIndices);
+    attributes.setModifiedPaletteSettingsSavedToScene(true);
+}
+
+/**
+ * Save the state of every data file, called right after a scene loads the files.
+ */
+void
+Brain::saveLoadedDataFileStates()
+{
+    clearLoadedDataFileStates();
+    
+    SceneAttributes attributes(SceneTypeEnum::SCENE_TYPE_FULL);
+    setLoadedDataFileStateAttributes(attributes);
+    std::vector<CaretDataFile*> allCaretDataFiles;
+    getAllDataFiles(allCaretDataFiles);
+    for (std::vector<CaretDataFile*>::iterator iter = allCaretDataFiles.begin();
+         iter != allCaretDataFiles.end();
+         iter++) {
+        CaretDataFile* caretDataFile = *iter;
+        SceneClass* fileClass = caretDataFile->saveToScene(&attributes,
+                                                           caretDataFile->getFileNameNoPath());
+        if (fileClass != NULL) {
+            m_loadedDataFileStates.push_back(fileClass);
+        }
+    }
+}
+
+/**
+ * Put every data file back in the state saved by saveLoadedDataFileStates().
+ * Files are matched by name, the same as when restoring a scene.
+ */
+void
+Brain::restoreLoadedDataFileStates()
+{
+    SceneAttributes attributes(SceneTypeEnum::SCENE_TYPE_FULL);
+    setLoadedDataFileStateAttributes(attributes);
+    std::vector<CaretDataFile*> allCaretDataFiles;
+    getAllDataFiles(allCaretDataFiles);
+    for (std::vector<CaretDataFile*>::iterator iter = allCaretDataFiles.begin();
+         iter != allCaretDataFiles.end();
+         iter++) {
+        CaretDataFile* caretDataFile = *iter;
+        const AString caretDataFileName = caretDataFile->getFileNameNoPath();
+        for (std::vector<SceneClass*>::iterator stateIter = m_loadedDataFileStates.begin();
+             stateIter != m_loadedDataFileStates.end();
+             stateIter++) {
+            if ((*stateIter)->getName() == caretDataFileName) {
+                caretDataFile->restoreFromScene(&attributes,
+                                                *stateIter);
+            }
+        }
+    }
+}
+
+/**
+ * Free the saved data file states.
+ */
+void
+Brain::clearLoadedDataFileStates()
+{
+    for (std::vector<SceneClass*>::iterator iter = m_loadedDataFileStates.begin();
+         iter != m_loadedDataFileStates.end();
+         iter++) {
+        delete *iter;
+    }
+    m_loadedDataFileStates.clear();
+}
+
 /**
  * @return The selection manager.
  */
@@ -371,6 +371,8 @@ namespace caret {
         virtual void restoreFromScene(const SceneAttributes* sceneAttributes,
                                       const SceneClass* sceneClass);
         
+        void setResetFilesToLoadedStateInGenericScenes(const bool status);
+        
         IdentificationManager* getIdentificationManager();
 
         SelectionManager* getSelectionManager();
@@ -380,6 +382,12 @@ namespace caret {
                               std::vector<CiftiBrainordinateScalarFile*>& ciftiScalarNotShapeFilesOut) const;
         
     private:
+        void saveLoadedDataFileStates();
+        
+        void restoreLoadedDataFileStates();
+        
+        void clearLoadedDataFileStates();
+        
         /**
          * Reset the brain scene file mode
          */
@@ -771,6 +779,12 @@ namespace caret {
         /** The loader of fiber orientation samples */
         FiberOrientationSamplesLoader* m_fiberOrientationSamplesLoader;
         
+        /** When true, a generic scene first puts the data files back in the state they had right after a scene loaded them */
+        bool m_resetFilesToLoadedStateInGenericScenes;
+        
+        /** State of each data file right after a scene loaded it, each class is named with the file's name */
+        std::vector<SceneClass*> m_loadedDataFileStates;
+        
         std::map<DataFileTypeEnum::Enum, int32_t> m_duplicateFileNameCounter;
     };
 
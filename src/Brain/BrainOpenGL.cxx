@@ -409,6 +409,14 @@ BrainOpenGL::initializeOpenGL()
     
 #ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
     s_supportsVertexBuffers = true;
+    
+    /*
+     * Buffer objects became core in OpenGL 1.5, headers may be newer
+     * than the runtime library (as with some offscreen Mesa builds).
+     */
+    if ( ! testForVersionOfOpenGLSupported("1.5")) {
+        s_supportsVertexBuffers = false;
+    }
 #endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
     
     lineInfo += ("\n\nBest Drawing Mode: "
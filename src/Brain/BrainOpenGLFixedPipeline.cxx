@@ -46,6 +46,7 @@
 #include "BrainOpenGLShapeCube.h"
 #include "BrainOpenGLShapeCylinder.h"
 #include "BrainOpenGLShapeSphere.h"
+#include "BrainOpenGLSurfaceBuffers.h"
 #include "BrainOpenGLViewportContent.h"
 #include "BrainStructure.h"
 #include "BrowserTabContent.h"
@@ -78,6 +79,7 @@
 #include "EventManager.h"
 #include "EventModelSurfaceGet.h"
 #include "EventNodeIdentificationColorsGetFromCharts.h"
+#include "EventSurfacesGet.h"
 #include "FastStatistics.h"
 #include "Fiber.h"
 #include "FiberOrientation.h"
@@ -155,6 +157,7 @@ BrainOpenGLFixedPipeline::BrainOpenGLFixedPipeline(BrainOpenGLTextRenderInterfac
     m_shapeCylinder = NULL;
     m_shapeCube   = NULL;
     m_shapeCubeRounded = NULL;
+    m_surfaceBuffers = new BrainOpenGLSurfaceBuffers();
     this->surfaceNodeColoring = new SurfaceNodeColoring();
     m_brain = NULL;
     m_clippingPlaneGroup = NULL;
@@ -185,6 +188,10 @@ BrainOpenGLFixedPipeline::~BrainOpenGLFixedPipeline()
         delete m_shapeCubeRounded;
         m_shapeCubeRounded = NULL;
     }
+    if (m_surfaceBuffers != NULL) {
+        delete m_surfaceBuffers;
+        m_surfaceBuffers = NULL;
+    }
     if (this->surfaceNodeColoring != NULL) {
         delete this->surfaceNodeColoring;
         this->surfaceNodeColoring = NULL;
@@ -366,6 +373,15 @@ BrainOpenGLFixedPipeline::drawModels(std::vector<BrainOpenGLViewportContent*>& v
     
     this->checkForOpenGLError(NULL, "At beginning of drawModels()");
     
+    /*
+     * Free buffers of surfaces that were closed
+     */
+    if (BrainOpenGLSurfaceBuffers::isSupported()) {
+        EventSurfacesGet surfacesGetEvent;
+        EventManager::get()->sendEvent(surfacesGetEvent.getPointer());
+        m_surfaceBuffers->releaseBuffersForUnusedSurfaces(surfacesGetEvent.getSurfaces());
+    }
+    
     /*
      * Default the background colors to first model
      * NOTE: If there are no models, the surface background color is used
@@ -1861,6 +1877,16 @@ void
 BrainOpenGLFixedPipeline::drawSurfaceTrianglesWithVertexArrays(const Surface* surface,
                                                                const float* nodeColoringRGBA)
 {
+    /*
+     * Geometry in buffers is only sent to OpenGL when the surface changes,
+     * vertex arrays from client memory are used if buffers are unavailable
+     */
+    if (m_surfaceBuffers->drawTriangles(surface,
+                                        nodeColoringRGBA,
+                                        m_backgroundColorFloat)) {
+        return;
+    }
+    
     glEnableClientState(GL_VERTEX_ARRAY);
     if (nodeColoringRGBA != NULL) {
         glEnableClientState(GL_COLOR_ARRAY);
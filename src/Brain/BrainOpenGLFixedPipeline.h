@@ -51,6 +51,7 @@ namespace caret {
     class BrainOpenGLShapeCube;
     class BrainOpenGLShapeCylinder;
     class BrainOpenGLShapeSphere;
+    class BrainOpenGLSurfaceBuffers;
     class BrainOpenGLViewportContent;
     class BrowserTabContent;
     class CaretMappableDataFile;
@@ -555,6 +556,9 @@ namespace caret {
         /** Cylinder symbol */
         BrainOpenGLShapeCylinder* m_shapeCylinder;
         
+        /** Surface geometry and coloring kept in buffers of this context */
+        BrainOpenGLSurfaceBuffers* m_surfaceBuffers;
+        
         std::list<FiberOrientation*> m_fiberOrientationsForDrawing;
         
         double inverseRotationMatrix[16];
@@ -101,6 +101,16 @@ BrainOpenGLShape::setImmediateModeOverride(const bool override)
     s_immediateModeOverride = override;
 }
 
+/**
+ * @return True if drawing is forced to immediate mode (such as
+ * during image capture).
+ */
+bool
+BrainOpenGLShape::isImmediateModeOverride()
+{
+    return s_immediateModeOverride;
+}
+
 /**
  * Draw the shape.
  *
@@ -42,6 +42,8 @@ namespace caret {
         
         static void setImmediateModeOverride(const bool override);
         
+        static bool isImmediateModeOverride();
+        
     private:
         BrainOpenGLShape(const BrainOpenGLShape&);
 
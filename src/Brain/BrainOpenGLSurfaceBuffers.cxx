@@ -0,0 +1,424 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <set>
+
+#include "BrainOpenGLSurfaceBuffers.h"
+
+#include "BrainOpenGLShape.h"
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "Surface.h"
+
+using namespace caret;
+
+/**
+ * \class caret::BrainOpenGLSurfaceBuffers 
+ * \brief Keeps surface geometry and coloring in OpenGL buffer objects.
+ *
+ * Coordinates, normal vectors, and triangles of each surface are copied
+ * into buffer objects once and reused until the surface's geometry changes,
+ * so that rotating or zooming does not send the geometry to OpenGL again.
+ * Node coloring is kept in a buffer for each tab's coloring and is copied
+ * only when that coloring is replaced.
+ *
+ * Buffer objects belong to an OpenGL context, so an instance must only be
+ * used (and destroyed) while the same context is current.
+ */
+
+/**
+ * Constructor.
+ */
+BrainOpenGLSurfaceBuffers::BrainOpenGLSurfaceBuffers()
+: CaretObject()
+{
+    
+}
+
+/**
+ * Destructor.
+ */
+BrainOpenGLSurfaceBuffers::~BrainOpenGLSurfaceBuffers()
+{
+    releaseAllBuffers();
+}
+
+/**
+ * @return True if surfaces can be drawn with buffer objects.  When false,
+ * drawTriangles() does nothing and returns false.
+ */
+bool
+BrainOpenGLSurfaceBuffers::isSupported()
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    /*
+     * Image capture may draw into a different context
+     */
+    if (BrainOpenGLShape::isImmediateModeOverride()) {
+        return false;
+    }
+    return BrainOpenGL::isVertexBuffersSupported();
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    return false;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+namespace
+{
+    /*
+     * Copy data into a buffer, creating the buffer if the ID is zero.
+     * Returns false if the buffer could not be created or filled.
+     */
+    bool loadBuffer(const GLenum target,
+                    GLuint& bufferID,
+                    const GLsizeiptr numberOfBytes,
+                    const GLvoid* data,
+                    const GLenum usage)
+    {
+        if (bufferID == 0) {
+            glGenBuffers(1, &bufferID);
+            if (bufferID == 0) {
+                CaretLogSevere("Failed to create a new OpenGL Vertex Buffer");
+                return false;
+            }
+        }
+        glBindBuffer(target, bufferID);
+        glBufferData(target, numberOfBytes, data, usage);
+        glBindBuffer(target, 0);
+        if (glGetError() == GL_OUT_OF_MEMORY) {
+            CaretLogWarning("Insufficient memory for OpenGL Vertex Buffer, surface will be drawn with vertex arrays");
+            return false;
+        }
+        return true;
+    }
+}
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+
+/**
+ * Draw the triangles of a surface using buffer objects.
+ *
+ * @param surface
+ *    Surface that is drawn.
+ * @param nodeColoringRGBA
+ *    RGBA coloring for the nodes, if NULL the background color is used.
+ * @param backgroundRGB
+ *    Background color used when there is no node coloring.
+ * @return
+ *    True if the surface was drawn, false if buffers are not available
+ *    and the caller must draw the surface in another way.
+ */
+bool
+BrainOpenGLSurfaceBuffers::drawTriangles(const Surface* surface,
+                                         const float* nodeColoringRGBA,
+                                         const float backgroundRGB[3])
+{
+    CaretAssert(surface);
+    if ( ! isSupported()) {
+        return false;
+    }
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    SurfaceBuffers* surfaceBuffers = getSurfaceBuffers(surface);
+    if (surfaceBuffers == NULL) {
+        return false;
+    }
+    
+    /*
+     * Coloring that does not belong to the surface (modification count is
+     * negative) is drawn from client memory.
+     */
+    GLuint colorBufferID = 0;
+    if (nodeColoringRGBA != NULL) {
+        const int64_t modificationCount = surface->getNodeColoringModificationCount(nodeColoringRGBA);
+        if (modificationCount >= 0) {
+            if ( ! loadColorBuffer(surface,
+                                   *surfaceBuffers,
+                                   nodeColoringRGBA,
+                                   modificationCount,
+                                   colorBufferID)) {
+                return false;
+            }
+        }
+    }
+    
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    
+    glBindBuffer(GL_ARRAY_BUFFER, surfaceBuffers->m_coordinateBufferID);
+    glVertexPointer(3,
+                    GL_FLOAT,
+                    0,
+                    0);
+    glBindBuffer(GL_ARRAY_BUFFER, surfaceBuffers->m_normalBufferID);
+    glNormalPointer(GL_FLOAT,
+                    0,
+                    0);
+    if (nodeColoringRGBA != NULL) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        if (colorBufferID != 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
+            glColorPointer(4,
+                           GL_FLOAT,
+                           0,
+                           0);
+        }
+        else {
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glColorPointer(4,
+                           GL_FLOAT,
+                           0,
+                           reinterpret_cast<const GLvoid*>(nodeColoringRGBA));
+        }
+    }
+    else {
+        glColor3fv(backgroundRGB);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, surfaceBuffers->m_triangleBufferID);
+    glDrawElements(GL_TRIANGLES,
+                   surfaceBuffers->m_numberOfTriangleVertices,
+                   GL_UNSIGNED_INT,
+                   0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    
+    return true;
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    return false;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Get the buffers for a surface, creating them or replacing their content
+ * if the surface's geometry changed since they were loaded.
+ *
+ * @param surface
+ *    The surface.
+ * @return
+ *    Buffers for the surface or NULL if they could not be created.
+ */
+BrainOpenGLSurfaceBuffers::SurfaceBuffers*
+BrainOpenGLSurfaceBuffers::getSurfaceBuffers(const Surface* surface)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    const int64_t geometryModificationCount = surface->getGeometryModificationCount();
+    std::map<const Surface*, SurfaceBuffers>::iterator iter = m_surfaceBuffers.find(surface);
+    if (iter != m_surfaceBuffers.end()) {
+        if (iter->second.m_geometryModificationCount == geometryModificationCount) {
+            return &iter->second;
+        }
+        
+        /*
+         * Geometry changed (or a new surface is at the address of a
+         * deleted surface), colors are also reloaded.
+         */
+        releaseSurfaceBuffers(iter->second);
+    }
+    else {
+        SurfaceBuffers emptyBuffers;
+        emptyBuffers.m_coordinateBufferID = 0;
+        emptyBuffers.m_normalBufferID     = 0;
+        emptyBuffers.m_triangleBufferID   = 0;
+        iter = m_surfaceBuffers.insert(std::make_pair(surface,
+                                                      emptyBuffers)).first;
+    }
+    
+    SurfaceBuffers& buffers = iter->second;
+    buffers.m_geometryModificationCount = geometryModificationCount;
+    buffers.m_numberOfTriangleVertices  = 3 * surface->getNumberOfTriangles();
+    const GLsizeiptr numberOfCoordinateBytes = 3 * surface->getNumberOfNodes() * sizeof(float);
+    if ((numberOfCoordinateBytes <= 0)
+        || (buffers.m_numberOfTriangleVertices <= 0)
+        || (surface->getNormalData() == NULL)
+        || ( ! loadBuffer(GL_ARRAY_BUFFER,
+                          buffers.m_coordinateBufferID,
+                          numberOfCoordinateBytes,
+                          surface->getCoordinateData(),
+                          GL_STATIC_DRAW))
+        || ( ! loadBuffer(GL_ARRAY_BUFFER,
+                          buffers.m_normalBufferID,
+                          numberOfCoordinateBytes,
+                          surface->getNormalData(),
+                          GL_STATIC_DRAW))
+        || ( ! loadBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                          buffers.m_triangleBufferID,
+                          buffers.m_numberOfTriangleVertices * sizeof(int32_t),
+                          surface->getTriangle(0),
+                          GL_STATIC_DRAW))) {
+        releaseSurfaceBuffers(buffers);
+        m_surfaceBuffers.erase(iter);
+        return NULL;
+    }
+    
+    return &buffers;
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    return NULL;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Get the buffer containing node coloring, copying the coloring into the
+ * buffer if it was replaced since it was last copied.
+ *
+ * @param surface
+ *    The surface.
+ * @param surfaceBuffers
+ *    Buffers of the surface.
+ * @param nodeColoringRGBA
+ *    The node coloring.
+ * @param modificationCount
+ *    Modification count of the node coloring.
+ * @param bufferIDOut
+ *    Output containing the buffer.
+ * @return
+ *    True if the buffer is valid.
+ */
+bool
+BrainOpenGLSurfaceBuffers::loadColorBuffer(const Surface* surface,
+                                           SurfaceBuffers& surfaceBuffers,
+                                           const float* nodeColoringRGBA,
+                                           const int64_t modificationCount,
+                                           GLuint& bufferIDOut)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    std::map<const float*, ColorBuffer>::iterator iter = surfaceBuffers.m_colorBuffers.find(nodeColoringRGBA);
+    if (iter == surfaceBuffers.m_colorBuffers.end()) {
+        ColorBuffer emptyBuffer;
+        emptyBuffer.m_bufferID = 0;
+        emptyBuffer.m_modificationCount = -1;
+        iter = surfaceBuffers.m_colorBuffers.insert(std::make_pair(nodeColoringRGBA,
+                                                                   emptyBuffer)).first;
+    }
+    
+    ColorBuffer& colorBuffer = iter->second;
+    if (colorBuffer.m_modificationCount != modificationCount) {
+        colorBuffer.m_modificationCount = modificationCount;
+        if ( ! loadBuffer(GL_ARRAY_BUFFER,
+                          colorBuffer.m_bufferID,
+                          4 * surface->getNumberOfNodes() * sizeof(float),
+                          nodeColoringRGBA,
+                          GL_DYNAMIC_DRAW)) {
+            if (colorBuffer.m_bufferID != 0) {
+                glDeleteBuffers(1, &colorBuffer.m_bufferID);
+            }
+            surfaceBuffers.m_colorBuffers.erase(iter);
+            return false;
+        }
+    }
+    
+    bufferIDOut = colorBuffer.m_bufferID;
+    return true;
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    return false;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Release buffers of surfaces that no longer exist and coloring buffers
+ * whose coloring was invalidated.  The OpenGL context must be current.
+ *
+ * @param surfacesInUse
+ *    All existing surfaces.
+ */
+void
+BrainOpenGLSurfaceBuffers::releaseBuffersForUnusedSurfaces(const std::vector<Surface*>& surfacesInUse)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    if (m_surfaceBuffers.empty()) {
+        return;
+    }
+    
+    const std::set<const Surface*> surfaceSet(surfacesInUse.begin(),
+                                              surfacesInUse.end());
+    std::map<const Surface*, SurfaceBuffers>::iterator iter = m_surfaceBuffers.begin();
+    while (iter != m_surfaceBuffers.end()) {
+        if (surfaceSet.find(iter->first) == surfaceSet.end()) {
+            releaseSurfaceBuffers(iter->second);
+            m_surfaceBuffers.erase(iter++);
+            continue;
+        }
+        
+        const Surface* surface = iter->first;
+        std::map<const float*, ColorBuffer>& colorBuffers = iter->second.m_colorBuffers;
+        std::map<const float*, ColorBuffer>::iterator colorIter = colorBuffers.begin();
+        while (colorIter != colorBuffers.end()) {
+            if (surface->getNodeColoringModificationCount(colorIter->first) < 0) {
+                glDeleteBuffers(1, &colorIter->second.m_bufferID);
+                colorBuffers.erase(colorIter++);
+            }
+            else {
+                ++colorIter;
+            }
+        }
+        ++iter;
+    }
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Release all buffers.  The OpenGL context must be current.
+ */
+void
+BrainOpenGLSurfaceBuffers::releaseAllBuffers()
+{
+    for (std::map<const Surface*, SurfaceBuffers>::iterator iter = m_surfaceBuffers.begin();
+         iter != m_surfaceBuffers.end();
+         iter++) {
+        releaseSurfaceBuffers(iter->second);
+    }
+    m_surfaceBuffers.clear();
+}
+
+/**
+ * Release the buffers of a surface.
+ *
+ * @param surfaceBuffers
+ *    Buffers that are released, IDs are set to zero.
+ */
+void
+BrainOpenGLSurfaceBuffers::releaseSurfaceBuffers(SurfaceBuffers& surfaceBuffers)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    GLuint* geometryBufferIDs[3] = {
+        &surfaceBuffers.m_coordinateBufferID,
+        &surfaceBuffers.m_normalBufferID,
+        &surfaceBuffers.m_triangleBufferID
+    };
+    for (int32_t i = 0; i < 3; i++) {
+        if (*geometryBufferIDs[i] != 0) {
+            glDeleteBuffers(1, geometryBufferIDs[i]);
+            *geometryBufferIDs[i] = 0;
+        }
+    }
+    for (std::map<const float*, ColorBuffer>::iterator iter = surfaceBuffers.m_colorBuffers.begin();
+         iter != surfaceBuffers.m_colorBuffers.end();
+         iter++) {
+        if (iter->second.m_bufferID != 0) {
+            glDeleteBuffers(1, &iter->second.m_bufferID);
+        }
+    }
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    surfaceBuffers.m_colorBuffers.clear();
+}
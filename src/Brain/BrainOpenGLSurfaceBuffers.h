@@ -0,0 +1,94 @@
+#ifndef __BRAIN_OPEN_GL_SURFACE_BUFFERS_H__
+#define __BRAIN_OPEN_GL_SURFACE_BUFFERS_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <map>
+#include <vector>
+
+#include "BrainOpenGL.h"
+
+namespace caret {
+
+    class Surface;
+    
+    class BrainOpenGLSurfaceBuffers : public CaretObject {
+        
+    public:
+        BrainOpenGLSurfaceBuffers();
+        
+        virtual ~BrainOpenGLSurfaceBuffers();
+        
+        static bool isSupported();
+        
+        bool drawTriangles(const Surface* surface,
+                           const float* nodeColoringRGBA,
+                           const float backgroundRGB[3]);
+        
+        void releaseBuffersForUnusedSurfaces(const std::vector<Surface*>& surfacesInUse);
+        
+        void releaseAllBuffers();
+        
+    private:
+        BrainOpenGLSurfaceBuffers(const BrainOpenGLSurfaceBuffers&);
+
+        BrainOpenGLSurfaceBuffers& operator=(const BrainOpenGLSurfaceBuffers&);
+        
+        /** A buffer containing node coloring for one tab */
+        struct ColorBuffer {
+            GLuint m_bufferID;
+            
+            /** Modification count of the node coloring when it was copied into the buffer */
+            int64_t m_modificationCount;
+        };
+        
+        /** Buffers containing a surface's geometry and its node coloring */
+        struct SurfaceBuffers {
+            /** Geometry modification count of the surface when it was copied into the buffers */
+            int64_t m_geometryModificationCount;
+            
+            GLuint m_coordinateBufferID;
+            
+            GLuint m_normalBufferID;
+            
+            GLuint m_triangleBufferID;
+            
+            GLsizei m_numberOfTriangleVertices;
+            
+            /** Color buffers indexed by the node coloring pointer of each tab */
+            std::map<const float*, ColorBuffer> m_colorBuffers;
+        };
+        
+        SurfaceBuffers* getSurfaceBuffers(const Surface* surface);
+        
+        bool loadColorBuffer(const Surface* surface,
+                             SurfaceBuffers& surfaceBuffers,
+                             const float* nodeColoringRGBA,
+                             const int64_t modificationCount,
+                             GLuint& bufferIDOut);
+        
+        static void releaseSurfaceBuffers(SurfaceBuffers& surfaceBuffers);
+        
+        std::map<const Surface*, SurfaceBuffers> m_surfaceBuffers;
+    };
+    
+} // namespace
+#endif  //__BRAIN_OPEN_GL_SURFACE_BUFFERS_H__
@@ -33,6 +33,7 @@
 #include "CaretPreferences.h"
 #include "CiftiConnectivityMatrixDataFileManager.h"
 #include "CiftiFiberTrajectoryManager.h"
+#include "CiftiMappableDataFile.h"
 #include "ElapsedTimer.h"
 #include "EventManager.h"
 #include "EventBrowserTabDelete.h"
@@ -64,6 +65,7 @@ SessionManager::SessionManager()
 : CaretObject(), EventListenerInterface(), SceneableInterface()
 {
     m_caretPreferences = new CaretPreferences();
+    CiftiMappableDataFile::setMatrixColumnCacheEnabled(m_caretPreferences->isCiftiMatrixColumnCacheEnabled());
     
     m_ciftiConnectivityMatrixDataFileManager = new CiftiConnectivityMatrixDataFileManager();
     m_ciftiFiberTrajectoryManager = new CiftiFiberTrajectoryManager();
@@ -29,6 +29,7 @@
 #include "EventBrowserTabGet.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "CiftiBrainordinateDataSeriesFile.h"
 #include "CiftiBrainordinateLabelFile.h"
 #include "CiftiBrainordinateScalarFile.h"
@@ -72,7 +73,7 @@ using namespace caret;
 SurfaceNodeColoring::SurfaceNodeColoring()
 : CaretObject()
 {
-    
+    m_compositionCounter = 0;
 }
 
 /**
@@ -196,8 +197,12 @@ SurfaceNodeColoring::colorSurfaceNodes(Model* model,
     }
     
     const int numNodes = surface->getNumberOfNodes();
+    if (numNodes <= 0) {
+        return rgba;
+    }
     const int numColorComponents = numNodes * 4;
-    float *rgbaColor = new float[numColorComponents];
+    m_compositeRGBA.resize(numColorComponents);
+    float* rgbaColor = &m_compositeRGBA[0];
     
     /*
      * Color the surface nodes
@@ -223,8 +228,6 @@ SurfaceNodeColoring::colorSurfaceNodes(Model* model,
                                                             rgbaColor);
         rgba = surface->getWholeBrainNodeColoringRgbaForBrowserTab(browserTabIndex);
     }
-
-    if(rgbaColor) delete [] rgbaColor;
     
     return rgba;
 }
@@ -247,11 +250,15 @@ SurfaceNodeColoring::colorSurfaceNodes(const DisplayPropertiesLabels* displayPro
                                        float* rgbaNodeColors)
 {
     const int32_t numNodes = surface->getNumberOfNodes();
+    if (numNodes <= 0) {
+        return;
+    }
     const int32_t numberOfDisplayedOverlays = overlaySet->getNumberOfDisplayedOverlays();
     
     /*
      * Default color.
      */
+#pragma omp CARET_PARFOR
     for (int32_t i = 0; i < numNodes; i++) {
         const int32_t i4 = i * 4;
         rgbaNodeColors[i4] = 0.70;
@@ -265,8 +272,11 @@ SurfaceNodeColoring::colorSurfaceNodes(const DisplayPropertiesLabels* displayPro
     const Brain* brain = brainStructure->getBrain();
     CaretAssert(brain);
     
+    m_compositionCounter++;
+    
     bool firstOverlayFlag = true;
-    float* overlayRGBV = new float[numNodes * 4];
+    m_overlayRGBV.resize(numNodes * 4);
+    float* overlayRGBV = &m_overlayRGBV[0];
     
     for (int32_t iOver = (numberOfDisplayedOverlays - 1); iOver >= 0; iOver--) {
         Overlay* overlay = overlaySet->getOverlay(iOver);
@@ -284,6 +294,12 @@ SurfaceNodeColoring::colorSurfaceNodes(const DisplayPropertiesLabels* displayPro
                 mapDataFileType = selectedMapFile->getDataFileType();
             }
             
+            /*
+             * Metric coloring comes from a cached layer, all other
+             * types are colored into the overlay coloring array.
+             */
+            const float* layerRGBV = overlayRGBV;
+            
             bool isColoringValid = false;
             switch (mapDataFileType) {
                 case DataFileTypeEnum::BORDER:
@@ -400,11 +416,16 @@ SurfaceNodeColoring::colorSurfaceNodes(const DisplayPropertiesLabels* displayPro
                                                                 overlayRGBV);
                     break;
                 case DataFileTypeEnum::METRIC:
-                    isColoringValid = this->assignMetricColoring(brainStructure, 
-                                                                 dynamic_cast<MetricFile*>(selectedMapFile),
-                                                                 selectedMapIndex,
-                                                                 numNodes, 
-                                                                 overlayRGBV);
+                {
+                    const float* metricRGBV = this->getMetricLayerColoring(brainStructure,
+                                                                           dynamic_cast<MetricFile*>(selectedMapFile),
+                                                                           selectedMapIndex,
+                                                                           numNodes);
+                    if (metricRGBV != NULL) {
+                        layerRGBV = metricRGBV;
+                        isColoringValid = true;
+                    }
+                }
                     break;
                 case DataFileTypeEnum::PALETTE:
                     break;
@@ -428,46 +449,11 @@ SurfaceNodeColoring::colorSurfaceNodes(const DisplayPropertiesLabels* displayPro
             }
             
             if (isColoringValid) {
-                const float opacity = overlay->getOpacity();
-                const float oneMinusOpacity = 1.0 - opacity;
-                
-                for (int32_t i = 0; i < numNodes; i++) {
-                    const int32_t i4 = i * 4;
-                    const float valid = overlayRGBV[i4 + 3];
-                    if (valid > 0.0 ) {
-                        if (opacity < 1.0) {
-                            if (firstOverlayFlag) {
-                                /*
-                                 * When first overlay, there is nothing to 
-                                 * blend with
-                                 */
-                                rgbaNodeColors[i4]   = (overlayRGBV[i4]   * opacity);
-                                rgbaNodeColors[i4+1] = (overlayRGBV[i4+1] * opacity);
-                                rgbaNodeColors[i4+2] = (overlayRGBV[i4+2] * opacity);
-                            }
-                            else {
-                                /*
-                                 * Blend with underlaying colors
-                                 */
-                                rgbaNodeColors[i4]   = (overlayRGBV[i4]   * opacity)
-                                + (rgbaNodeColors[i4] * oneMinusOpacity);
-                                rgbaNodeColors[i4+1] = (overlayRGBV[i4+1] * opacity)
-                                + (rgbaNodeColors[i4+1] * oneMinusOpacity);
-                                rgbaNodeColors[i4+2] = (overlayRGBV[i4+2] * opacity)
-                                + (rgbaNodeColors[i4+2] * oneMinusOpacity);
-                            }
-                        }
-                        else {
-                            /*
-                             * No opacity so simple replace coloring
-                             */
-                            rgbaNodeColors[i4] = overlayRGBV[i4];
-                            rgbaNodeColors[i4+1] = overlayRGBV[i4+1];
-                            rgbaNodeColors[i4+2] = overlayRGBV[i4+2];
-                        }
-                    }
-                }
-                
+                blendOverlayColoring(layerRGBV,
+                                     numNodes,
+                                     overlay->getOpacity(),
+                                     firstOverlayFlag,
+                                     rgbaNodeColors);
                 firstOverlayFlag = false;
             }
         }
@@ -479,13 +465,177 @@ SurfaceNodeColoring::colorSurfaceNodes(const DisplayPropertiesLabels* displayPro
      */
     const float opacity = brain->getDisplayPropertiesSurface()->getOpacity();
     if (opacity < 1.0) {
+#pragma omp CARET_PARFOR
         for (int32_t i = 0; i < numNodes; i++) {
             const int32_t i4 = i * 4;
             rgbaNodeColors[i4+3] = opacity;
         }
     }
     
-    delete[] overlayRGBV;
+    removeUnusedMetricLayers();
+}
+
+/**
+ * Blend the coloring of an overlay into the surface coloring.
+ * Only nodes that the overlay colored (valid component greater
+ * than zero) are modified.
+ *
+ * @param overlayRGBV
+ *    Coloring of the overlay (red, green, blue, valid).
+ * @param numberOfNodes
+ *    Number of nodes in surface.
+ * @param opacity
+ *    Opacity of the overlay.
+ * @param firstOverlayFlag
+ *    True if this is the first (bottom) overlay.
+ * @param rgbaNodeColors
+ *    RGBA surface coloring that is updated.
+ */
+void
+SurfaceNodeColoring::blendOverlayColoring(const float* overlayRGBV,
+                                          const int32_t numberOfNodes,
+                                          const float opacity,
+                                          const bool firstOverlayFlag,
+                                          float* rgbaNodeColors)
+{
+    if (opacity < 1.0) {
+        if (firstOverlayFlag) {
+            /*
+             * When first overlay, there is nothing to
+             * blend with
+             */
+#pragma omp CARET_PARFOR
+            for (int32_t i = 0; i < numberOfNodes; i++) {
+                const int32_t i4 = i * 4;
+                if (overlayRGBV[i4 + 3] > 0.0) {
+                    rgbaNodeColors[i4]   = (overlayRGBV[i4]   * opacity);
+                    rgbaNodeColors[i4+1] = (overlayRGBV[i4+1] * opacity);
+                    rgbaNodeColors[i4+2] = (overlayRGBV[i4+2] * opacity);
+                }
+            }
+        }
+        else {
+            /*
+             * Blend with underlaying colors
+             */
+            const float oneMinusOpacity = 1.0 - opacity;
+#pragma omp CARET_PARFOR
+            for (int32_t i = 0; i < numberOfNodes; i++) {
+                const int32_t i4 = i * 4;
+                if (overlayRGBV[i4 + 3] > 0.0) {
+                    rgbaNodeColors[i4]   = (overlayRGBV[i4]   * opacity)
+                    + (rgbaNodeColors[i4] * oneMinusOpacity);
+                    rgbaNodeColors[i4+1] = (overlayRGBV[i4+1] * opacity)
+                    + (rgbaNodeColors[i4+1] * oneMinusOpacity);
+                    rgbaNodeColors[i4+2] = (overlayRGBV[i4+2] * opacity)
+                    + (rgbaNodeColors[i4+2] * oneMinusOpacity);
+                }
+            }
+        }
+    }
+    else {
+        /*
+         * No opacity so simple replace coloring
+         */
+#pragma omp CARET_PARFOR
+        for (int32_t i = 0; i < numberOfNodes; i++) {
+            const int32_t i4 = i * 4;
+            if (overlayRGBV[i4 + 3] > 0.0) {
+                rgbaNodeColors[i4]   = overlayRGBV[i4];
+                rgbaNodeColors[i4+1] = overlayRGBV[i4+1];
+                rgbaNodeColors[i4+2] = overlayRGBV[i4+2];
+            }
+        }
+    }
+}
+
+/**
+ * Get the coloring of a metric map.  The coloring is kept and reused
+ * until the metric's data, its palette color mapping, or the palette
+ * change so that switching tabs or surfaces, or changing another
+ * overlay, does not recolor the metric.
+ *
+ * @param brainStructure
+ *    The brain structure that contains the data files.
+ * @param metricFile
+ *    Metric file that is selected.
+ * @param displayColumn
+ *    Index of selected map.
+ * @param numberOfNodes
+ *    Number of nodes in surface.
+ * @return
+ *    Pointer to the coloring (red, green, blue, valid) or NULL
+ *    if the metric does not color the surface.
+ */
+const float*
+SurfaceNodeColoring::getMetricLayerColoring(const BrainStructure* brainStructure,
+                                            MetricFile* metricFile,
+                                            const int32_t displayColumn,
+                                            const int32_t numberOfNodes)
+{
+    if (metricFile == NULL) {
+        return NULL;
+    }
+    if (displayColumn < 0) {
+        return NULL;
+    }
+    if ( ! metricFile->isMappableToSurfaceStructure(brainStructure->getStructure())) {
+        return NULL;
+    }
+    
+    const PaletteColorMapping* paletteColorMapping = metricFile->getPaletteColorMapping(displayColumn);
+    const Palette* palette = brainStructure->getBrain()->getPaletteFile()->getPaletteByName(paletteColorMapping->getSelectedPaletteName());
+    const int64_t dataModificationCount = metricFile->getDataModificationCount();
+    
+    MetricLayer& layer = m_metricLayers[std::make_pair(const_cast<const MetricFile*>(metricFile),
+                                                       displayColumn)];
+    layer.m_lastUsedComposition = m_compositionCounter;
+    
+    const int32_t numberOfComponents = numberOfNodes * 4;
+    if ((static_cast<int32_t>(layer.m_rgbv.size()) == numberOfComponents)
+        && (layer.m_dataModificationCount == dataModificationCount)
+        && (layer.m_palette == palette)
+        && (layer.m_paletteColorMapping == *paletteColorMapping)) {
+        return &layer.m_rgbv[0];
+    }
+    
+    layer.m_rgbv.resize(numberOfComponents);
+    assignMetricColoring(brainStructure,
+                         metricFile,
+                         displayColumn,
+                         numberOfNodes,
+                         &layer.m_rgbv[0]);
+    layer.m_dataModificationCount = dataModificationCount;
+    layer.m_palette = palette;
+    layer.m_paletteColorMapping = *paletteColorMapping;
+    
+    return &layer.m_rgbv[0];
+}
+
+/**
+ * Remove metric layers that have not been used by recent
+ * surface colorings so that closed files and maps that are
+ * no longer displayed do not hold memory.
+ */
+void
+SurfaceNodeColoring::removeUnusedMetricLayers()
+{
+    /*
+     * Surfaces in several tabs and a whole brain may be colored
+     * for each redraw so allow some number of colorings
+     * before removing a layer.
+     */
+    const int64_t maximumUnusedCompositions = 32;
+    
+    std::map<std::pair<const MetricFile*, int32_t>, MetricLayer>::iterator iter = m_metricLayers.begin();
+    while (iter != m_metricLayers.end()) {
+        if ((m_compositionCounter - iter->second.m_lastUsedComposition) > maximumUnusedCompositions) {
+            m_metricLayers.erase(iter++);
+        }
+        else {
+            ++iter;
+        }
+    }
 }
 
 /**
@@ -21,11 +21,15 @@
  */
 /*LICENSE_END*/
 
+#include <map>
+#include <vector>
+
 #include "CaretColorEnum.h"
 #include "CaretObject.h"
 #include "CaretPointer.h"
 #include "DisplayGroupEnum.h"
 #include "LabelDrawingTypeEnum.h"
+#include "PaletteColorMapping.h"
 
 namespace caret {
 
@@ -147,6 +151,19 @@ namespace caret {
                                   const int32_t numberOfNodes,
                                   float* rgbv);
         
+        const float* getMetricLayerColoring(const BrainStructure* brainStructure,
+                                            MetricFile* metricFile,
+                                            const int32_t mapIndex,
+                                            const int32_t numberOfNodes);
+        
+        void removeUnusedMetricLayers();
+        
+        static void blendOverlayColoring(const float* overlayRGBV,
+                                         const int32_t numberOfNodes,
+                                         const float opacity,
+                                         const bool firstOverlayFlag,
+                                         float* rgbaNodeColors);
+        
         bool assignRgbaColoring(const BrainStructure* brainStructure,
                                 const RgbaFile* rgbaFile,
                                 const int32_t mapIndex,
@@ -162,6 +179,32 @@ namespace caret {
                                     const std::vector<float>& labelIndices,
                                     const bool drawMedialWallFilledFlag,
                                     float* rgbv);
+        
+        /** Coloring of a metric map, reused while the data and its palette mapping are unchanged */
+        struct MetricLayer {
+            int64_t m_dataModificationCount;
+            
+            PaletteColorMapping m_paletteColorMapping;
+            
+            const Palette* m_palette;
+            
+            /** Value of m_compositionCounter when last used */
+            int64_t m_lastUsedComposition;
+            
+            std::vector<float> m_rgbv;
+        };
+        
+        /** Metric layers indexed by file and map index, shared by all overlays and tabs */
+        std::map<std::pair<const MetricFile*, int32_t>, MetricLayer> m_metricLayers;
+        
+        /** Incremented each time the overlays of a surface are composited */
+        int64_t m_compositionCounter;
+        
+        /** Coloring of the overlay being composited, kept to avoid reallocation */
+        std::vector<float> m_overlayRGBV;
+        
+        /** Composited coloring before it is copied to the surface */
+        std::vector<float> m_compositeRGBA;
     };
     
 #ifdef __SURFACE_NODE_COLORING_DECLARE__
@@ -0,0 +1,205 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiColumnCache.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CiftiFile.h"
+#include "DataFileException.h"
+#include "FileInformation.h"
+#include "SystemUtilities.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+#include <cstring>
+
+#ifdef CARET_OS_WINDOWS
+#include "windows.h"
+#else
+#include <sys/statvfs.h>
+#endif
+
+using namespace std;
+using namespace caret;
+
+namespace
+{
+    const char CACHE_MAGIC[8] = { 'W', 'B', 'C', 'O', 'L', 'T', 'R', '1' };
+    const int64_t CACHE_HEADER_SIZE = 8 + 4 * sizeof(int64_t);//magic, rows, columns, source size, source modified time
+    const int64_t BUILD_BLOCK_BYTES = ((int64_t)1)<<28;//256MB of rows per pass, so the number of seeks while transposing stays reasonable
+    const int64_t FREE_SPACE_MARGIN = ((int64_t)1)<<30;//don't fill the disk to the last byte, leave 1GB for everything else
+    
+    QString sidecarName(const QString& sourceFile)
+    {
+        return sourceFile + ".colcache";
+    }
+    
+    QString tempDirName(const QString& sourceFile)
+    {//in case the data directory isn't writable, hash the full path so same-named files in different directories don't collide
+        return SystemUtilities::getTempDirectory() + "/" + FileInformation(sourceFile).getFileName() + "." + QString::number(qHash(sourceFile), 16) + ".colcache";
+    }
+}
+
+CiftiColumnCache::CiftiColumnCache(const QString& cacheFile, const int64_t& numRows, const int64_t& numCols)
+{
+    m_numRows = numRows;
+    m_numCols = numCols;
+    m_file.open(cacheFile);
+}
+
+void CiftiColumnCache::getSourceStamp(const QString& sourceFile, int64_t& sizeOut, int64_t& modifiedOut)
+{
+    QFileInfo myInfo(sourceFile);
+    sizeOut = myInfo.size();
+    modifiedOut = myInfo.lastModified().toMSecsSinceEpoch();
+}
+
+int64_t CiftiColumnCache::getFreeDiskSpace(const QString& fileInDirectory)
+{//returns -1 if it can't be determined
+    QString directory = QFileInfo(fileInDirectory).absolutePath();
+#ifdef CARET_OS_WINDOWS
+    ULARGE_INTEGER freeBytes;
+    if (GetDiskFreeSpaceExW((LPCWSTR)directory.utf16(), &freeBytes, NULL, NULL) == 0) return -1;
+    return (int64_t)freeBytes.QuadPart;
+#else
+    struct statvfs myStats;
+    if (statvfs(directory.toLocal8Bit().constData(), &myStats) != 0) return -1;
+    return (int64_t)myStats.f_bavail * (int64_t)myStats.f_frsize;
+#endif
+}
+
+bool CiftiColumnCache::checkCacheFile(const QString& cacheFile, const QString& sourceFile, const int64_t& numRows, const int64_t& numCols)
+{
+    if (!QFile::exists(cacheFile)) return false;
+    try
+    {
+        CaretBinaryFile testFile(cacheFile);
+        char magic[8];
+        int64_t header[4];
+        testFile.read(magic, 8);
+        testFile.read(header, 4 * sizeof(int64_t));
+        if (memcmp(magic, CACHE_MAGIC, 8) != 0) return false;
+        int64_t sourceSize, sourceModified;
+        getSourceStamp(sourceFile, sourceSize, sourceModified);
+        if (header[0] != numRows || header[1] != numCols || header[2] != sourceSize || header[3] != sourceModified) return false;
+        if (QFileInfo(cacheFile).size() != CACHE_HEADER_SIZE + numRows * numCols * (int64_t)sizeof(float)) return false;//interrupted build
+    } catch (CaretException&) {//unreadable or truncated header, just rebuild it
+        return false;
+    }
+    return true;
+}
+
+bool CiftiColumnCache::buildCacheFile(const QString& cacheFile, const QString& sourceFile, const CiftiFile& source)
+{
+    const int64_t numRows = source.getNumberOfRows(), numCols = source.getNumberOfColumns();
+    QString tempName = cacheFile + ".part";//so that a crash partway through never leaves something that looks valid
+    const int64_t cacheSize = CACHE_HEADER_SIZE + numRows * numCols * (int64_t)sizeof(float);
+    int64_t freeSpace = getFreeDiskSpace(cacheFile);
+    if (freeSpace >= 0 && freeSpace < cacheSize + FREE_SPACE_MARGIN)
+    {
+        CaretLogInfo("not enough free disk space for column cache '" + cacheFile + "', need " + QString::number(cacheSize) + " bytes");
+        return false;
+    }
+    try
+    {
+        CaretBinaryFile outFile(tempName, CaretBinaryFile::WRITE_TRUNCATE);
+        int64_t header[4];
+        header[0] = numRows;
+        header[1] = numCols;
+        getSourceStamp(sourceFile, header[2], header[3]);
+        outFile.write(CACHE_MAGIC, 8);
+        outFile.write(header, 4 * sizeof(int64_t));
+        int64_t blockRows = BUILD_BLOCK_BYTES / (numCols * sizeof(float));
+        if (blockRows < 1) blockRows = 1;
+        if (blockRows > numRows) blockRows = numRows;
+        vector<float> block(blockRows * numCols), colPiece(blockRows);
+        int lastPercent = 0;
+        for (int64_t rowStart = 0; rowStart < numRows; rowStart += blockRows)
+        {
+            int percent = (int)(rowStart * 100 / numRows);
+            if (percent >= lastPercent + 10)
+            {
+                lastPercent = percent - percent % 10;
+                CaretLogInfo("building column cache '" + cacheFile + "': " + QString::number(lastPercent) + "% done");
+            }
+            int64_t rowsThisBlock = min(blockRows, numRows - rowStart);
+            for (int64_t i = 0; i < rowsThisBlock; ++i)
+            {
+                source.getRow(block.data() + i * numCols, rowStart + i);
+            }
+            for (int64_t col = 0; col < numCols; ++col)//ascending offsets, so the writes are mostly forward seeks
+            {
+                for (int64_t i = 0; i < rowsThisBlock; ++i)
+                {
+                    colPiece[i] = block[i * numCols + col];
+                }
+                outFile.seek(CACHE_HEADER_SIZE + (col * numRows + rowStart) * sizeof(float));
+                outFile.write(colPiece.data(), rowsThisBlock * sizeof(float));
+            }
+        }
+        outFile.close();
+    } catch (CaretException& e) {
+        CaretLogWarning("failed to build column cache '" + cacheFile + "': " + e.whatString());
+        QFile::remove(tempName);
+        return false;
+    }
+    QFile::remove(cacheFile);//rename doesn't overwrite
+    if (!QFile::rename(tempName, cacheFile))
+    {
+        QFile::remove(tempName);
+        return false;
+    }
+    return true;
+}
+
+CiftiColumnCache* CiftiColumnCache::openOrBuild(const CiftiFile& source, const QString& sourceFile)
+{
+    const int64_t numRows = source.getNumberOfRows(), numCols = source.getNumberOfColumns();
+    QString candidates[2] = { sidecarName(sourceFile), tempDirName(sourceFile) };
+    for (int i = 0; i < 2; ++i)
+    {
+        if (checkCacheFile(candidates[i], sourceFile, numRows, numCols))
+        {
+            CaretLogFine("using existing column cache '" + candidates[i] + "'");
+            return new CiftiColumnCache(candidates[i], numRows, numCols);
+        }
+    }
+    CaretLogInfo("building column cache for '" + sourceFile + "', this reads the entire file once");
+    for (int i = 0; i < 2; ++i)
+    {
+        if (buildCacheFile(candidates[i], sourceFile, source))
+        {
+            return new CiftiColumnCache(candidates[i], numRows, numCols);
+        }
+    }
+    return NULL;
+}
+
+void CiftiColumnCache::getColumn(float* dataOut, const int64_t& index) const
+{
+    CaretAssert(index >= 0 && index < m_numCols);
+    CaretMutexLocker locked(&m_fileMutex);
+    m_file.seek(CACHE_HEADER_SIZE + index * m_numRows * sizeof(float));
+    m_file.read(dataOut, m_numRows * sizeof(float));
+}
@@ -0,0 +1,53 @@
+#ifndef __CIFTI_COLUMN_CACHE_H__
+#define __CIFTI_COLUMN_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretBinaryFile.h"
+#include "CaretMutex.h"
+
+#include <QString>
+
+#include <vector>
+
+namespace caret
+{
+    class CiftiFile;
+    
+    ///transposed copy of a 2D on-disk cifti matrix, so that a column is one sequential read instead of one read per element
+    class CiftiColumnCache
+    {
+        mutable CaretBinaryFile m_file;//because file objects aren't stateless (current position), so reading "changes" them
+        mutable CaretMutex m_fileMutex;//seek and read must happen together
+        int64_t m_numRows, m_numCols;
+        CiftiColumnCache(const QString& cacheFile, const int64_t& numRows, const int64_t& numCols);
+        static bool checkCacheFile(const QString& cacheFile, const QString& sourceFile, const int64_t& numRows, const int64_t& numCols);
+        static bool buildCacheFile(const QString& cacheFile, const QString& sourceFile, const CiftiFile& source);
+        static void getSourceStamp(const QString& sourceFile, int64_t& sizeOut, int64_t& modifiedOut);
+        static int64_t getFreeDiskSpace(const QString& fileInDirectory);
+    public:
+        ///reuse an up-to-date cache file next to the source file (or in the temp directory), or build one by reading every row - returns NULL on failure
+        static CiftiColumnCache* openOrBuild(const CiftiFile& source, const QString& sourceFile);
+        void getColumn(float* dataOut, const int64_t& index) const;
+    };
+}
+
+#endif //__CIFTI_COLUMN_CACHE_H__
@@ -24,11 +24,16 @@
 #include "CaretAssert.h"
 #include "CaretHttpManager.h"
 #include "CaretLogger.h"
+#include "CiftiColumnCache.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
+#include "MappedFileRegion.h"
 #include "MultiDimArray.h"
 #include "MultiDimIterator.h"
 #include "NiftiIO.h"
+#include "PerformanceStatistics.h"
+
+#include <cstring>
 
 using namespace std;
 using namespace caret;
@@ -38,6 +43,7 @@ namespace caret
 {
     class CiftiOnDiskImpl : public CiftiFile::WriteImplInterface
     {
+    protected:
         mutable NiftiIO m_nifti;//because file objects aren't stateless (current position), so reading "changes" them
         CiftiXML m_xml;//because we need to parse it to set up the dimensions anyway
     public:
@@ -51,6 +57,20 @@ namespace caret
         void setColumn(const float* dataIn, const int64_t& index);
     };
     
+    //read-only, maps the data section of the file when it is uncompressed native-endian unscaled float32, otherwise acts exactly like CiftiOnDiskImpl
+    class CiftiMmapImpl : public CiftiOnDiskImpl
+    {
+        MappedFileRegion m_mapping;
+        const uint8_t* m_mapped;//NULL when mapping wasn't possible, then we use the NiftiIO path
+        std::vector<int64_t> m_dims;
+        bool canMap() const;
+    public:
+        CiftiMmapImpl(const QString& filename);
+        void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
+        void getColumn(float* dataOut, const int64_t& index) const;
+        bool isMapped() const { return m_mapped != NULL; }
+    };
+    
     class CiftiMemoryImpl : public CiftiFile::WriteImplInterface
     {
         MultiDimArray<float> m_array;
@@ -89,15 +109,22 @@ CiftiFile::WriteImplInterface::~WriteImplInterface()
 
 CiftiFile::CiftiFile(const QString& fileName)
 {
+    m_columnCacheEnabled = false;
+    m_columnCacheTried = false;
     openFile(fileName);
 }
 
+CiftiFile::~CiftiFile()
+{//defined here so CiftiColumnCache can be forward declared in the header
+}
+
 void CiftiFile::openFile(const QString& fileName)
 {
+    clearColumnCache();
     m_writingImpl.grabNew(NULL);
     m_readingImpl.grabNew(NULL);//to make sure it closes everything first, even if the open throws
     m_dims.clear();
-    CaretPointer<CiftiOnDiskImpl> newRead(new CiftiOnDiskImpl(FileInformation(fileName).getAbsoluteFilePath()));//this constructor opens existing file read-only
+    CaretPointer<CiftiOnDiskImpl> newRead(new CiftiMmapImpl(FileInformation(fileName).getAbsoluteFilePath()));//this constructor opens existing file read-only, and falls back to normal reading if it can't map it
     m_readingImpl = newRead;//it should be noted that if the constructor throws (if the file isn't readable), new guarantees the memory allocated for the object will be freed
     m_xml = newRead->getCiftiXML();
     m_dims = m_xml.getDimensions();
@@ -157,6 +184,7 @@ void CiftiFile::writeFile(const QString& fileName, const CiftiVersion& writingVe
     copyImplData(m_readingImpl, tempWrite, m_dims);
     if (collision)//if we rewrote the file, we need the handle to the new file, and to dump the temporary in-memory version
     {
+        clearColumnCache();
         m_onDiskVersion = writingVersion;//also record the current version number
         m_readingImpl = tempWrite;//replace the temporary memory version
         if (hadWriter)//if it was in read-write mode
@@ -199,9 +227,41 @@ void CiftiFile::getColumn(float* dataOut, const int64_t& index) const
     if (m_dims.empty()) throw DataFileException("getColumn called on uninitialized CiftiFile");
     if (m_dims.size() != 2) throw DataFileException("getColumn called on non-2D CiftiFile");
     if (m_readingImpl == NULL) return;//NOT an error because we are pretending to have a matrix already, while we are waiting for setRow to actually start writing the file
+    const CiftiOnDiskImpl* diskImpl = dynamic_cast<CiftiOnDiskImpl*>(m_readingImpl.getPointer());
+    if (m_columnCacheEnabled && m_writingImpl == NULL && diskImpl != NULL)
+    {//only for read-only on-disk, if we are writing, the cache would go stale
+        CaretPointer<CiftiColumnCache> myCache;//keep our own reference, in case another thread clears it
+        {
+            CaretMutexLocker locked(&m_columnCacheMutex);
+            if (!m_columnCacheTried)
+            {
+                m_columnCacheTried = true;
+                m_columnCache.grabNew(CiftiColumnCache::openOrBuild(*this, diskImpl->getFilename()));//already absolute
+            }
+            myCache = m_columnCache;
+        }
+        if (myCache != NULL)
+        {
+            myCache->getColumn(dataOut, index);
+            return;
+        }
+    }
     m_readingImpl->getColumn(dataOut, index);
 }
 
+void CiftiFile::setColumnCacheEnabled(const bool& enabled)
+{
+    m_columnCacheEnabled = enabled;
+    if (!enabled) clearColumnCache();
+}
+
+void CiftiFile::clearColumnCache()
+{
+    CaretMutexLocker locked(&m_columnCacheMutex);
+    m_columnCache.grabNew(NULL);
+    m_columnCacheTried = false;
+}
+
 void CiftiFile::setCiftiXML(const CiftiXML& xml, const bool useOldMetadata)
 {
     if (xml.getNumberOfDimensions() == 0) throw DataFileException("setCiftiXML called with 0-dimensional CiftiXML");
@@ -225,6 +285,7 @@ void CiftiFile::setCiftiXML(const CiftiXML& xml, const bool useOldMetadata)
         m_xml = xml;
     }
     m_dims = m_xml.getDimensions();
+    clearColumnCache();
     m_readingImpl.grabNew(NULL);//drop old implementation, as it is now invalid due to XML (and therefore matrix size) change
     m_writingImpl.grabNew(NULL);
 }
@@ -302,6 +363,7 @@ void CiftiFile::setRow(const float* dataIn, const int64_t& index)
 void CiftiFile::verifyWriteImpl()
 {//this is where the magic happens - we want to emulate being a simple in-memory file, but actually be reading/writing on-disk when possible
     if (m_writingImpl != NULL) return;
+    clearColumnCache();
     CaretAssert(!m_dims.empty());//if the xml hasn't been set, then we can't do anything meaningful
     if (m_dims.empty()) throw DataFileException("setRow or setColumn attempted on uninitialized CiftiFile");
     if (m_writingFile == "")
@@ -518,6 +580,73 @@ void CiftiOnDiskImpl::setColumn(const float* dataIn, const int64_t& index)
     }
 }
 
+CiftiMmapImpl::CiftiMmapImpl(const QString& filename) : CiftiOnDiskImpl(filename)
+{
+    m_mapped = NULL;
+    m_dims = m_xml.getDimensions();
+    if (!canMap()) return;
+    int64_t numElems = 1;
+    for (int i = 0; i < (int)m_dims.size(); ++i)
+    {
+        numElems *= m_dims[i];
+    }
+    const int64_t dataOffset = m_nifti.getHeader().getDataOffset();
+    const int64_t dataBytes = numElems * (int64_t)sizeof(float);
+    if (m_mapping.map(filename, dataOffset, dataBytes))//takes care of page alignment, and fails on truncated files, so NiftiIO reports those when the rows are actually read
+    {
+        m_mapped = m_mapping.getData();
+    } else {//can also fail for lack of address space on 32-bit, or on some network filesystems
+        CaretLogFine("unable to memory map cifti file '" + filename + "', using normal reading");
+    }
+}
+
+bool CiftiMmapImpl::canMap() const
+{
+    const NiftiHeader& myHeader = m_nifti.getHeader();
+    if (m_nifti.getFilename().endsWith(".gz")) return false;
+    if (myHeader.getDataType() != NIFTI_TYPE_FLOAT32) return false;
+    if (myHeader.isSwapped()) return false;
+    double mult, offset;
+    if (myHeader.getDataScaling(mult, offset)) return false;
+    return true;
+}
+
+void CiftiMmapImpl::getRow(float* dataOut, const vector<int64_t>& indexSelect, const bool& tolerateShortRead) const
+{
+    if (m_mapped == NULL)
+    {
+        CiftiOnDiskImpl::getRow(dataOut, indexSelect, tolerateShortRead);
+        return;
+    }
+    CaretAssert(indexSelect.size() + 1 == m_dims.size());
+    int64_t rowStart = 0, stride = m_dims[0];
+    for (int i = 0; i < (int)indexSelect.size(); ++i)
+    {
+        CaretAssert(indexSelect[i] >= 0 && indexSelect[i] < m_dims[i + 1]);
+        rowStart += indexSelect[i] * stride;
+        stride *= m_dims[i + 1];
+    }
+    memcpy(dataOut, m_mapped + rowStart * sizeof(float), m_dims[0] * sizeof(float));//size was checked when mapping, so no short reads
+    if (PerformanceStatistics::isEnabled()) PerformanceStatistics::addBytesRead(m_dims[0] * sizeof(float));//doesn't go through CaretBinaryFile, so count it here
+}
+
+void CiftiMmapImpl::getColumn(float* dataOut, const int64_t& index) const
+{
+    if (m_mapped == NULL)
+    {
+        CiftiOnDiskImpl::getColumn(dataOut, index);
+        return;
+    }
+    CaretAssert(m_dims.size() == 2);//otherwise this shouldn't be called
+    CaretAssert(index >= 0 && index < m_dims[0]);
+    const int64_t rowSize = m_dims[0], colSize = m_dims[1];
+    for (int64_t i = 0; i < colSize; ++i)//strided access through the page cache, still touches every page, but no syscall per element
+    {
+        memcpy(dataOut + i, m_mapped + (index + rowSize * i) * sizeof(float), sizeof(float));//memcpy because the data offset doesn't guarantee alignment
+    }
+    if (PerformanceStatistics::isEnabled()) PerformanceStatistics::addBytesRead(colSize * sizeof(float));
+}
+
 CiftiXnatImpl::CiftiXnatImpl(const QString& url, const QString& user, const QString& pass)
 {
     CaretHttpManager::setAuthentication(url, user, pass);
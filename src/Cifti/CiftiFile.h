@@ -21,6 +21,7 @@
  */
 /*LICENSE_END*/
 
+#include "CaretMutex.h"
 #include "CaretPointer.h"
 #include "CiftiInterface.h"
 #include "CiftiXML.h"
@@ -32,12 +33,14 @@
 
 namespace caret
 {
+    class CiftiColumnCache;
     
     class CiftiFile : public CiftiInterface
     {
     public:
-        CiftiFile() { }
+        CiftiFile() { m_columnCacheEnabled = false; m_columnCacheTried = false; }
         explicit CiftiFile(const QString &fileName);//calls openFile
+        ~CiftiFile();
         void openFile(const QString& fileName);//starts on-disk reading
         void openURL(const QString& url, const QString& user, const QString& pass);//open from XNAT
         void openURL(const QString& url);//same, without user/pass (or curently, reusing existing auth if the server matches
@@ -49,7 +52,8 @@ namespace caret
         bool isInMemory() const;
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead = false) const;//tolerateShortRead is useful for on-disk writing when it is easiest to do RMW multiple times on a new file
         const std::vector<int64_t>& getDimensions() const { return m_dims; }
-        void getColumn(float* dataOut, const int64_t& index) const;//for 2D only, will be slow if on disk!
+        void getColumn(float* dataOut, const int64_t& index) const;//for 2D only, will be slow if on disk, unless the column cache is enabled
+        void setColumnCacheEnabled(const bool& enabled);//for read-only on-disk files, build (or reuse) a transposed copy of the matrix on the first getColumn
         
         void setCiftiXML(const CiftiXML& xml, const bool useOldMetadata = true);
         void setCiftiXML(const CiftiXMLOld &xml, const bool useOldMetadata = true);//set xml from old implementation
@@ -86,6 +90,11 @@ namespace caret
         QString m_writingFile, m_fileName;
         //CiftiXML m_xml;//uncomment when we drop CiftiInterface
         CiftiVersion m_onDiskVersion;
+        bool m_columnCacheEnabled;
+        mutable bool m_columnCacheTried;//so a failed build isn't retried on every getColumn
+        mutable CaretPointer<CiftiColumnCache> m_columnCache;
+        mutable CaretMutex m_columnCacheMutex;//getColumn is const and may be called from several threads, only one should build the cache
+        void clearColumnCache();
         void verifyWriteImpl();
         static void copyImplData(const ReadImplInterface* from, WriteImplInterface* to, const std::vector<int64_t>& dims);
     };
@@ -0,0 +1,217 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiRowCache.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "CiftiFile.h"
+#include "DataFileException.h"
+
+#include <QThread>
+
+using namespace std;
+using namespace caret;
+
+namespace
+{
+    const int64_t RING_MEM_FRACTION = 20;//when memory is limited, the ring gets at most 1/20th of the limit
+}
+
+class CiftiRowCache::ReadThread : public QThread
+{
+    CiftiRowCache* m_cache;
+public:
+    ReadThread(CiftiRowCache* cache) { m_cache = cache; }
+    void run() { m_cache->readRows(); }
+};
+
+CiftiRowCache::CiftiRowCache(const CiftiFile* input, const int64_t& memLimitBytes)
+{
+    m_input = input;
+    m_rowLength = input->getNumberOfColumns();
+    m_numSlots = 0;
+    if (memLimitBytes < 0)
+    {
+        m_maxSlots = getDefaultNumSlots();
+    } else {
+        int64_t rowBytes = max(m_rowLength * (int64_t)sizeof(float), (int64_t)1);
+        m_maxSlots = (int)min(memLimitBytes / rowBytes, (int64_t)input->getNumberOfRows());
+        if (m_maxSlots < 2) m_maxSlots = 2;//so that reading can overlap with at least one row of computation
+    }
+}
+
+CiftiRowCache::~CiftiRowCache()
+{
+    finish();
+}
+
+int64_t CiftiRowCache::getRingBytes(const int64_t& rowBytes, const int64_t& totalMemLimitBytes)
+{
+    int64_t numSlots = getDefaultNumSlots();
+    if (totalMemLimitBytes >= 0)
+    {
+        int64_t limitSlots = totalMemLimitBytes / RING_MEM_FRACTION / max(rowBytes, (int64_t)1);
+        if (limitSlots < 2) limitSlots = 2;//the constructor never goes below 2 either
+        if (limitSlots < numSlots) numSlots = limitSlots;
+    }
+    return numSlots * rowBytes;
+}
+
+int64_t CiftiRowCache::getRingBytesForMemLimit(const int64_t& numColumns, const float& memLimitGB)
+{
+    int64_t limitBytes = -1;
+    if (memLimitGB >= 0.0f) limitBytes = (int64_t)(memLimitGB * 1024 * 1024 * 1024);
+    return getRingBytes(numColumns * (int64_t)sizeof(float), limitBytes);
+}
+
+int CiftiRowCache::getDefaultNumSlots()
+{
+#ifdef CARET_OMP
+    return 2 * omp_get_max_threads() + 2;//enough that every thread can have one row while the next ones are being read
+#else
+    return 4;
+#endif
+}
+
+void CiftiRowCache::startRows(const vector<int64_t>& rowOrder, const vector<bool>* skipRow)
+{
+    finish();
+    m_order = rowOrder;
+    if (skipRow != NULL)
+    {
+        CaretAssert((int64_t)skipRow->size() == m_input->getNumberOfRows());
+        m_skipRow = *skipRow;
+    } else {
+        m_skipRow.clear();
+    }
+    m_numSlots = (int)min((int64_t)m_maxSlots, max((int64_t)rowOrder.size(), (int64_t)1));
+    if ((int)m_slots.size() < m_numSlots)
+    {
+        m_slots.resize(m_numSlots);
+    }
+    for (int i = 0; i < m_numSlots; ++i)
+    {//no other thread is running, so no locks needed
+        if (m_slots[i] == NULL) m_slots[i].grabNew(new Slot());
+        Slot& mySlot = *(m_slots[i]);
+        mySlot.m_data.resize(m_rowLength);
+        mySlot.m_filled = -1;
+        mySlot.m_released = 0;
+        mySlot.m_error = false;
+        mySlot.m_stop = false;
+    }
+    m_nextTicket.fetchAndStoreOrdered(0);
+    m_thread.grabNew(new ReadThread(this));
+    m_thread->start();
+}
+
+void CiftiRowCache::readRows()
+{//the only thread that touches the CiftiFile, so the file doesn't need a lock
+    const int64_t numTickets = (int64_t)m_order.size();
+    try
+    {
+        for (int64_t ticket = 0; ticket < numTickets; ++ticket)
+        {
+            Slot& mySlot = *(m_slots[ticket % m_numSlots]);
+            const int64_t round = ticket / m_numSlots;
+            {
+                QMutexLocker locked(&mySlot.m_mutex);
+                while (mySlot.m_released < round)//wait until the previous row in this slot is released
+                {
+                    if (mySlot.m_stop) return;
+                    mySlot.m_changed.wait(&mySlot.m_mutex);
+                }
+                if (mySlot.m_stop) return;
+            }
+            const int64_t row = m_order[ticket];
+            if (m_skipRow.empty() || !m_skipRow[row])
+            {
+                m_input->getRow(mySlot.m_data.data(), row);
+            }
+            QMutexLocker locked(&mySlot.m_mutex);
+            mySlot.m_filled = ticket;
+            mySlot.m_changed.wakeAll();//a consumer of the next round in this slot may also be waiting, it will go back to sleep
+        }
+    } catch (CaretException& e) {
+        setError(e.whatString());
+    } catch (std::exception& e) {
+        setError(e.what());
+    }
+}
+
+void CiftiRowCache::setError(const QString& message)
+{
+    m_errorMessage = message;//only the reading thread calls this, and consumers only read it after seeing the flag
+    for (int i = 0; i < m_numSlots; ++i)
+    {//consumers can be waiting on any slot
+        QMutexLocker locked(&m_slots[i]->m_mutex);
+        m_slots[i]->m_error = true;
+        m_slots[i]->m_changed.wakeAll();
+    }
+}
+
+bool CiftiRowCache::acquireRow(float*& dataOut, int64_t& rowOut, int64_t& ticketOut)
+{
+    const int ticket = m_nextTicket.fetchAndAddOrdered(1);
+    if (ticket >= (int64_t)m_order.size()) return false;
+    Slot& mySlot = *(m_slots[ticket % m_numSlots]);
+    {
+        QMutexLocker locked(&mySlot.m_mutex);
+        while (mySlot.m_filled != ticket)
+        {
+            if (mySlot.m_error)
+            {
+                throw DataFileException("error while reading rows: " + m_errorMessage);
+            }
+            mySlot.m_changed.wait(&mySlot.m_mutex);
+        }
+    }
+    rowOut = m_order[ticket];
+    ticketOut = ticket;
+    if (!m_skipRow.empty() && m_skipRow[rowOut])
+    {
+        dataOut = NULL;
+    } else {
+        dataOut = mySlot.m_data.data();
+    }
+    return true;
+}
+
+void CiftiRowCache::releaseRow(const int64_t& ticket)
+{
+    Slot& mySlot = *(m_slots[ticket % m_numSlots]);
+    QMutexLocker locked(&mySlot.m_mutex);
+    ++mySlot.m_released;
+    mySlot.m_changed.wakeAll();
+}
+
+void CiftiRowCache::finish()
+{
+    if (m_thread == NULL) return;
+    for (int i = 0; i < m_numSlots; ++i)
+    {//only matters if rows weren't all claimed and released, as in an exception, the reader can only be waiting on one slot, but we don't know which
+        QMutexLocker locked(&m_slots[i]->m_mutex);
+        m_slots[i]->m_stop = true;
+        m_slots[i]->m_changed.wakeAll();
+    }
+    m_thread->wait();
+    m_thread.grabNew(NULL);
+}
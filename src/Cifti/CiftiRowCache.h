@@ -0,0 +1,86 @@
+#ifndef __CIFTI_ROW_CACHE_H__
+#define __CIFTI_ROW_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretPointer.h"
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+#include <stdint.h>
+#include <vector>
+
+namespace caret
+{
+    class CiftiFile;
+    
+    ///reads a list of rows in order on a background thread into a ring of row buffers, so that file IO overlaps computation
+    ///any number of threads may call acquireRow/releaseRow concurrently, tickets are handed out with an atomic, and each slot of the ring has its own lock and wait condition, so threads only contend when they want the same slot
+    class CiftiRowCache
+    {
+        class ReadThread;
+        friend class ReadThread;
+        struct Slot
+        {
+            std::vector<float> m_data;//belongs to whoever has the slot's current ticket, so it isn't locked
+            QMutex m_mutex;//protects everything below
+            QWaitCondition m_changed;//row filled, row released, error or stop
+            int64_t m_filled;//ticket whose row is ready, -1 initially
+            int64_t m_released;//number of tickets released from this slot, so the reader knows when it can reuse it
+            bool m_error, m_stop;//copies of the cache's state, so that waiters see them under the slot's lock
+        };
+        const CiftiFile* m_input;
+        int64_t m_rowLength;
+        int m_maxSlots, m_numSlots;
+        std::vector<CaretPointer<Slot> > m_slots;
+        std::vector<int64_t> m_order;
+        std::vector<bool> m_skipRow;//by row index, empty means read everything
+        QAtomicInt m_nextTicket;
+        QString m_errorMessage;//written before m_error is set in any slot, so reading it after seeing m_error under a slot lock is safe
+        CaretPointer<ReadThread> m_thread;
+        void readRows();
+        void setError(const QString& message);
+        CiftiRowCache(const CiftiRowCache&);
+        CiftiRowCache& operator=(const CiftiRowCache&);
+    public:
+        ///memLimitBytes limits the ring buffer size (see getRingBytes), -1 for a default of a few rows per thread
+        CiftiRowCache(const CiftiFile* input, const int64_t& memLimitBytes = -1);
+        ~CiftiRowCache();
+        ///start reading rows in the given order, skipRow (indexed by row) marks rows the caller already has, which are handed out without reading
+        void startRows(const std::vector<int64_t>& rowOrder, const std::vector<bool>* skipRow = NULL);
+        ///get the next row in the order, returns false when all have been handed out - dataOut is NULL for skipped rows, otherwise it may be modified until releaseRow
+        bool acquireRow(float*& dataOut, int64_t& rowOut, int64_t& ticketOut);
+        void releaseRow(const int64_t& ticket);
+        ///wait for the background reading to end, stops it early if rows were left unclaimed
+        void finish();
+        ///number of rows in the default ring
+        static int getDefaultNumSlots();
+        ///ring size to use when the whole computation is limited to totalMemLimitBytes (negative for no limit), count it against the limit and pass it to the constructor
+        static int64_t getRingBytes(const int64_t& rowBytes, const int64_t& totalMemLimitBytes);
+        ///same as getRingBytes, for rows of numColumns floats and a limit in GB as given by -mem-limit options (negative for no limit)
+        static int64_t getRingBytesForMemLimit(const int64_t& numColumns, const float& memLimitGB);
+    };
+}
+
+#endif //__CIFTI_ROW_CACHE_H__
@@ -0,0 +1,307 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CommandInputFileCache.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+
+#include "CaretLogger.h"
+#include "CiftiFile.h"
+#include "SurfaceFile.h"
+
+using namespace caret;
+
+/**
+ * \class caret::CommandInputFileCache
+ * \brief Keeps input files read by commands for use by later commands.
+ *
+ * When several commands run in one process (batch mode), the same
+ * surfaces and CIFTI files are often inputs to many of the commands.
+ * Files are kept by their canonical path along with their modification
+ * time and size, and a file is read again when either changes.
+ *
+ * Files are shared through reference counted pointers so a file that
+ * is removed from the cache remains valid for any command still using it.
+ * A surface's topology helper and geodesic helpers are kept by the surface
+ * so they are also reused.  CIFTI files are opened on disk so reuse
+ * avoids parsing the CIFTI XML again.
+ *
+ * Commands receive their input files as modifiable objects, and a few
+ * modify them (for instance, by converting an on-disk CIFTI file to
+ * in-memory).  A cached file that has been modified since it was read
+ * is removed from the cache when it is next requested, so later
+ * commands always get the file as it is on disk.
+ *
+ * The number of files and the total size of the surfaces in the cache
+ * are limited, and the least recently used files are removed when a
+ * limit is exceeded.  The batch runner also removes files that no later
+ * command reads.
+ */
+
+const int32_t CommandInputFileCache::MAXIMUM_NUMBER_OF_FILES = 32;
+
+const int64_t CommandInputFileCache::MAXIMUM_SURFACE_BYTES = ((int64_t)1) << 30;
+
+/**
+ * Constructor.
+ */
+CommandInputFileCache::CommandInputFileCache()
+: CaretObject()
+{
+    m_useCounter = 0;
+}
+
+/**
+ * Destructor.
+ */
+CommandInputFileCache::~CommandInputFileCache()
+{
+    clear();
+}
+
+/**
+ * Get a surface file, reading it if it is not in the cache or
+ * the file has changed since it was read.
+ *
+ * @param fileName
+ *    Name of the surface file.
+ * @return
+ *    The surface file.
+ * @throw DataFileException
+ *    If reading the file fails.
+ */
+CaretPointer<SurfaceFile>
+CommandInputFileCache::getSurfaceFile(const AString& fileName)
+{
+    AString key;
+    int64_t lastModified = 0;
+    int64_t size = 0;
+    CacheEntry* entry = getValidEntry(fileName,
+                                      key,
+                                      lastModified,
+                                      size);
+    if ((entry != NULL)
+        && (entry->m_surfaceFile.getPointer() != NULL)) {
+        if ( ! entry->m_surfaceFile->isModified()) {
+            CaretLogFine("Using cached surface " + fileName);
+            entry->m_lastUsed = ++m_useCounter;
+            return entry->m_surfaceFile;
+        }
+        CaretLogFine("Cached surface " + fileName + " was modified by a command, reading it again");
+    }
+    
+    CaretPointer<SurfaceFile> surfaceFile(new SurfaceFile());
+    surfaceFile->readFile(fileName);
+    
+    if ( ! key.isEmpty()) {
+        CacheEntry& newEntry = addEntry(key,
+                                        lastModified,
+                                        size);
+        newEntry.m_surfaceFile = surfaceFile;
+        removeLeastRecentlyUsed(key);
+    }
+    
+    return surfaceFile;
+}
+
+/**
+ * Get a CIFTI file, opening it if it is not in the cache or
+ * the file has changed since it was opened.
+ *
+ * @param fileName
+ *    Name of the CIFTI file.
+ * @return
+ *    The CIFTI file (on disk).
+ * @throw DataFileException
+ *    If opening the file fails.
+ */
+CaretPointer<CiftiFile>
+CommandInputFileCache::getCiftiFile(const AString& fileName)
+{
+    AString key;
+    int64_t lastModified = 0;
+    int64_t size = 0;
+    CacheEntry* entry = getValidEntry(fileName,
+                                      key,
+                                      lastModified,
+                                      size);
+    if ((entry != NULL)
+        && (entry->m_ciftiFile.getPointer() != NULL)) {
+        /*
+         * Converting to in-memory and replacing the XML both leave
+         * the file in memory, and are how a command modifies it
+         */
+        if ( ! entry->m_ciftiFile->isInMemory()) {
+            CaretLogFine("Using cached CIFTI file " + fileName);
+            entry->m_lastUsed = ++m_useCounter;
+            return entry->m_ciftiFile;
+        }
+        CaretLogFine("Cached CIFTI file " + fileName + " was modified by a command, opening it again");
+    }
+    
+    CaretPointer<CiftiFile> ciftiFile(new CiftiFile());
+    ciftiFile->openFile(fileName);
+    
+    if ( ! key.isEmpty()) {
+        CacheEntry& newEntry = addEntry(key,
+                                        lastModified,
+                                        size);
+        newEntry.m_ciftiFile = ciftiFile;
+        removeLeastRecentlyUsed(key);
+    }
+    
+    return ciftiFile;
+}
+
+/**
+ * Remove a file from the cache.  Called before a command writes
+ * the file so that the cache does not hold the file open.
+ *
+ * @param fileName
+ *    Name of the file.
+ */
+void
+CommandInputFileCache::removeFile(const AString& fileName)
+{
+    QFileInfo fileInfo(fileName);
+    if ( ! fileInfo.exists()) {
+        return;
+    }
+    m_entries.erase(fileInfo.canonicalFilePath());
+}
+
+/**
+ * Remove all files from the cache.
+ */
+void
+CommandInputFileCache::clear()
+{
+    m_entries.clear();
+}
+
+/**
+ * Add an entry for a file to the cache, replacing any existing entry.
+ *
+ * @param key
+ *    Key of the file in the cache.
+ * @param lastModified
+ *    Modification time of the file.
+ * @param size
+ *    Size of the file.
+ * @return
+ *    The new entry, without a file.
+ */
+CommandInputFileCache::CacheEntry&
+CommandInputFileCache::addEntry(const AString& key,
+                                const int64_t lastModified,
+                                const int64_t size)
+{
+    CacheEntry& newEntry = m_entries[key];
+    newEntry.m_lastModified = lastModified;
+    newEntry.m_size = size;
+    newEntry.m_lastUsed = ++m_useCounter;
+    newEntry.m_surfaceFile = CaretPointer<SurfaceFile>();
+    newEntry.m_ciftiFile = CaretPointer<CiftiFile>();
+    return newEntry;
+}
+
+/**
+ * Remove the least recently used files until the number of files
+ * and the size of the surfaces are within the limits.
+ *
+ * @param keepKey
+ *    Key of a file that is not removed (the file just added).
+ */
+void
+CommandInputFileCache::removeLeastRecentlyUsed(const AString& keepKey)
+{
+    while (true) {
+        int64_t surfaceBytes = 0;
+        std::map<AString, CacheEntry>::iterator oldestIter = m_entries.end();
+        for (std::map<AString, CacheEntry>::iterator iter = m_entries.begin();
+             iter != m_entries.end();
+             iter++) {
+            if (iter->second.m_surfaceFile.getPointer() != NULL) {
+                surfaceBytes += iter->second.m_size;
+            }
+            if ((iter->first != keepKey)
+                && ((oldestIter == m_entries.end())
+                    || (iter->second.m_lastUsed < oldestIter->second.m_lastUsed))) {
+                oldestIter = iter;
+            }
+        }
+        if ((oldestIter == m_entries.end())
+            || ((static_cast<int32_t>(m_entries.size()) <= MAXIMUM_NUMBER_OF_FILES)
+                && (surfaceBytes <= MAXIMUM_SURFACE_BYTES))) {
+            return;
+        }
+        CaretLogFine("Removing least recently used file from cache " + oldestIter->first);
+        m_entries.erase(oldestIter);
+    }
+}
+
+/**
+ * Find the cache entry for a file.  If the file has changed since it
+ * was cached, the entry is removed.
+ *
+ * @param fileName
+ *    Name of the file.
+ * @param keyOut
+ *    Output with key of the file in the cache, empty if the file
+ *    cannot be cached (such as a file that is not on the local disk).
+ * @param lastModifiedOut
+ *    Output with modification time of the file.
+ * @param sizeOut
+ *    Output with size of the file.
+ * @return
+ *    The entry or NULL if the file is not in the cache.
+ */
+CommandInputFileCache::CacheEntry*
+CommandInputFileCache::getValidEntry(const AString& fileName,
+                                     AString& keyOut,
+                                     int64_t& lastModifiedOut,
+                                     int64_t& sizeOut)
+{
+    keyOut = "";
+    
+    QFileInfo fileInfo(fileName);
+    if ( ! fileInfo.exists()) {
+        return NULL;
+    }
+    
+    keyOut = fileInfo.canonicalFilePath();
+    lastModifiedOut = fileInfo.lastModified().toMSecsSinceEpoch();
+    sizeOut = fileInfo.size();
+    
+    std::map<AString, CacheEntry>::iterator iter = m_entries.find(keyOut);
+    if (iter == m_entries.end()) {
+        return NULL;
+    }
+    
+    if ((iter->second.m_lastModified != lastModifiedOut)
+        || (iter->second.m_size != sizeOut)) {
+        m_entries.erase(iter);
+        return NULL;
+    }
+    
+    return &iter->second;
+}
@@ -0,0 +1,94 @@
+#ifndef __COMMAND_INPUT_FILE_CACHE_H__
+#define __COMMAND_INPUT_FILE_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <map>
+
+#include "CaretObject.h"
+#include "CaretPointer.h"
+
+namespace caret {
+
+    class CiftiFile;
+    class SurfaceFile;
+    
+    /// Keeps input files that were read by commands so that later commands in the same process can use them without reading them again
+    class CommandInputFileCache : public CaretObject {
+        
+    public:
+        CommandInputFileCache();
+        
+        virtual ~CommandInputFileCache();
+        
+        CaretPointer<SurfaceFile> getSurfaceFile(const AString& fileName);
+        
+        CaretPointer<CiftiFile> getCiftiFile(const AString& fileName);
+        
+        void removeFile(const AString& fileName);
+        
+        void clear();
+        
+    private:
+        CommandInputFileCache(const CommandInputFileCache&);
+
+        CommandInputFileCache& operator=(const CommandInputFileCache&);
+        
+        /** A file that has been read and the state of the file on disk when it was read */
+        struct CacheEntry {
+            int64_t m_lastModified;
+            
+            int64_t m_size;
+            
+            int64_t m_lastUsed;
+            
+            CaretPointer<SurfaceFile> m_surfaceFile;
+            
+            CaretPointer<CiftiFile> m_ciftiFile;
+        };
+        
+        CacheEntry* getValidEntry(const AString& fileName,
+                                  AString& keyOut,
+                                  int64_t& lastModifiedOut,
+                                  int64_t& sizeOut);
+        
+        CacheEntry& addEntry(const AString& key,
+                             const int64_t lastModified,
+                             const int64_t size);
+        
+        void removeLeastRecentlyUsed(const AString& keepKey);
+        
+        /** Maximum number of files in the cache, CIFTI files each keep a file open */
+        static const int32_t MAXIMUM_NUMBER_OF_FILES;
+        
+        /** Maximum total size of the surface files in the cache */
+        static const int64_t MAXIMUM_SURFACE_BYTES;
+        
+        /** Cached files indexed by canonical path */
+        std::map<AString, CacheEntry> m_entries;
+        
+        /** Incremented each time a file is used, for finding the least recently used file */
+        int64_t m_useCounter;
+    };
+    
+} // namespace
+
+#endif // __COMMAND_INPUT_FILE_CACHE_H__
@@ -199,8 +199,16 @@
 
 #include "AlgorithmException.h"
 #include "ApplicationInformation.h"
+#include "CaretAssert.h"
+#include "CaretCommandLine.h"
+#include "CaretOMP.h"
+#include "CommandInputFileCache.h"
 #include "CommandParser.h"
+#include "ElapsedTimer.h"
+#include "FileInformation.h"
+#include "GiftiFile.h"
 #include "OperationException.h"
+#include "PerformanceStatistics.h"
 
 #include "CommandClassAddMember.h"
 #include "CommandClassCreate.h"
@@ -214,8 +222,17 @@
 
 #include "CaretLogger.h"
 
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
 #include <iostream>
 
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 using namespace caret;
 using namespace std;
 
@@ -252,6 +269,8 @@ CommandOperationManager::deleteCommandOperationManager()
  */
 CommandOperationManager::CommandOperationManager()
 {
+    m_batchRunning = false;
+    
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmBorderResample()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmBorderToVertices()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmCiftiAllLabelsToROIs()));
@@ -469,12 +488,61 @@ CommandOperationManager::~CommandOperationManager()
  */
 void 
 CommandOperationManager::runCommand(ProgramParameters& parameters)
+{
+    vector<AString> performanceArgs;
+    const bool recordPerformance = getGlobalOption(parameters, "-performance-json", 1, performanceArgs);
+    if (recordPerformance) {
+        if (m_batchRunning) {
+            CaretLogWarning("-performance-json is ignored inside a batch file, give it to the -batch command instead");
+        } else {
+            /*
+             * Statistics for each command that runs, including all
+             * commands of a batch file, are written when done
+             */
+            m_performanceFileName = performanceArgs[0];
+            m_performanceRecords.clear();
+            PerformanceStatistics::setEnabled(true);
+            try {
+                runCommandSwitch(parameters);
+            }
+            catch (...) {
+                PerformanceStatistics::setEnabled(false);
+                writePerformanceFile();
+                throw;
+            }
+            PerformanceStatistics::setEnabled(false);
+            writePerformanceFile();
+            return;
+        }
+    }
+    
+    runCommandSwitch(parameters);
+}
+
+/**
+ * Run the command switch (and any global options) in the parameters.
+ *
+ * @param parameters
+ *    Reference to the command's parameters.
+ * @throws CommandException
+ *    If the command failed.
+ */
+void
+CommandOperationManager::runCommandSwitch(ProgramParameters& parameters)
 {
     vector<AString> globalOptionArgs;//not used yet
     bool preventProvenance = getGlobalOption(parameters, "-disable-provenance", 0, globalOptionArgs);//check these BEFORE we test if we have a command switch
-
-    const uint64_t numberOfCommands = this->commandOperations.size();
-    const uint64_t numberOfDeprecated = this->deprecatedOperations.size();
+    int32_t giftiCompressionLevel = -1;//reset for each command of a batch
+    if (getGlobalOption(parameters, "-gifti-compression", 1, globalOptionArgs))
+    {
+        bool ok = false;
+        giftiCompressionLevel = globalOptionArgs[0].toInt(&ok);
+        if (!ok || giftiCompressionLevel < 0 || giftiCompressionLevel > 9)
+        {
+            throw CommandException("-gifti-compression requires an integer from 0 to 9, got '" + globalOptionArgs[0] + "'");
+        }
+    }
+    GiftiFile::setDefaultCompressionLevelForWriting(giftiCompressionLevel);
 
     if (parameters.hasNext() == false) {
         printHelpInfo();
@@ -497,29 +565,15 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
         printDeprecatedCommands();
     } else if (commandSwitch == "-all-commands-help") {
         printAllCommandsHelpInfo(parameters.getProgramName());
+    } else if (commandSwitch == "-batch") {
+        if (m_batchRunning) {
+            throw CommandException("-batch cannot be used in a batch file");
+        }
+        runBatch(parameters,
+                 preventProvenance);
     } else {
         
-        CommandOperation* operation = NULL;
-        
-        for (uint64_t i = 0; i < numberOfCommands; i++)
-        {
-            if (this->commandOperations[i]->getCommandLineSwitch() == commandSwitch)
-            {
-                operation = this->commandOperations[i];
-                break;
-            }
-        }
-        if (operation == NULL)
-        {
-            for (uint64_t i = 0; i < numberOfDeprecated; i++)
-            {
-                if (this->deprecatedOperations[i]->getCommandLineSwitch() == commandSwitch)
-                {
-                    operation = this->deprecatedOperations[i];
-                    break;
-                }
-            }
-        }
+        CommandOperation* operation = findCommandOperation(commandSwitch);
         
         if (operation == NULL) {
             if (!parameters.hasNext())
@@ -532,6 +586,10 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
             if (!parameters.hasNext() && operation->takesParameters())
             {
                 cout << operation->getHelpInformation(parameters.getProgramName()) << endl;
+            } else if (PerformanceStatistics::isEnabled()) {
+                executeOperationWithStatistics(operation,
+                                               parameters,
+                                               preventProvenance);
             } else {
                 operation->execute(parameters, preventProvenance);
             }
@@ -554,9 +612,9 @@ bool CommandOperationManager::getGlobalOption(ProgramParameters& parameters, con
                 if (!parameters.hasNext())
                 {
                     throw CommandException("missing argument #" + AString::number(i + 1) + " to global option '" + optionString + "'");
-                    arguments.push_back(parameters.nextString("global option argument"));
-                    parameters.remove();
                 }
+                arguments.push_back(parameters.nextString("global option argument"));
+                parameters.remove();
             }
             parameters.setParameterIndex(0);
             return true;
@@ -566,6 +624,920 @@ bool CommandOperationManager::getGlobalOption(ProgramParameters& parameters, con
     return false;
 }
 
+/**
+ * Find the command or deprecated command with the given switch.
+ *
+ * @param commandSwitch
+ *    Switch of the command.
+ * @return
+ *    The command or NULL if not found.
+ */
+CommandOperation*
+CommandOperationManager::findCommandOperation(const AString& commandSwitch)
+{
+    const uint64_t numberOfCommands = this->commandOperations.size();
+    for (uint64_t i = 0; i < numberOfCommands; i++) {
+        if (this->commandOperations[i]->getCommandLineSwitch() == commandSwitch) {
+            return this->commandOperations[i];
+        }
+    }
+    const uint64_t numberOfDeprecated = this->deprecatedOperations.size();
+    for (uint64_t i = 0; i < numberOfDeprecated; i++) {
+        if (this->deprecatedOperations[i]->getCommandLineSwitch() == commandSwitch) {
+            return this->deprecatedOperations[i];
+        }
+    }
+    return NULL;
+}
+
+namespace {
+    /*
+     * Quote and escape text for a JSON string.
+     */
+    AString toJsonString(const AString& text)
+    {
+        AString result = "\"";
+        const int32_t length = text.length();
+        for (int32_t i = 0; i < length; i++) {
+            const QChar c = text[i];
+            if (c == '"') {
+                result += "\\\"";
+            } else if (c == '\\') {
+                result += "\\\\";
+            } else if (c == '\n') {
+                result += "\\n";
+            } else if (c == '\t') {
+                result += "\\t";
+            } else if (c.unicode() < 0x20) {
+                result += "\\u" + AString::number(c.unicode(), 16).rightJustified(4, '0');
+            } else {
+                result += c;
+            }
+        }
+        result += "\"";
+        return result;
+    }
+}
+
+/**
+ * Execute an operation while recording its performance statistics.
+ *
+ * @param operation
+ *    The operation.
+ * @param parameters
+ *    Parameters for the operation.
+ * @param preventProvenance
+ *    If true, provenance is disabled.
+ * @throws CommandException
+ *    If the operation failed, after its statistics are recorded.
+ */
+void
+CommandOperationManager::executeOperationWithStatistics(CommandOperation* operation,
+                                                        ProgramParameters& parameters,
+                                                        const bool preventProvenance)
+{
+    PerformanceStatistics::reset();
+    const double cpuSecondsStart = PerformanceStatistics::getProcessCpuSeconds();
+    ElapsedTimer timer;
+    timer.start();
+    try {
+        operation->execute(parameters, preventProvenance);
+    }
+    catch (...) {
+        addPerformanceRecord(operation->getCommandLineSwitch(),
+                             false,
+                             timer.getElapsedTimeSeconds(),
+                             PerformanceStatistics::getProcessCpuSeconds() - cpuSecondsStart);
+        throw;
+    }
+    addPerformanceRecord(operation->getCommandLineSwitch(),
+                         true,
+                         timer.getElapsedTimeSeconds(),
+                         PerformanceStatistics::getProcessCpuSeconds() - cpuSecondsStart);
+}
+
+/**
+ * Add a JSON record with the performance statistics of a command that
+ * has finished.
+ *
+ * @param commandSwitch
+ *    Switch of the command.
+ * @param succeeded
+ *    True if the command did not throw an exception.
+ * @param wallSeconds
+ *    Elapsed time of the command.
+ * @param cpuSeconds
+ *    CPU time used by all threads during the command.
+ */
+void
+CommandOperationManager::addPerformanceRecord(const AString& commandSwitch,
+                                              const bool succeeded,
+                                              const double wallSeconds,
+                                              const double cpuSeconds)
+{
+    int32_t numberOfThreads = 1;
+#ifdef CARET_OMP
+    numberOfThreads = omp_get_max_threads();
+#endif // CARET_OMP
+    /*
+     * Fraction of the available threads kept busy, near zero when the
+     * command is waiting on I/O, near one when all threads are computing
+     */
+    double threadUtilization = 0.0;
+    if (wallSeconds > 0.0) {
+        threadUtilization = cpuSeconds / (wallSeconds * numberOfThreads);
+    }
+    
+    std::vector<AString> phaseNames;
+    std::vector<double> phaseSeconds;
+    std::vector<int64_t> phaseCounts;
+    PerformanceStatistics::getPhaseTimes(phaseNames, phaseSeconds, phaseCounts);
+    AString phasesText;
+    for (int32_t i = 0; i < static_cast<int32_t>(phaseNames.size()); i++) {
+        if (i > 0) {
+            phasesText += ",";
+        }
+        phasesText += ("{\"name\":" + toJsonString(phaseNames[i])
+                       + ",\"seconds\":" + AString::number(phaseSeconds[i], 'f', 6)
+                       + ",\"count\":" + AString::number(phaseCounts[i])
+                       + "}");
+    }
+    
+    const AString record = ("{\"command\":" + toJsonString(commandSwitch)
+                            + ",\"command_line\":" + toJsonString(caret_global_commandLine)
+                            + ",\"succeeded\":" + AString(succeeded ? "true" : "false")
+                            + ",\"wall_seconds\":" + AString::number(wallSeconds, 'f', 6)
+                            + ",\"cpu_seconds\":" + AString::number(cpuSeconds, 'f', 6)
+                            + ",\"threads\":" + AString::number(numberOfThreads)
+                            + ",\"thread_utilization\":" + AString::number(threadUtilization, 'f', 3)
+                            + ",\"bytes_read\":" + AString::number(PerformanceStatistics::getBytesRead())
+                            + ",\"bytes_written\":" + AString::number(PerformanceStatistics::getBytesWritten())
+                            + ",\"peak_rss_bytes\":" + AString::number(PerformanceStatistics::getPeakResidentSetSizeBytes())
+                            + ",\"phases\":[" + phasesText + "]}");
+    m_performanceRecords.push_back(record);
+}
+
+/**
+ * Write the performance records as a JSON document to the file
+ * given with -performance-json.  Failure to write is logged, not
+ * thrown, so that it does not hide the result of the command.
+ */
+void
+CommandOperationManager::writePerformanceFile()
+{
+    QFile file(m_performanceFileName);
+    if ( ! file.open(QFile::WriteOnly | QFile::Truncate)) {
+        CaretLogWarning("unable to write performance statistics to "
+                        + m_performanceFileName + ": " + file.errorString());
+        return;
+    }
+    QTextStream stream(&file);
+    stream << "{\"commands\":[";
+    for (int32_t i = 0; i < static_cast<int32_t>(m_performanceRecords.size()); i++) {
+        if (i > 0) {
+            stream << ",";
+        }
+        stream << "\n" << m_performanceRecords[i];
+    }
+    stream << "\n]}\n";
+    stream.flush();
+    if (file.error() != QFile::NoError) {
+        CaretLogWarning("error writing performance statistics to "
+                        + m_performanceFileName + ": " + file.errorString());
+    }
+    m_performanceRecords.clear();
+}
+
+namespace {
+    /**
+     * Split a line of a batch file into arguments.  Single quotes,
+     * double quotes, and backslashes are treated as they are by a
+     * POSIX shell, but there is no variable or wildcard expansion.
+     * An unquoted '#' at the start of an argument begins a comment.
+     *
+     * @param line
+     *    The line of text.
+     * @return
+     *    Arguments from the line.
+     * @throw CommandException
+     *    If a quote is not terminated.
+     */
+    std::vector<AString> splitBatchLine(const AString& line)
+    {
+        std::vector<AString> arguments;
+        AString argument;
+        bool inArgument = false;
+        const int32_t length = line.length();
+        for (int32_t i = 0; i < length; i++) {
+            const QChar c = line[i];
+            if (c == '\'') {
+                const int32_t endQuote = line.indexOf('\'', i + 1);
+                if (endQuote < 0) {
+                    throw CommandException("unterminated single quote");
+                }
+                argument += line.mid(i + 1, endQuote - i - 1);
+                inArgument = true;
+                i = endQuote;
+            }
+            else if (c == '"') {
+                i++;
+                while ((i < length)
+                       && (line[i] != '"')) {
+                    if ((line[i] == '\\')
+                        && ((i + 1) < length)
+                        && ((line[i + 1] == '"')
+                            || (line[i + 1] == '\\')
+                            || (line[i + 1] == '$')
+                            || (line[i + 1] == '`'))) {
+                        i++;
+                    }
+                    argument += line[i];
+                    i++;
+                }
+                if (i >= length) {
+                    throw CommandException("unterminated double quote");
+                }
+                inArgument = true;
+            }
+            else if (c == '\\') {
+                if ((i + 1) < length) {
+                    i++;
+                    argument += line[i];
+                }
+                inArgument = true;
+            }
+            else if (c.isSpace()) {
+                if (inArgument) {
+                    arguments.push_back(argument);
+                    argument = "";
+                    inArgument = false;
+                }
+            }
+            else if ((c == '#')
+                     && ( ! inArgument)) {
+                break;
+            }
+            else {
+                argument += c;
+                inArgument = true;
+            }
+        }
+        if (inArgument) {
+            arguments.push_back(argument);
+        }
+        return arguments;
+    }
+    
+    /**
+     * Is a string parameter of a command possibly the name of a file
+     * that the command reads or writes (such as the file modified by
+     * -set-structure or the text file written by -cifti-label-export-table)?
+     * Any string that is an existing file, or looks like a path or file
+     * name, is treated as a file.  Treating a string that is not a file
+     * as a file only reduces the number of commands that run concurrently.
+     */
+    bool isPossibleFileName(const AString& text)
+    {
+        if (text.isEmpty()) {
+            return false;
+        }
+        if (text.contains('/')
+            || text.contains('.')) {
+            return true;
+        }
+        FileInformation fileInfo(text);
+        return fileInfo.exists();
+    }
+}
+
+/**
+ * Run the commands in a batch file.  All commands run in this process
+ * and share a cache of input files, so process startup and reading the
+ * same surfaces and CIFTI files for each command are avoided.
+ *
+ * With more than one job, commands are divided into groups where commands
+ * in different groups do not write any file that is read or written by
+ * another group.  Groups run concurrently in separate worker processes
+ * and commands within a group run in the order of the batch file.
+ *
+ * @param parameters
+ *    Parameters following "-batch".
+ * @param preventProvenance
+ *    If true, provenance is disabled for all commands.
+ * @throws CommandException
+ *    If reading the batch file or a command fails.
+ */
+void
+CommandOperationManager::runBatch(ProgramParameters& parameters,
+                                  const bool preventProvenance)
+{
+    const AString batchFileName = parameters.nextString("batch file");
+    int32_t numberOfJobs = 1;
+    while (parameters.hasNext()) {
+        const AString option = parameters.nextString("batch option");
+        if (option == "-jobs") {
+            numberOfJobs = parameters.nextInt("number of jobs");
+            if (numberOfJobs < 1) {
+                throw CommandException("number of jobs must be at least 1");
+            }
+        }
+        else {
+            throw CommandException("unrecognized option to -batch: " + option);
+        }
+    }
+    
+    std::vector<BatchCommand> commands;
+    readBatchFile(batchFileName,
+                  commands);
+    const int32_t numberOfBatchCommands = static_cast<int32_t>(commands.size());
+    if (numberOfBatchCommands <= 0) {
+        return;
+    }
+    
+    const AString programName = parameters.getProgramName();
+    const AString batchCommandLine = caret_global_commandLine;
+    m_batchRunning = true;
+    
+    std::vector<std::vector<int32_t> > workerCommands;
+#ifndef _WIN32
+    if (numberOfJobs > 1) {
+        /*
+         * Spread the groups of commands over the workers, placing
+         * each group with the worker that has the fewest commands
+         */
+        std::vector<std::vector<int32_t> > groups = groupIndependentBatchCommands(commands);
+        const int32_t numberOfWorkers = std::min(numberOfJobs,
+                                                 static_cast<int32_t>(groups.size()));
+        if (numberOfWorkers > 1) {
+            std::vector<std::pair<int32_t, int32_t> > groupSizes;
+            for (int32_t i = 0; i < static_cast<int32_t>(groups.size()); i++) {
+                groupSizes.push_back(std::make_pair(-static_cast<int32_t>(groups[i].size()), i));
+            }
+            std::sort(groupSizes.begin(), groupSizes.end());
+            workerCommands.resize(numberOfWorkers);
+            for (int32_t i = 0; i < static_cast<int32_t>(groupSizes.size()); i++) {
+                int32_t smallestWorker = 0;
+                for (int32_t j = 1; j < numberOfWorkers; j++) {
+                    if (workerCommands[j].size() < workerCommands[smallestWorker].size()) {
+                        smallestWorker = j;
+                    }
+                }
+                const std::vector<int32_t>& group = groups[groupSizes[i].second];
+                workerCommands[smallestWorker].insert(workerCommands[smallestWorker].end(),
+                                                      group.begin(),
+                                                      group.end());
+            }
+            for (int32_t j = 0; j < numberOfWorkers; j++) {
+                std::sort(workerCommands[j].begin(), workerCommands[j].end());
+            }
+        }
+    }
+#endif // _WIN32
+    
+    if (workerCommands.empty()) {
+        /*
+         * Run all commands in order in this process
+         */
+        std::vector<int32_t> indices;
+        for (int32_t i = 0; i < numberOfBatchCommands; i++) {
+            indices.push_back(i);
+        }
+        const std::vector<std::vector<AString> > filesNotReadAgain = findFilesReadForLastTime(commands,
+                                                                                              indices);
+        CommandInputFileCache fileCache;
+        CommandParser::setInputFileCache(&fileCache);
+        try {
+            for (int32_t i = 0; i < numberOfBatchCommands; i++) {
+                runBatchCommand(commands[i],
+                                programName,
+                                preventProvenance,
+                                filesNotReadAgain[i],
+                                fileCache);
+            }
+        }
+        catch (...) {
+            CommandParser::setInputFileCache(NULL);
+            m_batchRunning = false;
+            throw;
+        }
+        CommandParser::setInputFileCache(NULL);
+        caret_global_commandLine = batchCommandLine;
+        m_batchRunning = false;
+        return;
+    }
+    
+#ifndef _WIN32
+    const int32_t numberOfWorkers = static_cast<int32_t>(workerCommands.size());
+    cout.flush();
+    cerr.flush();
+    std::vector<pid_t> workerProcessIDs;
+    for (int32_t iWorker = 0; iWorker < numberOfWorkers; iWorker++) {
+        const pid_t pid = fork();
+        if (pid < 0) {
+            /*
+             * Commands already started by other workers are still
+             * running, wait for them before reporting the error.
+             */
+            for (int32_t j = 0; j < static_cast<int32_t>(workerProcessIDs.size()); j++) {
+                int status = 0;
+                waitpid(workerProcessIDs[j], &status, 0);
+            }
+            m_batchRunning = false;
+            throw CommandException("failed to start worker process for batch commands");
+        }
+        if (pid == 0) {
+            /*
+             * Worker process divides the processors with the other workers
+             */
+#ifdef CARET_OMP
+            omp_set_num_threads(std::max(1, omp_get_num_procs() / numberOfWorkers));
+#endif // CARET_OMP
+            int exitStatus = 0;
+            const std::vector<int32_t>& indices = workerCommands[iWorker];
+            const std::vector<std::vector<AString> > filesNotReadAgain = findFilesReadForLastTime(commands,
+                                                                                                  indices);
+            CommandInputFileCache fileCache;
+            CommandParser::setInputFileCache(&fileCache);
+            for (int32_t i = 0; i < static_cast<int32_t>(indices.size()); i++) {
+                try {
+                    runBatchCommand(commands[indices[i]],
+                                    programName,
+                                    preventProvenance,
+                                    filesNotReadAgain[i],
+                                    fileCache);
+                }
+                catch (const CaretException& e) {
+                    cerr << "\nWhile running:\n" << caret_global_commandLine << "\n\nERROR: " << e.whatString().toStdString() << endl << endl;
+                    exitStatus = 1;
+                }
+                catch (const std::exception& e) {
+                    cerr << "\nWhile running:\n" << caret_global_commandLine << "\n\nERROR: " << e.what() << endl << endl;
+                    exitStatus = 1;
+                }
+                if (exitStatus != 0) {
+                    break;
+                }
+            }
+            CommandParser::setInputFileCache(NULL);
+            if ( PerformanceStatistics::isEnabled()) {
+                writeWorkerPerformanceRecords(getWorkerPerformanceFileName(iWorker));
+            }
+            cout.flush();
+            cerr.flush();
+            _exit(exitStatus);
+        }
+        workerProcessIDs.push_back(pid);
+    }
+    
+    int32_t failedWorkerCount = 0;
+    for (int32_t iWorker = 0; iWorker < numberOfWorkers; iWorker++) {
+        int status = 0;
+        if (waitpid(workerProcessIDs[iWorker], &status, 0) < 0) {
+            failedWorkerCount++;
+        }
+        else if (( ! WIFEXITED(status))
+                 || (WEXITSTATUS(status) != 0)) {
+            failedWorkerCount++;
+        }
+        if ( PerformanceStatistics::isEnabled()) {
+            readWorkerPerformanceRecords(getWorkerPerformanceFileName(iWorker));
+        }
+    }
+    caret_global_commandLine = batchCommandLine;
+    m_batchRunning = false;
+    
+    if (failedWorkerCount > 0) {
+        throw CommandException(AString::number(failedWorkerCount)
+                               + " of "
+                               + AString::number(numberOfWorkers)
+                               + " batch worker processes had a failed command, see errors above");
+    }
+#endif // _WIN32
+}
+
+/**
+ * @return Name of the file used by a batch worker process to pass
+ * its performance records to the main process.
+ *
+ * @param workerIndex
+ *    Index of the worker.
+ */
+AString
+CommandOperationManager::getWorkerPerformanceFileName(const int32_t workerIndex) const
+{
+    return m_performanceFileName + ".worker" + AString::number(workerIndex);
+}
+
+/**
+ * Write the performance records, one per line, for the main process to read.
+ *
+ * @param fileName
+ *    Name of the file.
+ */
+void
+CommandOperationManager::writeWorkerPerformanceRecords(const AString& fileName)
+{
+    QFile file(fileName);
+    if ( ! file.open(QFile::WriteOnly | QFile::Truncate)) {
+        CaretLogWarning("unable to write performance statistics to " + fileName);
+        return;
+    }
+    QTextStream stream(&file);
+    for (std::vector<AString>::iterator iter = m_performanceRecords.begin();
+         iter != m_performanceRecords.end();
+         iter++) {
+        stream << *iter << "\n";
+    }
+    stream.flush();
+}
+
+/**
+ * Add the performance records written by a worker process and
+ * remove the worker's file.
+ *
+ * @param fileName
+ *    Name of the file.
+ */
+void
+CommandOperationManager::readWorkerPerformanceRecords(const AString& fileName)
+{
+    QFile file(fileName);
+    if ( ! file.open(QFile::ReadOnly)) {
+        return;//worker failed before writing
+    }
+    QTextStream stream(&file);
+    while ( ! stream.atEnd()) {
+        const AString line = stream.readLine();
+        if ( ! line.isEmpty()) {
+            m_performanceRecords.push_back(line);
+        }
+    }
+    file.close();
+    file.remove();
+}
+
+/**
+ * Read the commands in a batch file.  Each line contains one command,
+ * optionally preceded by the program name.  A line ending with a
+ * backslash continues on the next line.  Empty lines and lines
+ * starting with '#' are ignored.
+ *
+ * @param batchFileName
+ *    Name of the batch file.
+ * @param commandsOut
+ *    Output with the commands.
+ * @throws CommandException
+ *    If the file cannot be read or a line is invalid.
+ */
+void
+CommandOperationManager::readBatchFile(const AString& batchFileName,
+                                       std::vector<BatchCommand>& commandsOut)
+{
+    commandsOut.clear();
+    
+    QFile file(batchFileName);
+    if ( ! file.open(QFile::ReadOnly | QFile::Text)) {
+        throw CommandException("Unable to open batch file "
+                               + batchFileName
+                               + ": "
+                               + file.errorString());
+    }
+    QTextStream stream(&file);
+    
+    int32_t lineNumber = 0;
+    while ( ! stream.atEnd()) {
+        lineNumber++;
+        const int32_t commandLineNumber = lineNumber;
+        AString line = stream.readLine();
+        while (line.endsWith('\\')
+               && ( ! stream.atEnd())) {
+            line.chop(1);
+            line += " " + stream.readLine();
+            lineNumber++;
+        }
+        
+        BatchCommand command;
+        command.m_lineNumber = commandLineNumber;
+        command.m_filesKnown = false;
+        try {
+            command.m_arguments = splitBatchLine(line);
+        }
+        catch (const CommandException& e) {
+            throw CommandException(batchFileName
+                                   + " line "
+                                   + AString::number(commandLineNumber)
+                                   + ": "
+                                   + e.whatString());
+        }
+        if (command.m_arguments.empty()) {
+            continue;
+        }
+        
+        /*
+         * Commands may be copied from a script with the program name
+         */
+        const AString firstArgument = command.m_arguments[0];
+        if (( ! firstArgument.startsWith("-"))
+            && FileInformation(firstArgument).getFileName().startsWith("wb_command")) {
+            command.m_arguments.erase(command.m_arguments.begin());
+            if (command.m_arguments.empty()) {
+                continue;
+            }
+        }
+        
+        findBatchCommandFiles(command);
+        commandsOut.push_back(command);
+    }
+}
+
+/**
+ * Find the files that a batch command reads and writes, without
+ * reading any files.  If the files cannot be determined (the
+ * command is not a processing command or has invalid parameters),
+ * the command's files are marked unknown.
+ *
+ * @param command
+ *    The command.
+ */
+void
+CommandOperationManager::findBatchCommandFiles(BatchCommand& command)
+{
+    command.m_filesKnown = false;
+    command.m_readFileNames.clear();
+    command.m_writtenFileNames.clear();
+    
+    ProgramParameters parameters;
+    for (std::vector<AString>::const_iterator iter = command.m_arguments.begin();
+         iter != command.m_arguments.end();
+         iter++) {
+        parameters.addParameter(*iter);
+    }
+    
+    try {
+        std::vector<AString> globalOptionArgs;
+        getGlobalOption(parameters, "-disable-provenance", 0, globalOptionArgs);
+        getGlobalOption(parameters, "-performance-json", 1, globalOptionArgs);
+        getGlobalOption(parameters, "-gifti-compression", 1, globalOptionArgs);
+        if ( ! parameters.hasNext()) {
+            return;
+        }
+        CommandParser* commandParser = dynamic_cast<CommandParser*>(findCommandOperation(parameters.nextString("Command Name")));
+        if (commandParser == NULL) {
+            return;
+        }
+        
+        std::vector<AString> inputFileNames, outputFileNames, stringParameters;
+        commandParser->getFileNames(parameters,
+                                    inputFileNames,
+                                    outputFileNames,
+                                    stringParameters);
+        for (std::vector<AString>::iterator iter = inputFileNames.begin();
+             iter != inputFileNames.end();
+             iter++) {
+            command.m_readFileNames.push_back(FileInformation(*iter).getAbsoluteFilePath());
+        }
+        for (std::vector<AString>::iterator iter = outputFileNames.begin();
+             iter != outputFileNames.end();
+             iter++) {
+            command.m_writtenFileNames.push_back(FileInformation(*iter).getAbsoluteFilePath());
+        }
+        for (std::vector<AString>::iterator iter = stringParameters.begin();
+             iter != stringParameters.end();
+             iter++) {
+            if (isPossibleFileName(*iter)) {
+                command.m_writtenFileNames.push_back(FileInformation(*iter).getAbsoluteFilePath());
+            }
+        }
+        command.m_filesKnown = true;
+    }
+    catch (const CaretException&) {
+        /*
+         * Errors are reported when the command is run
+         */
+    }
+}
+
+/**
+ * Divide batch commands into groups so that no command writes a file
+ * that is read or written by a command in another group.  If the files
+ * of any command are unknown, all commands are in one group.
+ *
+ * @param commands
+ *    The batch commands.
+ * @return
+ *    Indices of the commands in each group, in order of the batch file.
+ */
+std::vector<std::vector<int32_t> >
+CommandOperationManager::groupIndependentBatchCommands(const std::vector<BatchCommand>& commands)
+{
+    const int32_t numberOfBatchCommands = static_cast<int32_t>(commands.size());
+    std::vector<std::vector<int32_t> > groups;
+    
+    bool allFilesKnown = true;
+    for (int32_t i = 0; i < numberOfBatchCommands; i++) {
+        if ( ! commands[i].m_filesKnown) {
+            allFilesKnown = false;
+        }
+    }
+    if ( ! allFilesKnown) {
+        groups.resize(1);
+        for (int32_t i = 0; i < numberOfBatchCommands; i++) {
+            groups[0].push_back(i);
+        }
+        return groups;
+    }
+    
+    /*
+     * Commands using each file and whether any command writes it
+     */
+    std::map<AString, std::vector<int32_t> > fileCommands;
+    std::map<AString, bool> fileWritten;
+    for (int32_t i = 0; i < numberOfBatchCommands; i++) {
+        const BatchCommand& command = commands[i];
+        for (std::vector<AString>::const_iterator iter = command.m_readFileNames.begin();
+             iter != command.m_readFileNames.end();
+             iter++) {
+            fileCommands[*iter].push_back(i);
+        }
+        for (std::vector<AString>::const_iterator iter = command.m_writtenFileNames.begin();
+             iter != command.m_writtenFileNames.end();
+             iter++) {
+            fileCommands[*iter].push_back(i);
+            fileWritten[*iter] = true;
+        }
+    }
+    
+    /*
+     * Join commands that use a written file into the same group
+     */
+    std::vector<int32_t> groupOfCommand(numberOfBatchCommands);
+    for (int32_t i = 0; i < numberOfBatchCommands; i++) {
+        groupOfCommand[i] = i;
+    }
+    for (std::map<AString, bool>::iterator writtenIter = fileWritten.begin();
+         writtenIter != fileWritten.end();
+         writtenIter++) {
+        const std::vector<int32_t>& users = fileCommands[writtenIter->first];
+        for (int32_t i = 1; i < static_cast<int32_t>(users.size()); i++) {
+            int32_t first = users[0];
+            while (groupOfCommand[first] != first) {
+                first = groupOfCommand[first];
+            }
+            int32_t other = users[i];
+            while (groupOfCommand[other] != other) {
+                other = groupOfCommand[other];
+            }
+            if (first != other) {
+                groupOfCommand[std::max(first, other)] = std::min(first, other);
+            }
+        }
+    }
+    
+    std::map<int32_t, int32_t> groupIndices;
+    for (int32_t i = 0; i < numberOfBatchCommands; i++) {
+        int32_t root = i;
+        while (groupOfCommand[root] != root) {
+            root = groupOfCommand[root];
+        }
+        std::map<int32_t, int32_t>::iterator iter = groupIndices.find(root);
+        if (iter == groupIndices.end()) {
+            iter = groupIndices.insert(std::make_pair(root, static_cast<int32_t>(groups.size()))).first;
+            groups.push_back(std::vector<int32_t>());
+        }
+        groups[iter->second].push_back(i);
+    }
+    
+    return groups;
+}
+
+/**
+ * Run one command from a batch file.
+ *
+ * @param command
+ *    The command.
+ * @param programName
+ *    Name of the program, used for provenance.
+ * @param preventProvenance
+ *    If true, provenance is disabled for the command.
+ * @param filesNotReadAgain
+ *    Files read by the command that no later command reads, they
+ *    are removed from the cache after the command.
+ * @param fileCache
+ *    Cache of input files.
+ * @throws CommandException
+ *    If the command fails.
+ */
+void
+CommandOperationManager::runBatchCommand(const BatchCommand& command,
+                                         const AString& programName,
+                                         const bool preventProvenance,
+                                         const std::vector<AString>& filesNotReadAgain,
+                                         CommandInputFileCache& fileCache)
+{
+    /*
+     * Construct parameters as if the command was run by itself
+     * so that the command line in provenance is the same.
+     */
+    std::vector<QByteArray> argumentBytes;
+    argumentBytes.push_back(programName.toLocal8Bit());
+    for (std::vector<AString>::const_iterator iter = command.m_arguments.begin();
+         iter != command.m_arguments.end();
+         iter++) {
+        argumentBytes.push_back(iter->toLocal8Bit());
+    }
+    if (preventProvenance) {
+        argumentBytes.push_back(QByteArray("-disable-provenance"));
+    }
+    std::vector<const char*> argv;
+    for (std::vector<QByteArray>::const_iterator iter = argumentBytes.begin();
+         iter != argumentBytes.end();
+         iter++) {
+        argv.push_back(iter->constData());
+    }
+    ProgramParameters parameters(static_cast<int>(argv.size()),
+                                 &argv[0]);
+    caret_global_commandLine_init(parameters);
+    CaretLogFine("Running: " + caret_global_commandLine);
+    
+    /*
+     * Files in the cache that the command writes are removed
+     * so that they are read again by later commands.
+     */
+    for (std::vector<AString>::const_iterator iter = command.m_writtenFileNames.begin();
+         iter != command.m_writtenFileNames.end();
+         iter++) {
+        fileCache.removeFile(*iter);
+    }
+    if ( ! command.m_filesKnown) {
+        fileCache.clear();
+    }
+    
+    try {
+        runCommand(parameters);
+    }
+    catch (const CaretException& e) {
+        throw CommandException("line "
+                               + AString::number(command.m_lineNumber)
+                               + " of batch file: "
+                               + e.whatString());
+    }
+    
+    /*
+     * A command that writes one of its inputs has just cached the
+     * old contents, and files no later command reads are not needed.
+     */
+    for (std::vector<AString>::const_iterator iter = command.m_writtenFileNames.begin();
+         iter != command.m_writtenFileNames.end();
+         iter++) {
+        fileCache.removeFile(*iter);
+    }
+    for (std::vector<AString>::const_iterator iter = filesNotReadAgain.begin();
+         iter != filesNotReadAgain.end();
+         iter++) {
+        fileCache.removeFile(*iter);
+    }
+}
+
+/**
+ * Find the files that each command reads for the last time, so that they
+ * can be removed from the input file cache after the command.  A command
+ * whose files are unknown clears the cache before it runs, so it is
+ * treated as reading nothing.
+ *
+ * @param commands
+ *    The batch commands.
+ * @param indices
+ *    Indices of the commands that are run, in the order they are run.
+ * @return
+ *    For each command in indices, the files it reads that no later
+ *    command in indices reads.
+ */
+std::vector<std::vector<AString> >
+CommandOperationManager::findFilesReadForLastTime(const std::vector<BatchCommand>& commands,
+                                                  const std::vector<int32_t>& indices)
+{
+    const int32_t numberOfIndices = static_cast<int32_t>(indices.size());
+    std::map<AString, int32_t> lastReadPosition;
+    for (int32_t i = 0; i < numberOfIndices; i++) {
+        CaretAssertVectorIndex(commands, indices[i]);
+        const BatchCommand& command = commands[indices[i]];
+        for (std::vector<AString>::const_iterator iter = command.m_readFileNames.begin();
+             iter != command.m_readFileNames.end();
+             iter++) {
+            lastReadPosition[*iter] = i;
+        }
+    }
+    
+    std::vector<std::vector<AString> > filesReadForLastTime(numberOfIndices);
+    for (std::map<AString, int32_t>::const_iterator iter = lastReadPosition.begin();
+         iter != lastReadPosition.end();
+         iter++) {
+        filesReadForLastTime[iter->second].push_back(iter->first);
+    }
+    
+    return filesReadForLastTime;
+}
+
 /**
  * Print all of the commands.
  */
@@ -720,8 +1692,23 @@ void CommandOperationManager::printHelpInfo()
     cout << "   -list-deprecated-commands   list deprecated subcommands" << endl;
     cout << "   -all-commands-help          show all processing subcommands and their help" << endl;
     cout << "                                  info - VERY LONG" << endl;
+    cout << endl << "Batch mode:" << endl;
+    cout << "   -batch <file> [-jobs <n>]   run the commands in a file, one per line, in" << endl;
+    cout << "                                  one process, reusing surfaces and cifti" << endl;
+    cout << "                                  files that are inputs to several commands." << endl;
+    cout << "                                  Quoting is as in a shell, but there is no" << endl;
+    cout << "                                  variable expansion.  With -jobs, commands" << endl;
+    cout << "                                  that share no written files run" << endl;
+    cout << "                                  concurrently in up to <n> processes" << endl;
     cout << endl << "Global options (can be added to any command):" << endl;
     cout << "   -disable-provenance         don't generate provenance info in output files" << endl;
+    cout << "   -performance-json <file>    write wall and cpu time, thread utilization," << endl;
+    cout << "                                  bytes read and written, peak memory, and" << endl;
+    cout << "                                  phase times of each command (including" << endl;
+    cout << "                                  each command of a batch) to a JSON file" << endl;
+    cout << "   -gifti-compression <level>  zlib level for compressed GIFTI output, 1" << endl;
+    cout << "                                  (fastest) to 9 (smallest), or 0 to write" << endl;
+    cout << "                                  uncompressed base64 instead" << endl;
     cout << endl;
     cout << "If the first argument is not recognized, all processing commands that start" << endl;
     cout << "   with the argument are displayed" << endl;
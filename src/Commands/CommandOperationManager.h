@@ -29,6 +29,7 @@
 
 namespace caret {
 
+    class CommandInputFileCache;
     class CommandOperation;
     class ProgramParameters;
     
@@ -69,9 +70,76 @@ namespace caret {
         
         bool getGlobalOption(ProgramParameters& parameters, const AString& optionString, const int& numArgs, std::vector<AString>& arguments);
         
+        CommandOperation* findCommandOperation(const AString& commandSwitch);
+        
+        void runCommandSwitch(ProgramParameters& parameters);
+        
+        void executeOperationWithStatistics(CommandOperation* operation,
+                                            ProgramParameters& parameters,
+                                            const bool preventProvenance);
+        
+        void addPerformanceRecord(const AString& commandSwitch,
+                                  const bool succeeded,
+                                  const double wallSeconds,
+                                  const double cpuSeconds);
+        
+        void writePerformanceFile();
+        
+        AString getWorkerPerformanceFileName(const int32_t workerIndex) const;
+        
+        void writeWorkerPerformanceRecords(const AString& fileName);
+        
+        void readWorkerPerformanceRecords(const AString& fileName);
+        
+        /** A command read from a batch file */
+        struct BatchCommand {
+            /** Arguments of the command, first is the command switch */
+            std::vector<AString> m_arguments;
+            
+            /** Line in the batch file */
+            int32_t m_lineNumber;
+            
+            /** True if the files read and written by the command are known */
+            bool m_filesKnown;
+            
+            /** Absolute paths of files read by the command */
+            std::vector<AString> m_readFileNames;
+            
+            /** Absolute paths of files the command may write */
+            std::vector<AString> m_writtenFileNames;
+        };
+        
+        void runBatch(ProgramParameters& parameters,
+                      const bool preventProvenance);
+        
+        void readBatchFile(const AString& batchFileName,
+                           std::vector<BatchCommand>& commandsOut);
+        
+        void findBatchCommandFiles(BatchCommand& command);
+        
+        void runBatchCommand(const BatchCommand& command,
+                             const AString& programName,
+                             const bool preventProvenance,
+                             const std::vector<AString>& filesNotReadAgain,
+                             CommandInputFileCache& fileCache);
+        
+        std::vector<std::vector<int32_t> > groupIndependentBatchCommands(const std::vector<BatchCommand>& commands);
+        
+        std::vector<std::vector<AString> > findFilesReadForLastTime(const std::vector<BatchCommand>& commands,
+                                                                    const std::vector<int32_t>& indices);
+        
     private:
         std::vector<CommandOperation*> commandOperations, deprecatedOperations;
         
+        /** True while commands from a batch file are running */
+        bool m_batchRunning;
+        
+        /** File for performance statistics, empty if not recording */
+        AString m_performanceFileName;
+        
+        /** JSON records with the performance statistics of finished commands */
+        std::vector<AString> m_performanceRecords;
+        
         static CommandOperationManager* singletonCommandOperationManager;
     };
     
@@ -28,6 +28,7 @@
 #include "CaretDataFileHelper.h"
 #include "CaretLogger.h"
 #include "CiftiFile.h"
+#include "CommandInputFileCache.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
 #include "FociFile.h"
@@ -35,6 +36,7 @@
 #include "LabelFile.h"
 #include "MetricFile.h"
 #include "OperationException.h"
+#include "PerformanceStatistics.h"
 #include "SurfaceFile.h"
 #include "VolumeFile.h"
 
@@ -49,12 +51,14 @@ const AString CommandParser::PROVENANCE_NAME = "Provenance";
 const AString CommandParser::PARENT_PROVENANCE_NAME = "ParentProvenance";
 const AString CommandParser::PROGRAM_PROVENANCE_NAME = "ProgramProvenance";
 const AString CommandParser::CWD_PROVENANCE_NAME = "WorkingDirectory";
+CommandInputFileCache* CommandParser::s_inputFileCache = NULL;
 
 CommandParser::CommandParser(AutoOperationInterface* myAutoOper) :
     CommandOperation(myAutoOper->getCommandSwitch(), myAutoOper->getShortDescription()),
     OperationParserInterface(myAutoOper)
 {
     m_doProvenance = true;
+    m_listFilesOnly = false;
 }
 
 void CommandParser::disableProvenance()
@@ -65,28 +69,74 @@ void CommandParser::disableProvenance()
 
 void CommandParser::executeOperation(ProgramParameters& parameters)
 {
-    CaretPointer<OperationParameters> myAlgParams(m_autoOper->getParameters());//could be an autopointer, but this is safer
+    try
+    {
+        CaretPointer<OperationParameters> myAlgParams(m_autoOper->getParameters());//could be an autopointer, but this is safer
+        vector<OutputAssoc> myOutAssoc;
+        m_provenance = caret_global_commandLine;
+        //the idea is to have m_provenance set before the command executes, so it can be overridden, but have m_parentProvenance set AFTER the processing is complete
+        //the parent provenance should never be generated manually
+        m_parentProvenance = "";//in case someone tries to use the same instance more than once
+        m_inputCiftiNames.clear();//ditto
+        m_workingDir = QDir::currentPath();//get the current path, in case some stupid command changes the working directory
+        //these get set on output files during writeOutput (and for on-disk in provenanceBeforeOperation)
+        {
+            PerformancePhaseTimer phaseTimer("parse and read inputs");
+            parseComponent(myAlgParams.getPointer(), parameters, myOutAssoc);//parsing block
+            parameters.verifyAllParametersProcessed();
+            makeOnDiskOutputs(myOutAssoc);//check for input on-disk files used as output on-disk files
+            //code to show what arguments map to what parameters should go here
+            if (m_doProvenance) provenanceBeforeOperation(myOutAssoc);
+        }
+        {
+            PerformancePhaseTimer phaseTimer("operation");
+            m_autoOper->useParameters(myAlgParams.getPointer(), NULL);//TODO: progress status for caret_command? would probably get messed up by any command info output
+        }
+        vector<AString> uncheckedWarnings = myAlgParams->findUncheckedParams("the command");
+        for (size_t i = 0; i < uncheckedWarnings.size(); ++i)
+        {
+            CaretLogWarning(uncheckedWarnings[i]);
+        }
+        PerformancePhaseTimer phaseTimer("write outputs");
+        if (m_doProvenance) provenanceAfterOperation(myOutAssoc);
+        //TODO: deallocate input files - give abstract parameter a virtual deallocate method? use CaretPointer and rely on reference counting?
+        writeOutput(myOutAssoc);
+    } catch (...) {
+        m_doProvenance = true;//-disable-provenance applies to one run, and batch mode can run the same command again
+        throw;
+    }
+    m_doProvenance = true;
+}
+
+void CommandParser::getFileNames(ProgramParameters& parameters, vector<AString>& inputFileNamesOut, vector<AString>& outputFileNamesOut,
+                                 vector<AString>& stringParametersOut)
+{
+    CaretPointer<OperationParameters> myAlgParams(m_autoOper->getParameters());
     vector<OutputAssoc> myOutAssoc;
-    m_provenance = caret_global_commandLine;
-    //the idea is to have m_provenance set before the command executes, so it can be overridden, but have m_parentProvenance set AFTER the processing is complete
-    //the parent provenance should never be generated manually
-    m_parentProvenance = "";//in case someone tries to use the same instance more than once
-    m_workingDir = QDir::currentPath();//get the current path, in case some stupid command changes the working directory
-    //these get set on output files during writeOutput (and for on-disk in provenanceBeforeOperation)
-    parseComponent(myAlgParams.getPointer(), parameters, myOutAssoc);//parsing block
-    parameters.verifyAllParametersProcessed();
-    makeOnDiskOutputs(myOutAssoc);//check for input on-disk files used as output on-disk files
-    //code to show what arguments map to what parameters should go here
-    if (m_doProvenance) provenanceBeforeOperation(myOutAssoc);
-    m_autoOper->useParameters(myAlgParams.getPointer(), NULL);//TODO: progress status for caret_command? would probably get messed up by any command info output
-    vector<AString> uncheckedWarnings = myAlgParams->findUncheckedParams("the command");
-    for (size_t i = 0; i < uncheckedWarnings.size(); ++i)
+    m_listedInputNames.clear();
+    m_listedStrings.clear();
+    m_listFilesOnly = true;//parse without reading any input files
+    try
+    {
+        parseComponent(myAlgParams.getPointer(), parameters, myOutAssoc);
+        parameters.verifyAllParametersProcessed();
+    } catch (...) {
+        m_listFilesOnly = false;
+        throw;
+    }
+    m_listFilesOnly = false;
+    inputFileNamesOut = m_listedInputNames;
+    stringParametersOut = m_listedStrings;
+    outputFileNamesOut.clear();
+    for (size_t i = 0; i < myOutAssoc.size(); ++i)
     {
-        CaretLogWarning(uncheckedWarnings[i]);
+        outputFileNamesOut.push_back(myOutAssoc[i].m_fileName);
     }
-    if (m_doProvenance) provenanceAfterOperation(myOutAssoc);
-    //TODO: deallocate input files - give abstract parameter a virtual deallocate method? use CaretPointer and rely on reference counting?
-    writeOutput(myOutAssoc);
+}
+
+void CommandParser::setInputFileCache(CommandInputFileCache* cache)
+{
+    s_inputFileCache = cache;
 }
 
 void CommandParser::showParsedOperation(ProgramParameters& parameters)
@@ -126,6 +176,30 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
             }
         }
         const OperationParametersEnum::Enum nextType = myComponent->m_paramList[i]->getType();// need in catch statement below
+        if (m_listFilesOnly)
+        {
+            bool isListed = false;
+            switch (nextType)
+            {
+                case OperationParametersEnum::BORDER:
+                case OperationParametersEnum::CIFTI:
+                case OperationParametersEnum::FOCI:
+                case OperationParametersEnum::LABEL:
+                case OperationParametersEnum::METRIC:
+                case OperationParametersEnum::SURFACE:
+                case OperationParametersEnum::VOLUME:
+                    m_listedInputNames.push_back(nextArg);
+                    isListed = true;
+                    break;
+                case OperationParametersEnum::STRING:
+                    m_listedStrings.push_back(nextArg);
+                    isListed = true;
+                    break;
+                default:
+                    break;
+            }
+            if (isListed) continue;//don't read the file
+        }
         try {
             switch (myComponent->m_paramList[i]->getType())
             {
@@ -167,8 +241,14 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 case OperationParametersEnum::CIFTI:
                 {
                     FileInformation myInfo(nextArg);
-                    CaretPointer<CiftiFile> myFile(new CiftiFile());
-                    myFile->openFile(nextArg);
+                    CaretPointer<CiftiFile> myFile;
+                    if (s_inputFileCache != NULL)
+                    {
+                        myFile = s_inputFileCache->getCiftiFile(nextArg);
+                    } else {
+                        myFile.grabNew(new CiftiFile());
+                        myFile->openFile(nextArg);
+                    }
                     m_inputCiftiNames.insert(myInfo.getCanonicalFilePath());//track only names of input cifti, because inputs are always on-disk
                     if (m_doProvenance)//just an optimization, if we aren't going to write provenance, don't generate it, either
                     {
@@ -299,8 +379,14 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::SURFACE:
                 {
-                    CaretPointer<SurfaceFile> myFile(new SurfaceFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<SurfaceFile> myFile;
+                    if (s_inputFileCache != NULL)
+                    {
+                        myFile = s_inputFileCache->getSurfaceFile(nextArg);
+                    } else {
+                        myFile.grabNew(new SurfaceFile());
+                        myFile->readFile(nextArg);
+                    }
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -32,11 +32,16 @@
 
 namespace caret {
 
+    class CommandInputFileCache;
+    
     class CommandParser : public CommandOperation, OperationParserInterface
     {
         int m_minIndent, m_maxIndent, m_indentIncrement, m_maxWidth;
         AString m_provenance, m_parentProvenance, m_workingDir;
         bool m_doProvenance;
+        bool m_listFilesOnly;//parse only to find file names, without reading input files
+        std::vector<AString> m_listedInputNames, m_listedStrings;
+        static CommandInputFileCache* s_inputFileCache;
         const static AString PROVENANCE_NAME, PARENT_PROVENANCE_NAME, PROGRAM_PROVENANCE_NAME, CWD_PROVENANCE_NAME;//TODO: put this elsewhere?
         std::set<AString> m_inputCiftiNames;
         struct OutputAssoc
@@ -63,6 +68,9 @@ namespace caret {
         void disableProvenance();
         void executeOperation(ProgramParameters& parameters);
         void showParsedOperation(ProgramParameters& parameters);
+        void getFileNames(ProgramParameters& parameters, std::vector<AString>& inputFileNamesOut, std::vector<AString>& outputFileNamesOut,
+                          std::vector<AString>& stringParametersOut);
+        static void setInputFileCache(CommandInputFileCache* cache);
         AString getHelpInformation(const AString& programName);
         bool takesParameters();
     };
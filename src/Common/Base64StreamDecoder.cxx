@@ -0,0 +1,268 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "Base64StreamDecoder.h"
+
+#include <algorithm>
+
+using namespace caret;
+
+namespace {
+    /*
+     * Value of each character: 0-63 for data, WHITESPACE for characters
+     * that are skipped, PADDING for '=', INVALID for anything else.
+     * Values above 63 share the two high bits so that a group of
+     * four characters can be tested with a single mask.
+     */
+    const uint8_t WHITESPACE = 0xFE;
+    const uint8_t PADDING = 0xFD;
+    const uint8_t INVALID = 0xFF;
+    
+    const uint8_t DECODE_TABLE[256] = {
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFE,0xFE,0xFF,0xFF,0xFE,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFE,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0x3E,0xFF,0xFF,0xFF,0x3F,
+        0x34,0x35,0x36,0x37,0x38,0x39,0x3A,0x3B,
+        0x3C,0x3D,0xFF,0xFF,0xFF,0xFD,0xFF,0xFF,
+        0xFF,0x00,0x01,0x02,0x03,0x04,0x05,0x06,
+        0x07,0x08,0x09,0x0A,0x0B,0x0C,0x0D,0x0E,
+        0x0F,0x10,0x11,0x12,0x13,0x14,0x15,0x16,
+        0x17,0x18,0x19,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0x1A,0x1B,0x1C,0x1D,0x1E,0x1F,0x20,
+        0x21,0x22,0x23,0x24,0x25,0x26,0x27,0x28,
+        0x29,0x2A,0x2B,0x2C,0x2D,0x2E,0x2F,0x30,
+        0x31,0x32,0x33,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF
+    };
+}
+
+/**
+ * \class caret::Base64StreamDecoder
+ * \brief Decodes Base64 text that arrives in pieces.
+ *
+ * Text can be split at any character, an incomplete group of four
+ * characters is kept until the next call.  Whitespace is skipped,
+ * and text after the padding that ends the data is ignored.  Groups of
+ * four data characters are decoded without per-character tests, which
+ * is the bulk of the work for large arrays.
+ */
+
+/**
+ * Constructor.
+ */
+Base64StreamDecoder::Base64StreamDecoder()
+{
+    reset();
+}
+
+/**
+ * Reset to decode new data.
+ */
+void
+Base64StreamDecoder::reset()
+{
+    m_numberInQuad = 0;
+    m_numberOfPadding = 0;
+    m_finished = false;
+    m_error = false;
+}
+
+/**
+ * Decode the next piece of text.  After an error, nothing more is decoded.
+ *
+ * @param text
+ *    The Base64 text.
+ * @param textLength
+ *    Number of characters in the text.
+ * @param output
+ *    Location for the decoded bytes.
+ * @param outputCapacity
+ *    Number of bytes that may be written to output, if the text
+ *    decodes to more bytes than this, it is an error.
+ * @return
+ *    Number of bytes written to output.
+ */
+int64_t
+Base64StreamDecoder::decode(const char* text,
+                            const int64_t textLength,
+                            uint8_t* output,
+                            const int64_t outputCapacity)
+{
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(text);
+    int64_t inputIndex = 0;
+    int64_t outputIndex = 0;
+    while ((inputIndex < textLength)
+           && ( ! m_finished)
+           && ( ! m_error)) {
+        if (m_numberInQuad == 0) {
+            /*
+             * Whole groups of four data characters
+             */
+            const int64_t numberOfQuads = std::min((textLength - inputIndex) / 4,
+                                                   (outputCapacity - outputIndex) / 3);
+            const unsigned char* quadEnd = input + inputIndex + numberOfQuads * 4;
+            const unsigned char* inputPointer = input + inputIndex;
+            uint8_t* outputPointer = output + outputIndex;
+            while (inputPointer < quadEnd) {
+                const uint32_t d0 = DECODE_TABLE[inputPointer[0]];
+                const uint32_t d1 = DECODE_TABLE[inputPointer[1]];
+                const uint32_t d2 = DECODE_TABLE[inputPointer[2]];
+                const uint32_t d3 = DECODE_TABLE[inputPointer[3]];
+                if (((d0 | d1 | d2 | d3) & 0xC0) != 0) {
+                    break;//whitespace, padding, or invalid, handle one character at a time
+                }
+                const uint32_t bits = (d0 << 18) | (d1 << 12) | (d2 << 6) | d3;
+                outputPointer[0] = static_cast<uint8_t>(bits >> 16);
+                outputPointer[1] = static_cast<uint8_t>(bits >> 8);
+                outputPointer[2] = static_cast<uint8_t>(bits);
+                inputPointer += 4;
+                outputPointer += 3;
+            }
+            inputIndex = inputPointer - input;
+            outputIndex = outputPointer - output;
+            if (inputIndex >= textLength) {
+                break;
+            }
+        }
+        
+        const uint8_t value = DECODE_TABLE[input[inputIndex]];
+        inputIndex++;
+        if (value == WHITESPACE) {
+            continue;
+        }
+        if (value == INVALID) {
+            m_error = true;
+            break;
+        }
+        if (value == PADDING) {
+            if (m_numberInQuad < 2) {
+                m_error = true;
+                break;
+            }
+            m_quad[m_numberInQuad] = 0;
+            m_numberOfPadding++;
+        }
+        else {
+            if (m_numberOfPadding > 0) {
+                m_error = true;//data after padding in the same group
+                break;
+            }
+            m_quad[m_numberInQuad] = value;
+        }
+        m_numberInQuad++;
+        if (m_numberInQuad == 4) {
+            outputIndex += decodeQuad(output + outputIndex,
+                                      outputCapacity - outputIndex);
+        }
+    }
+    
+    return outputIndex;
+}
+
+/**
+ * Finish decoding, an incomplete last group of characters is decoded
+ * as if it had padding.
+ *
+ * @param output
+ *    Location for the decoded bytes.
+ * @param outputCapacity
+ *    Number of bytes that may be written to output.
+ * @return
+ *    Number of bytes written to output.
+ */
+int64_t
+Base64StreamDecoder::finish(uint8_t* output,
+                            const int64_t outputCapacity)
+{
+    if (m_error
+        || m_finished
+        || (m_numberInQuad == 0)) {
+        return 0;
+    }
+    if (m_numberInQuad == 1) {
+        m_error = true;//a single character does not contain a whole byte
+        return 0;
+    }
+    while (m_numberInQuad < 4) {
+        m_quad[m_numberInQuad] = 0;
+        m_numberInQuad++;
+        m_numberOfPadding++;
+    }
+    return decodeQuad(output,
+                      outputCapacity);
+}
+
+/**
+ * Decode the complete group of four characters.
+ *
+ * @param output
+ *    Location for the decoded bytes.
+ * @param outputCapacity
+ *    Number of bytes that may be written to output.
+ * @return
+ *    Number of bytes written to output.
+ */
+int64_t
+Base64StreamDecoder::decodeQuad(uint8_t* output,
+                                const int64_t outputCapacity)
+{
+    const int64_t numberOfBytes = 3 - m_numberOfPadding;
+    m_numberInQuad = 0;
+    if (m_numberOfPadding > 0) {
+        m_finished = true;
+        m_numberOfPadding = 0;
+    }
+    if (numberOfBytes > outputCapacity) {
+        m_error = true;
+        return 0;
+    }
+    
+    const uint32_t bits = ((static_cast<uint32_t>(m_quad[0]) << 18)
+                           | (static_cast<uint32_t>(m_quad[1]) << 12)
+                           | (static_cast<uint32_t>(m_quad[2]) << 6)
+                           | static_cast<uint32_t>(m_quad[3]));
+    output[0] = static_cast<uint8_t>(bits >> 16);
+    if (numberOfBytes > 1) {
+        output[1] = static_cast<uint8_t>(bits >> 8);
+    }
+    if (numberOfBytes > 2) {
+        output[2] = static_cast<uint8_t>(bits);
+    }
+    return numberOfBytes;
+}
@@ -0,0 +1,71 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#ifndef __BASE64_STREAM_DECODER_H__
+#define __BASE64_STREAM_DECODER_H__
+
+#include <stdint.h>
+
+namespace caret {
+
+    /// Decodes Base64 text that arrives in pieces, such as from an XML parser
+    class Base64StreamDecoder {
+        
+    public:
+        Base64StreamDecoder();
+        
+        void reset();
+        
+        int64_t decode(const char* text,
+                       const int64_t textLength,
+                       uint8_t* output,
+                       const int64_t outputCapacity);
+        
+        int64_t finish(uint8_t* output,
+                       const int64_t outputCapacity);
+        
+        /** @return True if invalid text or more data than the output could hold was found. */
+        bool hasError() const { return m_error; }
+        
+        /** @return Maximum number of bytes that decoding the given number of characters may produce. */
+        static int64_t getMaximumDecodedLength(const int64_t textLength) { return ((textLength + 3) / 4) * 3 + 3; }
+        
+    private:
+        int64_t decodeQuad(uint8_t* output,
+                           const int64_t outputCapacity);
+        
+        /** Values of the characters in an incomplete group of four */
+        uint8_t m_quad[4];
+        
+        /** Number of characters in m_quad */
+        int32_t m_numberInQuad;
+        
+        /** Number of padding ('=') characters in m_quad */
+        int32_t m_numberOfPadding;
+        
+        /** Padding ended the data, remaining text is ignored */
+        bool m_finished;
+        
+        bool m_error;
+    };
+    
+} // namespace
+
+#endif // __BASE64_STREAM_DECODER_H__
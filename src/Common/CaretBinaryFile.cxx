@@ -26,12 +26,19 @@
 #endif
 
 #include "CaretBinaryFile.h"
+#include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "DataFileException.h"
+#include "PerformanceStatistics.h"
 
 #include <QFile>
 #include "zlib.h"
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 using namespace caret;
 using namespace std;
 
@@ -52,6 +59,49 @@ namespace caret
         void write(const void* dataIn, const int64_t& count);
         ~ZFileImpl();
     };
+
+    //BGZF: a series of independent gzip members of at most 64KiB each, with the compressed size of each member in a gzip extra field
+    //this is still a valid .gz file to any gzip reader, but blocks can be found without decompressing, so seeking is cheap and blocks can be (de)compressed in parallel
+    class BgzfFileImpl : public CaretBinaryFile::ImplInterface
+    {
+        struct BlockInfo
+        {
+            int64_t m_fileOffset, m_dataOffset;//where the block starts in the file, and where its uncompressed data starts in the stream
+            int32_t m_blockSize, m_dataSize;//compressed size including header and trailer, uncompressed size
+        };
+        QFile m_file;
+        bool m_writing;
+        int64_t m_pos;
+        //reading
+        std::vector<BlockInfo> m_blocks;
+        int64_t m_dataSize;
+        int64_t m_cachedBlock;
+        std::vector<uint8_t> m_blockData, m_compressedBuffer;
+        //writing
+        std::vector<uint8_t> m_pending;
+        int64_t m_flushedSize;
+        bool buildIndex();
+        int64_t findBlock(const int64_t& position) const;
+        void readBlocks(const int64_t& firstBlock, const int64_t& endBlock, uint8_t* dataOut);
+        void flushBlocks(const bool& final);
+    public:
+        static const int BLOCK_DATA_SIZE = 0xff00;//the same as other BGZF writers, leaves room for incompressible data to still fit in a 64KiB block
+        static const int MAX_BLOCK_SIZE = 65536;
+        static const int HEADER_SIZE = 18, TRAILER_SIZE = 8;
+        static const int64_t BATCH_BLOCKS = 256;//blocks to (de)compress in one parallel batch, 16MB of uncompressed data
+        static bool isBgzf(const QString& filename);
+        static int compressBlock(const uint8_t* dataIn, const int& dataSize, uint8_t* blockOut);//returns block size, or -1 on error
+        static bool decompressBlock(const uint8_t* blockIn, const int& blockSize, uint8_t* dataOut, const int& dataSize);
+        BgzfFileImpl() { m_writing = false; m_pos = 0; m_dataSize = 0; m_cachedBlock = -1; m_flushedSize = 0; }
+        bool openRead(const QString& filename);//returns false if any block isn't BGZF, so the caller can fall back to ordinary gzip
+        void open(const QString& filename, const CaretBinaryFile::OpenMode& opmode);
+        void close();
+        void seek(const int64_t& position);
+        int64_t pos();
+        void read(void* dataOut, const int64_t& count, int64_t* numRead);
+        void write(const void* dataIn, const int64_t& count);
+        ~BgzfFileImpl();
+    };
 #endif //ZLIB_VERSION
 
     class QFileImpl : public CaretBinaryFile::ImplInterface
@@ -107,7 +157,22 @@ void CaretBinaryFile::open(const QString& filename, const OpenMode& opmode)
     if (filename.endsWith(".gz"))
     {
 #ifdef ZLIB_VERSION
-        m_impl.grabNew(new ZFileImpl());
+        if (opmode == READ && BgzfFileImpl::isBgzf(filename))
+        {//the first header only says it starts as BGZF, concatenated files can continue with ordinary gzip data
+            BgzfFileImpl* bgzfImpl = new BgzfFileImpl();
+            m_impl.grabNew(bgzfImpl);
+            if (bgzfImpl->openRead(filename))
+            {
+                m_curMode = opmode;
+                return;
+            }
+            CaretLogFine("compressed file '" + filename + "' is not entirely BGZF, reading it as ordinary gzip");
+            m_impl.grabNew(new ZFileImpl());
+        } else if (opmode == WRITE_TRUNCATE) {//always write BGZF, still read ordinary gzip files
+            m_impl.grabNew(new BgzfFileImpl());
+        } else {
+            m_impl.grabNew(new ZFileImpl());
+        }
 #else //ZLIB_VERSION
         throw DataFileException("can't open .gz file '" + filename + "', compiled without zlib support");
 #endif //ZLIB_VERSION
@@ -122,6 +187,7 @@ void CaretBinaryFile::read(void* dataOut, const int64_t& count, int64_t* numRead
 {
     if (!getOpenForRead()) throw DataFileException("file is not open for reading");
     m_impl->read(dataOut, count, numRead);
+    if (PerformanceStatistics::isEnabled()) PerformanceStatistics::addBytesRead(numRead != NULL ? *numRead : count);
 }
 
 void CaretBinaryFile::seek(const int64_t& position)
@@ -140,6 +206,7 @@ void CaretBinaryFile::write(const void* dataIn, const int64_t& count)
 {
     if (!getOpenForWrite()) throw DataFileException("file is not open for writing");
     m_impl->write(dataIn, count);
+    if (PerformanceStatistics::isEnabled()) PerformanceStatistics::addBytesWritten(count);
 }
 
 #ifdef ZLIB_VERSION
@@ -261,6 +328,337 @@ ZFileImpl::~ZFileImpl()
         CaretLogWarning("caught unknown exception type while closing a compressed file");
     }
 }
+
+namespace
+{
+    const uint8_t BGZF_EOF_BLOCK[28] = { 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 66, 67, 2, 0, 27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0 };//empty block that marks the end
+    
+    uint32_t readLE16(const uint8_t* data) { return (uint32_t)data[0] | ((uint32_t)data[1] << 8); }
+    uint32_t readLE32(const uint8_t* data) { return readLE16(data) | (readLE16(data + 2) << 16); }
+    void writeLE16(uint8_t* data, const uint32_t& value) { data[0] = value & 0xff; data[1] = (value >> 8) & 0xff; }
+    void writeLE32(uint8_t* data, const uint32_t& value) { writeLE16(data, value & 0xffff); writeLE16(data + 2, value >> 16); }
+    
+    int getBgzfBlockSize(const uint8_t* header)
+    {//returns -1 if this isn't a BGZF header - we only accept the layout we write, with the BC field first, which is what other BGZF writers do
+        if (header[0] != 31 || header[1] != 139 || header[2] != 8 || header[3] != 4) return -1;//FEXTRA only, so the data always starts at HEADER_SIZE
+        if (readLE16(header + 10) != 6 || header[12] != 'B' || header[13] != 'C' || readLE16(header + 14) != 2) return -1;
+        return readLE16(header + 16) + 1;
+    }
+}
+
+bool BgzfFileImpl::isBgzf(const QString& filename)
+{
+    QFile testFile(filename);
+    if (!testFile.open(QIODevice::ReadOnly)) return false;//let the real open report the error
+    uint8_t header[HEADER_SIZE];
+    if (testFile.read((char*)header, HEADER_SIZE) != HEADER_SIZE) return false;
+    return getBgzfBlockSize(header) > 0;
+}
+
+int BgzfFileImpl::compressBlock(const uint8_t* dataIn, const int& dataSize, uint8_t* blockOut)
+{
+    CaretAssert(dataSize <= BLOCK_DATA_SIZE);
+    z_stream myStream;
+    memset(&myStream, 0, sizeof(z_stream));
+    if (deflateInit2(&myStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return -1;//negative window bits: raw deflate, we write our own gzip header
+    myStream.next_in = (Bytef*)dataIn;
+    myStream.avail_in = dataSize;
+    myStream.next_out = blockOut + HEADER_SIZE;
+    myStream.avail_out = MAX_BLOCK_SIZE - HEADER_SIZE - TRAILER_SIZE;
+    int ret = deflate(&myStream, Z_FINISH);
+    int compressedSize = myStream.total_out;
+    deflateEnd(&myStream);
+    if (ret != Z_STREAM_END) return -1;
+    int blockSize = HEADER_SIZE + compressedSize + TRAILER_SIZE;
+    memcpy(blockOut, BGZF_EOF_BLOCK, HEADER_SIZE);//same header, except the size
+    writeLE16(blockOut + 16, blockSize - 1);
+    writeLE32(blockOut + blockSize - 8, crc32(crc32(0, Z_NULL, 0), dataIn, dataSize));
+    writeLE32(blockOut + blockSize - 4, dataSize);
+    return blockSize;
+}
+
+bool BgzfFileImpl::decompressBlock(const uint8_t* blockIn, const int& blockSize, uint8_t* dataOut, const int& dataSize)
+{
+    z_stream myStream;
+    memset(&myStream, 0, sizeof(z_stream));
+    if (inflateInit2(&myStream, -15) != Z_OK) return false;
+    myStream.next_in = (Bytef*)(blockIn + HEADER_SIZE);
+    myStream.avail_in = blockSize - HEADER_SIZE - TRAILER_SIZE;
+    myStream.next_out = dataOut;
+    myStream.avail_out = dataSize;
+    int ret = inflate(&myStream, Z_FINISH);
+    bool ok = (ret == Z_STREAM_END && (int)myStream.total_out == dataSize);
+    inflateEnd(&myStream);
+    return ok && crc32(crc32(0, Z_NULL, 0), dataOut, dataSize) == readLE32(blockIn + blockSize - 8);
+}
+
+bool BgzfFileImpl::openRead(const QString& filename)
+{
+    close();
+    m_fileName = filename;
+    m_file.setFileName(filename);
+    m_pos = 0;
+    if (!m_file.open(QIODevice::ReadOnly)) throw DataFileException("failed to open file '" + m_fileName + "'");
+    m_writing = false;
+    if (!buildIndex())
+    {
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+void BgzfFileImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& opmode)
+{
+    close();
+    m_fileName = filename;
+    m_file.setFileName(filename);
+    m_pos = 0;
+    switch (opmode)
+    {
+        case CaretBinaryFile::READ:
+            if (!m_file.open(QIODevice::ReadOnly)) throw DataFileException("failed to open file '" + m_fileName + "'");
+            m_writing = false;
+            if (!buildIndex()) throw DataFileException("compressed file '" + m_fileName + "' is truncated, or mixes BGZF with ordinary gzip data");
+            break;
+        case CaretBinaryFile::WRITE_TRUNCATE:
+            if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) throw DataFileException("failed to open file '" + m_fileName + "'");
+            m_writing = true;
+            m_flushedSize = 0;
+            m_pending.reserve(BATCH_BLOCKS * BLOCK_DATA_SIZE);
+            break;
+        default:
+            throw DataFileException("compressed file only supports READ and WRITE_TRUNCATE modes");
+    }
+}
+
+bool BgzfFileImpl::buildIndex()
+{//only reads the headers and the uncompressed size in the trailer of each block, returns false if a block isn't BGZF
+    m_blocks.clear();
+    m_dataSize = 0;
+    m_cachedBlock = -1;
+    int64_t fileSize = m_file.size(), offset = 0;
+    uint8_t header[HEADER_SIZE], trailer[TRAILER_SIZE];
+    while (offset < fileSize)
+    {
+        if (!m_file.seek(offset)) throw DataFileException("error reading block header in compressed file '" + m_fileName + "'");
+        BlockInfo myInfo;
+        myInfo.m_fileOffset = offset;
+        myInfo.m_dataOffset = m_dataSize;
+        myInfo.m_blockSize = -1;
+        if (m_file.read((char*)header, HEADER_SIZE) == HEADER_SIZE) myInfo.m_blockSize = getBgzfBlockSize(header);
+        if (myInfo.m_blockSize < HEADER_SIZE + TRAILER_SIZE || offset + myInfo.m_blockSize > fileSize)
+        {//not a complete BGZF block, could be a truncated file, or ordinary gzip data appended to BGZF
+            m_blocks.clear();
+            m_dataSize = 0;
+            return false;
+        }
+        if (!m_file.seek(offset + myInfo.m_blockSize - TRAILER_SIZE) || m_file.read((char*)trailer, TRAILER_SIZE) != TRAILER_SIZE)
+        {
+            throw DataFileException("error reading block trailer in compressed file '" + m_fileName + "'");
+        }
+        myInfo.m_dataSize = readLE32(trailer + 4);
+        if (myInfo.m_dataSize > MAX_BLOCK_SIZE) throw DataFileException("invalid block size in compressed file '" + m_fileName + "'");
+        if (myInfo.m_dataSize > 0)//don't index empty blocks, like the end marker
+        {
+            m_blocks.push_back(myInfo);
+            m_dataSize += myInfo.m_dataSize;
+        }
+        offset += myInfo.m_blockSize;
+    }
+    return true;
+}
+
+int64_t BgzfFileImpl::findBlock(const int64_t& position) const
+{
+    CaretAssert(position >= 0 && position < m_dataSize);
+    int64_t low = 0, high = m_blocks.size();//invariant: answer is in [low, high)
+    while (high - low > 1)
+    {
+        int64_t guess = (low + high) / 2;
+        if (m_blocks[guess].m_dataOffset <= position)
+        {
+            low = guess;
+        } else {
+            high = guess;
+        }
+    }
+    return low;
+}
+
+void BgzfFileImpl::readBlocks(const int64_t& firstBlock, const int64_t& endBlock, uint8_t* dataOut)
+{//blocks are contiguous in the file, so read them in one call, then decompress in parallel
+    CaretAssert(firstBlock < endBlock && endBlock <= (int64_t)m_blocks.size());
+    int64_t fileStart = m_blocks[firstBlock].m_fileOffset;
+    int64_t fileBytes = m_blocks[endBlock - 1].m_fileOffset + m_blocks[endBlock - 1].m_blockSize - fileStart;
+    m_compressedBuffer.resize(fileBytes);
+    if (!m_file.seek(fileStart) || m_file.read((char*)m_compressedBuffer.data(), fileBytes) != fileBytes)
+    {
+        throw DataFileException("error while reading compressed file '" + m_fileName + "'");
+    }
+    int64_t dataStart = m_blocks[firstBlock].m_dataOffset;
+    bool failed = false;
+#pragma omp CARET_PARFOR schedule(dynamic) if (endBlock - firstBlock > 1)
+    for (int64_t i = firstBlock; i < endBlock; ++i)
+    {
+        const BlockInfo& myInfo = m_blocks[i];
+        if (!decompressBlock(m_compressedBuffer.data() + (myInfo.m_fileOffset - fileStart), myInfo.m_blockSize, dataOut + (myInfo.m_dataOffset - dataStart), myInfo.m_dataSize))
+        {
+            failed = true;//can't throw out of an omp loop
+        }
+    }
+    if (failed) throw DataFileException("error decompressing data in compressed file '" + m_fileName + "'");
+}
+
+void BgzfFileImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
+{
+    if (m_writing) throw DataFileException("read called on compressed file opened for writing");//shouldn't happen
+    uint8_t* charOut = (uint8_t*)dataOut;
+    int64_t totalRead = 0;
+    while (totalRead < count && m_pos < m_dataSize)
+    {
+        int64_t block = findBlock(m_pos);
+        if (m_pos == m_blocks[block].m_dataOffset && block != m_cachedBlock)
+        {//aligned to a block, decompress whole blocks directly into the output
+            int64_t endBlock = block;
+            int64_t maxEnd = min((int64_t)m_blocks.size(), block + BATCH_BLOCKS);
+            while (endBlock < maxEnd && m_blocks[endBlock].m_dataOffset + m_blocks[endBlock].m_dataSize - m_pos <= count - totalRead)
+            {
+                ++endBlock;
+            }
+            if (endBlock > block)
+            {
+                readBlocks(block, endBlock, charOut + totalRead);
+                int64_t batchSize = m_blocks[endBlock - 1].m_dataOffset + m_blocks[endBlock - 1].m_dataSize - m_pos;
+                totalRead += batchSize;
+                m_pos += batchSize;
+                continue;
+            }
+        }
+        if (block != m_cachedBlock)
+        {//partial block, keep it around for the following read
+            m_blockData.resize(m_blocks[block].m_dataSize);
+            m_cachedBlock = -1;//in case of exception
+            readBlocks(block, block + 1, m_blockData.data());
+            m_cachedBlock = block;
+        }
+        int64_t blockPos = m_pos - m_blocks[block].m_dataOffset;
+        int64_t toCopy = min(count - totalRead, (int64_t)m_blocks[block].m_dataSize - blockPos);
+        memcpy(charOut + totalRead, m_blockData.data() + blockPos, toCopy);
+        totalRead += toCopy;
+        m_pos += toCopy;
+    }
+    if (numRead == NULL)
+    {
+        if (totalRead != count) throw DataFileException("premature end of file in compressed file '" + m_fileName + "'");
+    } else {
+        *numRead = totalRead;
+    }
+}
+
+void BgzfFileImpl::seek(const int64_t& position)
+{
+    if (position < 0) throw DataFileException("seek failed in compressed file '" + m_fileName + "'");
+    if (m_writing)
+    {
+        int64_t curPos = pos();
+        if (position < curPos) throw DataFileException("can't seek backwards while writing compressed file '" + m_fileName + "'");
+        if (position > curPos)
+        {//like gzseek, forward seeks write zeros
+            vector<char> zeros(min(position - curPos, (int64_t)(1<<20)), 0);
+            while (pos() < position)
+            {
+                write(zeros.data(), min(position - pos(), (int64_t)zeros.size()));
+            }
+        }
+        return;
+    }
+    if (position > m_dataSize) throw DataFileException("seek failed in compressed file '" + m_fileName + "'");
+    m_pos = position;
+}
+
+int64_t BgzfFileImpl::pos()
+{
+    if (m_writing) return m_flushedSize + m_pending.size();
+    return m_pos;
+}
+
+void BgzfFileImpl::flushBlocks(const bool& final)
+{
+    int64_t pendingSize = m_pending.size();
+    int64_t numBlocks = pendingSize / BLOCK_DATA_SIZE;
+    if (final && pendingSize % BLOCK_DATA_SIZE != 0) ++numBlocks;
+    if (numBlocks == 0) return;
+    vector<uint8_t> compressed(numBlocks * MAX_BLOCK_SIZE);
+    vector<int> blockSizes(numBlocks);
+#pragma omp CARET_PARFOR schedule(dynamic) if (numBlocks > 1)
+    for (int64_t i = 0; i < numBlocks; ++i)
+    {
+        int64_t start = i * BLOCK_DATA_SIZE;
+        blockSizes[i] = compressBlock(m_pending.data() + start, (int)min((int64_t)BLOCK_DATA_SIZE, pendingSize - start), compressed.data() + i * MAX_BLOCK_SIZE);
+    }
+    for (int64_t i = 0; i < numBlocks; ++i)
+    {
+        if (blockSizes[i] < 0) throw DataFileException("error compressing data for file '" + m_fileName + "'");
+        if (m_file.write((const char*)compressed.data() + i * MAX_BLOCK_SIZE, blockSizes[i]) != blockSizes[i])
+        {
+            throw DataFileException("failed to write to compressed file '" + m_fileName + "'");
+        }
+    }
+    int64_t consumed = min(numBlocks * BLOCK_DATA_SIZE, pendingSize);
+    m_pending.erase(m_pending.begin(), m_pending.begin() + consumed);
+    m_flushedSize += consumed;
+}
+
+void BgzfFileImpl::write(const void* dataIn, const int64_t& count)
+{
+    if (!m_writing) throw DataFileException("write called on compressed file opened for reading");//shouldn't happen
+    const uint8_t* charIn = (const uint8_t*)dataIn;
+    int64_t totalWritten = 0;
+    const int64_t batchBytes = BATCH_BLOCKS * BLOCK_DATA_SIZE;
+    while (totalWritten < count)
+    {
+        int64_t toCopy = min(count - totalWritten, batchBytes - (int64_t)m_pending.size());
+        m_pending.insert(m_pending.end(), charIn + totalWritten, charIn + totalWritten + toCopy);
+        totalWritten += toCopy;
+        if ((int64_t)m_pending.size() >= batchBytes) flushBlocks(false);
+    }
+}
+
+void BgzfFileImpl::close()
+{
+    if (!m_file.isOpen()) return;
+    if (m_writing)
+    {
+        m_writing = false;//don't try again from the destructor if this throws
+        flushBlocks(true);
+        if (m_file.write((const char*)BGZF_EOF_BLOCK, sizeof(BGZF_EOF_BLOCK)) != (int64_t)sizeof(BGZF_EOF_BLOCK))
+        {
+            m_file.close();
+            throw DataFileException("failed to write to compressed file '" + m_fileName + "'");
+        }
+    }
+    m_file.close();
+    m_pending.clear();
+    m_blocks.clear();
+    m_blockData.clear();
+    m_compressedBuffer.clear();
+    m_cachedBlock = -1;
+}
+
+BgzfFileImpl::~BgzfFileImpl()
+{
+    try//throwing from a destructor is a bad idea
+    {
+        close();
+    } catch (CaretException& e) {
+        CaretLogWarning(e.whatString());
+    } catch (exception& e) {
+        CaretLogWarning(e.what());
+    } catch (...) {
+        CaretLogWarning("caught unknown exception type while closing a compressed file");
+    }
+}
 #endif //ZLIB_VERSION
 
 void QFileImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& opmode)
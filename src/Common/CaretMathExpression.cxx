@@ -22,7 +22,9 @@
 #include "CaretException.h"
 #include "CaretLogger.h"
 #include "CaretMathExpression.h"
+#include "CaretOMP.h"
 
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
@@ -39,6 +41,7 @@ CaretMathExpression::CaretMathExpression(const AString& expression)
         throw CaretException("extra characters on end of expression input: '" + m_input.mid(m_position) + "'");
     }
     CaretLogInfo("parsed '" + expression + "' as '" + toString() + "'");
+    compileProgram();
 }
 
 double CaretMathExpression::evaluate(const vector<float>& variableValues) const
@@ -47,6 +50,375 @@ double CaretMathExpression::evaluate(const vector<float>& variableValues) const
     return m_root->eval(variableValues);
 }
 
+namespace
+{
+    const int CHUNK_SIZE = 256;//elements per register, small enough that the live registers stay in L1/L2
+}
+
+struct CaretMathExpression::CompileState
+{
+    vector<int> m_freeRegisters;
+    vector<bool> m_isConst;//constant registers are never written to after setup, so can't be reused
+};
+
+CaretMathExpression::Instruction::Instruction(const MathNode::ExprType& type)
+{
+    m_type = type;
+    m_function = MathFunctionEnum::INVALID;
+    m_invert = false;
+    m_inclusive = false;
+    m_varIndex = -1;
+    m_out = -1;
+    m_args[0] = 0;//point unused arguments at a real register, so runProgram doesn't need to check
+    m_args[1] = 0;
+    m_args[2] = 0;
+}
+
+void CaretMathExpression::compileProgram()
+{
+    m_program.clear();
+    m_constRegisters.clear();
+    m_numRegisters = 0;
+    CompileState state;
+    m_resultRegister = compileNode(m_root, state);
+}
+
+bool CaretMathExpression::isConstantNode(const MathNode* node)
+{
+    if (node->m_type == MathNode::VAR) return false;
+    for (int i = 0; i < (int)node->m_arguments.size(); ++i)
+    {
+        if (!isConstantNode(node->m_arguments[i])) return false;
+    }
+    return true;
+}
+
+int CaretMathExpression::compileNode(const MathNode* node, CompileState& state)
+{
+    if (isConstantNode(node))
+    {//fold it, using the tree evaluation so the value is identical
+        int reg = m_numRegisters;
+        ++m_numRegisters;
+        state.m_isConst.push_back(true);
+        m_constRegisters.push_back(make_pair(reg, node->eval(vector<float>())));
+        return reg;
+    }
+    vector<int> argRegs;
+    for (int i = 0; i < (int)node->m_arguments.size(); ++i)
+    {
+        argRegs.push_back(compileNode(node->m_arguments[i], state));
+    }
+    int numArgs = (int)argRegs.size();
+    int outReg;//write in place over the first argument if it is a temporary
+    if (numArgs > 0 && !state.m_isConst[argRegs[0]])
+    {
+        outReg = argRegs[0];
+    } else if (!state.m_freeRegisters.empty()) {
+        outReg = state.m_freeRegisters.back();
+        state.m_freeRegisters.pop_back();
+    } else {
+        outReg = m_numRegisters;
+        ++m_numRegisters;
+        state.m_isConst.push_back(false);
+    }
+    switch (node->m_type)
+    {
+        case MathNode::VAR:
+        {
+            Instruction inst(MathNode::VAR);
+            inst.m_varIndex = node->m_varIndex;
+            inst.m_out = outReg;
+            m_program.push_back(inst);
+            break;
+        }
+        case MathNode::OR:
+        case MathNode::AND:
+        case MathNode::EQUAL:
+        case MathNode::GREATERLESS:
+        case MathNode::ADDSUB:
+        case MathNode::MULTDIV:
+        {//evaluated left to right like the tree, as a chain of binary instructions
+            CaretAssert(numArgs > 1);
+            int accum = argRegs[0];
+            for (int i = 1; i < numArgs; ++i)
+            {
+                Instruction inst(node->m_type);
+                if (i < (int)node->m_invert.size()) inst.m_invert = node->m_invert[i];
+                if (i < (int)node->m_inclusive.size()) inst.m_inclusive = node->m_inclusive[i];
+                inst.m_args[0] = accum;
+                inst.m_args[1] = argRegs[i];
+                inst.m_out = outReg;
+                m_program.push_back(inst);
+                accum = outReg;
+            }
+            break;
+        }
+        case MathNode::NOT:
+        case MathNode::NEGATE:
+        case MathNode::POW:
+        case MathNode::FUNC:
+        {
+            CaretAssert(numArgs > 0 && numArgs <= 3);
+            Instruction inst(node->m_type);
+            inst.m_function = node->m_function;
+            for (int i = 0; i < numArgs; ++i)
+            {
+                inst.m_args[i] = argRegs[i];
+            }
+            inst.m_out = outReg;
+            m_program.push_back(inst);
+            break;
+        }
+        case MathNode::CONST://always folded
+        case MathNode::INVALID:
+            CaretAssertMessage(0, "invalid MathNode in compile");
+            throw CaretException("parsing problem in CaretMathExpression");
+    }
+    for (int i = 0; i < numArgs; ++i)
+    {
+        if (argRegs[i] != outReg && !state.m_isConst[argRegs[i]])
+        {
+            state.m_freeRegisters.push_back(argRegs[i]);
+        }
+    }
+    return outReg;
+}
+
+void CaretMathExpression::evaluateArrays(const vector<const float*>& variableArrays, float* output, const int64_t& count) const
+{
+    CaretAssert(variableArrays.size() == m_varNames.size());
+    const int64_t numChunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+#pragma omp CARET_PAR if (numChunks > 1)
+    {
+        vector<double> registers(m_numRegisters * CHUNK_SIZE);
+        for (int i = 0; i < (int)m_constRegisters.size(); ++i)
+        {
+            std::fill(registers.begin() + m_constRegisters[i].first * CHUNK_SIZE, registers.begin() + (m_constRegisters[i].first + 1) * CHUNK_SIZE, m_constRegisters[i].second);
+        }
+        const double* result = registers.data() + m_resultRegister * CHUNK_SIZE;
+#pragma omp CARET_FOR schedule(dynamic, 16)
+        for (int64_t chunk = 0; chunk < numChunks; ++chunk)
+        {
+            int64_t start = chunk * CHUNK_SIZE;
+            int length = (int)min((int64_t)CHUNK_SIZE, count - start);
+            runProgram(registers.data(), variableArrays, start, length);
+            for (int i = 0; i < length; ++i)
+            {
+                output[start + i] = (float)result[i];
+            }
+        }
+    }
+}
+
+void CaretMathExpression::runProgram(double* registers, const vector<const float*>& variableArrays, const int64_t& start, const int& length) const
+{//these loops must give the same results as MathNode::eval
+    const int numInstructions = (int)m_program.size();
+    for (int inst = 0; inst < numInstructions; ++inst)
+    {
+        const Instruction& myInst = m_program[inst];
+        double* out = registers + myInst.m_out * CHUNK_SIZE;
+        const double* a = registers + myInst.m_args[0] * CHUNK_SIZE;
+        const double* b = registers + myInst.m_args[1] * CHUNK_SIZE;
+        const double* c = registers + myInst.m_args[2] * CHUNK_SIZE;
+        switch (myInst.m_type)
+        {
+            case MathNode::VAR:
+            {
+                CaretAssertVectorIndex(variableArrays, myInst.m_varIndex);
+                const float* input = variableArrays[myInst.m_varIndex] + start;
+                for (int i = 0; i < length; ++i) out[i] = input[i];
+                break;
+            }
+            case MathNode::OR:
+                for (int i = 0; i < length; ++i) out[i] = (a[i] > 0.0 || b[i] > 0.0) ? 1.0 : 0.0;
+                break;
+            case MathNode::AND:
+                for (int i = 0; i < length; ++i) out[i] = (a[i] > 0.0 && b[i] > 0.0) ? 1.0 : 0.0;
+                break;
+            case MathNode::EQUAL:
+            {
+                const double ifEqual = myInst.m_invert ? 0.0 : 1.0;
+                for (int i = 0; i < length; ++i)
+                {
+                    float adjust = min(abs(a[i]), abs(b[i])) / 1000000;//same fudge factor as the tree
+                    bool equal = (a[i] >= b[i] - adjust) && (a[i] <= b[i] + adjust);
+                    out[i] = equal ? ifEqual : 1.0 - ifEqual;
+                }
+                break;
+            }
+            case MathNode::GREATERLESS:
+                if (myInst.m_inclusive)
+                {
+                    if (myInst.m_invert)
+                    {
+                        for (int i = 0; i < length; ++i)
+                        {
+                            float adjust = min(abs(a[i]), abs(b[i])) / 1000000;
+                            out[i] = (a[i] <= b[i] + adjust ? 1.0 : 0.0);
+                        }
+                    } else {
+                        for (int i = 0; i < length; ++i)
+                        {
+                            float adjust = min(abs(a[i]), abs(b[i])) / 1000000;
+                            out[i] = (a[i] >= b[i] - adjust ? 1.0 : 0.0);
+                        }
+                    }
+                } else {
+                    if (myInst.m_invert)
+                    {
+                        for (int i = 0; i < length; ++i) out[i] = (a[i] < b[i] ? 1.0 : 0.0);
+                    } else {
+                        for (int i = 0; i < length; ++i) out[i] = (a[i] > b[i] ? 1.0 : 0.0);
+                    }
+                }
+                break;
+            case MathNode::ADDSUB:
+                if (myInst.m_invert)
+                {
+                    for (int i = 0; i < length; ++i) out[i] = a[i] - b[i];
+                } else {
+                    for (int i = 0; i < length; ++i) out[i] = a[i] + b[i];
+                }
+                break;
+            case MathNode::MULTDIV:
+                if (myInst.m_invert)
+                {
+                    for (int i = 0; i < length; ++i) out[i] = a[i] / b[i];
+                } else {
+                    for (int i = 0; i < length; ++i) out[i] = a[i] * b[i];
+                }
+                break;
+            case MathNode::NOT:
+                for (int i = 0; i < length; ++i) out[i] = (a[i] > 0.0) ? 0.0 : 1.0;
+                break;
+            case MathNode::NEGATE:
+                for (int i = 0; i < length; ++i) out[i] = -a[i];
+                break;
+            case MathNode::POW:
+                for (int i = 0; i < length; ++i) out[i] = pow(a[i], b[i]);
+                break;
+            case MathNode::FUNC:
+                switch (myInst.m_function)
+                {
+                    case MathFunctionEnum::SIN:
+                        for (int i = 0; i < length; ++i) out[i] = sin(a[i]);
+                        break;
+                    case MathFunctionEnum::COS:
+                        for (int i = 0; i < length; ++i) out[i] = cos(a[i]);
+                        break;
+                    case MathFunctionEnum::TAN:
+                        for (int i = 0; i < length; ++i) out[i] = tan(a[i]);
+                        break;
+                    case MathFunctionEnum::ASIN:
+                        for (int i = 0; i < length; ++i) out[i] = asin(a[i]);
+                        break;
+                    case MathFunctionEnum::ACOS:
+                        for (int i = 0; i < length; ++i) out[i] = acos(a[i]);
+                        break;
+                    case MathFunctionEnum::ATAN:
+                        for (int i = 0; i < length; ++i) out[i] = atan(a[i]);
+                        break;
+                    case MathFunctionEnum::SINH:
+                        for (int i = 0; i < length; ++i) out[i] = sinh(a[i]);
+                        break;
+                    case MathFunctionEnum::COSH:
+                        for (int i = 0; i < length; ++i) out[i] = cosh(a[i]);
+                        break;
+                    case MathFunctionEnum::TANH:
+                        for (int i = 0; i < length; ++i) out[i] = tanh(a[i]);
+                        break;
+                    case MathFunctionEnum::ASINH:
+                        for (int i = 0; i < length; ++i)
+                        {
+                            double arg = a[i];
+                            if (arg > 0)
+                            {
+                                out[i] = log(arg + sqrt(arg * arg + 1));
+                            } else {
+                                out[i] = -log(-arg + sqrt(arg * arg + 1));
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::ACOSH:
+                        for (int i = 0; i < length; ++i) out[i] = log(a[i] + sqrt(a[i] * a[i] - 1));
+                        break;
+                    case MathFunctionEnum::ATANH:
+                        for (int i = 0; i < length; ++i) out[i] = 0.5 * log((1 + a[i]) / (1 - a[i]));
+                        break;
+                    case MathFunctionEnum::LN:
+                        for (int i = 0; i < length; ++i) out[i] = log(a[i]);
+                        break;
+                    case MathFunctionEnum::EXP:
+                        for (int i = 0; i < length; ++i) out[i] = exp(a[i]);
+                        break;
+                    case MathFunctionEnum::LOG:
+                        for (int i = 0; i < length; ++i) out[i] = log10(a[i]);
+                        break;
+                    case MathFunctionEnum::SQRT:
+                        for (int i = 0; i < length; ++i) out[i] = sqrt(a[i]);
+                        break;
+                    case MathFunctionEnum::ABS:
+                        for (int i = 0; i < length; ++i) out[i] = abs(a[i]);
+                        break;
+                    case MathFunctionEnum::FLOOR:
+                        for (int i = 0; i < length; ++i) out[i] = floor(a[i]);
+                        break;
+                    case MathFunctionEnum::ROUND:
+                        for (int i = 0; i < length; ++i)
+                        {
+                            if (a[i] > 0.0)
+                            {
+                                out[i] = floor(a[i] + 0.5);
+                            } else {
+                                out[i] = ceil(a[i] - 0.5);
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::CEIL:
+                        for (int i = 0; i < length; ++i) out[i] = ceil(a[i]);
+                        break;
+                    case MathFunctionEnum::ATAN2:
+                        for (int i = 0; i < length; ++i) out[i] = atan2(a[i], b[i]);
+                        break;
+                    case MathFunctionEnum::MIN:
+                        for (int i = 0; i < length; ++i) out[i] = (a[i] > b[i] ? b[i] : a[i]);
+                        break;
+                    case MathFunctionEnum::MAX:
+                        for (int i = 0; i < length; ++i) out[i] = (a[i] < b[i] ? b[i] : a[i]);
+                        break;
+                    case MathFunctionEnum::MOD:
+                        for (int i = 0; i < length; ++i)
+                        {
+                            if (b[i] == 0.0)
+                            {
+                                out[i] = 0.0;
+                            } else {
+                                out[i] = a[i] - b[i] * floor(a[i] / b[i]);
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::CLAMP:
+                        for (int i = 0; i < length; ++i)
+                        {
+                            double temp = a[i];
+                            if (temp < b[i]) temp = b[i];
+                            if (temp > c[i]) temp = c[i];
+                            out[i] = temp;
+                        }
+                        break;
+                    case MathFunctionEnum::INVALID:
+                        CaretAssertMessage(0, "compiled instruction is type FUNC but INVALID function");
+                        throw CaretException("parsing problem in CaretMathExpression");
+                }
+                break;
+            case MathNode::CONST:
+            case MathNode::INVALID:
+                CaretAssertMessage(0, "invalid instruction in compiled CaretMathExpression");
+                throw CaretException("parsing problem in CaretMathExpression");
+        }
+    }
+}
+
 vector<AString> CaretMathExpression::getVarNames() const
 {
     vector<AString> ret(m_varNames.size());
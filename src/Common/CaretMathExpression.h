@@ -26,8 +26,11 @@
 #include "MathFunctionEnum.h"
 
 #include <map>
+#include <utility>
 #include <vector>
 
+#include <stdint.h>
+
 namespace caret {
 
 class CaretMathExpression
@@ -63,6 +66,23 @@ class CaretMathExpression
         double eval(const std::vector<float>& values) const;
         AString toString(const std::vector<AString>& varNames) const;
     };
+    struct Instruction
+    {//one operation of the compiled program, applied to a whole chunk of elements, so the inner loops are simple enough to vectorize
+        MathNode::ExprType m_type;//VAR copies a variable into a register, chained operators are split into binary instructions
+        MathFunctionEnum::Enum m_function;
+        bool m_invert, m_inclusive;
+        int m_varIndex, m_out;
+        int m_args[3];
+        Instruction(const MathNode::ExprType& type);
+    };
+    struct CompileState;
+    std::vector<Instruction> m_program;
+    std::vector<std::pair<int, double> > m_constRegisters;//folded constant subexpressions, filled once per thread rather than per chunk
+    int m_numRegisters, m_resultRegister;
+    void compileProgram();
+    int compileNode(const MathNode* node, CompileState& state);
+    static bool isConstantNode(const MathNode* node);
+    void runProgram(double* registers, const std::vector<const float*>& variableArrays, const int64_t& start, const int& length) const;
     std::map<AString, int> m_varNames;
     AString m_input;
     int m_position, m_end;
@@ -86,6 +106,8 @@ public:
     static bool getNamedConstant(const AString& name, double& valueOut);
     CaretMathExpression(const AString& expression);
     double evaluate(const std::vector<float>& variableValues) const;
+    ///evaluate at every index of the arrays, one array per variable in the order of getVarNames(), using the compiled program, parallel over chunks
+    void evaluateArrays(const std::vector<const float*>& variableArrays, float* output, const int64_t& count) const;
     std::vector<AString> getVarNames() const;
     AString toString() const;//the expression, with a lot of parentheses added
 };
@@ -19,54 +19,48 @@
 /*LICENSE_END*/
 
 #include "CaretPointLocator.h"
-#include "CaretHeap.h"
-#include <cmath>
+#include "CaretOMP.h"
+
+#include <algorithm>
+#include <limits>
 
 using namespace caret;
 using namespace std;
 
-void CaretPointLocator::addPoint(Oct<LeafVector<Point> >* thisOct, const float point[3], const int32_t index, const int32_t pointSet)
+namespace
 {
-    if (thisOct->m_leaf)
+    float distSquared(const float a[3], const float b[3])
     {
-        thisOct->m_data.m_vector->push_back(Point(point, index, pointSet));
-        int curSize = (int)thisOct->m_data.m_vector->size();
-        if (curSize > NUM_POINTS_SPLIT)
-        {//test that not all points are the same, or that they have some minimum percentage spread, or...
-            vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-            Vector3D minBox = myVecRef[0].m_point, maxBox = myVecRef[0].m_point, tempvec;
-            tempvec[0] = thisOct->m_bounds[0][2] - thisOct->m_bounds[0][0];
-            tempvec[1] = thisOct->m_bounds[1][2] - thisOct->m_bounds[1][0];
-            tempvec[2] = thisOct->m_bounds[2][2] - thisOct->m_bounds[2][0];
-            float diagonal = tempvec.length();
-            bool safeToSplit = false;
-            for (int i = 1; i < curSize; ++i)
-            {//this will slow down if lots of stuff is continuously put in an Oct that is far too big - use random sampling?
-                if (myVecRef[i].m_point[0] < minBox[0]) minBox[0] = myVecRef[i].m_point[0];
-                if (myVecRef[i].m_point[1] < minBox[1]) minBox[1] = myVecRef[i].m_point[1];
-                if (myVecRef[i].m_point[2] < minBox[2]) minBox[2] = myVecRef[i].m_point[2];
-                if (myVecRef[i].m_point[0] > maxBox[0]) maxBox[0] = myVecRef[i].m_point[0];
-                if (myVecRef[i].m_point[1] > maxBox[1]) maxBox[1] = myVecRef[i].m_point[1];
-                if (myVecRef[i].m_point[2] > maxBox[2]) maxBox[2] = myVecRef[i].m_point[2];
-                tempvec = minBox - maxBox;
-                if (tempvec.length() > 0.01f * diagonal)//make sure points aren't all identical, would go to infinity recursively
-                {
-                    safeToSplit = true;
-                    break;
-                }
-            }
-            if (safeToSplit)
+        float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+    
+    float boxDistSquared(const float minCoord[3], const float maxCoord[3], const float point[3])
+    {
+        float ret = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            float tempf = 0.0f;
+            if (point[i] < minCoord[i])
             {
-                thisOct->makeChildren();
-                for (int i = 0; i < curSize; ++i)
-                {
-                    addPoint(thisOct->containingChild(myVecRef[i].m_point), myVecRef[i].m_point, myVecRef[i].m_index, myVecRef[i].m_mySet);
-                }
-                thisOct->m_data.freeData();
+                tempf = minCoord[i] - point[i];
+            } else if (point[i] > maxCoord[i]) {
+                tempf = point[i] - maxCoord[i];
             }
+            ret += tempf * tempf;
         }
-    } else {
-        addPoint(thisOct->containingChild(point), point, index, pointSet);
+        return ret;
+    }
+    
+    ///spread the low 10 bits of a value out to every third bit, for morton order
+    uint32_t spreadBits(uint32_t value)
+    {
+        value &= 0x3FF;
+        value = (value | (value << 16)) & 0x030000FF;
+        value = (value | (value << 8)) & 0x0300F00F;
+        value = (value | (value << 4)) & 0x030C30C3;
+        value = (value | (value << 2)) & 0x09249249;
+        return value;
     }
 }
 
@@ -75,230 +69,297 @@ int32_t CaretPointLocator::addPointSet(const float* coordsIn, const int32_t numC
     CaretMutexLocker locked(&m_modifyMutex);
     int32_t setNum = newIndex();
     if (numCoords < 1) return setNum;
-    if (m_tree == NULL)
-    {
-        Vector3D minBox, maxBox;
-        minBox = maxBox = coordsIn;//hack - first triple
-        for (int32_t i = 1; i < numCoords; ++i)
-        {
-            int32_t i3 = i * 3;
-            if (coordsIn[i3] < minBox[0]) minBox[0] = coordsIn[i3];
-            if (coordsIn[i3 + 1] < minBox[1]) minBox[1] = coordsIn[i3 + 1];
-            if (coordsIn[i3 + 2] < minBox[2]) minBox[2] = coordsIn[i3 + 2];
-            if (coordsIn[i3] > maxBox[0]) maxBox[0] = coordsIn[i3];
-            if (coordsIn[i3 + 1] > maxBox[1]) maxBox[1] = coordsIn[i3 + 1];
-            if (coordsIn[i3 + 2] > maxBox[2]) maxBox[2] = coordsIn[i3 + 2];
-        }
-        m_tree = new Oct<LeafVector<Point> >(minBox, maxBox);
-    }
+    m_points.reserve(m_points.size() + numCoords);
     for (int32_t i = 0; i < numCoords; ++i)
     {
-        int32_t i3 = i * 3;
-        m_tree = m_tree->makeContains(coordsIn + i3);//make new root if needed
-        addPoint(m_tree, coordsIn + i3, i, setNum);//and add the point
+        m_points.push_back(Point(coordsIn + i * 3, i, setNum));
     }
+    rebuildTree();
     return setNum;
 }
 
 CaretPointLocator::CaretPointLocator(const float* coordsIn, const int32_t numCoords)
 {
     m_nextSetIndex = 1;//next set will be set #1
-    m_tree = NULL;
+    m_firstLeaf = 0;
     if (numCoords >= 1)
     {
-        Vector3D minBox, maxBox;
-        minBox = maxBox = coordsIn;//hack - first triple
-        for (int32_t i = 1; i < numCoords; ++i)
-        {
-            int32_t i3 = i * 3;
-            if (coordsIn[i3] < minBox[0]) minBox[0] = coordsIn[i3];
-            if (coordsIn[i3 + 1] < minBox[1]) minBox[1] = coordsIn[i3 + 1];
-            if (coordsIn[i3 + 2] < minBox[2]) minBox[2] = coordsIn[i3 + 2];
-            if (coordsIn[i3] > maxBox[0]) maxBox[0] = coordsIn[i3];
-            if (coordsIn[i3 + 1] > maxBox[1]) maxBox[1] = coordsIn[i3 + 1];
-            if (coordsIn[i3 + 2] > maxBox[2]) maxBox[2] = coordsIn[i3 + 2];
-        }
-        m_tree = new Oct<LeafVector<Point> >(minBox, maxBox);
+        m_points.reserve(numCoords);
         for (int32_t i = 0; i < numCoords; ++i)
         {
-            int32_t i3 = i * 3;
-            addPoint(m_tree, coordsIn + i3, i, 0);//this is set #0
+            m_points.push_back(Point(coordsIn + i * 3, i, 0));//this is set #0
         }
+        rebuildTree();
     }
 }
 
 CaretPointLocator::CaretPointLocator(const float minBounds[3], const float maxBounds[3])
-{
+{//the tree is rebuilt from the points whenever a set is added, so the bounds aren't needed
+    (void)minBounds;
+    (void)maxBounds;
     m_nextSetIndex = 0;
-    m_tree = new Oct<LeafVector<Point> >(minBounds, maxBounds);
+    m_firstLeaf = 0;
 }
 
-int32_t CaretPointLocator::closestPoint(const float target[3], LocatorInfo* infoOut) const
+void CaretPointLocator::rebuildTree()
 {
-    if (m_tree == NULL) return -1;
-    CaretSimpleMinHeap<Oct<LeafVector<Point> >*, float> myHeap;
-    bool first = true;
-    float bestDist2 = -1.0f, bestDist = -1.0f, tempf, curDist = m_tree->distToPoint(target);
-    Vector3D bestPoint;
-    int32_t bestSet = -1, bestIndex = -1;
-    myHeap.push(m_tree, curDist);
-    while (curDist < bestDist || first)
+    m_nodes.clear();
+    m_firstLeaf = 0;
+    int32_t numPoints = (int32_t)m_points.size();
+    if (numPoints < 1) return;
+    int depth = 0;//all nodes on a level differ in size by at most one point, so every leaf ends up on the same level
+    while ((numPoints + (1 << depth) - 1) >> depth > LEAF_POINTS)
     {
-        Oct<LeafVector<Point> >* thisOct = myHeap.pop();
-        if (thisOct->m_leaf)
+        ++depth;
+    }
+    m_firstLeaf = (1 << depth) - 1;
+    m_nodes.resize((1 << (depth + 1)) - 1);
+    m_nodes[0].m_start = 0;
+    m_nodes[0].m_end = numPoints;
+    for (int level = 0; level <= depth; ++level)
+    {//nodes on one level own disjoint point ranges, so they can be split in parallel
+        int32_t levelStart = (1 << level) - 1, levelSize = 1 << level;
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int32_t i = 0; i < levelSize; ++i)
         {
-            vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-            int curSize = (int)myVecRef.size();
-            for (int i = 0; i < curSize; ++i)
-            {
-                tempf = MathFunctions::distanceSquared3D(myVecRef[i].m_point, target);
-                if (tempf < bestDist2 || first)
-                {
-                    first = false;
-                    bestDist2 = tempf;
-                    bestPoint = myVecRef[i].m_point;
-                    bestSet = myVecRef[i].m_mySet;
-                    bestIndex = myVecRef[i].m_index;
-                }
-            }
-            bestDist = sqrt(bestDist2);
-        } else {
-            for (int ii = 0; ii < 2; ++ii)
-            {
-                for (int ij = 0; ij < 2; ++ij)
-                {
-                    for (int ik = 0; ik < 2; ++ik)
-                    {
-                        tempf = thisOct->m_children[ii][ij][ik]->distToPoint(target);
-                        if (tempf < bestDist || first)
-                        {
-                            myHeap.push(thisOct->m_children[ii][ij][ik], tempf);
-                        }
-                    }
-                }
-            }
+            buildNode(levelStart + i);
         }
-        if (myHeap.isEmpty())
+    }
+}
+
+void CaretPointLocator::buildNode(const int32_t node)
+{
+    KdNode& thisNode = m_nodes[node];
+    const float* first = m_points[thisNode.m_start].m_point;
+    for (int i = 0; i < 3; ++i)
+    {
+        thisNode.m_minCoord[i] = first[i];
+        thisNode.m_maxCoord[i] = first[i];
+    }
+    for (int32_t i = thisNode.m_start + 1; i < thisNode.m_end; ++i)
+    {
+        const float* thisPoint = m_points[i].m_point;
+        for (int j = 0; j < 3; ++j)
         {
-            break;//allows us to use top() without violating an assertion
+            if (thisPoint[j] < thisNode.m_minCoord[j]) thisNode.m_minCoord[j] = thisPoint[j];
+            if (thisPoint[j] > thisNode.m_maxCoord[j]) thisNode.m_maxCoord[j] = thisPoint[j];
         }
-        myHeap.top(&curDist);//get the key for the next item
     }
-    if (infoOut != NULL)
+    if (node >= m_firstLeaf) return;
+    int axis = 0;//split on the longest side of the box, at the median, so the tree follows the point distribution
+    for (int i = 1; i < 3; ++i)
     {
-        infoOut->whichSet = bestSet;
-        infoOut->coords = bestPoint;
-        infoOut->index = bestIndex;
+        if (thisNode.m_maxCoord[i] - thisNode.m_minCoord[i] > thisNode.m_maxCoord[axis] - thisNode.m_minCoord[axis]) axis = i;
+    }
+    int32_t middle = thisNode.m_start + (thisNode.m_end - thisNode.m_start) / 2;
+    vector<Point>::iterator base = m_points.begin();
+    switch (axis)
+    {//a comparison object would need a member for the axis, this lets the compiler inline each comparison
+        case 0:
+            nth_element(base + thisNode.m_start, base + middle, base + thisNode.m_end, PointLess<0>());
+            break;
+        case 1:
+            nth_element(base + thisNode.m_start, base + middle, base + thisNode.m_end, PointLess<1>());
+            break;
+        default:
+            nth_element(base + thisNode.m_start, base + middle, base + thisNode.m_end, PointLess<2>());
+            break;
     }
-    return bestIndex;
+    KdNode& left = m_nodes[2 * node + 1];
+    KdNode& right = m_nodes[2 * node + 2];
+    left.m_start = thisNode.m_start;
+    left.m_end = middle;
+    right.m_start = middle;
+    right.m_end = thisNode.m_end;
 }
 
-int32_t CaretPointLocator::closestPointLimited(const float target[3], const float& maxDist, LocatorInfo* infoOut) const
-{
-    if (m_tree == NULL) return -1;
-    float curDist2 = m_tree->distSquaredToPoint(target), maxDist2 = maxDist * maxDist;
-    if (curDist2 > maxDist2)
+int32_t CaretPointLocator::findClosest(const float target[3], const float& maxDist2, const int32_t hintPoint) const
+{//returns position in m_points, ties go to the earliest position so that the answer doesn't depend on the hint or search order
+    int32_t bestPoint = -1;
+    float bestDist2 = (maxDist2 < 0.0f ? numeric_limits<float>::infinity() : maxDist2);
+    if (hintPoint >= 0)
     {
-        if (infoOut != NULL)
+        float tempf = distSquared(m_points[hintPoint].m_point, target);
+        if (tempf <= bestDist2)
         {
-            infoOut->whichSet = -1;
-            infoOut->index = -1;
+            bestPoint = hintPoint;
+            bestDist2 = tempf;
         }
-        return -1;
     }
-    CaretSimpleMinHeap<Oct<LeafVector<Point> >*, float> myHeap;
-    bool first = true;
-    float bestDist2 = -1.0f, tempf;
-    Vector3D bestPoint;
-    int32_t bestSet = -1, bestIndex = -1;
-    myHeap.push(m_tree, curDist2);
-    while (curDist2 < bestDist2 || first)
+    int32_t nodeStack[64];//depth can't exceed 31 with 32 bit indices, and each level pushes at most 2
+    float distStack[64];
+    int stackSize = 0;
+    float tempf = boxDistSquared(m_nodes[0].m_minCoord, m_nodes[0].m_maxCoord, target);
+    if (tempf <= bestDist2)
+    {
+        nodeStack[0] = 0;
+        distStack[0] = tempf;
+        stackSize = 1;
+    }
+    while (stackSize > 0)
     {
-        Oct<LeafVector<Point> >* thisOct = myHeap.pop();
-        if (thisOct->m_leaf)
+        --stackSize;
+        if (distStack[stackSize] > bestDist2) continue;//bound may have shrunk since it was pushed
+        int32_t node = nodeStack[stackSize];
+        const KdNode& thisNode = m_nodes[node];
+        if (node >= m_firstLeaf)
         {
-            vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-            int curSize = (int)myVecRef.size();
-            for (int i = 0; i < curSize; ++i)
+            for (int32_t i = thisNode.m_start; i < thisNode.m_end; ++i)
             {
-                tempf = MathFunctions::distanceSquared3D(myVecRef[i].m_point, target);
-                if (tempf < bestDist2 || (first && tempf <= maxDist2))
+                tempf = distSquared(m_points[i].m_point, target);
+                if (tempf < bestDist2 || (tempf == bestDist2 && (bestPoint == -1 || i < bestPoint)))
                 {
-                    first = false;
+                    bestPoint = i;
                     bestDist2 = tempf;
-                    bestPoint = myVecRef[i].m_point;
-                    bestSet = myVecRef[i].m_mySet;
-                    bestIndex = myVecRef[i].m_index;
                 }
             }
         } else {
-            for (int ii = 0; ii < 2; ++ii)
+            int32_t nearChild = 2 * node + 1, farChild = nearChild + 1;
+            float nearDist = boxDistSquared(m_nodes[nearChild].m_minCoord, m_nodes[nearChild].m_maxCoord, target);
+            float farDist = boxDistSquared(m_nodes[farChild].m_minCoord, m_nodes[farChild].m_maxCoord, target);
+            if (farDist < nearDist)
             {
-                for (int ij = 0; ij < 2; ++ij)
-                {
-                    for (int ik = 0; ik < 2; ++ik)
-                    {
-                        tempf = thisOct->m_children[ii][ij][ik]->distSquaredToPoint(target);
-                        if (tempf < bestDist2 || (first && tempf <= maxDist2))
-                        {
-                            myHeap.push(thisOct->m_children[ii][ij][ik], tempf);
-                        }
-                    }
-                }
+                swap(nearChild, farChild);
+                swap(nearDist, farDist);
+            }
+            if (farDist <= bestDist2)
+            {
+                nodeStack[stackSize] = farChild;
+                distStack[stackSize] = farDist;
+                ++stackSize;
+            }
+            if (nearDist <= bestDist2)//push nearer child last so it is searched first
+            {
+                nodeStack[stackSize] = nearChild;
+                distStack[stackSize] = nearDist;
+                ++stackSize;
             }
         }
-        if (myHeap.isEmpty())
+    }
+    return bestPoint;
+}
+
+void CaretPointLocator::setInfo(const int32_t whichPoint, LocatorInfo* infoOut) const
+{
+    if (infoOut == NULL) return;
+    if (whichPoint < 0)
+    {
+        infoOut->whichSet = -1;
+        infoOut->index = -1;
+    } else {
+        const Point& thisPoint = m_points[whichPoint];
+        infoOut->whichSet = thisPoint.m_mySet;
+        infoOut->coords = thisPoint.m_point;
+        infoOut->index = thisPoint.m_index;
+    }
+}
+
+int32_t CaretPointLocator::closestPoint(const float target[3], LocatorInfo* infoOut) const
+{
+    if (m_nodes.empty()) return -1;
+    int32_t bestPoint = findClosest(target, -1.0f, -1);
+    setInfo(bestPoint, infoOut);
+    return m_points[bestPoint].m_index;
+}
+
+int32_t CaretPointLocator::closestPointLimited(const float target[3], const float& maxDist, LocatorInfo* infoOut) const
+{
+    if (m_nodes.empty()) return -1;
+    int32_t bestPoint = findClosest(target, maxDist * maxDist, -1);
+    setInfo(bestPoint, infoOut);
+    if (bestPoint < 0) return -1;
+    return m_points[bestPoint].m_index;
+}
+
+void CaretPointLocator::closestPoints(const float* targetsIn, const int64_t numTargets, int32_t* indicesOut, LocatorInfo* infoOut, const float& maxDist) const
+{
+    if (numTargets < 1) return;
+    if (m_nodes.empty())
+    {
+        for (int64_t i = 0; i < numTargets; ++i)
         {
-            break;//allows us to use top() without violating an assertion
+            indicesOut[i] = -1;
+            setInfo(-1, infoOut == NULL ? NULL : infoOut + i);
         }
-        myHeap.top(&curDist2);//get the key for the next item
+        return;
     }
-    if (infoOut != NULL)
+    float maxDist2 = (maxDist > 0.0f ? maxDist * maxDist : -1.0f);
+    vector<pair<uint32_t, int64_t> > order(numTargets);//sort targets along a morton curve, so consecutive queries are close together
+    const KdNode& root = m_nodes[0];
+    float scale[3];
+    for (int i = 0; i < 3; ++i)
     {
-        infoOut->whichSet = bestSet;
-        infoOut->coords = bestPoint;
-        infoOut->index = bestIndex;
+        float extent = root.m_maxCoord[i] - root.m_minCoord[i];
+        scale[i] = (extent > 0.0f ? 1023.0f / extent : 0.0f);
+    }
+    for (int64_t i = 0; i < numTargets; ++i)
+    {
+        uint32_t key = 0;
+        for (int j = 0; j < 3; ++j)
+        {
+            float tempf = (targetsIn[i * 3 + j] - root.m_minCoord[j]) * scale[j];
+            uint32_t cell = 0;
+            if (tempf > 1023.0f)
+            {
+                cell = 1023;
+            } else if (tempf > 0.0f) {
+                cell = (uint32_t)tempf;
+            }
+            key |= spreadBits(cell) << j;
+        }
+        order[i] = make_pair(key, i);
+    }
+    sort(order.begin(), order.end());
+    int64_t numChunks = (numTargets - 1) / QUERY_CHUNK_SIZE + 1;
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t chunk = 0; chunk < numChunks; ++chunk)
+    {
+        int64_t chunkEnd = min(numTargets, (chunk + 1) * QUERY_CHUNK_SIZE);
+        int32_t hintPoint = -1;//the previous answer is usually close to the next one, so it gives a tight starting bound
+        for (int64_t i = chunk * QUERY_CHUNK_SIZE; i < chunkEnd; ++i)
+        {
+            int64_t target = order[i].second;
+            int32_t bestPoint = findClosest(targetsIn + target * 3, maxDist2, hintPoint);
+            if (bestPoint >= 0)
+            {
+                hintPoint = bestPoint;
+                indicesOut[target] = m_points[bestPoint].m_index;
+            } else {
+                indicesOut[target] = -1;
+            }
+            if (infoOut != NULL) setInfo(bestPoint, infoOut + target);
+        }
     }
-    return bestIndex;
 }
 
 set<LocatorInfo> CaretPointLocator::pointsInRange(const float target[3], const float& maxDist) const
 {
     set<LocatorInfo> ret;
-    if (m_tree == NULL) return ret;
-    float curDist2 = m_tree->distSquaredToPoint(target), maxDist2 = maxDist * maxDist;
-    if (curDist2 > maxDist2) return ret;
-    vector<Oct<LeafVector<Point> >*> myStack;//since we don't need the points sorted by distance
-    myStack.push_back(m_tree);
+    if (m_nodes.empty()) return ret;
+    float maxDist2 = maxDist * maxDist;
+    vector<int32_t> myStack;//since we don't need the points sorted by distance
+    if (boxDistSquared(m_nodes[0].m_minCoord, m_nodes[0].m_maxCoord, target) <= maxDist2) myStack.push_back(0);
     while (!myStack.empty())
     {
-        Oct<LeafVector<Point> >* thisOct = myStack.back();
+        int32_t node = myStack.back();
         myStack.pop_back();
-        if (thisOct->m_leaf)
+        const KdNode& thisNode = m_nodes[node];
+        if (node >= m_firstLeaf)
         {
-            vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-            int curSize = (int)myVecRef.size();
-            for (int i = 0; i < curSize; ++i)
+            for (int32_t i = thisNode.m_start; i < thisNode.m_end; ++i)
             {
-                float tempf = MathFunctions::distanceSquared3D(myVecRef[i].m_point, target);
-                if (tempf <= maxDist2)
+                const Point& thisPoint = m_points[i];
+                if (distSquared(thisPoint.m_point, target) <= maxDist2)
                 {
-                    ret.insert(LocatorInfo(myVecRef[i].m_index, myVecRef[i].m_mySet, myVecRef[i].m_point));//let std::set sort out uniqueness
+                    ret.insert(LocatorInfo(thisPoint.m_index, thisPoint.m_mySet, thisPoint.m_point));//let std::set sort out uniqueness
                 }
             }
         } else {
-            for (int ii = 0; ii < 2; ++ii)
+            for (int32_t child = 2 * node + 1; child <= 2 * node + 2; ++child)
             {
-                for (int ij = 0; ij < 2; ++ij)
+                if (boxDistSquared(m_nodes[child].m_minCoord, m_nodes[child].m_maxCoord, target) <= maxDist2)
                 {
-                    for (int ik = 0; ik < 2; ++ik)
-                    {
-                        float tempf = thisOct->m_children[ii][ij][ik]->distSquaredToPoint(target);
-                        if (tempf <= maxDist2)
-                        {
-                            myStack.push_back(thisOct->m_children[ii][ij][ik]);
-                        }
-                    }
+                    myStack.push_back(child);
                 }
             }
         }
@@ -322,48 +383,17 @@ void CaretPointLocator::removePointSet(int32_t whichSet)
 {
     CaretMutexLocker locked(&m_modifyMutex);
     m_unusedIndexes.push_back(whichSet);
-    removeSetHelper(m_tree, whichSet);
-}
-
-void CaretPointLocator::removeSetHelper(Oct<LeafVector<CaretPointLocator::Point> >* thisOct, int32_t thisSet)
-{
-    if (thisOct == NULL) return;
-    if (thisOct->m_leaf)
+    vector<Point> tempvec;
+    tempvec.reserve(m_points.size());
+    int32_t numPoints = (int32_t)m_points.size();
+    for (int32_t i = 0; i < numPoints; ++i)
     {
-        vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
-        int curSize = (int)myVecRef.size();
-        bool match = false;
-        for (int i = 0; i < curSize; ++i)//make sure something gets removed, so we don't have to do an allocation if it isn't needed
-        {
-            if (myVecRef[i].m_mySet == thisSet)
-            {
-                match = true;
-                break;
-            }
-        }
-        if (match)
-        {
-            vector<Point> tempvec;
-            tempvec.reserve(curSize - 1);//because at least one is getting removed
-            for (int i = 0; i < curSize; ++i)
-            {
-                if (myVecRef[i].m_mySet != thisSet)
-                {
-                    tempvec.push_back(myVecRef[i]);
-                }
-            }
-            myVecRef = tempvec;
-        }
-    } else {
-        for (int ii = 0; ii < 2; ++ii)
+        if (m_points[i].m_mySet != whichSet)
         {
-            for (int ij = 0; ij < 2; ++ij)
-            {
-                for (int ik = 0; ik < 2; ++ik)
-                {
-                    removeSetHelper(thisOct->m_children[ii][ij][ik], thisSet);
-                }
-            }
+            tempvec.push_back(m_points[i]);
         }
     }
+    if (tempvec.size() == m_points.size()) return;//nothing removed, tree is still valid
+    m_points.swap(tempvec);
+    rebuildTree();
 }
@@ -23,7 +23,6 @@
 /*LICENSE_END*/
 
 #include "CaretMutex.h"
-#include "OctTree.h"
 #include "Vector3D.h"
 
 #include <set>
@@ -35,6 +34,7 @@ namespace caret {
     {
         int32_t index, whichSet;
         Vector3D coords;
+        LocatorInfo() : index(-1), whichSet(-1) { }
         LocatorInfo(const int32_t& indexIn, const int32_t& whichSetIn, const Vector3D& coordsIn) : index(indexIn), whichSet(whichSetIn), coords(coordsIn) { }
         bool operator==(const LocatorInfo& rhs) const { return (index == rhs.index) && (whichSet == rhs.whichSet); }//ignore coords
         bool operator<(const LocatorInfo& rhs) const
@@ -52,26 +52,44 @@ namespace caret {
     {
         struct Point
         {
-            Vector3D m_point;
+            float m_point[3];
             int32_t m_index, m_mySet;
             Point(const float point[3], const int32_t index, const int32_t mySet)
             {
-                m_point = point;
+                m_point[0] = point[0];
+                m_point[1] = point[1];
+                m_point[2] = point[2];
                 m_index = index;
                 m_mySet = mySet;
             }
         };
+        template <int AXIS>
+        struct PointLess
+        {
+            bool operator()(const Point& left, const Point& right) const { return left.m_point[AXIS] < right.m_point[AXIS]; }
+        };
+        ///k-d tree node, stored in implicit heap order (children of node i are 2i + 1 and 2i + 2), points of a node are the contiguous range [m_start, m_end) of m_points
+        struct KdNode
+        {
+            float m_minCoord[3], m_maxCoord[3];//tight bounding box of the node's points
+            int32_t m_start, m_end;
+        };
         CaretMutex m_modifyMutex;//thread safety, don't let multiple threads modify the point sets at once
-        Oct<LeafVector<Point> >* m_tree;
+        std::vector<Point> m_points;//reordered so that every node's points are contiguous
+        std::vector<KdNode> m_nodes;
+        int32_t m_firstLeaf;//all leaves are on the last level, so anything at or above this index is a leaf
         int32_t m_nextSetIndex;
         std::vector<int32_t> m_unusedIndexes;
-        void addPoint(Oct<LeafVector<Point> >* thisOct, const float point[3], const int32_t index, const int32_t pointSet);
         int32_t newIndex();
-        static const int NUM_POINTS_SPLIT = 100;
-        void removeSetHelper(Oct<LeafVector<Point> >* thisOct, const int32_t thisSet);
+        static const int LEAF_POINTS = 16;
+        static const int64_t QUERY_CHUNK_SIZE = 64;
+        void rebuildTree();
+        void buildNode(const int32_t node);
+        int32_t findClosest(const float target[3], const float& maxDist2, const int32_t hintPoint) const;
+        void setInfo(const int32_t whichPoint, LocatorInfo* infoOut) const;
         CaretPointLocator();
     public:
-        ///make an empty point locator with given bounding box (bounding box can expand later, but may be less efficient
+        ///make an empty point locator with given bounding box (the bounding box is only a hint, the tree adapts to whatever points are added)
         CaretPointLocator(const float minBounds[3], const float maxBounds[3]);
         ///make a point locator with the bounding box of this point set, and use this point set as set #0
         CaretPointLocator(const float* coordsIn, const int32_t numCoords);
@@ -82,6 +100,8 @@ namespace caret {
         ///returns the index of the closest point, and optionally which point set and the coords
         int32_t closestPoint(const float target[3], LocatorInfo* infoOut = NULL) const;
         int32_t closestPointLimited(const float target[3], const float& maxDist, LocatorInfo* infoOut = NULL) const;
+        ///closest point for each of many targets, within maxDist if maxDist is positive (-1 where nothing is in range), uses multiple threads
+        void closestPoints(const float* targetsIn, const int64_t numTargets, int32_t* indicesOut, LocatorInfo* infoOut = NULL, const float& maxDist = -1.0f) const;
         std::set<LocatorInfo> pointsInRange(const float target[3], const float& maxDist) const;
     };
 }
@@ -1320,6 +1320,29 @@ void CaretPreferences::setVolumeIdentificationDefaultedOn(const bool status)
     this->qSettings->sync();
 }
 
+/**
+ * @return Is the column cache enabled for CIFTI matrix files?
+ */
+bool CaretPreferences::isCiftiMatrixColumnCacheEnabled() const
+{
+    return this->ciftiMatrixColumnCacheEnabled;
+}
+
+/**
+ * Set the column cache enabled for CIFTI matrix files.  The cache is
+ * a transposed copy of the matrix, as large as the file itself.
+ *
+ * @param enabled
+ *    New status for the column cache.
+ */
+void CaretPreferences::setCiftiMatrixColumnCacheEnabled(const bool enabled)
+{
+    this->ciftiMatrixColumnCacheEnabled = enabled;
+    this->setBoolean(CaretPreferences::NAME_CIFTI_MATRIX_COLUMN_CACHE,
+                     this->ciftiMatrixColumnCacheEnabled);
+    this->qSettings->sync();
+}
+
 /**
  * Read an unsigned byte array to the preferences.
  *
@@ -1520,6 +1543,9 @@ CaretPreferences::readPreferences()
     this->volumeIdentificationDefaultedOn = this->getBoolean(CaretPreferences::NAME_VOLUME_IDENTIFICATION_DEFAULTED_ON,
                                                              true);
     
+    this->ciftiMatrixColumnCacheEnabled = this->getBoolean(CaretPreferences::NAME_CIFTI_MATRIX_COLUMN_CACHE,
+                                                           false);
+    
     this->remoteFileUserName = this->getString(NAME_REMOTE_FILE_USER_NAME);
     this->remoteFilePassword = this->getString(NAME_REMOTE_FILE_PASSWORD);
     this->remoteFileLoginSaved = this->getBoolean(NAME_REMOTE_FILE_LOGIN_SAVED,
@@ -189,6 +189,10 @@ namespace caret {
         
         void setVolumeIdentificationDefaultedOn(const bool status);
         
+        bool isCiftiMatrixColumnCacheEnabled() const;
+        
+        void setCiftiMatrixColumnCacheEnabled(const bool enabled);
+        
         SpecFileDialogViewFilesTypeEnum::Enum getManageFilesViewFileType() const;
         
         void setManageFilesViewFileType(const SpecFileDialogViewFilesTypeEnum::Enum manageFilesViewFileType);
@@ -293,6 +297,8 @@ namespace caret {
         
         bool yokingDefaultedOn;
         
+        bool ciftiMatrixColumnCacheEnabled;
+        
         AString remoteFileUserName;
         AString remoteFilePassword;
         bool remoteFileLoginSaved;
@@ -331,6 +337,7 @@ namespace caret {
         static const AString NAME_TILE_TABS_CONFIGURATIONS;
         static const AString NAME_VOLUME_IDENTIFICATION_DEFAULTED_ON;
         static const AString NAME_YOKING_DEFAULT_ON;
+        static const AString NAME_CIFTI_MATRIX_COLUMN_CACHE;
         
     };
     
@@ -367,6 +374,7 @@ namespace caret {
     const AString CaretPreferences::NAME_TILE_TABS_CONFIGURATIONS = "tileTabsConfigurations";
     const AString CaretPreferences::NAME_VOLUME_IDENTIFICATION_DEFAULTED_ON = "volumeIdentificationDefaultedOn";
     const AString CaretPreferences::NAME_YOKING_DEFAULT_ON = "yokingDefaultedOn";
+    const AString CaretPreferences::NAME_CIFTI_MATRIX_COLUMN_CACHE = "ciftiMatrixColumnCache";
 #endif // __CARET_PREFERENCES_DECLARE__
 
 } // namespace
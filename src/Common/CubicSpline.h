@@ -58,6 +58,12 @@ namespace caret {
         {
             return p1 * m_weights[1] + p2 * m_weights[2];
         }
+        
+        ///the weight applied to p[which], for precomputing interpolation tables
+        inline float getWeight(const int which) const
+        {
+            return m_weights[which];
+        }
     };
 
 }
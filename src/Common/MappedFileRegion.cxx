@@ -0,0 +1,192 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "MappedFileRegion.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else // _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+using namespace caret;
+
+/**
+ * \class caret::MappedFileRegion
+ * \brief A copy-on-write memory mapping of part of a file.
+ *
+ * This is the one way files are memory mapped.  The mapping is private
+ * and writable, rather than read-only as with QFile::map(), because GIFTI
+ * arrays are mapped and then byte swapped or converted in place.  Readers
+ * that never write the data lose nothing, since unwritten pages are still
+ * shared with the page cache.  The region need not start on a page
+ * boundary, and callers fall back to reading the file normally when a
+ * region cannot be mapped.
+ */
+
+/**
+ * Constructor, nothing is mapped.
+ */
+MappedFileRegion::MappedFileRegion()
+{
+    m_mapStart = NULL;
+    m_mapLength = 0;
+    m_data = NULL;
+    m_numberOfBytes = 0;
+}
+
+/**
+ * Destructor, unmaps the region.
+ */
+MappedFileRegion::~MappedFileRegion()
+{
+    unmap();
+}
+
+/**
+ * Map part of a file privately: pages are shared with other processes
+ * mapping or caching the same file until they are written, and writes
+ * are never carried to the file.
+ *
+ * @param filename
+ *    Name of the file.
+ * @param offset
+ *    Offset of the region in the file, need not be page aligned.
+ * @param numberOfBytes
+ *    Size of the region.
+ * @return
+ *    True if mapped.  False if the file is shorter than the region, or
+ *    cannot be opened or mapped (such as a region too large for the
+ *    address space), in which case the file should be read normally.
+ */
+bool
+MappedFileRegion::map(const AString& filename,
+                      const int64_t offset,
+                      const int64_t numberOfBytes)
+{
+    unmap();
+    if ((offset < 0)
+        || (numberOfBytes <= 0)) {
+        return false;
+    }
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileW(reinterpret_cast<const wchar_t*>(filename.utf16()),
+                                    GENERIC_READ,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                    NULL,
+                                    OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL,
+                                    NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if ((GetFileSizeEx(fileHandle, &fileSize) == 0)
+        || (static_cast<int64_t>(fileSize.QuadPart) < offset + numberOfBytes)) {
+        CloseHandle(fileHandle);
+        return false;
+    }
+    HANDLE mappingHandle = CreateFileMappingW(fileHandle,
+                                              NULL,
+                                              PAGE_WRITECOPY,
+                                              0,
+                                              0,
+                                              NULL);
+    CloseHandle(fileHandle);//the mapping object keeps its own reference to the file
+    if (mappingHandle == NULL) {
+        return false;
+    }
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    const int64_t alignment = systemInfo.dwAllocationGranularity;//views must start on this, not just a page
+#else // _WIN32
+    const QByteArray name = filename.toLocal8Bit();
+    const int fd = open(name.constData(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStatus;
+    if ((fstat(fd, &fileStatus) != 0)
+        || (static_cast<int64_t>(fileStatus.st_size) < offset + numberOfBytes)) {
+        close(fd);
+        return false;
+    }
+    const int64_t alignment = sysconf(_SC_PAGESIZE);
+#endif // _WIN32
+    const int64_t alignedOffset = offset - (offset % alignment);
+    const int64_t mapLength = numberOfBytes + (offset - alignedOffset);
+    void* mapStart = NULL;
+    if (static_cast<int64_t>(static_cast<size_t>(mapLength)) == mapLength) {//otherwise too large for a 32-bit address space
+#ifdef _WIN32
+        mapStart = MapViewOfFile(mappingHandle,
+                                 FILE_MAP_COPY,
+                                 static_cast<DWORD>(alignedOffset >> 32),
+                                 static_cast<DWORD>(alignedOffset & 0xFFFFFFFF),
+                                 static_cast<SIZE_T>(mapLength));
+#else // _WIN32
+        mapStart = mmap(NULL,
+                        static_cast<size_t>(mapLength),
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE,
+                        fd,
+                        static_cast<off_t>(alignedOffset));
+        if (mapStart == MAP_FAILED) {
+            mapStart = NULL;
+        }
+#endif // _WIN32
+    }
+#ifdef _WIN32
+    CloseHandle(mappingHandle);//the view keeps the mapping object
+#else // _WIN32
+    close(fd);//the mapping keeps its own reference to the file
+#endif // _WIN32
+    if (mapStart == NULL) {
+        return false;
+    }
+    m_mapStart = mapStart;
+    m_mapLength = static_cast<size_t>(mapLength);
+    m_data = static_cast<uint8_t*>(mapStart) + (offset - alignedOffset);
+    m_numberOfBytes = numberOfBytes;
+    return true;
+}
+
+/**
+ * Unmap the region, if mapped.
+ */
+void
+MappedFileRegion::unmap()
+{
+    if (m_mapStart != NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_mapStart);
+#else // _WIN32
+        munmap(m_mapStart,
+               m_mapLength);
+#endif // _WIN32
+    }
+    m_mapStart = NULL;
+    m_mapLength = 0;
+    m_data = NULL;
+    m_numberOfBytes = 0;
+}
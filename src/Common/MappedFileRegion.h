@@ -0,0 +1,69 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#ifndef __MAPPED_FILE_REGION_H__
+#define __MAPPED_FILE_REGION_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "AString.h"
+
+namespace caret {
+
+    /// A copy-on-write memory mapping of part of a file, used for all memory mapped reading
+    class MappedFileRegion {
+        
+    public:
+        MappedFileRegion();
+        
+        ~MappedFileRegion();
+        
+        bool map(const AString& filename,
+                 const int64_t offset,
+                 const int64_t numberOfBytes);
+        
+        void unmap();
+        
+        /** @return The mapped bytes, NULL if not mapped.  Writing them does not change the file. */
+        uint8_t* getData() const { return m_data; }
+        
+        /** @return Number of mapped bytes. */
+        int64_t getNumberOfBytes() const { return m_numberOfBytes; }
+        
+    private:
+        MappedFileRegion(const MappedFileRegion&);
+        
+        MappedFileRegion& operator=(const MappedFileRegion&);
+        
+        /** Start of the mapping, which is page aligned, so may precede m_data */
+        void* m_mapStart;
+        
+        /** Length of the mapping from m_mapStart */
+        size_t m_mapLength;
+        
+        uint8_t* m_data;
+        
+        int64_t m_numberOfBytes;
+    };
+    
+} // namespace
+
+#endif // __MAPPED_FILE_REGION_H__
@@ -0,0 +1,43 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ModificationCounter.h"
+
+#include "CaretMutex.h"
+
+using namespace caret;
+
+namespace
+{
+    CaretMutex modificationCounterMutex;//files may be modified from several threads, such as algorithms processing files in parallel
+    int64_t modificationCounter = 0;
+}
+
+/**
+ * @return A modification count that has not been returned before.  This takes
+ * a lock, so per-value setters should only mark their count stale and get a
+ * new count when it is next asked for.
+ */
+int64_t
+ModificationCounter::next()
+{
+    CaretMutexLocker locked(&modificationCounterMutex);
+    return ++modificationCounter;
+}
@@ -0,0 +1,258 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#define __PERFORMANCE_STATISTICS_DECLARE__
+#include "PerformanceStatistics.h"
+#undef __PERFORMANCE_STATISTICS_DECLARE__
+
+#include "CaretOMP.h"
+
+#ifdef CARET_OS_WINDOWS
+#include "windows.h"
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace caret;
+
+/**
+ * \class caret::PerformanceStatistics
+ * \brief Counters and timers used to measure the performance of a command.
+ *
+ * Bytes read and written through CaretBinaryFile are counted and named
+ * phases (see PerformancePhaseTimer) are timed while statistics are
+ * enabled.  When disabled, the cost of the counters is a test of a flag.
+ * Reads that bypass CaretBinaryFile, such as memory mapped CIFTI data,
+ * GIFTI external data, interpolation plan files, and cached surface
+ * weights, add their bytes where the data is copied out.
+ */
+
+/**
+ * Enable or disable recording of statistics.
+ *
+ * @param enabled
+ *    New enabled status.
+ */
+void
+PerformanceStatistics::setEnabled(const bool enabled)
+{
+    s_enabled = enabled;
+}
+
+/**
+ * Reset the byte counters and phase times.
+ */
+void
+PerformanceStatistics::reset()
+{
+    CaretMutexLocker locker(&s_phaseMutex);
+    s_bytesRead = 0;
+    s_bytesWritten = 0;
+    s_phaseNames.clear();
+    s_phaseTimes.clear();
+}
+
+/**
+ * Add to the number of bytes read.
+ *
+ * @param numberOfBytes
+ *    Number of bytes that were read.
+ */
+void
+PerformanceStatistics::addBytesRead(const int64_t numberOfBytes)
+{
+    if ( ! s_enabled) {
+        return;
+    }
+#pragma omp atomic
+    s_bytesRead += numberOfBytes;
+}
+
+/**
+ * Add to the number of bytes written.
+ *
+ * @param numberOfBytes
+ *    Number of bytes that were written.
+ */
+void
+PerformanceStatistics::addBytesWritten(const int64_t numberOfBytes)
+{
+    if ( ! s_enabled) {
+        return;
+    }
+#pragma omp atomic
+    s_bytesWritten += numberOfBytes;
+}
+
+/**
+ * @return Number of bytes read since the last reset.
+ */
+int64_t
+PerformanceStatistics::getBytesRead()
+{
+    return s_bytesRead;
+}
+
+/**
+ * @return Number of bytes written since the last reset.
+ */
+int64_t
+PerformanceStatistics::getBytesWritten()
+{
+    return s_bytesWritten;
+}
+
+/**
+ * Add time to a named phase.
+ *
+ * @param phaseName
+ *    Name of the phase.
+ * @param seconds
+ *    Time spent in the phase.
+ */
+void
+PerformanceStatistics::addPhaseTime(const AString& phaseName,
+                                    const double seconds)
+{
+    if ( ! s_enabled) {
+        return;
+    }
+    CaretMutexLocker locker(&s_phaseMutex);
+    std::map<AString, PhaseTime>::iterator iter = s_phaseTimes.find(phaseName);
+    if (iter == s_phaseTimes.end()) {
+        iter = s_phaseTimes.insert(std::make_pair(phaseName, PhaseTime())).first;
+        s_phaseNames.push_back(phaseName);
+    }
+    iter->second.m_seconds += seconds;
+    iter->second.m_count++;
+}
+
+/**
+ * Get the time spent in each phase since the last reset.
+ *
+ * @param phaseNamesOut
+ *    Output with names of the phases in order of first use.
+ * @param secondsOut
+ *    Output with total time spent in each phase.
+ * @param countsOut
+ *    Output with number of times each phase ran.
+ */
+void
+PerformanceStatistics::getPhaseTimes(std::vector<AString>& phaseNamesOut,
+                                     std::vector<double>& secondsOut,
+                                     std::vector<int64_t>& countsOut)
+{
+    CaretMutexLocker locker(&s_phaseMutex);
+    phaseNamesOut = s_phaseNames;
+    secondsOut.clear();
+    countsOut.clear();
+    for (std::vector<AString>::iterator iter = s_phaseNames.begin();
+         iter != s_phaseNames.end();
+         iter++) {
+        const PhaseTime& phaseTime = s_phaseTimes[*iter];
+        secondsOut.push_back(phaseTime.m_seconds);
+        countsOut.push_back(phaseTime.m_count);
+    }
+}
+
+/**
+ * @return CPU time (user and system) used by all threads of this process.
+ */
+double
+PerformanceStatistics::getProcessCpuSeconds()
+{
+#ifdef CARET_OS_WINDOWS
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime) == 0) {
+        return 0.0;
+    }
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return (kernel.QuadPart + user.QuadPart) * 1.0e-7;//100 nanosecond units
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+    + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0e-6;
+#endif
+}
+
+/**
+ * @return Peak resident memory of this process since it started,
+ * or -1 if not available.
+ */
+int64_t
+PerformanceStatistics::getPeakResidentSetSizeBytes()
+{
+#ifdef CARET_OS_WINDOWS
+    return -1;//would need psapi
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#ifdef CARET_OS_MACOSX
+    return usage.ru_maxrss;//bytes on mac
+#else
+    return static_cast<int64_t>(usage.ru_maxrss) * 1024;//kilobytes on linux
+#endif
+#endif
+}
+
+/**
+ * \class caret::PerformancePhaseTimer
+ * \brief Times a named phase for PerformanceStatistics.
+ *
+ * Create one at the start of a block of code, and the time until it goes
+ * out of scope is added to the named phase.  Nothing is recorded when
+ * statistics are disabled.
+ */
+
+/**
+ * Constructor, starts timing.
+ *
+ * @param phaseName
+ *    Name of the phase.
+ */
+PerformancePhaseTimer::PerformancePhaseTimer(const AString& phaseName)
+: m_phaseName(phaseName),
+m_enabled(PerformanceStatistics::isEnabled())
+{
+    if (m_enabled) {
+        m_timer.start();
+    }
+}
+
+/**
+ * Destructor, adds the elapsed time to the phase.
+ */
+PerformancePhaseTimer::~PerformancePhaseTimer()
+{
+    if (m_enabled) {
+        PerformanceStatistics::addPhaseTime(m_phaseName,
+                                            m_timer.getElapsedTimeSeconds());
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef __PERFORMANCE_STATISTICS__H_
+#define __PERFORMANCE_STATISTICS__H_
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include "AString.h"
+#include "CaretMutex.h"
+#include "ElapsedTimer.h"
+
+namespace caret {
+
+    /// Counters and timers used to measure the performance of a command
+    class PerformanceStatistics {
+        
+    public:
+        static void setEnabled(const bool enabled);
+        
+        /** @return True if statistics are being recorded. */
+        static bool isEnabled() { return s_enabled; }
+        
+        static void reset();
+        
+        static void addBytesRead(const int64_t numberOfBytes);
+        
+        static void addBytesWritten(const int64_t numberOfBytes);
+        
+        static int64_t getBytesRead();
+        
+        static int64_t getBytesWritten();
+        
+        static void addPhaseTime(const AString& phaseName,
+                                 const double seconds);
+        
+        static void getPhaseTimes(std::vector<AString>& phaseNamesOut,
+                                  std::vector<double>& secondsOut,
+                                  std::vector<int64_t>& countsOut);
+        
+        static double getProcessCpuSeconds();
+        
+        static int64_t getPeakResidentSetSizeBytes();
+        
+    private:
+        PerformanceStatistics();
+        
+        /** Total time and number of times a phase ran */
+        struct PhaseTime {
+            PhaseTime() : m_seconds(0.0), m_count(0) { }
+            
+            double m_seconds;
+            
+            int64_t m_count;
+        };
+        
+        static bool s_enabled;
+        
+        static int64_t s_bytesRead;
+        
+        static int64_t s_bytesWritten;
+        
+        /** Phases in order of first use */
+        static std::vector<AString> s_phaseNames;
+        
+        static std::map<AString, PhaseTime> s_phaseTimes;
+        
+        static CaretMutex s_phaseMutex;
+    };
+    
+    /// Adds the time from its creation to its destruction to a named phase of PerformanceStatistics
+    class PerformancePhaseTimer {
+        
+    public:
+        PerformancePhaseTimer(const AString& phaseName);
+        
+        ~PerformancePhaseTimer();
+        
+    private:
+        PerformancePhaseTimer(const PerformancePhaseTimer&);
+        
+        PerformancePhaseTimer& operator=(const PerformancePhaseTimer&);
+        
+        const AString m_phaseName;
+        
+        const bool m_enabled;
+        
+        ElapsedTimer m_timer;
+    };
+    
+#ifdef __PERFORMANCE_STATISTICS_DECLARE__
+    bool PerformanceStatistics::s_enabled = false;
+    int64_t PerformanceStatistics::s_bytesRead = 0;
+    int64_t PerformanceStatistics::s_bytesWritten = 0;
+    std::vector<AString> PerformanceStatistics::s_phaseNames;
+    std::map<AString, PerformanceStatistics::PhaseTime> PerformanceStatistics::s_phaseTimes;
+    CaretMutex PerformanceStatistics::s_phaseMutex;
+#endif // __PERFORMANCE_STATISTICS_DECLARE__
+
+} // namespace
+#endif  //__PERFORMANCE_STATISTICS__H_
@@ -585,6 +585,9 @@ CiftiMappableDataFile::readFile(const AString& ciftiMapFileName)
                     break;
                 case FILE_MAP_DATA_TYPE_MATRIX:
                     m_ciftiFile->openFile(ciftiMapFileName);
+                    if (s_matrixColumnCacheEnabled) {
+                        m_ciftiFile->setColumnCacheEnabled(true);//column loading reads the matrix transposed, instead of one element per row
+                    }
                     break;
                 case FILE_MAP_DATA_TYPE_MULTI_MAP:
                     m_ciftiFile->openFile(ciftiMapFileName);
@@ -4922,6 +4925,31 @@ CiftiMappableDataFile::addToDataFileContentInformation(DataFileContentInformatio
                                                                    ciftiXML);
 }
 
+/**
+ * Set the status of the column cache for matrix files that are read from
+ * disk.  When enabled, the first column loaded from a file writes a
+ * transposed copy of the matrix (the same size as the file) next to the
+ * file or in the temporary directory, so later columns load quickly.
+ * Only affects files read after this is called.
+ *
+ * @param enabled
+ *     New status.
+ */
+void
+CiftiMappableDataFile::setMatrixColumnCacheEnabled(const bool enabled)
+{
+    s_matrixColumnCacheEnabled = enabled;
+}
+
+/**
+ * @return Is the column cache enabled for matrix files read from disk?
+ */
+bool
+CiftiMappableDataFile::isMatrixColumnCacheEnabled()
+{
+    return s_matrixColumnCacheEnabled;
+}
+
 /**
  * Get a text name for a CIFTI mapping type.
  *
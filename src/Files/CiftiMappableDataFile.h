@@ -162,6 +162,10 @@ namespace caret {
         static void addCiftiXmlToDataFileContentInformation(DataFileContentInformation& dataFileInformation,
                                                             const CiftiXML& ciftiXML);
         
+        static void setMatrixColumnCacheEnabled(const bool enabled);
+        
+        static bool isMatrixColumnCacheEnabled();
+        
         virtual void clear();
         
         virtual bool isEmpty() const;
@@ -703,6 +707,9 @@ namespace caret {
         
         static const int32_t S_CIFTI_XML_ALONG_INVALID;
         
+        /** build a transposed column cache file for on-disk matrix files, off unless the user opts in */
+        static bool s_matrixColumnCacheEnabled;
+        
 //        std::vector<int64_t> m_ciftiDimensions;
         
         // ADD_NEW_MEMBERS_HERE
@@ -711,6 +718,7 @@ namespace caret {
     
 #ifdef __CIFTI_MAPPABLE_DATA_FILE_DECLARE__
     const int32_t CiftiMappableDataFile::S_CIFTI_XML_ALONG_INVALID = -1;
+    bool CiftiMappableDataFile::s_matrixColumnCacheEnabled = false;
 #endif // __CIFTI_MAPPABLE_DATA_FILE_DECLARE__
     
 } // namespace
@@ -23,11 +23,14 @@
 #include "CaretAssert.h"
 #include "CaretHeap.h"
 #include "CaretMutex.h"
+#include "CaretOMP.h"
 #include "FastStatistics.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <stdint.h>
 
@@ -1223,3 +1226,101 @@ int32_t GeodesicHelper::getClosestNodeInRoi(const int32_t& root, const char* roi
     }
     return ret;
 }
+
+GeodesicHelperPool::GeodesicHelperPool(const CaretPointer<const GeodesicHelperBase>& baseIn)
+{
+    CaretAssert(baseIn != NULL);
+    m_myBase = baseIn;
+    m_surface = NULL;
+    m_helperIndex = 0;
+}
+
+GeodesicHelperPool::GeodesicHelperPool(const SurfaceFile* surfaceIn)
+{
+    CaretAssert(surfaceIn != NULL);
+    m_surface = surfaceIn;
+    m_helperIndex = 0;
+}
+
+void GeodesicHelperPool::getHelper(CaretPointer<GeodesicHelper>& helpOut)
+{
+    if (m_surface != NULL)
+    {
+        m_surface->getGeodesicHelper(helpOut);//surface already pools its helpers, and keeps them around after we are gone
+        return;
+    }
+    {//same strategy as SurfaceFile, search for an unused helper while locked
+        CaretMutexLocker myLock(&m_mutex);
+        int32_t myEnd = m_helpers.size();
+        for (int32_t i = 0; i < myEnd; ++i)
+        {
+            if (m_helperIndex >= myEnd) m_helperIndex = 0;
+            if (m_helpers[m_helperIndex].getReferenceCount() == 1)//1 reference: in this class, so unused elsewhere
+            {
+                helpOut = m_helpers[m_helperIndex];
+                ++m_helperIndex;
+                return;
+            }
+            ++m_helperIndex;
+        }
+    }//UNLOCK while allocating the scratch arrays of a new one
+    CaretPointer<GeodesicHelper> ret(new GeodesicHelper(m_myBase));
+    CaretMutexLocker myLock(&m_mutex);
+    m_helpers.push_back(ret);
+    helpOut = ret;
+}
+
+void GeodesicHelperPool::getNodesToGeoDist(const vector<int32_t>& roots, const float maxdist, GeodesicNeighborLists& listsOut, const bool smoothflag)
+{
+    getNodesToGeoDist(roots, vector<float>(roots.size(), maxdist), listsOut, smoothflag);
+}
+
+void GeodesicHelperPool::getNodesToGeoDist(const vector<int32_t>& roots, const vector<float>& maxdists, GeodesicNeighborLists& listsOut, const bool smoothflag)
+{
+    CaretAssert(roots.size() == maxdists.size());
+    const int64_t CHUNK_SIZE = 64;//roots per work item, so that the per-chunk buffers are large enough to not matter, but still balance well
+    int64_t numRoots = (int64_t)roots.size();
+    int64_t numChunks = (numRoots + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    vector<vector<int32_t> > chunkNodes(numChunks);
+    vector<vector<float> > chunkDists(numChunks);
+    listsOut.m_offsets.resize(numRoots + 1);
+    listsOut.m_offsets[0] = 0;
+#pragma omp CARET_PAR
+    {
+        CaretPointer<GeodesicHelper> myHelp;
+        getHelper(myHelp);
+        vector<int32_t> nodes;
+        vector<float> dists;
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t chunk = 0; chunk < numChunks; ++chunk)
+        {
+            int64_t chunkEnd = min(numRoots, (chunk + 1) * CHUNK_SIZE);
+            for (int64_t i = chunk * CHUNK_SIZE; i < chunkEnd; ++i)
+            {
+                myHelp->getNodesToGeoDist(roots[i], maxdists[i], nodes, dists, smoothflag);
+                chunkNodes[chunk].insert(chunkNodes[chunk].end(), nodes.begin(), nodes.end());
+                chunkDists[chunk].insert(chunkDists[chunk].end(), dists.begin(), dists.end());
+                listsOut.m_offsets[i + 1] = (int64_t)nodes.size();//just the count for now
+            }
+        }
+    }
+    for (int64_t i = 0; i < numRoots; ++i)
+    {
+        listsOut.m_offsets[i + 1] += listsOut.m_offsets[i];
+    }
+    listsOut.m_nodes.resize(listsOut.m_offsets[numRoots]);
+    listsOut.m_dists.resize(listsOut.m_offsets[numRoots]);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t chunk = 0; chunk < numChunks; ++chunk)
+    {
+        int64_t start = listsOut.m_offsets[chunk * CHUNK_SIZE];
+        CaretAssert(start + (int64_t)chunkNodes[chunk].size() <= listsOut.m_offsets[numRoots]);
+        if (!chunkNodes[chunk].empty())
+        {
+            memcpy(listsOut.m_nodes.data() + start, chunkNodes[chunk].data(), chunkNodes[chunk].size() * sizeof(int32_t));
+            memcpy(listsOut.m_dists.data() + start, chunkDists[chunk].data(), chunkDists[chunk].size() * sizeof(float));
+        }
+        vector<int32_t>().swap(chunkNodes[chunk]);//release as we go, so we don't hold two copies any longer than needed
+        vector<float>().swap(chunkDists[chunk]);
+    }
+}
@@ -121,6 +121,42 @@ namespace caret {
         int32_t getClosestNodeInRoi(const int32_t& root, const char* roi, const float& maxdist, float& distOut, bool smoothflag = true);
         int32_t getClosestNodeInRoi(const int32_t& root, const char* roi, std::vector<int32_t>& pathNodesOut, std::vector<float>& pathDistsOut, bool smoothflag);
     };
+    
+    ///results of many restricted geodesic searches, stored contiguously (CSR style) instead of as a vector per root
+    struct GeodesicNeighborLists
+    {
+        std::vector<int64_t> m_offsets;//results for root index i are in [m_offsets[i], m_offsets[i + 1])
+        std::vector<int32_t> m_nodes;
+        std::vector<float> m_dists;
+        int64_t getNumberOfRoots() const { return (m_offsets.empty() ? 0 : (int64_t)m_offsets.size() - 1); }
+        int64_t getNumberOfNeighbors(const int64_t& rootIndex) const { return m_offsets[rootIndex + 1] - m_offsets[rootIndex]; }
+        const int32_t* getNodes(const int64_t& rootIndex) const { return m_nodes.data() + m_offsets[rootIndex]; }
+        const float* getDists(const int64_t& rootIndex) const { return m_dists.data() + m_offsets[rootIndex]; }
+    };
+    
+    class GeodesicHelperPool
+    {//hands out helpers that aren't in use by anything else, so their scratch arrays get reused across threads and calls
+        CaretPointer<const GeodesicHelperBase> m_myBase;
+        const SurfaceFile* m_surface;//if set, use the surface's own helpers instead
+        CaretMutex m_mutex;
+        int32_t m_helperIndex;
+        std::vector<CaretPointer<GeodesicHelper> > m_helpers;
+        GeodesicHelperPool();
+        GeodesicHelperPool& operator=(const GeodesicHelperPool& right);
+        GeodesicHelperPool(const GeodesicHelperPool&);
+    public:
+        explicit GeodesicHelperPool(const CaretPointer<const GeodesicHelperBase>& baseIn);
+        explicit GeodesicHelperPool(const SurfaceFile* surfaceIn);//shares the surface's cached base and helpers
+        
+        ///get a helper that nothing else is using - it goes back into the pool when all references to it are gone
+        void getHelper(CaretPointer<GeodesicHelper>& helpOut);
+        
+        /// Get distances from each root node up to a geodesic distance cutoff, roots are processed in parallel - same results as calling getNodesToGeoDist on each root
+        void getNodesToGeoDist(const std::vector<int32_t>& roots, const float maxdist, GeodesicNeighborLists& listsOut, const bool smoothflag = true);
+        
+        /// Get distances from each root node up to its own geodesic distance cutoff, roots are processed in parallel
+        void getNodesToGeoDist(const std::vector<int32_t>& roots, const std::vector<float>& maxdists, GeodesicNeighborLists& listsOut, const bool smoothflag = true);
+    };
 
 } //namespace caret
 
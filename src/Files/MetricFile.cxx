@@ -27,6 +27,7 @@
 #include "GiftiFile.h"
 #include "MathFunctions.h"
 #include "MetricFile.h"
+#include "ModificationCounter.h"
 #include "NiftiEnums.h"
 #include "PaletteColorMapping.h"
 #include "SceneClass.h"
@@ -93,6 +94,35 @@ MetricFile::clear()
 {
     GiftiTypeFile::clear();
     this->columnDataPointers.clear();
+    m_dataModificationCount = ModificationCounter::next();
+    m_dataModificationCountStale = false;
+}
+
+/**
+ * Set the modified status, also changes the data modification count.
+ */
+void
+MetricFile::setModified()
+{
+    GiftiTypeFile::setModified();
+    m_dataModificationCount = ModificationCounter::next();
+    m_dataModificationCountStale = false;
+}
+
+/**
+ * @return A count that changes whenever the data in this file may have
+ * changed.  Counts are unique among all files, so coloring that
+ * was computed from this file's data can be reused while the count is
+ * unchanged.
+ */
+int64_t
+MetricFile::getDataModificationCount() const
+{
+    if (m_dataModificationCountStale) {
+        m_dataModificationCountStale = false;//clear first, so a value set while we get the new count marks it stale again
+        m_dataModificationCount = ModificationCounter::next();
+    }
+    return m_dataModificationCount;
 }
 
 /**
@@ -207,6 +237,8 @@ MetricFile::initializeMembersMetricFile()
     for (int32_t i = 0; i < BrainConstants::MAXIMUM_NUMBER_OF_BROWSER_TABS; i++) {
         m_chartingEnabledForTab[i] = false;
     }
+    m_dataModificationCount = ModificationCounter::next();
+    m_dataModificationCountStale = false;
 }
 
 /**
@@ -265,7 +297,8 @@ MetricFile::setValue(const int32_t nodeIndex,
     CaretAssertMessage((nodeIndex >= 0) && (nodeIndex < this->getNumberOfNodes()), "Node Index out of range.");
     
     this->columnDataPointers[columnIndex][nodeIndex] = value;
-    setModified();
+    GiftiTypeFile::setModified();
+    m_dataModificationCountStale = true;//getting a new count takes a lock, don't do it for every value
 }
 
 const float* 
@@ -58,6 +58,10 @@ namespace caret {
         virtual void addMaps(const int32_t numberOfNodes,
                              const int32_t numberOfMaps);
         
+        virtual void setModified();
+        
+        int64_t getDataModificationCount() const;
+        
         float getValue(const int32_t nodeIndex,
                        const int32_t columnIndex) const;
         
@@ -115,6 +119,12 @@ namespace caret {
         std::vector<float*> columnDataPointers;
 
         bool m_chartingEnabledForTab[BrainConstants::MAXIMUM_NUMBER_OF_BROWSER_TABS];
+        
+        ///changes whenever the file is modified, unique among all files
+        mutable int64_t m_dataModificationCount;
+        
+        ///set by setValue, the count is updated when it is next asked for
+        mutable bool m_dataModificationCountStale;
     };
 
 } // namespace
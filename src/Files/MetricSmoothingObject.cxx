@@ -23,10 +23,12 @@
 #include "CaretAssert.h"
 #include "CaretException.h"
 #include "SurfaceFile.h"
+#include "SurfaceWeightCache.h"
 #include "MetricFile.h"
 #include "GeodesicHelper.h"
 #include "TopologyHelper.h"
 #include "CaretOMP.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace std;
@@ -121,22 +123,65 @@ void MetricSmoothingObject::smoothMetric(const MetricFile* metricIn, MetricFile*
     {
         metricOut->setNumberOfNodesAndColumns(m_weightLists.size(), numCols);
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
-    if (roi != NULL)
+    if (roi != NULL && roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
     {
-        if (roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
-        {
-            throw CaretException("roi does not match surface number of nodes");
-        }
-        for (int32_t i = 0; i < numCols; ++i)
-        {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, roi, 0, fixZeros);
-        }
-    } else {
-        for (int32_t i = 0; i < numCols; ++i)
+        throw CaretException("roi does not match surface number of nodes");
+    }
+    smoothColumns(metricIn, 0, numCols, metricOut, 0, roi, 0, fixZeros);
+}
+
+namespace
+{
+    const int SMOOTH_BLOCK_COLUMNS = 16;//columns smoothed together, interleaved so each neighbor's values for the whole block are contiguous - multiple of common SIMD widths
+}
+
+void MetricSmoothingObject::smoothColumns(const MetricFile* metricIn, const int& firstColumn, const int& numColumns, MetricFile* metricOut, const int& firstOutColumn,
+                                          const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const
+{
+    CaretAssert(metricIn != NULL);
+    CaretAssert(metricOut != NULL);
+    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    {
+        throw CaretException("metric does not match surface number of nodes");
+    }
+    if (metricOut->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    {
+        throw CaretException("output metric does not match surface number of nodes");
+    }
+    if (roi != NULL && (roi->getNumberOfNodes() != (int32_t)m_weightLists.size()))
+    {
+        throw CaretException("roi does not match surface number of nodes");
+    }
+    if (numColumns < 0 || firstColumn < 0 || firstColumn + numColumns > metricIn->getNumberOfColumns())
+    {
+        throw CaretException("invalid input column range");
+    }
+    if (firstOutColumn < 0 || firstOutColumn + numColumns > metricOut->getNumberOfColumns())
+    {
+        throw CaretException("invalid output column range");
+    }
+    if (roi != NULL && (whichRoiColumn < 0 || whichRoiColumn >= roi->getNumberOfColumns()))
+    {
+        throw CaretException("invalid roi column number");
+    }
+    int32_t numNodes = metricIn->getNumberOfNodes();
+    const float* roiColumn = NULL;
+    if (roi != NULL) roiColumn = roi->getValuePointerForColumn(whichRoiColumn);
+    if (numColumns == 1)
+    {//no point in interleaving
+        vector<float> scratch(numNodes);
+        if (roi != NULL)
         {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, fixZeros);
+            smoothColumnInternal(scratch.data(), metricIn, firstColumn, metricOut, firstOutColumn, roi, whichRoiColumn, fixZeros);
+        } else {
+            smoothColumnInternal(scratch.data(), metricIn, firstColumn, metricOut, firstOutColumn, fixZeros);
         }
+        return;
+    }
+    vector<float> blockScratch(2 * (int64_t)numNodes * SMOOTH_BLOCK_COLUMNS), scratch(numNodes);
+    for (int start = 0; start < numColumns; start += SMOOTH_BLOCK_COLUMNS)
+    {
+        smoothBlockInternal(blockScratch.data(), scratch.data(), metricIn, firstColumn + start, min(SMOOTH_BLOCK_COLUMNS, numColumns - start), metricOut, firstOutColumn + start, roiColumn, fixZeros);
     }
 }
 
@@ -277,6 +322,101 @@ void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFil
     metricOut->setValuesForColumn(whichOutColumn, scratch);
 }
 
+void MetricSmoothingObject::smoothBlockInternal(float* blockScratch, float* scratch, const MetricFile* metricIn, const int& firstColumn, const int& numColumns, MetricFile* metricOut, const int& firstOutColumn,
+                                                const float* roiColumn, const bool& fixZeros) const
+{//same arithmetic in the same order as smoothColumnInternal, so results are identical, but each neighbor's weight is applied to the whole block at once
+    CaretAssert(numColumns > 0 && numColumns <= SMOOTH_BLOCK_COLUMNS);
+    const int B = SMOOTH_BLOCK_COLUMNS;
+    int32_t numNodes = metricIn->getNumberOfNodes();
+    float* blockIn = blockScratch;//node-major: blockIn[node * B + col]
+    float* blockOut = blockScratch + (int64_t)numNodes * B;
+    for (int c = 0; c < B; ++c)
+    {
+        if (c < numColumns)
+        {
+            const float* column = metricIn->getValuePointerForColumn(firstColumn + c);
+#pragma omp CARET_PARFOR schedule(static)
+            for (int32_t i = 0; i < numNodes; ++i)
+            {
+                blockIn[(int64_t)i * B + c] = column[i];
+            }
+        } else {//pad the last block with zeros, so the inner loops always have the same length
+#pragma omp CARET_PARFOR schedule(static)
+            for (int32_t i = 0; i < numNodes; ++i)
+            {
+                blockIn[(int64_t)i * B + c] = 0.0f;
+            }
+        }
+    }
+#pragma omp CARET_PARFOR schedule(dynamic, 64)
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        const WeightList& myWeightRef = m_weightLists[i];
+        float* outRow = blockOut + (int64_t)i * B;
+        if ((roiColumn != NULL && !(roiColumn[i] > 0.0f)) || myWeightRef.m_weightSum == 0.0f)
+        {
+            for (int c = 0; c < B; ++c) outRow[c] = 0.0f;
+            continue;
+        }
+        float sum[B], weightsum[B];
+        for (int c = 0; c < B; ++c)
+        {
+            sum[c] = 0.0f;
+            weightsum[c] = 0.0f;
+        }
+        int32_t numWeights = myWeightRef.m_nodes.size();
+        float roiWeightSum = 0.0f;
+        for (int32_t j = 0; j < numWeights; ++j)
+        {
+            int32_t neighbor = myWeightRef.m_nodes[j];
+            if (roiColumn != NULL && !(roiColumn[neighbor] > 0.0f)) continue;
+            float weight = myWeightRef.m_weights[j];
+            const float* inRow = blockIn + (int64_t)neighbor * B;
+            if (fixZeros)
+            {
+                for (int c = 0; c < B; ++c)
+                {
+                    float useWeight = (inRow[c] != 0.0f) ? weight : 0.0f;
+                    sum[c] += useWeight * inRow[c];
+                    weightsum[c] += useWeight;
+                }
+            } else {
+                for (int c = 0; c < B; ++c)
+                {
+                    sum[c] += weight * inRow[c];
+                }
+                roiWeightSum += weight;
+            }
+        }
+        if (fixZeros)
+        {
+            for (int c = 0; c < B; ++c)
+            {
+                outRow[c] = (weightsum[c] != 0.0f) ? sum[c] / weightsum[c] : 0.0f;
+            }
+        } else if (roiColumn != NULL) {
+            for (int c = 0; c < B; ++c)
+            {
+                outRow[c] = (roiWeightSum != 0.0f) ? sum[c] / roiWeightSum : 0.0f;
+            }
+        } else {
+            for (int c = 0; c < B; ++c)
+            {
+                outRow[c] = sum[c] / myWeightRef.m_weightSum;
+            }
+        }
+    }
+    for (int c = 0; c < numColumns; ++c)
+    {
+#pragma omp CARET_PARFOR schedule(static)
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            scratch[i] = blockOut[(int64_t)i * B + c];
+        }
+        metricOut->setValuesForColumn(firstOutColumn + c, scratch);
+    }
+}
+
 void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel)
 {
     int32_t numNodes = mySurf->getNumberOfNodes();
@@ -415,6 +555,8 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* myS
             m_weightLists[node].m_weights.push_back(weight);
             m_weightLists[node].m_weightSum += weight;
         }
+        vector<int32_t>().swap(tempList[i].m_nodes);//done with this scattering kernel, release it so we don't hold both full sets of weights
+        vector<float>().swap(tempList[i].m_weights);
     }
 }
 
@@ -639,6 +781,32 @@ void MetricSmoothingObject::precomputeWeights(const SurfaceFile* mySurf, float m
         default:
             break;
     }
+    int32_t numNodes = mySurf->getNumberOfNodes();
+    CaretPointer<SurfaceWeightCache::Key> cacheKey;
+    if (SurfaceWeightCache::isEnabled())
+    {//hash everything that affects the weights
+        cacheKey.grabNew(new SurfaceWeightCache::Key("metric_smoothing"));
+        cacheKey->addSurface(mySurf);
+        cacheKey->addValue((int32_t)myMethod);
+        cacheKey->addValue(myKernel);
+        cacheKey->addValue((int32_t)(passAreas != NULL));
+        if (passAreas != NULL) cacheKey->addData(passAreas, numNodes * sizeof(float));
+        cacheKey->addValue((int32_t)(theRoi != NULL));
+        if (theRoi != NULL) cacheKey->addData(theRoi->getValuePointerForColumn(0), numNodes * sizeof(float));
+        SurfaceWeightCache::WeightLists cached;
+        if (SurfaceWeightCache::load(*cacheKey, numNodes, cached) && (int64_t)cached.m_offsets.size() == (int64_t)numNodes + 1 && (int64_t)cached.m_rowValues.size() == numNodes)
+        {
+            m_weightLists.resize(numNodes);
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int32_t i = 0; i < numNodes; ++i)
+            {
+                m_weightLists[i].m_nodes.assign(cached.m_nodes.begin() + cached.m_offsets[i], cached.m_nodes.begin() + cached.m_offsets[i + 1]);
+                m_weightLists[i].m_weights.assign(cached.m_weights.begin() + cached.m_offsets[i], cached.m_weights.begin() + cached.m_offsets[i + 1]);
+                m_weightLists[i].m_weightSum = cached.m_rowValues[i];
+            }
+            return;
+        }
+    }
     if (theRoi != NULL)
     {
         switch (myMethod)
@@ -671,4 +839,24 @@ void MetricSmoothingObject::precomputeWeights(const SurfaceFile* mySurf, float m
                 throw CaretException("unknown smoothing method specified");
         };
     }
+    if (cacheKey != NULL)
+    {
+        SurfaceWeightCache::WeightLists toCache;
+        toCache.m_offsets.resize(numNodes + 1);
+        toCache.m_offsets[0] = 0;
+        toCache.m_rowValues.resize(numNodes);
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            toCache.m_offsets[i + 1] = toCache.m_offsets[i] + (int64_t)m_weightLists[i].m_nodes.size();
+            toCache.m_rowValues[i] = m_weightLists[i].m_weightSum;
+        }
+        toCache.m_nodes.reserve(toCache.m_offsets[numNodes]);
+        toCache.m_weights.reserve(toCache.m_offsets[numNodes]);
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            toCache.m_nodes.insert(toCache.m_nodes.end(), m_weightLists[i].m_nodes.begin(), m_weightLists[i].m_nodes.end());
+            toCache.m_weights.insert(toCache.m_weights.end(), m_weightLists[i].m_weights.begin(), m_weightLists[i].m_weights.end());
+        }
+        SurfaceWeightCache::store(*cacheKey, toCache);
+    }
 }
@@ -52,6 +52,9 @@ namespace caret {
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* columnOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi = NULL, const int& whichRoiColumn = 0, const bool& fixZeros = false) const;
         void smoothMetric(const MetricFile* metricIn, MetricFile* metricOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
+        ///smooth a range of columns together, which is much faster than one at a time when there are many columns - same result as calling smoothColumn on each
+        void smoothColumns(const MetricFile* metricIn, const int& firstColumn, const int& numColumns, MetricFile* metricOut, const int& firstOutColumn,
+                           const MetricFile* roi = NULL, const int& whichRoiColumn = 0, const bool& fixZeros = false) const;
     private:
         struct WeightList
         {
@@ -62,6 +65,8 @@ namespace caret {
         std::vector<WeightList> m_weightLists;
         void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const bool& fixZeros) const;
         void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const;
+        void smoothBlockInternal(float* blockScratch, float* scratch, const MetricFile* metricIn, const int& firstColumn, const int& numColumns, MetricFile* metricOut, const int& firstOutColumn,
+                                 const float* roiColumn, const bool& fixZeros) const;
         void precomputeWeights(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, Method myMethod, const float* nodeAreas);
         void precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel);
         void precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi);
@@ -21,6 +21,7 @@
 
 #include <cmath>
 #include <limits>
+#include <vector>
 
 //#include <QRunnable>
 //#include <QSemaphore>
@@ -38,7 +39,7 @@
 #include "GroupAndNameHierarchyItem.h"
 #include "Palette.h"
 #include "PaletteColorMapping.h"
-#include "CaretOMP.h"
+#include "PaletteScalarAndColor.h"
 
 using namespace caret;
 
@@ -56,7 +57,136 @@ static const float negativeThresholdGreenColor[] = {
     255.0f / 255.0f
 };
 
-
+namespace {
+    /**
+     * A palette's scalars, colors, and "none" status copied into
+     * contiguous arrays so that coloring many scalars avoids the
+     * color name comparisons and scalar and color object lookups that
+     * Palette::getPaletteColor() performs for each scalar.  Colors are
+     * identical to those from Palette::getPaletteColor().
+     *
+     * A table of colors sampled at fixed intervals is NOT used since
+     * values near a palette scalar (in particular the small normalized
+     * values used for data just above or below zero) would receive the
+     * color of the wrong palette entry.
+     */
+    class PaletteLookupTable {
+    public:
+        PaletteLookupTable(const Palette* palette,
+                           const bool interpolateColorFlag)
+        : m_interpolateColorFlag(interpolateColorFlag)
+        {
+            m_numberOfScalars = palette->getNumberOfScalarsAndColors();
+            m_scalars.resize(m_numberOfScalars);
+            m_rgba.resize(m_numberOfScalars * 4);
+            m_noneColorFlags.resize(m_numberOfScalars);
+            for (int32_t i = 0; i < m_numberOfScalars; i++) {
+                const PaletteScalarAndColor* psac = palette->getScalarAndColor(i);
+                m_scalars[i] = psac->getScalar();
+                psac->getColor(&m_rgba[i * 4]);
+                m_noneColorFlags[i] = (psac->isNoneColor() ? 1 : 0);
+            }
+        }
+        
+        /**
+         * Get the color for a normalized scalar, same as Palette::getPaletteColor().
+         *
+         * @param scalarIn
+         *    Normalized scalar value.
+         * @param rgbaOut
+         *    Output color.
+         */
+        void getPaletteColor(const float scalarIn,
+                             float rgbaOut[4]) const
+        {
+            rgbaOut[0] = 0.0f;
+            rgbaOut[1] = 0.0f;
+            rgbaOut[2] = 0.0f;
+            rgbaOut[3] = 1.0f;
+            
+            if (m_numberOfScalars <= 0) {
+                return;
+            }
+            
+            float scalar = scalarIn;
+            if (scalar < -1.0) scalar = -1.0;
+            if (scalar >  1.0) scalar = 1.0;
+            
+            bool interpolateColorFlag = m_interpolateColorFlag;
+            int32_t paletteIndex = -1;
+            if (m_numberOfScalars == 1) {
+                paletteIndex = 0;
+                interpolateColorFlag = false;
+            }
+            else if (scalar >= m_scalars[0]) {
+                paletteIndex = 0;
+                interpolateColorFlag = false;
+            }
+            else if (scalar <= m_scalars[m_numberOfScalars - 1]) {
+                paletteIndex = m_numberOfScalars - 1;
+                interpolateColorFlag = false;
+            }
+            else {
+                for (int32_t i = 1; i < m_numberOfScalars; i++) {
+                    if (scalar > m_scalars[i]) {
+                        paletteIndex = i - 1;
+                        break;
+                    }
+                }
+                
+                /*
+                 * Always interpolate if there are only two colors
+                 */
+                if (m_numberOfScalars == 2) {
+                    interpolateColorFlag = true;
+                }
+            }
+            
+            if (paletteIndex < 0) {
+                return;
+            }
+            
+            const float* rgbaAbove = &m_rgba[paletteIndex * 4];
+            rgbaOut[0] = rgbaAbove[0];
+            rgbaOut[1] = rgbaAbove[1];
+            rgbaOut[2] = rgbaAbove[2];
+            rgbaOut[3] = rgbaAbove[3];
+            if (interpolateColorFlag
+                && (paletteIndex < (m_numberOfScalars - 1))) {
+                const int32_t belowIndex = paletteIndex + 1;
+                const float totalDiff = m_scalars[paletteIndex] - m_scalars[belowIndex];
+                if (totalDiff != 0.0) {
+                    const float offset = scalar - m_scalars[belowIndex];
+                    const float percentAbove = offset / totalDiff;
+                    const float percentBelow = 1.0f - percentAbove;
+                    if (m_noneColorFlags[belowIndex] == 0) {
+                        const float* rgbaBelow = &m_rgba[belowIndex * 4];
+                        rgbaOut[0] = (percentAbove * rgbaAbove[0]
+                                      + percentBelow * rgbaBelow[0]);
+                        rgbaOut[1] = (percentAbove * rgbaAbove[1]
+                                      + percentBelow * rgbaBelow[1]);
+                        rgbaOut[2] = (percentAbove * rgbaAbove[2]
+                                      + percentBelow * rgbaBelow[2]);
+                    }
+                }
+            }
+            else if (m_noneColorFlags[paletteIndex] != 0) {
+                rgbaOut[3] = 0.0f;
+            }
+        }
+        
+    private:
+        const bool m_interpolateColorFlag;
+        
+        int32_t m_numberOfScalars;
+        
+        std::vector<float> m_scalars;
+        
+        std::vector<float> m_rgba;
+        
+        std::vector<char> m_noneColorFlags;
+    };
+}
     
 /**
  * \class NodeAndVoxelColoring 
@@ -179,25 +309,29 @@ NodeAndVoxelColoring::colorScalarsWithPalettePrivate(const FastStatistics* stati
                                                           &normalizedValues[0],
                                                           numberOfScalars);
     
+    /*
+     * Palette in a form that is fast to look up colors
+     */
+    const PaletteLookupTable paletteLookupTable(palette,
+                                                interpolateFlag);
+    
     /*
      * Get color for normalized values of -1.0 and 1.0.
      * Since there may be a large number of values that are -1.0 or 1.0
      * we can compute the color only once for these values and save time.
      */
     float rgbaPositiveOne[4], rgbaNegativeOne[4];
-    palette->getPaletteColor(1.0,
-                             interpolateFlag,
-                             rgbaPositiveOne);
+    paletteLookupTable.getPaletteColor(1.0,
+                                       rgbaPositiveOne);
     const bool rgbaPositiveOneValid = (rgbaPositiveOne[3] > 0.0);
-    palette->getPaletteColor(-1.0,
-                             interpolateFlag,
-                             rgbaNegativeOne);
+    paletteLookupTable.getPaletteColor(-1.0,
+                                       rgbaNegativeOne);
     const bool rgbaNegativeOneValid = (rgbaNegativeOne[3] > 0.0);
     
     /*
      * Color all scalars.
      */
-#pragma omp CARET_FOR
+#pragma omp CARET_PARFOR if (numberOfScalars > 10000)
 	for (int64_t i = 0; i < numberOfScalars; i++) {
         const int64_t i4 = i * 4;
         
@@ -284,9 +418,8 @@ NodeAndVoxelColoring::colorScalarsWithPalettePrivate(const FastStatistics* stati
              * Color scalar using palette
              */
             float rgba[4];
-            palette->getPaletteColor(normalValue,
-                                     interpolateFlag,
-                                     rgba);
+            paletteLookupTable.getPaletteColor(normalValue,
+                                               rgba);
             if (rgba[3] > 0.0f) {
                 rgbaOut[0] = rgba[0];
                 rgbaOut[1] = rgba[1];
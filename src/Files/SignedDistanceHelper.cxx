@@ -45,129 +45,195 @@ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FO
 DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
-#include "BoundingBox.h"
-#include "CaretHeap.h"
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+#include "MathFunctions.h"
 #include "SignedDistanceHelper.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace std;
 using namespace caret;
 
-float SignedDistanceHelper::dist(const float coord[3], WindingLogic myWinding)
+namespace
 {
-    CaretMutexLocker locked(&m_mutex);
-    CaretSimpleMinHeap<Oct<SignedDistanceHelperBase::TriVector>*, float> myHeap;
-    myHeap.push(m_base->m_indexRoot, m_base->m_indexRoot->distToPoint(coord));
-    ClosestPointInfo tempInfo, bestInfo;
-    float tempf = -1.0f, bestTriDist = -1.0f;
-    bool first = true;
-    int numChanged = 0;
-    while (!myHeap.isEmpty())
+    float boxDistSquared(const float coord[3], const float minCoord[3], const float maxCoord[3])
     {
-        Oct<SignedDistanceHelperBase::TriVector>* curOct = myHeap.pop(&tempf);
-        if (first || tempf < bestTriDist)
+        float ret = 0.0f;
+        for (int i = 0; i < 3; ++i)
         {
-            if (curOct->m_leaf)
+            float diff = 0.0f;
+            if (coord[i] < minCoord[i])
             {
-                vector<int32_t>& myVecRef = *(curOct->m_data.m_triList);
-                int numTris = (int)myVecRef.size();
-                for (int i = 0; i < numTris; ++i)
+                diff = minCoord[i] - coord[i];
+            } else if (coord[i] > maxCoord[i]) {
+                diff = coord[i] - maxCoord[i];
+            }
+            ret += diff * diff;
+        }
+        return ret;
+    }
+    
+    bool boxLineSegmentIntersects(const float start[3], const float end[3], const float minCoord[3], const float maxCoord[3])
+    {//same logic as Oct::lineSegmentIntersects
+        float curlow = 0.0f, curhigh = 1.0f;//parameterize the line segment to the range [0, 1] of t
+        for (int i = 0; i < 3; ++i)
+        {
+            float direction = end[i] - start[i];
+            if (direction != 0.0f)
+            {
+                float templow, temphigh;
+                if (direction > 0.0f)
                 {
-                    if (m_triMarked[myVecRef[i]] != 1)
-                    {
-                        m_triMarked[myVecRef[i]] = 1;
-                        m_triMarkChanged[numChanged++] = myVecRef[i];
-                        tempf = unsignedDistToTri(coord, myVecRef[i], tempInfo);
-                        if (first || tempf < bestTriDist)
-                        {
-                            bestInfo = tempInfo;
-                            bestTriDist = tempf;
-                            first = false;
-                        }
-                    }
+                    templow = (minCoord[i] - start[i]) / direction;//compute the range of t over which this line lies between the planes for this axis
+                    temphigh = (maxCoord[i] - start[i]) / direction;
+                } else {
+                    templow = (maxCoord[i] - start[i]) / direction;
+                    temphigh = (minCoord[i] - start[i]) / direction;
                 }
+                if (templow > curlow) curlow = templow;//intersect the ranges
+                if (temphigh < curhigh) curhigh = temphigh;
+                if (curhigh < curlow) return false;
             } else {
-                for (int ci = 0; ci < 2; ++ci)
-                {
-                    for (int cj = 0; cj < 2; ++cj)
-                    {
-                        for (int ck = 0; ck < 2; ++ck)
-                        {
-                            tempf = curOct->m_children[ci][cj][ck]->distToPoint(coord);
-                            if (first || tempf < bestTriDist)
-                            {
-                                myHeap.push(curOct->m_children[ci][cj][ck], tempf);
-                            }
-                        }
-                    }
-                }
+                if (start[i] < minCoord[i] || start[i] > maxCoord[i]) return false;
             }
         }
+        return true;
     }
-    while (numChanged)
+    
+    struct CenterLess
+    {//for partitioning triangles by the center of their bounding box along one axis
+        const float* m_centers;
+        int m_axis;
+        CenterLess(const float* centers, const int axis) : m_centers(centers), m_axis(axis) { }
+        bool operator()(const int32_t left, const int32_t right) const
+        {
+            return m_centers[left * 3 + m_axis] < m_centers[right * 3 + m_axis];
+        }
+    };
+}
+
+float SignedDistanceHelper::dist(const float coord[3], WindingLogic myWinding) const
+{
+    ClosestPointInfo bestInfo;
+    float bestTriDist = findClosest(coord, -1, bestInfo);
+    return bestTriDist * computeSign(coord, bestInfo, myWinding);
+}
+
+void SignedDistanceHelper::dist(const float* coordsIn, const int64_t numCoords, WindingLogic myWinding, float* distOut) const
+{
+    const int64_t numChunks = (numCoords + QUERY_CHUNK_SIZE - 1) / QUERY_CHUNK_SIZE;
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t chunk = 0; chunk < numChunks; ++chunk)
     {
-        m_triMarked[m_triMarkChanged[--numChanged]] = 0;//need to do this before computeSign
+        ClosestPointInfo bestInfo;
+        int32_t hintTriangle = -1;
+        int64_t chunkEnd = (chunk + 1) * QUERY_CHUNK_SIZE;
+        if (chunkEnd > numCoords) chunkEnd = numCoords;
+        for (int64_t i = chunk * QUERY_CHUNK_SIZE; i < chunkEnd; ++i)
+        {
+            const float* coord = coordsIn + i * 3;
+            float bestTriDist = findClosest(coord, hintTriangle, bestInfo);
+            hintTriangle = bestInfo.triangle;
+            distOut[i] = bestTriDist * computeSign(coord, bestInfo, myWinding);
+        }
     }
-    return bestTriDist * computeSign(coord, bestInfo, myWinding);
 }
 
-void SignedDistanceHelper::barycentricWeights(const float coord[3], BarycentricInfo& baryInfoOut)
+void SignedDistanceHelper::barycentricWeights(const float coord[3], BarycentricInfo& baryInfoOut) const
 {
-    CaretMutexLocker locked(&m_mutex);
-    CaretSimpleMinHeap<Oct<SignedDistanceHelperBase::TriVector>*, float> myHeap;
-    myHeap.push(m_base->m_indexRoot, m_base->m_indexRoot->distToPoint(coord));
-    ClosestPointInfo tempInfo, bestInfo;
-    float tempf = -1.0f, bestTriDist = -1.0f;
+    ClosestPointInfo bestInfo;
+    float bestTriDist = findClosest(coord, -1, bestInfo);
+    closestToBarycentric(bestInfo, bestTriDist, baryInfoOut);
+}
+
+void SignedDistanceHelper::barycentricWeights(const float* coordsIn, const int64_t numCoords, BarycentricInfo* baryInfoOut) const
+{
+    const int64_t numChunks = (numCoords + QUERY_CHUNK_SIZE - 1) / QUERY_CHUNK_SIZE;
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t chunk = 0; chunk < numChunks; ++chunk)
+    {
+        ClosestPointInfo bestInfo;
+        int32_t hintTriangle = -1;
+        int64_t chunkEnd = (chunk + 1) * QUERY_CHUNK_SIZE;
+        if (chunkEnd > numCoords) chunkEnd = numCoords;
+        for (int64_t i = chunk * QUERY_CHUNK_SIZE; i < chunkEnd; ++i)
+        {
+            float bestTriDist = findClosest(coordsIn + i * 3, hintTriangle, bestInfo);
+            hintTriangle = bestInfo.triangle;
+            closestToBarycentric(bestInfo, bestTriDist, baryInfoOut[i]);
+        }
+    }
+}
+
+float SignedDistanceHelper::findClosest(const float coord[3], const int32_t hintTriangle, ClosestPointInfo& bestInfo) const
+{
+    CaretAssert(m_base->m_numTris > 0);
+    const vector<SignedDistanceHelperBase::BvhNode>& myNodes = m_base->m_bvhNodes;
+    ClosestPointInfo tempInfo;
+    float tempf = -1.0f, bestTriDist = -1.0f, bestDistSquared = -1.0f;
     bool first = true;
-    int numChanged = 0;
-    while (!myHeap.isEmpty())
+    if (hintTriangle > -1)
+    {//a nearby point's closest triangle usually gives a tight bound to start with
+        bestTriDist = unsignedDistToTri(coord, hintTriangle, bestInfo);
+        bestDistSquared = bestTriDist * bestTriDist;
+        first = false;
+    }
+    int32_t nodeStack[SignedDistanceHelperBase::MAX_BVH_DEPTH];
+    float distStack[SignedDistanceHelperBase::MAX_BVH_DEPTH];//squared distance to the node's box, checked again when popped because the best distance may have shrunk
+    int stackSize = (myNodes.empty() ? 0 : 1);
+    nodeStack[0] = 0;
+    distStack[0] = 0.0f;
+    while (stackSize > 0)
     {
-        Oct<SignedDistanceHelperBase::TriVector>* curOct = myHeap.pop(&tempf);
-        if (first || tempf < bestTriDist)
+        --stackSize;
+        if (!first && distStack[stackSize] >= bestDistSquared) continue;
+        const SignedDistanceHelperBase::BvhNode& curNode = myNodes[nodeStack[stackSize]];
+        if (curNode.m_numTris > 0)
         {
-            if (curOct->m_leaf)
+            const int32_t* myTris = m_base->m_bvhTriangles.data() + curNode.m_index;
+            for (int i = 0; i < curNode.m_numTris; ++i)
             {
-                vector<int32_t>& myVecRef = *(curOct->m_data.m_triList);
-                int numTris = (int)myVecRef.size();
-                for (int i = 0; i < numTris; ++i)
+                tempf = unsignedDistToTri(coord, myTris[i], tempInfo);
+                if (first || tempf < bestTriDist)
                 {
-                    if (m_triMarked[myVecRef[i]] != 1)
-                    {
-                        m_triMarked[myVecRef[i]] = 1;
-                        m_triMarkChanged[numChanged++] = myVecRef[i];
-                        tempf = unsignedDistToTri(coord, myVecRef[i], tempInfo);
-                        if (first || tempf < bestTriDist)
-                        {
-                            bestInfo = tempInfo;
-                            bestTriDist = tempf;
-                            first = false;
-                        }
-                    }
-                }
-            } else {
-                for (int ci = 0; ci < 2; ++ci)
-                {
-                    for (int cj = 0; cj < 2; ++cj)
-                    {
-                        for (int ck = 0; ck < 2; ++ck)
-                        {
-                            tempf = curOct->m_children[ci][cj][ck]->distToPoint(coord);
-                            if (first || tempf < bestTriDist)
-                            {
-                                myHeap.push(curOct->m_children[ci][cj][ck], tempf);
-                            }
-                        }
-                    }
+                    bestInfo = tempInfo;
+                    bestTriDist = tempf;
+                    bestDistSquared = tempf * tempf;
+                    first = false;
                 }
             }
+        } else {
+            int32_t child1 = nodeStack[stackSize] + 1, child2 = curNode.m_index;
+            float dist1 = boxDistSquared(coord, myNodes[child1].m_minCoord, myNodes[child1].m_maxCoord);
+            float dist2 = boxDistSquared(coord, myNodes[child2].m_minCoord, myNodes[child2].m_maxCoord);
+            if (dist2 < dist1)
+            {
+                std::swap(child1, child2);
+                std::swap(dist1, dist2);
+            }
+            CaretAssert(stackSize + 2 <= SignedDistanceHelperBase::MAX_BVH_DEPTH);
+            if (first || dist2 < bestDistSquared)
+            {//push the farther child first, so the nearer one is searched first
+                nodeStack[stackSize] = child2;
+                distStack[stackSize] = dist2;
+                ++stackSize;
+            }
+            if (first || dist1 < bestDistSquared)
+            {
+                nodeStack[stackSize] = child1;
+                distStack[stackSize] = dist1;
+                ++stackSize;
+            }
         }
     }
-    while (numChanged)
-    {
-        m_triMarked[m_triMarkChanged[--numChanged]] = 0;//clean up
-    }
+    return bestTriDist;
+}
+
+void SignedDistanceHelper::closestToBarycentric(const ClosestPointInfo& bestInfo, const float bestTriDist, BarycentricInfo& baryInfoOut) const
+{
     baryInfoOut.triangle = bestInfo.triangle;
     baryInfoOut.point = bestInfo.tempPoint;
     baryInfoOut.absDistance = bestTriDist;
@@ -234,7 +300,7 @@ void SignedDistanceHelper::barycentricWeights(const float coord[3], BarycentricI
     };
 }
 
-int SignedDistanceHelper::computeSign(const float coord[3], SignedDistanceHelper::ClosestPointInfo myInfo, WindingLogic myWinding)
+int SignedDistanceHelper::computeSign(const float coord[3], SignedDistanceHelper::ClosestPointInfo myInfo, WindingLogic myWinding) const
 {
     Vector3D point = coord;
     Vector3D result = point - myInfo.tempPoint;
@@ -245,68 +311,53 @@ int SignedDistanceHelper::computeSign(const float coord[3], SignedDistanceHelper
         case NEGATIVE:
         case NONZERO:
             {
-                int numChanged = 0;
-                float positiveZ[3] = {0, 0, 1};
-                Vector3D point2 = point + positiveZ;
+                const vector<SignedDistanceHelperBase::BvhNode>& myNodes = m_base->m_bvhNodes;
                 int crossCount = 0;
-                vector<Oct<SignedDistanceHelperBase::TriVector>*> myStack;
-                myStack.push_back(m_base->m_indexRoot);
-                while (!myStack.empty())
+                int32_t nodeStack[SignedDistanceHelperBase::MAX_BVH_DEPTH];
+                int stackSize = (myNodes.empty() ? 0 : 1);
+                nodeStack[0] = 0;
+                while (stackSize > 0)
                 {
-                    Oct<SignedDistanceHelperBase::TriVector>* curOct = myStack[myStack.size() - 1];
-                    myStack.pop_back();
-                    if (curOct->m_leaf)
+                    const int32_t curIndex = nodeStack[--stackSize];
+                    const SignedDistanceHelperBase::BvhNode& curNode = myNodes[curIndex];
+                    if (coord[0] < curNode.m_minCoord[0] || coord[0] > curNode.m_maxCoord[0] ||
+                        coord[1] < curNode.m_minCoord[1] || coord[1] > curNode.m_maxCoord[1] ||
+                        coord[2] > curNode.m_maxCoord[2])
+                    {
+                        continue;//ray in the positive z direction misses the box
+                    }
+                    if (curNode.m_numTris > 0)
                     {
-                        vector<int32_t>& myVecRef = *(curOct->m_data.m_triList);
-                        int numTris = (int)myVecRef.size();
-                        for (int i = 0; i < numTris; ++i)
+                        const int32_t* myTris = m_base->m_bvhTriangles.data() + curNode.m_index;
+                        for (int i = 0; i < curNode.m_numTris; ++i)
                         {
-                            if (m_triMarked[myVecRef[i]] != 1)
+                            const int32_t* myTileNodes = m_base->getTriangle(myTris[i]);
+                            Vector3D verts[3];
+                            verts[0] = m_base->getCoordinate(myTileNodes[0]);
+                            verts[1] = m_base->getCoordinate(myTileNodes[1]);
+                            verts[2] = m_base->getCoordinate(myTileNodes[2]);
+                            Vector3D triNormal;
+                            MathFunctions::normalVector(verts[0], verts[1], verts[2], triNormal);
+                            float factor = triNormal[2];//equivalent to dot product with positiveZ
+                            if (factor != 0.0f)
                             {
-                                m_triMarked[myVecRef[i]] = 1;
-                                m_triMarkChanged[numChanged++] = myVecRef[i];
-                                const int32_t* myTileNodes = m_base->getTriangle(myVecRef[i]);
-                                Vector3D verts[3];
-                                verts[0] = m_base->getCoordinate(myTileNodes[0]);
-                                verts[1] = m_base->getCoordinate(myTileNodes[1]);
-                                verts[2] = m_base->getCoordinate(myTileNodes[2]);
-                                Vector3D triNormal;
-                                MathFunctions::normalVector(verts[0], verts[1], verts[2], triNormal);
-                                float factor = triNormal[2];//equivalent to dot product with positiveZ
-                                if (factor != 0.0f)
+                                if (triNormal.dot(verts[0] - point) / factor > 0.0f && pointInTri(verts, point, 0, 1))
                                 {
-                                    if (triNormal.dot(verts[0] - point) / factor > 0.0f && pointInTri(verts, point, 0, 1))
+                                    if (triNormal[2] < 0.0f)
                                     {
-                                        if (triNormal[2] < 0.0f)
-                                        {
-                                            ++crossCount;
-                                        } else {
-                                            --crossCount;
-                                        }
+                                        ++crossCount;
+                                    } else {
+                                        --crossCount;
                                     }
                                 }
                             }
                         }
                     } else {
-                        for (int ci = 0; ci < 2; ++ci)
-                        {
-                            for (int cj = 0; cj < 2; ++cj)
-                            {
-                                for (int ck = 0; ck < 2; ++ck)
-                                {
-                                    if (curOct->m_children[ci][cj][ck]->rayIntersects(coord, point2))
-                                    {
-                                        myStack.push_back(curOct->m_children[ci][cj][ck]);
-                                    }
-                                }
-                            }
-                        }
+                        CaretAssert(stackSize + 2 <= SignedDistanceHelperBase::MAX_BVH_DEPTH);
+                        nodeStack[stackSize++] = curNode.m_index;
+                        nodeStack[stackSize++] = curIndex + 1;
                     }
                 }
-                while (numChanged)
-                {
-                    m_triMarked[m_triMarkChanged[--numChanged]] = 0;
-                }
                 switch (myWinding)
                 {
                     case EVEN_ODD:
@@ -332,7 +383,6 @@ int SignedDistanceHelper::computeSign(const float coord[3], SignedDistanceHelper
                 case 0://node
                     {
                         int curSign = 0;
-                        int numChanged = 0;
                         const vector<int>& myTiles = m_base->m_topoHelp->getNodeTiles(myInfo.node1);
                         bool first = true;
                         float bestNorm = 0;
@@ -375,71 +425,57 @@ int SignedDistanceHelper::computeSign(const float coord[3], SignedDistanceHelper
                         {
                             midAxis = 2;
                         }
-                        vector<Oct<SignedDistanceHelperBase::TriVector>*> myStack;
-                        myStack.push_back(m_base->m_indexRoot);
-                        while (!myStack.empty())
+                        const vector<SignedDistanceHelperBase::BvhNode>& myNodes = m_base->m_bvhNodes;
+                        int32_t nodeStack[SignedDistanceHelperBase::MAX_BVH_DEPTH];
+                        int stackSize = (myNodes.empty() ? 0 : 1);
+                        nodeStack[0] = 0;
+                        while (stackSize > 0)
                         {
-                            Oct<SignedDistanceHelperBase::TriVector>* curOct = myStack[myStack.size() - 1];
-                            myStack.pop_back();
-                            if (curOct->m_leaf)
+                            const int32_t curIndex = nodeStack[--stackSize];
+                            const SignedDistanceHelperBase::BvhNode& curNode = myNodes[curIndex];
+                            if (!boxLineSegmentIntersects(coord, bestCent, curNode.m_minCoord, curNode.m_maxCoord))
+                            {
+                                continue;
+                            }
+                            if (curNode.m_numTris > 0)
                             {
-                                vector<int32_t>& myVecRef = *(curOct->m_data.m_triList);
-                                int numTris = (int)myVecRef.size();
-                                for (int i = 0; i < numTris; ++i)
+                                const int32_t* myTris = m_base->m_bvhTriangles.data() + curNode.m_index;
+                                for (int i = 0; i < curNode.m_numTris; ++i)
                                 {
-                                    if (m_triMarked[myVecRef[i]] != 1)
+                                    const int32_t* myTileNodes = m_base->getTriangle(myTris[i]);
+                                    Vector3D verts[3];
+                                    verts[0] = m_base->getCoordinate(myTileNodes[0]);
+                                    verts[1] = m_base->getCoordinate(myTileNodes[1]);
+                                    verts[2] = m_base->getCoordinate(myTileNodes[2]);
+                                    Vector3D triNormal;
+                                    MathFunctions::normalVector(verts[0], verts[1], verts[2], triNormal);
+                                    float factor = triNormal.dot(segNormal);
+                                    if (factor == 0.0f)
                                     {
-                                        m_triMarked[myVecRef[i]] = 1;
-                                        m_triMarkChanged[numChanged++] = myVecRef[i];
-                                        const int32_t* myTileNodes = m_base->getTriangle(myVecRef[i]);
-                                        Vector3D verts[3];
-                                        verts[0] = m_base->getCoordinate(myTileNodes[0]);
-                                        verts[1] = m_base->getCoordinate(myTileNodes[1]);
-                                        verts[2] = m_base->getCoordinate(myTileNodes[2]);
-                                        Vector3D triNormal;
-                                        MathFunctions::normalVector(verts[0], verts[1], verts[2], triNormal);
-                                        float factor = triNormal.dot(segNormal);
-                                        if (factor == 0.0f)
-                                        {
-                                            continue;//skip triangles parallel to the line segment
-                                        }
-                                        float intersectDist = triNormal.dot(point - verts[0]) / factor;
-                                        if (intersectDist > 0.0f && intersectDist < bestDist)
-                                        {
-                                            Vector3D inPlane = point - intersectDist * segNormal;
-                                            if (pointInTri(verts, inPlane, majAxis, midAxis))
-                                            {
-                                                bestDist = intersectDist;
-                                                if (triNormal.dot(mySeg) > 0.0f)
-                                                {
-                                                    curSign = 1;
-                                                } else {
-                                                    curSign = -1;
-                                                }
-                                            }
-                                        }
+                                        continue;//skip triangles parallel to the line segment
                                     }
-                                }
-                            } else {
-                                for (int ci = 0; ci < 2; ++ci)
-                                {
-                                    for (int cj = 0; cj < 2; ++cj)
+                                    float intersectDist = triNormal.dot(point - verts[0]) / factor;
+                                    if (intersectDist > 0.0f && intersectDist < bestDist)
                                     {
-                                        for (int ck = 0; ck < 2; ++ck)
+                                        Vector3D inPlane = point - intersectDist * segNormal;
+                                        if (pointInTri(verts, inPlane, majAxis, midAxis))
                                         {
-                                            if (curOct->m_children[ci][cj][ck]->lineSegmentIntersects(coord, bestCent))
+                                            bestDist = intersectDist;
+                                            if (triNormal.dot(mySeg) > 0.0f)
                                             {
-                                                myStack.push_back(curOct->m_children[ci][cj][ck]);
+                                                curSign = 1;
+                                            } else {
+                                                curSign = -1;
                                             }
                                         }
                                     }
                                 }
+                            } else {
+                                CaretAssert(stackSize + 2 <= SignedDistanceHelperBase::MAX_BVH_DEPTH);
+                                nodeStack[stackSize++] = curNode.m_index;
+                                nodeStack[stackSize++] = curIndex + 1;
                             }
                         }
-                        while (numChanged)
-                        {
-                            m_triMarked[m_triMarkChanged[--numChanged]] = 0;
-                        }
                         return curSign;
                     }
                     break;
@@ -500,7 +536,7 @@ int SignedDistanceHelper::computeSign(const float coord[3], SignedDistanceHelper
     return 1;
 }
 
-bool SignedDistanceHelper::pointInTri(Vector3D verts[3], Vector3D inPlane, int majAxis, int midAxis)
+bool SignedDistanceHelper::pointInTri(Vector3D verts[3], Vector3D inPlane, int majAxis, int midAxis) const
 {
     bool inside = false;
     for (int j = 2, i = 0; i < 3; ++i)//start with the wraparound case
@@ -526,7 +562,7 @@ bool SignedDistanceHelper::pointInTri(Vector3D verts[3], Vector3D inPlane, int m
 
 ///"dumb" implementation, projects to plane, test if inside while finding closest point on each edge
 ///there are faster implementations out there, but this is easier to follow
-float SignedDistanceHelper::unsignedDistToTri(const float coord[3], int32_t triangle, ClosestPointInfo& myInfo)
+float SignedDistanceHelper::unsignedDistToTri(const float coord[3], int32_t triangle, ClosestPointInfo& myInfo) const
 {
     const int32_t* triNodes = m_base->getTriangle(triangle);
     Vector3D point = coord;
@@ -706,24 +742,11 @@ float SignedDistanceHelper::unsignedDistToTri(const float coord[3], int32_t tria
 SignedDistanceHelper::SignedDistanceHelper(CaretPointer<SignedDistanceHelperBase> myBase)
 {
     m_base = myBase;
-    int32_t numTris = m_base->m_numTris;
-    m_triMarked = CaretArray<int>(numTris);
-    m_triMarkChanged = CaretArray<int>(numTris);
-    for (int32_t i = 0; i < numTris; ++i)
-    {
-        m_triMarked[i] = 0;
-    }
 }
 
 SignedDistanceHelperBase::SignedDistanceHelperBase(const SurfaceFile* mySurf)
 {
     m_topoHelp = mySurf->getTopologyHelper();
-    const float* myBB = mySurf->getBoundingBox()->getBounds();
-    Vector3D minCoord, maxCoord;
-    minCoord[0] = myBB[0]; maxCoord[0] = myBB[1];
-    minCoord[1] = myBB[2]; maxCoord[1] = myBB[3];
-    minCoord[2] = myBB[4]; maxCoord[2] = myBB[5];
-    m_indexRoot.grabNew(new Oct<TriVector>(minCoord, maxCoord));
     const float* myCoordData = mySurf->getCoordinateData();
     m_numNodes = mySurf->getNumberOfNodes();
     int32_t numNodes3 = m_numNodes * 3;
@@ -734,6 +757,8 @@ SignedDistanceHelperBase::SignedDistanceHelperBase(const SurfaceFile* mySurf)
     }
     m_numTris = mySurf->getNumberOfTriangles();
     m_triangleList.resize(m_numTris * 3);
+    vector<float> triBounds(m_numTris * 6), triCenters(m_numTris * 3);//min xyz, max xyz of each triangle, and the center of that box
+    m_bvhTriangles.resize(m_numTris);
     for (int32_t i = 0; i < m_numTris; ++i)
     {
         int32_t i3 = i * 3;
@@ -741,106 +766,76 @@ SignedDistanceHelperBase::SignedDistanceHelperBase(const SurfaceFile* mySurf)
         m_triangleList[i3] = thisTri[0];
         m_triangleList[i3 + 1] = thisTri[1];
         m_triangleList[i3 + 2] = thisTri[2];
-        maxCoord = minCoord = myCoordData + thisTri[0] * 3;//set both to the coordinates of the first node in the triangle
+        float* minCoord = triBounds.data() + i * 6;
+        float* maxCoord = minCoord + 3;
+        for (int k = 0; k < 3; ++k)
+        {
+            minCoord[k] = maxCoord[k] = myCoordData[thisTri[0] * 3 + k];//start with the coordinates of the first node in the triangle
+        }
         for (int j = 1; j < 3; ++j)
         {
             int32_t thisNode3 = thisTri[j] * 3;
-            if (myCoordData[thisNode3] < minCoord[0]) minCoord[0] = myCoordData[thisNode3];
-            if (myCoordData[thisNode3 + 1] < minCoord[1]) minCoord[1] = myCoordData[thisNode3 + 1];
-            if (myCoordData[thisNode3 + 2] < minCoord[2]) minCoord[2] = myCoordData[thisNode3 + 2];
-            if (myCoordData[thisNode3] > maxCoord[0]) maxCoord[0] = myCoordData[thisNode3];
-            if (myCoordData[thisNode3 + 1] > maxCoord[1]) maxCoord[1] = myCoordData[thisNode3 + 1];
-            if (myCoordData[thisNode3 + 2] > maxCoord[2]) maxCoord[2] = myCoordData[thisNode3 + 2];
+            for (int k = 0; k < 3; ++k)
+            {
+                if (myCoordData[thisNode3 + k] < minCoord[k]) minCoord[k] = myCoordData[thisNode3 + k];
+                if (myCoordData[thisNode3 + k] > maxCoord[k]) maxCoord[k] = myCoordData[thisNode3 + k];
+            }
         }
-        addTriangle(m_indexRoot, i, minCoord, maxCoord);//use bounding box for now as an easy test to capture any chance of the triangle intersecting the Oct
+        for (int k = 0; k < 3; ++k)
+        {
+            triCenters[i3 + k] = (minCoord[k] + maxCoord[k]) * 0.5f;
+        }
+        m_bvhTriangles[i] = i;
+    }
+    if (m_numTris > 0)
+    {
+        m_bvhNodes.reserve(m_numTris);//median splits leave at least 2 triangles in each leaf, so there are no more nodes than triangles
+        buildBvh(triBounds, triCenters, 0, m_numTris);
     }
 }
 
-void SignedDistanceHelperBase::addTriangle(Oct<TriVector>* thisOct, int32_t triangle, float minCoord[3], float maxCoord[3])
-{
-    if (thisOct->m_leaf)
+int32_t SignedDistanceHelperBase::buildBvh(const vector<float>& triBounds, const vector<float>& triCenters, const int32_t start, const int32_t end)
+{//builds the subtree for m_bvhTriangles[start, end), returns the index of its root node
+    const int32_t myIndex = (int32_t)m_bvhNodes.size();
+    m_bvhNodes.push_back(BvhNode());
+    BvhNode myNode;
+    float centerMin[3], centerMax[3];
+    for (int k = 0; k < 3; ++k)
     {
-        thisOct->m_data.m_triList->push_back(triangle);
-        int numTris = (int)thisOct->m_data.m_triList->size();
-        if (numTris >= NUM_TRIS_TO_TEST && numTris % NUM_TRIS_TEST_INCR == NUM_TRIS_TO_TEST % NUM_TRIS_TEST_INCR)//the second modulus should const out
+        myNode.m_minCoord[k] = triBounds[m_bvhTriangles[start] * 6 + k];
+        myNode.m_maxCoord[k] = triBounds[m_bvhTriangles[start] * 6 + 3 + k];
+        centerMin[k] = centerMax[k] = triCenters[m_bvhTriangles[start] * 3 + k];
+    }
+    for (int32_t i = start + 1; i < end; ++i)
+    {
+        const float* thisBounds = triBounds.data() + m_bvhTriangles[i] * 6;
+        const float* thisCenter = triCenters.data() + m_bvhTriangles[i] * 3;
+        for (int k = 0; k < 3; ++k)
         {
-            Vector3D tempMinCoord, tempMaxCoord;
-            const float* myCoordData = m_coordList.data();
-            int totalSize = 0;
-            int numSplit = 0;
-            for (int i = 0; i < numTris; ++i)//gather data on how it would end up splitting
-            {
-                const int32_t* tempTri = getTriangle((*(thisOct->m_data.m_triList))[i]);
-                tempMaxCoord = tempMinCoord = myCoordData + tempTri[0] * 3;//set both to the coordinates of the first node in the triangle
-                for (int j = 1; j < 3; ++j)
-                {
-                    int32_t thisNode3 = tempTri[j] * 3;
-                    if (myCoordData[thisNode3] < tempMinCoord[0]) tempMinCoord[0] = myCoordData[thisNode3];
-                    if (myCoordData[thisNode3 + 1] < tempMinCoord[1]) tempMinCoord[1] = myCoordData[thisNode3 + 1];
-                    if (myCoordData[thisNode3 + 2] < tempMinCoord[2]) tempMinCoord[2] = myCoordData[thisNode3 + 2];
-                    if (myCoordData[thisNode3] > tempMaxCoord[0]) tempMaxCoord[0] = myCoordData[thisNode3];
-                    if (myCoordData[thisNode3 + 1] > tempMaxCoord[1]) tempMaxCoord[1] = myCoordData[thisNode3 + 1];
-                    if (myCoordData[thisNode3 + 2] > tempMaxCoord[2]) tempMaxCoord[2] = myCoordData[thisNode3 + 2];
-                }
-                int minOct[3], maxOct[3];
-                thisOct->containingChild(tempMinCoord, minOct);
-                thisOct->containingChild(tempMaxCoord, maxOct);
-                int splitSize = 8;
-                if (minOct[0] == maxOct[0]) splitSize >>= 1;
-                if (minOct[1] == maxOct[1]) splitSize >>= 1;
-                if (minOct[2] == maxOct[2]) splitSize >>= 1;
-                totalSize += splitSize;
-                if (splitSize != 8) ++numSplit;
-            }
-            if (numSplit > 0 && totalSize < 3.0f * numTris)//don't split if all triangles end up in all child octs, and try to balance speedup with memory usage
-            {
-                thisOct->makeChildren();//do the split
-                for (int i = 0; i < numTris; ++i)//gather data on how it would end up splitting
-                {
-                    const int32_t* tempTri = getTriangle((*(thisOct->m_data.m_triList))[i]);
-                    tempMaxCoord = tempMinCoord = myCoordData + tempTri[0] * 3;//set both to the coordinates of the first node in the triangle
-                    for (int j = 1; j < 3; ++j)
-                    {
-                        int32_t thisNode3 = tempTri[j] * 3;
-                        if (myCoordData[thisNode3] < tempMinCoord[0]) tempMinCoord[0] = myCoordData[thisNode3];
-                        if (myCoordData[thisNode3 + 1] < tempMinCoord[1]) tempMinCoord[1] = myCoordData[thisNode3 + 1];
-                        if (myCoordData[thisNode3 + 2] < tempMinCoord[2]) tempMinCoord[2] = myCoordData[thisNode3 + 2];
-                        if (myCoordData[thisNode3] > tempMaxCoord[0]) tempMaxCoord[0] = myCoordData[thisNode3];
-                        if (myCoordData[thisNode3 + 1] > tempMaxCoord[1]) tempMaxCoord[1] = myCoordData[thisNode3 + 1];
-                        if (myCoordData[thisNode3 + 2] > tempMaxCoord[2]) tempMaxCoord[2] = myCoordData[thisNode3 + 2];
-                    }
-                    for (int ci = 0; ci < 2; ++ci)
-                    {
-                        for (int cj = 0; cj < 2; ++cj)
-                        {
-                            for (int ck = 0; ck < 2; ++ck)
-                            {
-                                if (thisOct->m_children[ci][cj][ck]->boundsOverlaps(tempMinCoord, tempMaxCoord))
-                                {
-                                    addTriangle(thisOct->m_children[ci][cj][ck], (*(thisOct->m_data.m_triList))[i], tempMinCoord, tempMaxCoord);
-                                }
-                            }
-                        }
-                    }
-                }
-                thisOct->m_data.freeData();//and free up some memory
-            }
+            if (thisBounds[k] < myNode.m_minCoord[k]) myNode.m_minCoord[k] = thisBounds[k];
+            if (thisBounds[k + 3] > myNode.m_maxCoord[k]) myNode.m_maxCoord[k] = thisBounds[k + 3];
+            if (thisCenter[k] < centerMin[k]) centerMin[k] = thisCenter[k];
+            if (thisCenter[k] > centerMax[k]) centerMax[k] = thisCenter[k];
         }
+    }
+    if (end - start <= MAX_LEAF_TRIS)
+    {
+        myNode.m_index = start;
+        myNode.m_numTris = end - start;
     } else {
-        for (int ci = 0; ci < 2; ++ci)
+        int axis = 0;//split along the longest extent of the triangle centers, at the median, so the tree is balanced
+        for (int k = 1; k < 3; ++k)
         {
-            for (int cj = 0; cj < 2; ++cj)
-            {
-                for (int ck = 0; ck < 2; ++ck)
-                {
-                    if (thisOct->m_children[ci][cj][ck]->boundsOverlaps(minCoord, maxCoord))
-                    {
-                        addTriangle(thisOct->m_children[ci][cj][ck], triangle, minCoord, maxCoord);
-                    }
-                }
-            }
+            if (centerMax[k] - centerMin[k] > centerMax[axis] - centerMin[axis]) axis = k;
         }
+        const int32_t middle = start + (end - start) / 2;
+        std::nth_element(m_bvhTriangles.begin() + start, m_bvhTriangles.begin() + middle, m_bvhTriangles.begin() + end, CenterLess(triCenters.data(), axis));
+        buildBvh(triBounds, triCenters, start, middle);//first child is always the next node
+        myNode.m_index = buildBvh(triBounds, triCenters, middle, end);
+        myNode.m_numTris = 0;
     }
+    m_bvhNodes[myIndex] = myNode;//don't keep a reference across the recursion, push_back may reallocate
+    return myIndex;
 }
 
 const float* SignedDistanceHelperBase::getCoordinate(const int32_t nodeIndex) const
@@ -22,9 +22,7 @@
 /*LICENSE_END*/
 
 #include "Vector3D.h"
-#include "CaretMutex.h"
 #include "CaretPointer.h"
-#include "OctTree.h"
 #include <vector>
 
 namespace caret {
@@ -34,29 +32,22 @@ namespace caret {
     
     class SignedDistanceHelperBase
     {
-        struct TriVector
-        {//specifically so we can cleanly deallocate the vector from non-leaf nodes when they split
-            std::vector<int32_t>* m_triList;
-            TriVector() { m_triList = new std::vector<int32_t>(); }
-            ~TriVector() { freeData(); }
-            void freeData()
-            {
-                if (m_triList != NULL)
-                {
-                    delete m_triList;
-                    m_triList = NULL;
-                }
-            }
+        struct BvhNode
+        {//nodes are stored depth first, so the first child of a node directly follows it
+            float m_minCoord[3], m_maxCoord[3];
+            int32_t m_index;//second child of an internal node, or first position in m_bvhTriangles of a leaf
+            int32_t m_numTris;//0 for internal nodes
         };
-        static const int NUM_TRIS_TO_TEST = 50;//test for whether to split leaf at this number
-        static const int NUM_TRIS_TEST_INCR = 50;//and again at further multiples of this
-        CaretPointer<Oct<TriVector> > m_indexRoot;
+        static const int MAX_LEAF_TRIS = 4;//split nodes with more triangles than this
+        static const int MAX_BVH_DEPTH = 64;//nodes are split at the median, so depth is at most log2(triangles) + 1
+        std::vector<BvhNode> m_bvhNodes;//flat bounding volume hierarchy, each triangle is in exactly one leaf, so queries need no scratch space to skip duplicates
+        std::vector<int32_t> m_bvhTriangles;//triangle indices in leaf order
         int32_t m_numTris, m_numNodes;
         std::vector<float> m_coordList;//make a copy of what we need from SurfaceFile so that if the SurfaceFile gets destroyed, we don't crash
         std::vector<int32_t> m_triangleList;
         CaretPointer<TopologyHelper> m_topoHelp;
         SignedDistanceHelperBase();
-        void addTriangle(Oct<TriVector>* thisOct, int32_t triangle, float minCoord[3], float maxCoord[3]);
+        int32_t buildBvh(const std::vector<float>& triBounds, const std::vector<float>& triCenters, const int32_t start, const int32_t end);
         const float* getCoordinate(const int32_t nodeIndex) const;//make these public? probably don't want them to be widely used, that is what SurfaceFile is for (but we don't want to store a SurfaceFile pointer)
         const int32_t* getTriangle(const int32_t tileIndex) const;
     public:
@@ -92,10 +83,7 @@ namespace caret {
             NORMALS
         };
     private:
-        CaretMutex m_mutex;
         CaretPointer<SignedDistanceHelperBase> m_base;
-        CaretArray<int> m_triMarked;
-        CaretArray<int> m_triMarkChanged;
         SignedDistanceHelper();
         struct ClosestPointInfo
         {
@@ -103,18 +91,27 @@ namespace caret {
             int32_t node1, node2, triangle;
             Vector3D tempPoint;
         };
-        float unsignedDistToTri(const float coord[3], int32_t triangle, ClosestPointInfo& myInfo);
-        int computeSign(const float coord[3], ClosestPointInfo myInfo, WindingLogic myWinding);
-        bool pointInTri(Vector3D verts[3], Vector3D inPlane, int majAxis, int midAxis);
+        static const int64_t QUERY_CHUNK_SIZE = 64;//batch queries are split into chunks of consecutive points, which share their previous answer as a starting bound
+        float findClosest(const float coord[3], const int32_t hintTriangle, ClosestPointInfo& bestInfo) const;
+        void closestToBarycentric(const ClosestPointInfo& bestInfo, const float bestTriDist, BarycentricInfo& baryInfoOut) const;
+        float unsignedDistToTri(const float coord[3], int32_t triangle, ClosestPointInfo& myInfo) const;
+        int computeSign(const float coord[3], ClosestPointInfo myInfo, WindingLogic myWinding) const;
+        bool pointInTri(Vector3D verts[3], Vector3D inPlane, int majAxis, int midAxis) const;
     public:
         SignedDistanceHelper(CaretPointer<SignedDistanceHelperBase> myBase);
         
-        ///return the signed distance value at the point
-        float dist(const float coord[3], WindingLogic myWinding);
+        ///return the signed distance value at the point, safe to call from several threads at once
+        float dist(const float coord[3], WindingLogic myWinding) const;
+        
+        ///compute the signed distance of many points (3 floats each) in parallel, faster when points that are near each other are near each other in the list
+        void dist(const float* coordsIn, const int64_t numCoords, WindingLogic myWinding, float* distOut) const;
         
         ///find the closest point ON the surface, and return information about it
         ///will never have negative barycentric weights, or a point outside the triangle
-        void barycentricWeights(const float coordIn[3], BarycentricInfo& baryInfoOut);
+        void barycentricWeights(const float coordIn[3], BarycentricInfo& baryInfoOut) const;
+        
+        ///find the closest points ON the surface to many points (3 floats each) in parallel
+        void barycentricWeights(const float* coordsIn, const int64_t numCoords, BarycentricInfo* baryInfoOut) const;
     };
 
 }
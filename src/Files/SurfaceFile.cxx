@@ -38,6 +38,7 @@
 #include "GiftiMetaDataXmlElements.h"
 #include "MathFunctions.h"
 #include "Matrix4x4.h"
+#include "ModificationCounter.h"
 #include "Vector3D.h"
 
 #include "CaretPointLocator.h"
@@ -502,6 +503,12 @@ SurfaceFile::initializeMembersSurfaceFile()
     m_geoHelperIndex = 0;
     m_topoHelperIndex = 0;
     m_normalsComputed = false;
+    m_geometryModificationCount = ModificationCounter::next();
+    for (int32_t i = 0; i < BrainConstants::MAXIMUM_NUMBER_OF_BROWSER_TABS; i++) {
+        m_surfaceNodeColoringModificationCount[i] = 0;
+        m_surfaceMontageNodeColoringModificationCount[i] = 0;
+        m_wholeBrainNodeColoringModificationCount[i] = 0;
+    }
 }
 
 /**
@@ -542,6 +549,7 @@ void
 SurfaceFile::invalidateNormals()
 {
     m_normalsComputed = false;
+    m_geometryModificationCount = ModificationCounter::next();
 }
 /**
  * Compute surface normals.
@@ -554,6 +562,7 @@ SurfaceFile::computeNormals()
         return;
     }
     m_normalsComputed = true;
+    m_geometryModificationCount = ModificationCounter::next();
     int32_t numCoords = this->getNumberOfNodes();
     if (numCoords > 0) {
         this->normalVectors.resize(numCoords * 3);
@@ -855,6 +864,7 @@ CaretPointer<SignedDistanceHelper> SurfaceFile::getSignedDistanceHelper() const
 
 void SurfaceFile::invalidateHelpers()
 {
+    m_geometryModificationCount = ModificationCounter::next();
     if (m_geoBase != NULL)
     {
         CaretMutexLocker myLock(&m_geoHelperMutex);//make this function threadsafe
@@ -985,6 +995,7 @@ SurfaceFile::applyMatrix(const Matrix4x4& matrix)
             matrix.multiplyPoint3(&coordinatePointer[i*3]);
         }
     }
+    m_geometryModificationCount = ModificationCounter::next();
     
     computeNormals();
     
@@ -1172,6 +1183,11 @@ int32_t SurfaceFile::closestNode(const float target[3], const float maxDist) con
     }
 }
 
+void SurfaceFile::closestNodes(const float* targets, const int64_t numTargets, int32_t* nodesOut, const float maxDist) const
+{
+    getPointLocator()->closestPoints(targets, numTargets, nodesOut, NULL, maxDist);
+}
+
 CaretPointer<const CaretPointLocator> SurfaceFile::getPointLocator() const
 {
     if (m_locator == NULL)//try to avoid locking even once
@@ -1450,6 +1466,7 @@ SurfaceFile::setSurfaceNodeColoringRgbaForBrowserTab(const int32_t browserTabInd
     for (int32_t i = 0; i < numberOfComponentsRGBA; i++) {
         rgba[i] = rgbaNodeColorComponents[i];
     }
+    m_surfaceNodeColoringModificationCount[browserTabIndex] = ModificationCounter::next();
 }
 
 /**
@@ -1497,6 +1514,7 @@ SurfaceFile::setSurfaceMontageNodeColoringRgbaForBrowserTab(const int32_t browse
     for (int32_t i = 0; i < numberOfComponentsRGBA; i++) {
         rgba[i] = rgbaNodeColorComponents[i];
     }
+    m_surfaceMontageNodeColoringModificationCount[browserTabIndex] = ModificationCounter::next();
 }
 
 
@@ -1544,6 +1562,54 @@ SurfaceFile::setWholeBrainNodeColoringRgbaForBrowserTab(const int32_t browserTab
     for (int32_t i = 0; i < numberOfComponentsRGBA; i++) {
         rgba[i] = rgbaNodeColorComponents[i];
     }
+    m_wholeBrainNodeColoringModificationCount[browserTabIndex] = ModificationCounter::next();
+}
+
+/**
+ * @return A count that changes whenever the coordinates, triangles, or
+ * normal vectors of this surface change.  Counts are unique among all
+ * surfaces, so drawing code may use the count to decide if data it has
+ * copied from this surface is still valid.
+ */
+int64_t
+SurfaceFile::getGeometryModificationCount() const
+{
+    return m_geometryModificationCount;
+}
+
+/**
+ * Get the modification count of node coloring returned by one of the
+ * get*NodeColoringRgbaForBrowserTab() methods.  The count changes whenever
+ * that coloring is replaced.
+ *
+ * @param rgbaNodeColorComponents
+ *    Pointer previously returned for node coloring of this surface.
+ * @return
+ *    Modification count of the coloring, or negative if the pointer is not
+ *    valid node coloring of this surface (such as after the coloring was
+ *    invalidated).
+ */
+int64_t
+SurfaceFile::getNodeColoringModificationCount(const float* rgbaNodeColorComponents) const
+{
+    if (rgbaNodeColorComponents == NULL) {
+        return -1;
+    }
+    for (int32_t i = 0; i < BrainConstants::MAXIMUM_NUMBER_OF_BROWSER_TABS; i++) {
+        if (( ! this->surfaceNodeColoringForBrowserTabs[i].empty())
+            && (rgbaNodeColorComponents == &this->surfaceNodeColoringForBrowserTabs[i][0])) {
+            return m_surfaceNodeColoringModificationCount[i];
+        }
+        if (( ! this->surfaceMontageNodeColoringForBrowserTabs[i].empty())
+            && (rgbaNodeColorComponents == &this->surfaceMontageNodeColoringForBrowserTabs[i][0])) {
+            return m_surfaceMontageNodeColoringModificationCount[i];
+        }
+        if (( ! this->wholeBrainNodeColoringForBrowserTabs[i].empty())
+            && (rgbaNodeColorComponents == &this->wholeBrainNodeColoringForBrowserTabs[i][0])) {
+            return m_wholeBrainNodeColoringModificationCount[i];
+        }
+    }
+    return -1;
 }
 
 /**
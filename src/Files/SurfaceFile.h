@@ -155,6 +155,9 @@ namespace caret {
         ///find the closest node on the surface, within maxDist if maxDist is positive
         int32_t closestNode(const float target[3], const float maxDist = -1.0f) const;
         
+        ///find the closest node for each of many targets (-1 where nothing is within maxDist, if maxDist is positive), uses multiple threads
+        void closestNodes(const float* targets, const int64_t numTargets, int32_t* nodesOut, const float maxDist = -1.0f) const;
+        
         virtual void setModified();
         
         AString getInformation() const;
@@ -173,6 +176,10 @@ namespace caret {
         
         void setWholeBrainNodeColoringRgbaForBrowserTab(const int32_t browserTabIndex,
                                               const float* rgbaNodeColorComponents);
+        
+        int64_t getGeometryModificationCount() const;
+        
+        int64_t getNodeColoringModificationCount(const float* rgbaNodeColorComponents) const;
 
         void invalidateNormals();
         
@@ -256,6 +263,16 @@ namespace caret {
         std::vector<float> normalVectors;
         
         bool m_normalsComputed;
+        
+        ///changes when coordinates, triangles, or normals change, for drawing code that caches them
+        int64_t m_geometryModificationCount;
+        
+        ///changes when the node coloring of the corresponding tab is replaced
+        int64_t m_surfaceNodeColoringModificationCount[BrainConstants::MAXIMUM_NUMBER_OF_BROWSER_TABS];
+        
+        int64_t m_surfaceMontageNodeColoringModificationCount[BrainConstants::MAXIMUM_NUMBER_OF_BROWSER_TABS];
+        
+        int64_t m_wholeBrainNodeColoringModificationCount[BrainConstants::MAXIMUM_NUMBER_OF_BROWSER_TABS];
 
         /** The node coloring. */
         std::vector<float> nodeColoring;
@@ -31,6 +31,7 @@
 #include "GeodesicHelper.h"
 #include "SignedDistanceHelper.h"
 #include "SurfaceFile.h"
+#include "SurfaceWeightCache.h"
 #include "TopologyHelper.h"
 #include "Vector3D.h"
 
@@ -44,6 +45,29 @@ SurfaceResamplingHelper::SurfaceResamplingHelper(const SurfaceResamplingMethodEn
                                                  const float* currentAreas, const float* newAreas, const float* currentRoi)
 {
     if (!checkSphere(currentSphere) || !checkSphere(newSphere)) throw CaretException("input surfaces to SurfaceResamplingHelper must be spheres");
+    CaretPointer<SurfaceWeightCache::Key> cacheKey;
+    if (SurfaceWeightCache::isEnabled())
+    {
+        cacheKey.grabNew(new SurfaceWeightCache::Key("surface_resampling"));
+        cacheKey->addValue((int32_t)myMethod);
+        cacheKey->addSurface(currentSphere);
+        cacheKey->addSurface(newSphere);
+        bool useAreas = (myMethod == SurfaceResamplingMethodEnum::ADAP_BARY_AREA && currentAreas != NULL && newAreas != NULL);
+        cacheKey->addValue((int32_t)useAreas);
+        if (useAreas)
+        {
+            cacheKey->addData(currentAreas, currentSphere->getNumberOfNodes() * sizeof(float));
+            cacheKey->addData(newAreas, newSphere->getNumberOfNodes() * sizeof(float));
+        }
+        cacheKey->addValue((int32_t)(currentRoi != NULL));
+        if (currentRoi != NULL) cacheKey->addData(currentRoi, currentSphere->getNumberOfNodes() * sizeof(float));
+        SurfaceWeightCache::WeightLists cached;
+        if (SurfaceWeightCache::load(*cacheKey, currentSphere->getNumberOfNodes(), cached) && (int64_t)cached.m_offsets.size() == (int64_t)newSphere->getNumberOfNodes() + 1)
+        {
+            fromCacheLists(cached);
+            return;
+        }
+    }
     SurfaceFile currentSphereMod, newSphereMod;
     changeRadius(100.0f, currentSphere, &currentSphereMod);
     changeRadius(100.0f, newSphere, &newSphereMod);
@@ -58,6 +82,12 @@ SurfaceResamplingHelper::SurfaceResamplingHelper(const SurfaceResamplingMethodEn
             computeWeightsBarycentric(&currentSphereMod, &newSphereMod, currentRoi);
             break;
     }
+    if (cacheKey != NULL)
+    {
+        SurfaceWeightCache::WeightLists toCache;
+        toCacheLists(toCache);
+        SurfaceWeightCache::store(*cacheKey, toCache);
+    }
 }
 
 void SurfaceResamplingHelper::resampleNormal(const float* input, float* output, const float& invalidVal) const
@@ -215,15 +245,8 @@ void SurfaceResamplingHelper::resampleCutSurface(const SurfaceFile* cutSurfaceIn
     cutCurSphere.setCoordinates(currentSphereMod.getCoordinateData());
     int newNodes = newSphere->getNumberOfNodes();
     vector<BarycentricInfo> newInfo(newSphere->getNumberOfNodes());
-#pragma omp CARET_PAR
-    {
-        CaretPointer<SignedDistanceHelper> mySignedHelp = cutCurSphere.getSignedDistanceHelper();
-#pragma omp CARET_FOR schedule(dynamic)
-        for (int i = 0; i < newNodes; ++i)
-        {
-            mySignedHelp->barycentricWeights(newSphereMod.getCoordinate(i), newInfo[i]);
-        }
-    }
+    CaretPointer<SignedDistanceHelper> mySignedHelp = cutCurSphere.getSignedDistanceHelper();
+    mySignedHelp->barycentricWeights(newSphereMod.getCoordinateData(), newNodes, newInfo.data());//runs in parallel
     vector<int> isOnEdge(newNodes, 0);//really used as bool, but avoid bitpacking so it can be modified in parallel
     CaretPointer<TopologyHelper> cutTopoHelp = cutSurfaceIn->getTopologyHelper();//because topology didn't change, and it might have one already - also, don't need separate helpers per thread, not using neighbors to depth
     CaretPointer<TopologyHelper> closedTopoHelp = currentSphere->getTopologyHelper();//ditto
@@ -557,6 +580,41 @@ void SurfaceResamplingHelper::compactWeights(const vector<map<int, float> >& wei
     m_weights[numNodes] = m_storagechunk + compactsize;
 }
 
+void SurfaceResamplingHelper::toCacheLists(SurfaceWeightCache::WeightLists& listsOut) const
+{
+    int64_t numNodes = m_weights.size() - 1;
+    int64_t numElems = m_weights[numNodes] - m_weights[0];
+    listsOut.m_offsets.resize(numNodes + 1);
+    listsOut.m_nodes.resize(numElems);
+    listsOut.m_weights.resize(numElems);
+    listsOut.m_rowValues.clear();
+    for (int64_t i = 0; i <= numNodes; ++i)
+    {
+        listsOut.m_offsets[i] = m_weights[i] - m_weights[0];
+    }
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        listsOut.m_nodes[i] = m_storagechunk[i].node;
+        listsOut.m_weights[i] = m_storagechunk[i].weight;
+    }
+}
+
+void SurfaceResamplingHelper::fromCacheLists(const SurfaceWeightCache::WeightLists& lists)
+{
+    int64_t numNodes = (int64_t)lists.m_offsets.size() - 1;
+    int64_t numElems = (int64_t)lists.m_nodes.size();
+    m_weights = CaretArray<WeightElem*>(numNodes + 1);
+    m_storagechunk = CaretArray<WeightElem>(numElems);
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        m_storagechunk[i] = WeightElem(lists.m_nodes[i], lists.m_weights[i]);
+    }
+    for (int64_t i = 0; i <= numNodes; ++i)
+    {
+        m_weights[i] = m_storagechunk + lists.m_offsets[i];
+    }
+}
+
 void SurfaceResamplingHelper::makeBarycentricWeights(const SurfaceFile* from, const SurfaceFile* to, vector<map<int, float> >& weights, const float* currentRoi)
 {
     int numToNodes = to->getNumberOfNodes();
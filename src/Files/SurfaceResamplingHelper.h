@@ -23,6 +23,7 @@
 
 #include "CaretPointer.h"
 #include "SurfaceResamplingMethodEnum.h"
+#include "SurfaceWeightCache.h"
 
 #include <map>
 #include <vector>
@@ -48,6 +49,8 @@ namespace caret {
         void computeWeightsBarycentric(const SurfaceFile* currentSphere, const SurfaceFile* newSphere, const float* currentRoi);
         static void makeBarycentricWeights(const SurfaceFile* from, const SurfaceFile* to, std::vector<std::map<int, float> >& weights, const float* currentRoi);
         void compactWeights(const std::vector<std::map<int, float> >& weights);
+        void toCacheLists(SurfaceWeightCache::WeightLists& listsOut) const;
+        void fromCacheLists(const SurfaceWeightCache::WeightLists& lists);
     public:
         SurfaceResamplingHelper() { }
         SurfaceResamplingHelper(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
@@ -0,0 +1,195 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "SurfaceWeightCache.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "PerformanceStatistics.h"
+#include "SurfaceFile.h"
+
+#include <QDir>
+#include <QFile>
+#include <QProcessEnvironment>
+#include <QTemporaryFile>
+
+#include <cstring>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const char CACHE_MAGIC[8] = { 'W', 'B', 'W', 'E', 'I', 'G', 'H', 'T' };
+    const int32_t CACHE_VERSION = 1;
+    const int32_t CACHE_BYTE_ORDER = 0x01020304;//files are native byte order, a file from a different endianness just doesn't match
+    
+    struct CacheHeader
+    {//all int64 after the first 16 bytes, so the arrays that follow are naturally aligned
+        char m_magic[8];
+        int32_t m_version;
+        int32_t m_byteOrder;
+        int64_t m_numRows;
+        int64_t m_numElems;
+        int64_t m_numRowValues;
+    };
+    
+    AString getCacheDirectory()
+    {
+        return QProcessEnvironment::systemEnvironment().value("WORKBENCH_WEIGHT_CACHE_DIR");
+    }
+    
+    int64_t getExpectedFileSize(const CacheHeader& header)
+    {
+        return sizeof(CacheHeader) + (header.m_numRows + 1) * sizeof(int64_t) + header.m_numElems * (sizeof(int32_t) + sizeof(float)) + header.m_numRowValues * sizeof(float);
+    }
+    
+    template <typename T>
+    bool readArray(QFile& file, vector<T>& data)
+    {
+        int64_t numBytes = (int64_t)(data.size() * sizeof(T));
+        return numBytes == 0 || file.read((char*)data.data(), numBytes) == numBytes;
+    }
+}
+
+SurfaceWeightCache::Key::Key(const AString& kind) : m_hash(QCryptographicHash::Sha1), m_kind(kind)
+{
+    QByteArray kindBytes = kind.toUtf8();
+    addData(kindBytes.constData(), kindBytes.size() + 1);//include the terminator so that the kind can't run into the following data
+    addValue(CACHE_VERSION);
+}
+
+void SurfaceWeightCache::Key::addData(const void* data, const int64_t& numBytes)
+{
+    CaretAssert(numBytes >= 0);
+    const char* charData = (const char*)data;
+    const int64_t MAX_CHUNK = 1 << 30;//addData takes int
+    for (int64_t start = 0; start < numBytes; start += MAX_CHUNK)
+    {
+        m_hash.addData(charData + start, (int)min(MAX_CHUNK, numBytes - start));
+    }
+}
+
+void SurfaceWeightCache::Key::addSurface(const SurfaceFile* surface)
+{
+    int32_t numNodes = surface->getNumberOfNodes();
+    int32_t numTiles = surface->getNumberOfTriangles();
+    addValue(numNodes);
+    addValue(numTiles);
+    addData(surface->getCoordinateData(), numNodes * 3 * sizeof(float));
+    for (int32_t i = 0; i < numTiles; ++i)
+    {
+        addData(surface->getTriangle(i), 3 * sizeof(int32_t));
+    }
+}
+
+AString SurfaceWeightCache::Key::getFileName() const
+{
+    return m_kind + "_" + AString(m_hash.result().toHex()) + ".wbweights";
+}
+
+bool SurfaceWeightCache::isEnabled()
+{
+    AString dir = getCacheDirectory();
+    return !dir.isEmpty() && QDir(dir).exists();
+}
+
+bool SurfaceWeightCache::load(const Key& key, const int32_t& numNodes, WeightLists& listsOut)
+{
+    if (!isEnabled()) return false;
+    QFile myFile(getCacheDirectory() + "/" + key.getFileName());
+    if (!myFile.exists() || !myFile.open(QIODevice::ReadOnly)) return false;
+    CacheHeader header;
+    bool ret = (myFile.read((char*)&header, sizeof(CacheHeader)) == sizeof(CacheHeader)) &&
+               memcmp(header.m_magic, CACHE_MAGIC, 8) == 0 && header.m_version == CACHE_VERSION && header.m_byteOrder == CACHE_BYTE_ORDER &&
+               header.m_numRows >= 0 && header.m_numElems >= 0 && header.m_numRowValues >= 0 && getExpectedFileSize(header) == myFile.size();
+    WeightLists lists;
+    if (ret)
+    {//read straight into the arrays, callers copy into their own layout anyway
+        lists.m_offsets.resize(header.m_numRows + 1);
+        lists.m_nodes.resize(header.m_numElems);
+        lists.m_weights.resize(header.m_numElems);
+        lists.m_rowValues.resize(header.m_numRowValues);
+        ret = readArray(myFile, lists.m_offsets) && readArray(myFile, lists.m_nodes) && readArray(myFile, lists.m_weights) && readArray(myFile, lists.m_rowValues);
+    }
+    if (PerformanceStatistics::isEnabled()) PerformanceStatistics::addBytesRead(myFile.pos());//QFile reads aren't counted by CaretBinaryFile
+    if (ret)
+    {//callers index with these, so a damaged file must not make them read out of bounds
+        ret = (lists.m_offsets[0] == 0 && lists.m_offsets[header.m_numRows] == header.m_numElems);
+        for (int64_t i = 0; ret && i < header.m_numRows; ++i)
+        {
+            if (lists.m_offsets[i + 1] < lists.m_offsets[i]) ret = false;
+        }
+        for (int64_t i = 0; ret && i < header.m_numElems; ++i)
+        {
+            if (lists.m_nodes[i] < 0 || lists.m_nodes[i] >= numNodes) ret = false;
+        }
+    }
+    if (ret)
+    {
+        CaretLogFine("using cached weights from " + myFile.fileName());
+        listsOut.m_offsets.swap(lists.m_offsets);
+        listsOut.m_nodes.swap(lists.m_nodes);
+        listsOut.m_weights.swap(lists.m_weights);
+        listsOut.m_rowValues.swap(lists.m_rowValues);
+    } else {
+        CaretLogWarning("ignoring invalid weight cache file " + myFile.fileName());
+    }
+    return ret;
+}
+
+void SurfaceWeightCache::store(const Key& key, const WeightLists& lists)
+{
+    if (!isEnabled()) return;
+    CaretAssert(!lists.m_offsets.empty());
+    CaretAssert(lists.m_nodes.size() == lists.m_weights.size());
+    CaretAssert(lists.m_offsets.back() == (int64_t)lists.m_nodes.size());
+    AString fileName = getCacheDirectory() + "/" + key.getFileName();
+    CacheHeader header;
+    memcpy(header.m_magic, CACHE_MAGIC, 8);
+    header.m_version = CACHE_VERSION;
+    header.m_byteOrder = CACHE_BYTE_ORDER;
+    header.m_numRows = (int64_t)lists.m_offsets.size() - 1;
+    header.m_numElems = (int64_t)lists.m_nodes.size();
+    header.m_numRowValues = (int64_t)lists.m_rowValues.size();
+    QTemporaryFile tempFile(fileName + ".XXXXXX");//write elsewhere and rename, so other processes never see a partial file
+    if (!tempFile.open())
+    {
+        CaretLogWarning("unable to create file in weight cache directory '" + getCacheDirectory() + "'");
+        return;
+    }
+    bool ok = tempFile.write((const char*)&header, sizeof(CacheHeader)) == sizeof(CacheHeader);
+    ok = ok && tempFile.write((const char*)lists.m_offsets.data(), lists.m_offsets.size() * sizeof(int64_t)) == (int64_t)(lists.m_offsets.size() * sizeof(int64_t));
+    ok = ok && tempFile.write((const char*)lists.m_nodes.data(), lists.m_nodes.size() * sizeof(int32_t)) == (int64_t)(lists.m_nodes.size() * sizeof(int32_t));
+    ok = ok && tempFile.write((const char*)lists.m_weights.data(), lists.m_weights.size() * sizeof(float)) == (int64_t)(lists.m_weights.size() * sizeof(float));
+    ok = ok && tempFile.write((const char*)lists.m_rowValues.data(), lists.m_rowValues.size() * sizeof(float)) == (int64_t)(lists.m_rowValues.size() * sizeof(float));
+    ok = ok && tempFile.flush();
+    if (!ok)
+    {
+        CaretLogWarning("error writing weight cache file '" + tempFile.fileName() + "'");
+        return;//QTemporaryFile removes it
+    }
+    tempFile.close();
+    if (QFile::rename(tempFile.fileName(), fileName))
+    {
+        tempFile.setAutoRemove(false);
+    }//if the rename failed, another process most likely wrote the same weights first, so let the temporary file get removed
+}
@@ -0,0 +1,79 @@
+#ifndef __SURFACE_WEIGHT_CACHE_H__
+#define __SURFACE_WEIGHT_CACHE_H__
+
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+
+#include <QCryptographicHash>
+
+#include <vector>
+#include <stdint.h>
+
+//NOTE: the cache is only used when the WORKBENCH_WEIGHT_CACHE_DIR environment variable is set to an existing directory.  Files in it are named by a hash of everything
+//      that went into computing the weights, so there is no invalidation - a changed surface, kernel, ROI, etc simply produces a different file name.  Deleting the
+//      directory contents at any time is safe.
+
+namespace caret {
+    
+    class SurfaceFile;
+    
+    class SurfaceWeightCache
+    {
+    public:
+        ///per-node weight lists in compact form, the same layout as the file
+        struct WeightLists
+        {
+            std::vector<int64_t> m_offsets;//row i uses [m_offsets[i], m_offsets[i + 1])
+            std::vector<int32_t> m_nodes;
+            std::vector<float> m_weights;
+            std::vector<float> m_rowValues;//optional extra value per row, like a precomputed weight sum
+        };
+        
+        class Key
+        {
+            QCryptographicHash m_hash;
+            AString m_kind;
+            Key();
+            Key(const Key&);
+            Key& operator=(const Key&);
+        public:
+            explicit Key(const AString& kind);//kind should be a short identifier for what is being computed, it is used in the filename
+            void addData(const void* data, const int64_t& numBytes);
+            void addValue(const int32_t& value) { addData(&value, sizeof(int32_t)); }
+            void addValue(const float& value) { addData(&value, sizeof(float)); }
+            void addSurface(const SurfaceFile* surface);//coordinates and topology
+            AString getFileName() const;
+        };
+        
+        static bool isEnabled();
+        
+        ///returns false if there is no valid cache file for this key - nodes are checked to be in [0, numNodes)
+        static bool load(const Key& key, const int32_t& numNodes, WeightLists& listsOut);
+        
+        ///failure to write only logs a warning, the cache is never required
+        static void store(const Key& key, const WeightLists& lists);
+    };
+    
+}
+
+#endif //__SURFACE_WEIGHT_CACHE_H__
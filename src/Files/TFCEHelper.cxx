@@ -0,0 +1,248 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "TFCEHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "SurfaceFile.h"
+#include "TopologyHelper.h"
+#include "Vector3D.h"
+#include "VolumeSpace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+using namespace caret;
+using namespace std;
+
+TFCEHelper::TFCEHelper(const SurfaceFile* mySurf, const float* areaData, const float* roiData)
+{
+    CaretAssert(mySurf != NULL && areaData != NULL);
+    m_numElements = mySurf->getNumberOfNodes();
+    CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();
+    m_neighborOffsets.resize(m_numElements + 1);
+    m_neighborOffsets[0] = 0;
+    for (int32_t i = 0; i < m_numElements; ++i)
+    {
+        const vector<int32_t>& neighbors = myTopoHelp->getNodeNeighbors(i);
+        if (roiData == NULL || roiData[i] > 0.0f)
+        {
+            for (int j = 0; j < (int)neighbors.size(); ++j)
+            {
+                if (roiData == NULL || roiData[neighbors[j]] > 0.0f) m_neighbors.push_back(neighbors[j]);
+            }
+        }
+        m_neighborOffsets[i + 1] = m_neighbors.size();
+    }
+    m_measures.assign(areaData, areaData + m_numElements);
+    finishConstruction(roiData);
+}
+
+TFCEHelper::TFCEHelper(const VolumeSpace& mySpace, const float* roiData)
+{
+    const int64_t* dims = mySpace.getDims();
+    int64_t frameSize = dims[0] * dims[1] * dims[2];
+    if (frameSize > numeric_limits<int32_t>::max()) throw CaretException("volume frame is too large for TFCE");
+    m_numElements = (int32_t)frameSize;
+    Vector3D ivec, jvec, kvec, origin;//compute the volume of a voxel so different resolutions have comparable values
+    mySpace.getSpacingVectors(ivec, jvec, kvec, origin);
+    m_measures.resize(m_numElements, abs(ivec.dot(jvec.cross(kvec))));
+    m_neighborOffsets.resize(m_numElements + 1);
+    m_neighborOffsets[0] = 0;
+    m_neighbors.reserve(frameSize * 6);
+    const int64_t stride[3] = { 1, dims[0], dims[0] * dims[1] };
+    int64_t index = 0;
+    for (int64_t k = 0; k < dims[2]; ++k)
+    {
+        for (int64_t j = 0; j < dims[1]; ++j)
+        {
+            for (int64_t i = 0; i < dims[0]; ++i, ++index)
+            {
+                if (roiData == NULL || roiData[index] > 0.0f)
+                {
+                    const int64_t ijk[3] = { i, j, k };
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        for (int dir = -1; dir <= 1; dir += 2)
+                        {
+                            int64_t neighCoord = ijk[axis] + dir;
+                            if (neighCoord < 0 || neighCoord >= dims[axis]) continue;
+                            int64_t neighIndex = index + dir * stride[axis];
+                            if (roiData == NULL || roiData[neighIndex] > 0.0f) m_neighbors.push_back((int32_t)neighIndex);
+                        }
+                    }
+                }
+                m_neighborOffsets[index + 1] = m_neighbors.size();
+            }
+        }
+    }
+    vector<int32_t>(m_neighbors).swap(m_neighbors);//shrink to fit, ROIs can make the reserve far too large
+    finishConstruction(roiData);
+}
+
+void TFCEHelper::finishConstruction(const float* roiData)
+{
+    m_inRoi.resize(m_numElements, 1);
+    if (roiData != NULL)
+    {
+        for (int32_t i = 0; i < m_numElements; ++i)
+        {
+            m_inRoi[i] = (roiData[i] > 0.0f ? 1 : 0);
+        }
+    }
+}
+
+void TFCEHelper::computeTFCE(const float* dataIn, float* dataOut, const float& param_e, const float& param_h) const
+{
+    Workspace work;
+    computeInternal(work, dataIn, dataOut, param_e, param_h);
+}
+
+void TFCEHelper::computeTFCE(const vector<const float*>& dataIn, const vector<float*>& dataOut, const float& param_e, const float& param_h) const
+{
+    CaretAssert(dataIn.size() == dataOut.size());
+    int64_t numMaps = (int64_t)dataIn.size();
+#pragma omp CARET_PAR
+    {
+        Workspace work;//allocated once per thread, reused for every map
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t i = 0; i < numMaps; ++i)
+        {
+            computeInternal(work, dataIn[i], dataOut[i], param_e, param_h);
+        }
+    }
+}
+
+int32_t TFCEHelper::findRoot(Workspace& work, const int32_t& element) const
+{//path compression, folding the offsets along the path into each compressed element
+    work.m_path.clear();
+    int32_t root = element;
+    while (work.m_parent[root] != root)
+    {
+        work.m_path.push_back(root);
+        root = work.m_parent[root];
+    }
+    if (work.m_path.size() > 1)
+    {
+        double pathOffset = 0.0;//offset from the element to root, excluding root
+        for (int64_t i = (int64_t)work.m_path.size() - 1; i >= 0; --i)
+        {
+            int32_t current = work.m_path[i];
+            pathOffset += work.m_offset[current];
+            work.m_offset[current] = pathOffset;
+            work.m_parent[current] = root;
+        }
+    }
+    return root;
+}
+
+void TFCEHelper::updateCluster(Workspace& work, const int32_t& root, const float& bottomVal, const float& param_e, const float& param_h)
+{
+    float& lastVal = work.m_lastVal[root];
+    if (bottomVal != lastVal)//skip computing if there is no difference
+    {
+        CaretAssert(bottomVal < lastVal);
+        double integrated_h = param_h + 1.0f;//integral(x^h) = (x^(h + 1))/(h + 1) + C
+        work.m_accum[root] += pow(work.m_size[root], (double)param_e) * (pow((double)lastVal, integrated_h) - pow((double)bottomVal, integrated_h)) / integrated_h;
+        lastVal = bottomVal;//computing in double precision, with float for inputs, puts the smallest difference between values far greater than the instability of the computation
+    }
+}
+
+void TFCEHelper::computeInternal(Workspace& work, const float* dataIn, float* dataOut, const float& param_e, const float& param_h) const
+{//visit elements from largest magnitude down, positive and negative clusters never touch each other, so do both in one pass
+    work.m_order.clear();
+    for (int32_t i = 0; i < m_numElements; ++i)
+    {
+        if (m_inRoi[i] && dataIn[i] != 0.0f && dataIn[i] == dataIn[i])
+        {
+            work.m_order.push_back(pair<float, int32_t>(abs(dataIn[i]), i));
+        }
+    }
+    sort(work.m_order.begin(), work.m_order.end(), greater<pair<float, int32_t> >());
+    work.m_parent.assign(m_numElements, -1);
+    work.m_offset.resize(m_numElements);
+    work.m_accum.resize(m_numElements);
+    work.m_size.resize(m_numElements);
+    work.m_lastVal.resize(m_numElements);
+    int64_t numActive = (int64_t)work.m_order.size();
+    for (int64_t index = 0; index < numActive; ++index)
+    {
+        float value = work.m_order[index].first;
+        int32_t element = work.m_order[index].second;
+        bool positive = dataIn[element] > 0.0f;
+        work.m_touching.clear();
+        for (int64_t j = m_neighborOffsets[element]; j < m_neighborOffsets[element + 1]; ++j)
+        {
+            int32_t neighbor = m_neighbors[j];
+            if (work.m_parent[neighbor] != -1 && (dataIn[neighbor] > 0.0f) == positive)
+            {
+                int32_t root = findRoot(work, neighbor);
+                if (find(work.m_touching.begin(), work.m_touching.end(), root) == work.m_touching.end()) work.m_touching.push_back(root);
+            }
+        }
+        int32_t mergedRoot = element;
+        if (work.m_touching.empty())
+        {//new cluster
+            work.m_accum[element] = 0.0;
+            work.m_size[element] = 0.0;
+            work.m_lastVal[element] = value;
+        } else {
+            mergedRoot = work.m_touching[0];//use the biggest cluster as the root, for shorter paths
+            for (size_t j = 1; j < work.m_touching.size(); ++j)
+            {
+                if (work.m_size[work.m_touching[j]] > work.m_size[mergedRoot]) mergedRoot = work.m_touching[j];
+            }
+            updateCluster(work, mergedRoot, value, param_e, param_h);
+            for (size_t j = 0; j < work.m_touching.size(); ++j)
+            {
+                int32_t otherRoot = work.m_touching[j];
+                if (otherRoot == mergedRoot) continue;
+                updateCluster(work, otherRoot, value, param_e, param_h);//align the cluster bottoms
+                work.m_parent[otherRoot] = mergedRoot;//attach the whole cluster, offset it so its members keep their integral so far
+                work.m_offset[otherRoot] = work.m_accum[otherRoot] - work.m_accum[mergedRoot];
+                work.m_size[mergedRoot] += work.m_size[otherRoot];
+            }
+        }
+        work.m_parent[element] = mergedRoot;
+        work.m_offset[element] = (mergedRoot == element ? 0.0 : -work.m_accum[mergedRoot]);//element only gets the integral from its own value downwards
+        work.m_size[mergedRoot] += m_measures[element];
+    }
+    for (int32_t i = 0; i < m_numElements; ++i)
+    {
+        if (work.m_parent[i] == i) updateCluster(work, i, 0.0f, param_e, param_h);//include the to-zero slice
+    }
+    for (int32_t i = 0; i < m_numElements; ++i)
+    {
+        if (work.m_parent[i] == -1)
+        {
+            dataOut[i] = 0.0f;
+        } else {
+            int32_t root = findRoot(work, i);
+            double result = work.m_accum[root];
+            if (i != root) result += work.m_offset[i];
+            dataOut[i] = (float)(dataIn[i] > 0.0f ? result : -result);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef __TFCE_HELPER_H__
+#define __TFCE_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+//NOTE: the neighbor lists and element measures are computed once in the constructor, and all compute methods are const, so one instance can score many maps
+//      concurrently, as is needed for permutation testing
+
+namespace caret {
+    
+    class SurfaceFile;
+    class VolumeSpace;
+    
+    class TFCEHelper
+    {
+        std::vector<int64_t> m_neighborOffsets;//neighbors of element i are in [m_neighborOffsets[i], m_neighborOffsets[i + 1])
+        std::vector<int32_t> m_neighbors;
+        std::vector<float> m_measures;//area or volume of each element
+        std::vector<char> m_inRoi;
+        int32_t m_numElements;
+        struct Workspace
+        {
+            std::vector<std::pair<float, int32_t> > m_order;
+            std::vector<int32_t> m_parent;//union-find forest, -1 for elements not yet reached
+            std::vector<double> m_offset;//integral offset relative to parent, so per-element values never need updating on merge
+            std::vector<double> m_accum, m_size;//cluster integral and total measure, only valid at roots
+            std::vector<float> m_lastVal;//value the cluster integral has been computed down to, only valid at roots
+            std::vector<int32_t> m_touching, m_path;
+        };
+        void computeInternal(Workspace& work, const float* dataIn, float* dataOut, const float& param_e, const float& param_h) const;
+        int32_t findRoot(Workspace& work, const int32_t& element) const;
+        static void updateCluster(Workspace& work, const int32_t& root, const float& bottomVal, const float& param_e, const float& param_h);
+        void finishConstruction(const float* roiData);
+    public:
+        ///vertex neighbors from the surface topology, vertex areas from areaData, which should usually be the vertex areas of the surface
+        TFCEHelper(const SurfaceFile* mySurf, const float* areaData, const float* roiData = NULL);
+        ///face neighbors (6-connected) in a single frame of the volume space, voxel volume as the measure
+        explicit TFCEHelper(const VolumeSpace& mySpace, const float* roiData = NULL);
+        int32_t getNumberOfElements() const { return m_numElements; }
+        ///positive and negative values are enhanced separately, negative inputs give negative outputs, outside the roi the output is zero
+        void computeTFCE(const float* dataIn, float* dataOut, const float& param_e, const float& param_h) const;
+        ///compute many maps in parallel, for example permutations of the same data - same results as calling computeTFCE on each
+        void computeTFCE(const std::vector<const float*>& dataIn, const std::vector<float*>& dataOut, const float& param_e, const float& param_h) const;
+    };
+    
+}
+
+#endif //__TFCE_HELPER_H__
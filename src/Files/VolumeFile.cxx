@@ -41,6 +41,7 @@
 #include "VolumeFile.h"
 #include "VolumeFileEditorDelegate.h"
 #include "VolumeFileVoxelColorizer.h"
+#include "VolumeInterpolationTable.h"
 #include "VolumeSpline.h"
 
 #include <limits>
@@ -287,17 +288,7 @@ VolumeFile::writeFile(const AString& filename)
         throw DataFileException(filename,
                                 "writing multi-component volumes is not currently supported");//its a hassle, and uncommon, and there is only one 3-component type, restricted to 0-255
     }
-    updateCaretExtension();
-    
-    NiftiHeader outHeader;//begin nifti-specific code
-    if (m_header != NULL && (m_header->getType() == AbstractHeader::NIFTI))
-    {
-        outHeader = *((NiftiHeader*)m_header.getPointer());//also shallow copies extensions
-    }
-    outHeader.clearDataScaling();
-    outHeader.setSForm(getVolumeSpace().getSform());
-    outHeader.setDimensions(getOriginalDimensions());
-    outHeader.setDataType(NIFTI_TYPE_FLOAT32);
+    NiftiHeader outHeader = getHeaderForWriting(getOriginalDimensions());//begin nifti-specific code
     NiftiIO myIO;
     int outVersion = 1;
     if (!outHeader.canWriteVersion(1)) outVersion = 2;
@@ -318,6 +309,34 @@ VolumeFile::writeFile(const AString& filename)
     m_volumeFileEditorDelegate->updateIfVolumeFileChangedNumberOfMaps();
 }
 
+void VolumeFile::openFileForWritingFrames(NiftiIO& writer, const AString& filename, const vector<int64_t>& dimensions, const vector<vector<float> >& sform)
+{
+    CaretAssert(dimensions.size() >= 3);
+    vector<int64_t> headerDims(3, 1);//the caret extension only depends on the number of maps, so use a volume with single voxel frames to build it
+    headerDims.insert(headerDims.end(), dimensions.begin() + 3, dimensions.end());
+    VolumeFile headerVolume(headerDims, sform);
+    headerVolume.checkFileWritability(filename);
+    NiftiHeader outHeader = headerVolume.getHeaderForWriting(dimensions);
+    int outVersion = 1;
+    if (!outHeader.canWriteVersion(1)) outVersion = 2;
+    writer.writeNew(filename, outHeader, outVersion);
+}
+
+NiftiHeader VolumeFile::getHeaderForWriting(const vector<int64_t>& dimensions)
+{
+    updateCaretExtension();
+    NiftiHeader outHeader;
+    if (m_header != NULL && (m_header->getType() == AbstractHeader::NIFTI))
+    {
+        outHeader = *((NiftiHeader*)m_header.getPointer());//also shallow copies extensions
+    }
+    outHeader.clearDataScaling();
+    outHeader.setSForm(getVolumeSpace().getSform());
+    outHeader.setDimensions(dimensions);
+    outHeader.setDataType(NIFTI_TYPE_FLOAT32);
+    return outHeader;
+}
+
 float VolumeFile::interpolateValue(const float* coordIn, InterpType interp, bool* validOut, const int64_t brickIndex, const int64_t component) const
 {
     return interpolateValue(coordIn[0], coordIn[1], coordIn[2], interp, validOut, brickIndex, component);
@@ -401,6 +420,32 @@ float VolumeFile::interpolateValue(const float coordIn1, const float coordIn2, c
     return INVALID_INTERP_VALUE;
 }
 
+void VolumeFile::interpolateValues(const VolumeInterpolationTable& table, float* valuesOut, const int64_t brickIndex, const int64_t component) const
+{
+    const int64_t* dimensions = getDimensionsPtr();
+    CaretAssert(table.getFrameSize() == dimensions[0] * dimensions[1] * dimensions[2]);
+    if (table.getInterpolationType() == CUBIC)
+    {
+        validateSpline(brickIndex, component);
+        table.sample(m_frameSplines[component * dimensions[3] + brickIndex].getCoefficients(), valuesOut);
+    } else {
+        table.sample(getFrame(brickIndex, component), valuesOut);
+    }
+}
+
+void VolumeFile::interpolateValues(const float* coordsIn, const int64_t& numCoords, float* valuesOut, InterpType interp, bool* validOut, const int64_t brickIndex, const int64_t component) const
+{
+    VolumeInterpolationTable myTable(getVolumeSpace(), coordsIn, numCoords, interp);
+    interpolateValues(myTable, valuesOut, brickIndex, component);
+    if (validOut != NULL)
+    {
+        for (int64_t i = 0; i < numCoords; ++i)
+        {
+            validOut[i] = myTable.isValid(i);
+        }
+    }
+}
+
 void VolumeFile::validateSpline(const int64_t brickIndex, const int64_t component) const
 {
     const int64_t* dimensions = getDimensionsPtr();
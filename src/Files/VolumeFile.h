@@ -38,8 +38,11 @@
 namespace caret {
     
     class GroupAndNameHierarchyModel;
+    struct NiftiHeader;
+    class NiftiIO;
     class VolumeFileEditorDelegate;
     class VolumeFileVoxelColorizer;
+    class VolumeInterpolationTable;
     class VolumeSpline;
     
     class VolumeFile : public VolumeBase, public CaretMappableDataFile, public ChartableLineSeriesBrainordinateInterface
@@ -56,6 +59,8 @@ namespace caret {
         
         void updateCaretExtension();//called before writing a file, erases all existing caret extensions from m_extensions, and rebuilds one from m_caretVolExt
         
+        NiftiHeader getHeaderForWriting(const std::vector<int64_t>& dimensions);//updates the caret extension, and sets sform, dimensions and datatype for writing
+        
         void checkStatisticsValid();
         
         struct BrickAttributes//for storing ONLY stuff that doesn't get saved to the caret extension
@@ -160,6 +165,13 @@ namespace caret {
 
         float interpolateValue(const float coordIn1, const float coordIn2, const float coordIn3, InterpType interp = TRILINEAR, bool* validOut = NULL, const int64_t brickIndex = 0, const int64_t component = 0) const;
 
+        ///sample all points of a precomputed table from one frame, same results as interpolateValue, but the weights are computed only once for all frames
+        void interpolateValues(const VolumeInterpolationTable& table, float* valuesOut, const int64_t brickIndex = 0, const int64_t component = 0) const;
+
+        ///coordsIn is numCoords interleaved xyz triples, validOut (if not NULL) must have numCoords elements
+        void interpolateValues(const float* coordsIn, const int64_t& numCoords, float* valuesOut, InterpType interp = TRILINEAR, bool* validOut = NULL,
+                               const int64_t brickIndex = 0, const int64_t component = 0) const;
+
         ///returns true if volume space matches in spatial dimensions and sform
         bool matchesVolumeSpace(const VolumeFile* right) const;
         
@@ -172,6 +184,9 @@ namespace caret {
         void readFile(const AString& filename);
 
         void writeFile(const AString& filename);
+        
+        ///open a file to write a volume one frame at a time without holding it in memory, with the same header and caret extension writeFile() would write
+        static void openFileForWritingFrames(NiftiIO& writer, const AString& filename, const std::vector<int64_t>& dimensions, const std::vector<std::vector<float> >& sform);
 
         bool isEmpty() const { return VolumeBase::isEmpty(); }
         
@@ -0,0 +1,470 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeInterpolationTable.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CubicSpline.h"
+#include "DataFileException.h"
+#include "MappedFileRegion.h"
+#include "PerformanceStatistics.h"
+#include "VolumeSpace.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const char TABLE_MAGIC[8] = { 'W', 'B', 'I', 'N', 'T', 'E', 'R', 'P' };
+    const int32_t TABLE_VERSION = 2;
+    const int32_t TABLE_BYTE_ORDER = 0x01020304;//files are native byte order, a file from a different endianness just doesn't match
+    const int TABLE_IDENTIFIER_SIZE = 24;//enough for a sha1 hash, and keeps the header a multiple of 8 bytes
+    
+    struct TableHeader
+    {
+        char m_magic[8];
+        int32_t m_version;
+        int32_t m_byteOrder;
+        char m_identifier[TABLE_IDENTIFIER_SIZE];
+        int32_t m_interp;
+        int32_t m_taps;
+        int64_t m_numPoints;
+        int64_t m_frameSize;
+        int32_t m_offsetBytes;//4 or 8
+        int32_t m_padding;//keep the arrays 8 byte aligned
+    };
+    
+    void setIdentifier(char* dest, const QByteArray& identifier)
+    {
+        memset(dest, 0, TABLE_IDENTIFIER_SIZE);
+        memcpy(dest, identifier.constData(), min(identifier.size(), TABLE_IDENTIFIER_SIZE));
+    }
+    
+    template <typename T>
+    bool offsetsInFrame(const T* offsets, const int64_t& numPoints, const int& taps, const int64_t& frameSize)
+    {//make sure every tap stays inside the frame, so a bad file can't make us read out of bounds
+        int64_t pointStride = 3 * taps;
+        for (int64_t point = 0; point < numPoints; ++point)
+        {
+            int64_t maxIndex = 0;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const T* axisOffsets = offsets + point * pointStride + axis * taps;
+                int64_t axisMax = 0;
+                for (int tap = 0; tap < taps; ++tap)
+                {
+                    if (axisOffsets[tap] < 0) return false;
+                    axisMax = max(axisMax, (int64_t)axisOffsets[tap]);
+                }
+                maxIndex += axisMax;
+            }
+            if (maxIndex >= frameSize) return false;
+        }
+        return true;
+    }
+    
+    template <typename T>
+    bool findSourceRegion(const T* offsets, const char* valid, const int64_t& numPoints, const int& taps, const int64_t stride[3], int64_t startOut[3], int64_t endOut[3])
+    {
+        int64_t pointStride = 3 * taps;
+        bool found = false;
+        for (int64_t point = 0; point < numPoints; ++point)
+        {
+            if (!valid[point]) continue;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const T* axisOffsets = offsets + point * pointStride + axis * taps;
+                for (int tap = 0; tap < taps; ++tap)
+                {
+                    int64_t index = axisOffsets[tap] / stride[axis];
+                    if (!found || index < startOut[axis]) startOut[axis] = index;
+                    if (!found || index + 1 > endOut[axis]) endOut[axis] = index + 1;
+                }
+            }
+            found = true;
+        }
+        return found;
+    }
+    
+    template <typename T>
+    void rebaseOffsets(T* offsets, const char* valid, const int64_t& numPoints, const int& taps, const int64_t stride[3], const int64_t boxStart[3], const int64_t boxStride[3])
+    {
+        int64_t pointStride = 3 * taps;
+#pragma omp CARET_PARFOR schedule(static)
+        for (int64_t point = 0; point < numPoints; ++point)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                T* axisOffsets = offsets + point * pointStride + axis * taps;
+                for (int tap = 0; tap < taps; ++tap)
+                {
+                    if (valid[point])
+                    {
+                        CaretAssert(axisOffsets[tap] / stride[axis] >= boxStart[axis]);
+                        axisOffsets[tap] = (T)((axisOffsets[tap] / stride[axis] - boxStart[axis]) * boxStride[axis]);
+                    } else {
+                        axisOffsets[tap] = 0;
+                    }
+                }
+            }
+        }
+    }
+    
+    template <int TAPS, typename T>
+    inline float gatherSeparable(const float* data, const T* offsets, const float* weights)
+    {//same order of operations as the per-point code, i first, then j, then k, so results are identical
+        const T* ioffs = offsets, *joffs = offsets + TAPS, *koffs = offsets + 2 * TAPS;
+        const float* iweights = weights, *jweights = weights + TAPS, *kweights = weights + 2 * TAPS;
+        float ktemp = 0.0f;
+        for (int k = 0; k < TAPS; ++k)
+        {
+            float jtemp = 0.0f;
+            for (int j = 0; j < TAPS; ++j)
+            {
+                const float* row = data + koffs[k] + joffs[j];
+                float itemp = iweights[0] * row[ioffs[0]];
+                for (int i = 1; i < TAPS; ++i)
+                {
+                    itemp += iweights[i] * row[ioffs[i]];
+                }
+                if (j == 0)
+                {
+                    jtemp = jweights[0] * itemp;
+                } else {
+                    jtemp += jweights[j] * itemp;
+                }
+            }
+            if (k == 0)
+            {
+                ktemp = kweights[0] * jtemp;
+            } else {
+                ktemp += kweights[k] * jtemp;
+            }
+        }
+        return ktemp;
+    }
+}
+
+VolumeInterpolationTable::VolumeInterpolationTable()
+{
+    m_interp = VolumeFile::TRILINEAR;
+    m_taps = 2;
+    m_numPoints = 0;
+    m_frameSize = 0;
+    m_narrowOffsets = true;
+}
+
+bool VolumeInterpolationTable::useNarrowOffsets(const int64_t& frameSize)
+{//every offset is at most frameSize - 1, and so is the sum of the three axis offsets for a valid point
+    return frameSize <= ((int64_t)1 << 31);
+}
+
+VolumeInterpolationTable::VolumeInterpolationTable(const VolumeSpace& mySpace, const float* coordsIn, const int64_t& numCoords, const VolumeFile::InterpType& interp)
+{
+    m_interp = interp;
+    switch (interp)
+    {
+        case VolumeFile::ENCLOSING_VOXEL:
+            m_taps = 1;
+            break;
+        case VolumeFile::TRILINEAR:
+            m_taps = 2;
+            break;
+        case VolumeFile::CUBIC:
+            m_taps = 4;
+            break;
+        default:
+            CaretAssert(false);
+            m_taps = 1;
+    }
+    const int64_t* dims = mySpace.getDims();
+    const int64_t stride[3] = { 1, dims[0], dims[0] * dims[1] };
+    m_frameSize = dims[0] * dims[1] * dims[2];
+    m_numPoints = numCoords;
+    m_narrowOffsets = useNarrowOffsets(m_frameSize);
+    int64_t pointStride = 3 * m_taps;
+    if (m_narrowOffsets)
+    {
+        m_offsets32.resize(m_numPoints * pointStride);
+    } else {
+        m_offsets64.resize(m_numPoints * pointStride);
+    }
+    m_weights.resize(m_numPoints * pointStride);
+    m_valid.resize(m_numPoints);
+#pragma omp CARET_PARFOR schedule(dynamic, 4096)
+    for (int64_t point = 0; point < m_numPoints; ++point)
+    {
+        int64_t offsets[12];//computed wide, then stored in whichever width the table uses
+        float* weights = m_weights.data() + point * pointStride;
+        const float* coord = coordsIn + point * 3;
+        bool valid = true;
+        if (m_interp == VolumeFile::ENCLOSING_VOXEL)
+        {
+            int64_t ijk[3];
+            mySpace.enclosingVoxel(coord, ijk);
+            valid = mySpace.indexValid(ijk);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                offsets[axis] = (valid ? ijk[axis] * stride[axis] : 0);
+                weights[axis] = 1.0f;
+            }
+        } else {
+            float indexSpace[3];
+            mySpace.spaceToIndex(coord, indexSpace);
+            int64_t lowIndex[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                lowIndex[axis] = (int64_t)floor(indexSpace[axis]);
+                if (lowIndex[axis] < 0 || lowIndex[axis] + 1 >= dims[axis]) valid = false;//same test as interpolateValue, both the low and high voxel must exist
+            }
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                int64_t* axisOffsets = offsets + axis * m_taps;
+                float* axisWeights = weights + axis * m_taps;
+                if (!valid)
+                {
+                    for (int tap = 0; tap < m_taps; ++tap)
+                    {
+                        axisOffsets[tap] = 0;
+                        axisWeights[tap] = 0.0f;
+                    }
+                    continue;
+                }
+                if (m_interp == VolumeFile::TRILINEAR)
+                {
+                    float highWeight = indexSpace[axis] - lowIndex[axis];
+                    axisWeights[0] = 1.0f - highWeight;
+                    axisWeights[1] = highWeight;
+                    axisOffsets[0] = lowIndex[axis] * stride[axis];
+                    axisOffsets[1] = (lowIndex[axis] + 1) * stride[axis];
+                } else {//cubic, matches the edge handling in VolumeSpline::sample
+                    float intPart;
+                    float fracPart = modf(indexSpace[axis], &intPart);
+                    int64_t low = (int64_t)intPart;
+                    bool lowEdge = (low < 1), highEdge = (low >= dims[axis] - 2);
+                    CubicSpline mySpline = CubicSpline::bspline(fracPart, lowEdge, highEdge);
+                    for (int tap = 0; tap < 4; ++tap)
+                    {
+                        int64_t tapIndex = low - 1 + tap;
+                        if ((tap == 0 && lowEdge) || (tap == 3 && highEdge) || tapIndex < 0 || tapIndex >= dims[axis])
+                        {
+                            axisWeights[tap] = 0.0f;
+                            axisOffsets[tap] = min(max(tapIndex, (int64_t)0), dims[axis] - 1) * stride[axis];
+                        } else {
+                            axisWeights[tap] = mySpline.getWeight(tap);
+                            axisOffsets[tap] = tapIndex * stride[axis];
+                        }
+                    }
+                }
+            }
+        }
+        m_valid[point] = (valid ? 1 : 0);
+        if (m_narrowOffsets)
+        {
+            int32_t* offsetsOut = m_offsets32.data() + point * pointStride;
+            for (int64_t i = 0; i < pointStride; ++i)
+            {
+                offsetsOut[i] = (int32_t)offsets[i];
+            }
+        } else {
+            memcpy(m_offsets64.data() + point * pointStride, offsets, pointStride * sizeof(int64_t));
+        }
+    }
+}
+
+void VolumeInterpolationTable::sample(const float* frameData, float* valuesOut) const
+{
+    if (m_narrowOffsets)
+    {
+        sampleInternal(m_offsets32.data(), frameData, valuesOut);
+    } else {
+        sampleInternal(m_offsets64.data(), frameData, valuesOut);
+    }
+}
+
+template <typename T>
+void VolumeInterpolationTable::sampleInternal(const T* offsetData, const float* frameData, float* valuesOut) const
+{
+    int64_t pointStride = 3 * m_taps;
+#pragma omp CARET_PARFOR schedule(dynamic, 4096)
+    for (int64_t point = 0; point < m_numPoints; ++point)
+    {
+        if (!m_valid[point])
+        {
+            valuesOut[point] = VolumeFile::INVALID_INTERP_VALUE;
+            continue;
+        }
+        const T* offsets = offsetData + point * pointStride;
+        const float* weights = m_weights.data() + point * pointStride;
+        switch (m_taps)
+        {
+            case 1:
+                valuesOut[point] = frameData[offsets[0] + offsets[1] + offsets[2]];//don't multiply by weights, enclosing voxel must give the exact value
+                break;
+            case 2:
+                valuesOut[point] = gatherSeparable<2>(frameData, offsets, weights);
+                break;
+            case 4:
+                valuesOut[point] = gatherSeparable<4>(frameData, offsets, weights);
+                break;
+            default:
+                CaretAssert(false);
+        }
+    }
+}
+
+bool VolumeInterpolationTable::getSourceRegion(const int64_t dims[3], int64_t startOut[3], int64_t endOut[3]) const
+{
+    CaretAssert(dims[0] * dims[1] * dims[2] == m_frameSize);
+    const int64_t stride[3] = { 1, dims[0], dims[0] * dims[1] };
+    if (m_narrowOffsets)
+    {
+        return findSourceRegion(m_offsets32.data(), m_valid.data(), m_numPoints, m_taps, stride, startOut, endOut);
+    } else {
+        return findSourceRegion(m_offsets64.data(), m_valid.data(), m_numPoints, m_taps, stride, startOut, endOut);
+    }
+}
+
+void VolumeInterpolationTable::restrictToBox(const int64_t dims[3], const int64_t boxStart[3], const int64_t boxDims[3])
+{
+    CaretAssert(dims[0] * dims[1] * dims[2] == m_frameSize);
+    const int64_t stride[3] = { 1, dims[0], dims[0] * dims[1] };
+    const int64_t boxStride[3] = { 1, boxDims[0], boxDims[0] * boxDims[1] };
+    if (m_narrowOffsets)
+    {
+        rebaseOffsets(m_offsets32.data(), m_valid.data(), m_numPoints, m_taps, stride, boxStart, boxStride);
+    } else {
+        rebaseOffsets(m_offsets64.data(), m_valid.data(), m_numPoints, m_taps, stride, boxStart, boxStride);
+    }
+    m_frameSize = boxDims[0] * boxDims[1] * boxDims[2];
+}
+
+void VolumeInterpolationTable::invalidatePoint(const int64_t& point)
+{
+    CaretAssert(point >= 0 && point < m_numPoints);
+    m_valid[point] = 0;
+}
+
+void VolumeInterpolationTable::writeFile(const AString& filename, const QByteArray& identifier) const
+{
+    TableHeader header;
+    memcpy(header.m_magic, TABLE_MAGIC, 8);
+    header.m_version = TABLE_VERSION;
+    header.m_byteOrder = TABLE_BYTE_ORDER;
+    setIdentifier(header.m_identifier, identifier);
+    header.m_interp = (int32_t)m_interp;
+    header.m_taps = m_taps;
+    header.m_numPoints = m_numPoints;
+    header.m_frameSize = m_frameSize;
+    header.m_offsetBytes = (m_narrowOffsets ? sizeof(int32_t) : sizeof(int64_t));
+    header.m_padding = 0;
+    QFile myFile(filename);
+    if (!myFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) throw DataFileException(filename, "unable to open file for writing");
+    bool ok = myFile.write((const char*)&header, sizeof(TableHeader)) == sizeof(TableHeader);
+    if (m_narrowOffsets)
+    {
+        ok = ok && myFile.write((const char*)m_offsets32.data(), m_offsets32.size() * sizeof(int32_t)) == (int64_t)(m_offsets32.size() * sizeof(int32_t));
+    } else {
+        ok = ok && myFile.write((const char*)m_offsets64.data(), m_offsets64.size() * sizeof(int64_t)) == (int64_t)(m_offsets64.size() * sizeof(int64_t));
+    }
+    ok = ok && myFile.write((const char*)m_weights.data(), m_weights.size() * sizeof(float)) == (int64_t)(m_weights.size() * sizeof(float));
+    ok = ok && myFile.write(m_valid.data(), m_valid.size()) == (int64_t)m_valid.size();
+    if (!ok) throw DataFileException(filename, "error writing interpolation table");
+}
+
+bool VolumeInterpolationTable::readFile(const AString& filename, const QByteArray& identifier, const int64_t& frameSize)
+{
+    QFile myFile(filename);
+    if (!myFile.exists()) return false;
+    int64_t fileSize = myFile.size();
+    if (fileSize < (int64_t)sizeof(TableHeader)) return false;
+    MappedFileRegion myMapping;
+    if (!myMapping.map(filename, 0, fileSize)) return false;
+    const uint8_t* mapped = myMapping.getData();
+    if (PerformanceStatistics::isEnabled()) PerformanceStatistics::addBytesRead(fileSize);//copied out of the mapping whenever it matches, so count it all
+    TableHeader header;
+    memcpy(&header, mapped, sizeof(TableHeader));
+    char expectIdentifier[TABLE_IDENTIFIER_SIZE];
+    setIdentifier(expectIdentifier, identifier);
+    bool ret = memcmp(header.m_magic, TABLE_MAGIC, 8) == 0 && header.m_version == TABLE_VERSION && header.m_byteOrder == TABLE_BYTE_ORDER &&
+               memcmp(header.m_identifier, expectIdentifier, TABLE_IDENTIFIER_SIZE) == 0 && header.m_frameSize == frameSize && header.m_numPoints >= 0;
+    int64_t pointStride = 3 * header.m_taps;
+    if (ret)
+    {
+        switch (header.m_interp)
+        {
+            case VolumeFile::ENCLOSING_VOXEL:
+                ret = (header.m_taps == 1);
+                break;
+            case VolumeFile::TRILINEAR:
+                ret = (header.m_taps == 2);
+                break;
+            case VolumeFile::CUBIC:
+                ret = (header.m_taps == 4);
+                break;
+            default:
+                ret = false;
+        }
+    }
+    int64_t offsetBytes = (useNarrowOffsets(frameSize) ? sizeof(int32_t) : sizeof(int64_t));
+    ret = ret && header.m_offsetBytes == offsetBytes;
+    ret = ret && (fileSize == (int64_t)sizeof(TableHeader) + header.m_numPoints * (pointStride * (int64_t)(offsetBytes + sizeof(float)) + 1));
+    if (ret)
+    {
+        const uint8_t* offsets = mapped + sizeof(TableHeader);
+        const float* weights = (const float*)(offsets + header.m_numPoints * pointStride * offsetBytes);
+        const char* valid = (const char*)(weights + header.m_numPoints * pointStride);
+        if (offsetBytes == sizeof(int32_t))
+        {
+            ret = offsetsInFrame((const int32_t*)offsets, header.m_numPoints, header.m_taps, frameSize);
+        } else {
+            ret = offsetsInFrame((const int64_t*)offsets, header.m_numPoints, header.m_taps, frameSize);
+        }
+        if (ret)
+        {
+            m_interp = (VolumeFile::InterpType)header.m_interp;
+            m_taps = header.m_taps;
+            m_numPoints = header.m_numPoints;
+            m_frameSize = header.m_frameSize;
+            m_narrowOffsets = (offsetBytes == sizeof(int32_t));
+            m_offsets32.clear();
+            m_offsets64.clear();
+            if (m_narrowOffsets)
+            {
+                m_offsets32.assign((const int32_t*)offsets, (const int32_t*)offsets + m_numPoints * pointStride);
+            } else {
+                m_offsets64.assign((const int64_t*)offsets, (const int64_t*)offsets + m_numPoints * pointStride);
+            }
+            m_weights.assign(weights, weights + m_numPoints * pointStride);
+            m_valid.assign(valid, valid + m_numPoints);
+        }
+    }
+    if (!ret) CaretLogInfo("interpolation table file '" + filename + "' does not match the current inputs, recomputing");
+    return ret;
+}
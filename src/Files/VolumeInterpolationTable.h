@@ -0,0 +1,88 @@
+#ifndef __VOLUME_INTERPOLATION_TABLE_H__
+#define __VOLUME_INTERPOLATION_TABLE_H__
+
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeFile.h"
+
+#include <QByteArray>
+
+#include <vector>
+#include <stdint.h>
+
+namespace caret {
+    
+    class VolumeSpace;
+    
+    ///precomputed voxel offsets and separable weights for sampling a fixed set of coordinates, so that many frames can be sampled with only a gather
+    class VolumeInterpolationTable
+    {
+        VolumeFile::InterpType m_interp;
+        int m_taps;//samples per axis: 1 for enclosing voxel, 2 for trilinear, 4 for cubic
+        int64_t m_numPoints;
+        int64_t m_frameSize;
+        bool m_narrowOffsets;//true when every voxel index fits in int32, which halves the size of the offsets
+        std::vector<int32_t> m_offsets32;//per point, per axis, per tap: the i, j*dims[0], or k*dims[0]*dims[1] part of the voxel index
+        std::vector<int64_t> m_offsets64;//only one of these is used, depending on m_narrowOffsets
+        std::vector<float> m_weights;//same layout as the offsets, taps that fall outside the volume have weight 0 and a clamped offset
+        std::vector<char> m_valid;
+        static bool useNarrowOffsets(const int64_t& frameSize);
+        template <typename T>
+        void sampleInternal(const T* offsetData, const float* frameData, float* valuesOut) const;
+    public:
+        ///empty table, for readFile
+        VolumeInterpolationTable();
+        
+        ///coordsIn is numCoords interleaved xyz triples, validity of each point follows VolumeFile::interpolateValue
+        VolumeInterpolationTable(const VolumeSpace& mySpace, const float* coordsIn, const int64_t& numCoords, const VolumeFile::InterpType& interp);
+        
+        ///for points whose coordinate couldn't be computed, like outside a warpfield
+        void invalidatePoint(const int64_t& point);
+        
+        ///bounding box of the voxels that valid points read from, as [start, end) per axis, returns false if no point is valid
+        bool getSourceRegion(const int64_t dims[3], int64_t startOut[3], int64_t endOut[3]) const;
+        
+        ///make the offsets index into a box of the frame instead, like a partial VolumeSpline, the box must contain the source region
+        void restrictToBox(const int64_t dims[3], const int64_t boxStart[3], const int64_t boxDims[3]);
+        
+        ///identifier is an arbitrary short key (like a hash of the inputs) that readFile must match, throws DataFileException on failure
+        void writeFile(const AString& filename, const QByteArray& identifier) const;
+        
+        ///returns false if the file doesn't exist, is corrupt, or was written with a different identifier or frame size
+        bool readFile(const AString& filename, const QByteArray& identifier, const int64_t& frameSize);
+        
+        VolumeFile::InterpType getInterpolationType() const { return m_interp; }
+        
+        int64_t getNumberOfPoints() const { return m_numPoints; }
+        
+        int64_t getFrameSize() const { return m_frameSize; }
+        
+        bool isValid(const int64_t& point) const { return m_valid[point] != 0; }
+        
+        ///sample every point from one frame, invalid points get VolumeFile::INVALID_INTERP_VALUE
+        ///for CUBIC, frameData must be the deconvolved spline coefficients, of the box if restrictToBox was used
+        void sample(const float* frameData, float* valuesOut) const;
+    };
+    
+}
+
+#endif //__VOLUME_INTERPOLATION_TABLE_H__
@@ -0,0 +1,160 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeResamplingHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretPointer.h"
+#include "VolumeInterpolationTable.h"
+#include "VolumeSpline.h"
+
+#include <QCryptographicHash>
+
+#include <algorithm>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t SLAB_VOXELS = 1 << 20;//output voxels per table when there is no plan file, so the weights never need much more memory than a frame
+    
+    QByteArray getPlanIdentifier(const VolumeFile* inVol, const VolumeFile* outVol, const VolumeFile::InterpType& interp, const VolumeResamplingHelper::CoordinateSource& source)
+    {//everything that affects the weights, so a plan file from different inputs is never used
+        QCryptographicHash myHash(QCryptographicHash::Sha1);
+        myHash.addData((const char*)inVol->getDimensionsPtr(), 3 * sizeof(int64_t));
+        myHash.addData((const char*)outVol->getDimensionsPtr(), 3 * sizeof(int64_t));
+        const vector<vector<float> >& inSform = inVol->getSform(), &outSform = outVol->getSform();
+        for (int i = 0; i < 3; ++i)
+        {
+            myHash.addData((const char*)inSform[i].data(), 4 * sizeof(float));
+            myHash.addData((const char*)outSform[i].data(), 4 * sizeof(float));
+        }
+        int32_t method = (int32_t)interp;
+        myHash.addData((const char*)&method, sizeof(int32_t));
+        source.addToIdentifier(myHash);
+        return myHash.result();
+    }
+    
+    VolumeInterpolationTable* makeTable(const VolumeFile* inVol, const VolumeFile::InterpType& interp, const VolumeResamplingHelper::CoordinateSource& source,
+                                        const int64_t& planeSize, const int64_t& kStart, const int64_t& kEnd)
+    {
+        int64_t numPoints = (kEnd - kStart) * planeSize;
+        vector<float> coords(numPoints * 3);
+        vector<char> valid(numPoints, 1);
+        source.getSourceCoordinates(kStart, kEnd, coords.data(), valid.data());
+        VolumeInterpolationTable* ret = new VolumeInterpolationTable(inVol->getVolumeSpace(), coords.data(), numPoints, interp);
+        for (int64_t point = 0; point < numPoints; ++point)
+        {
+            if (!valid[point]) ret->invalidatePoint(point);
+        }
+        return ret;
+    }
+    
+    void applyTable(const VolumeFile* inVol, VolumeFile* outVol, VolumeInterpolationTable& table, const int64_t& firstVoxel, vector<char>& warnedFrames)
+    {//the table is used for every frame before moving on, so it is only ever computed once
+        const int64_t* inDims = inVol->getDimensionsPtr();
+        int64_t numPoints = table.getNumberOfPoints();
+        vector<float> values(numPoints);
+        bool useBox = false;
+        int64_t boxStart[3], boxDims[3];
+        if (table.getInterpolationType() == VolumeFile::CUBIC)
+        {//the spline coefficients differ per frame, so deconvolve only the part of each frame this table reads
+            int64_t regionStart[3], regionEnd[3];
+            if (table.getSourceRegion(inDims, regionStart, regionEnd))
+            {
+                VolumeSpline::getPartialBox(inDims, regionStart, regionEnd, boxStart, boxDims);
+                table.restrictToBox(inDims, boxStart, boxDims);
+                useBox = true;
+            }
+        }
+        for (int64_t c = 0; c < inDims[4]; ++c)
+        {
+            for (int64_t b = 0; b < inDims[3]; ++b)
+            {
+                if (useBox)
+                {
+                    VolumeSpline boxSpline(inVol->getFrame(b, c), inDims, boxStart, boxDims);
+                    int64_t whichFrame = c * inDims[3] + b;
+                    if (boxSpline.ignoredNonNumeric() && !warnedFrames[whichFrame])
+                    {
+                        CaretLogWarning("ignored non-numeric input value when calculating cubic splines in volume '" + inVol->getFileName() + "', frame #" + AString::number(b + 1));
+                        warnedFrames[whichFrame] = 1;
+                    }
+                    table.sample(boxSpline.getCoefficients(), values.data());
+                } else {//with no valid points, cubic doesn't read the frame either
+                    table.sample(inVol->getFrame(b, c), values.data());
+                }
+                outVol->setFrameRange(values.data(), firstVoxel, numPoints, b, c);
+            }
+        }
+    }
+}
+
+VolumeResamplingHelper::CoordinateSource::~CoordinateSource()
+{
+}
+
+void VolumeResamplingHelper::resample(const VolumeFile* inVol, VolumeFile* outVol, const VolumeFile::InterpType& interp, const CoordinateSource& source, const AString& planFile)
+{
+    const int64_t* inDims = inVol->getDimensionsPtr();
+    const int64_t* outDims = outVol->getDimensionsPtr();
+    CaretAssert(inDims[3] == outDims[3] && inDims[4] == outDims[4]);
+    int64_t planeSize = outDims[0] * outDims[1];
+    vector<char> warnedFrames(inDims[3] * inDims[4], 0);
+    if (planFile != "")
+    {//the plan file holds the table for the whole output
+        QByteArray planIdentifier = getPlanIdentifier(inVol, outVol, interp, source);
+        CaretPointer<VolumeInterpolationTable> myTable(new VolumeInterpolationTable());
+        if (!myTable->readFile(planFile, planIdentifier, inDims[0] * inDims[1] * inDims[2]) || myTable->getNumberOfPoints() != planeSize * outDims[2])
+        {
+            myTable.grabNew(makeTable(inVol, interp, source, planeSize, 0, outDims[2]));
+            myTable->writeFile(planFile, planIdentifier);
+        }
+        applyTable(inVol, outVol, *myTable, 0, warnedFrames);
+    } else {
+        int64_t slabPlanes = max((int64_t)1, SLAB_VOXELS / planeSize);
+        for (int64_t kStart = 0; kStart < outDims[2]; kStart += slabPlanes)
+        {
+            CaretPointer<VolumeInterpolationTable> slabTable(makeTable(inVol, interp, source, planeSize, kStart, min(outDims[2], kStart + slabPlanes)));
+            applyTable(inVol, outVol, *slabTable, kStart * planeSize, warnedFrames);
+        }
+    }
+}
+
+AString VolumeResamplingHelper::getHelpText(const AString& transformName)
+{
+    return AString("The weights for each output voxel are computed once and applied to every frame, large outputs are processed in slabs to limit memory use.  ") +
+           "If -plan-file is specified and the file was made from the same volume spaces, " + transformName + ", and method, the weights for the whole output are loaded from it, " +
+           "otherwise they are computed and written to it.  " +
+           "This is useful when applying the same " + transformName + " to many runs.";
+}
+
+void VolumeResamplingHelper::addToHash(QCryptographicHash& hash, const void* data, const int64_t& numBytes)
+{
+    const int64_t MAX_CHUNK = 1 << 30;
+    const char* charData = (const char*)data;
+    for (int64_t start = 0; start < numBytes; start += MAX_CHUNK)
+    {
+        hash.addData(charData + start, (int)min(MAX_CHUNK, numBytes - start));
+    }
+}
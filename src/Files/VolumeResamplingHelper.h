@@ -0,0 +1,61 @@
+#ifndef __VOLUME_RESAMPLING_HELPER_H__
+#define __VOLUME_RESAMPLING_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeFile.h"
+
+#include "stdint.h"
+
+class QCryptographicHash;
+
+namespace caret {
+    
+    ///resamples every frame of a volume through VolumeInterpolationTable, the transform only supplies the source coordinate of each output voxel
+    class VolumeResamplingHelper
+    {
+    public:
+        class CoordinateSource
+        {
+        public:
+            ///fill interleaved xyz source coordinates for the output voxels in planes [kStart, kEnd), in frame order, set validOut to 0 where there is no source coordinate
+            virtual void getSourceCoordinates(const int64_t& kStart, const int64_t& kEnd, float* coordsOut, char* validOut) const = 0;
+            
+            ///add everything that defines the transform to a plan file identifier
+            virtual void addToIdentifier(QCryptographicHash& hash) const = 0;
+            
+            virtual ~CoordinateSource();
+        };
+        
+        ///outVol must already be initialized to the output space, with the same maps and components as inVol
+        ///with a plan file, the table for the whole output is loaded from it or saved to it, otherwise the output is processed in slabs to limit memory use
+        static void resample(const VolumeFile* inVol, VolumeFile* outVol, const VolumeFile::InterpType& interp, const CoordinateSource& source, const AString& planFile = "");
+        
+        ///help text for algorithms using this, transformName is what the plan file depends on, like "affine"
+        static AString getHelpText(const AString& transformName);
+        
+        ///QCryptographicHash::addData takes an int size, so split large arrays
+        static void addToHash(QCryptographicHash& hash, const void* data, const int64_t& numBytes);
+    };
+
+}
+
+#endif //__VOLUME_RESAMPLING_HELPER_H__
@@ -38,21 +38,47 @@ VolumeSpline::VolumeSpline()
     m_dims[2] = 0;
 }
 
+namespace
+{
+    const int64_t PARTIAL_BOX_MARGIN = 16;//the influence of a cut edge on the coefficients decays by a factor of 2 - sqrt(3) per voxel, so after 16 voxels it is far below float precision
+}
+
 VolumeSpline::VolumeSpline(const float* frame, const int64_t framedims[3])
+{
+    const int64_t boxStart[3] = { 0, 0, 0 };
+    compute(frame, framedims, boxStart, framedims);
+}
+
+VolumeSpline::VolumeSpline(const float* frame, const int64_t framedims[3], const int64_t boxStart[3], const int64_t boxDims[3])
+{
+    compute(frame, framedims, boxStart, boxDims);
+}
+
+void VolumeSpline::getPartialBox(const int64_t framedims[3], const int64_t regionStart[3], const int64_t regionEnd[3], int64_t boxStartOut[3], int64_t boxDimsOut[3])
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        boxStartOut[i] = max((int64_t)0, regionStart[i] - PARTIAL_BOX_MARGIN);
+        boxDimsOut[i] = min(framedims[i], regionEnd[i] + PARTIAL_BOX_MARGIN) - boxStartOut[i];
+    }
+}
+
+void VolumeSpline::compute(const float* frame, const int64_t framedims[3], const int64_t boxStart[3], const int64_t boxDims[3])
 {
     m_ignoredNonNumeric = false;
-    m_dims[0] = framedims[0];
-    m_dims[1] = framedims[1];
-    m_dims[2] = framedims[2];
+    m_dims[0] = boxDims[0];
+    m_dims[1] = boxDims[1];
+    m_dims[2] = boxDims[2];
     m_deconv = CaretArray<float>(m_dims[0] * m_dims[1] * m_dims[2]);
     CaretArray<float> scratchArray(m_dims[0] * max(m_dims[1], m_dims[2])), deconvScratch(max(m_dims[0], max(m_dims[1], m_dims[2])));//allocate as much as we will need, even if we don't use it all yet
     predeconvolve(deconvScratch, m_dims[0]);
     for (int k = 0; k < m_dims[2]; ++k)
     {
-        int64_t index = m_dims[0] * m_dims[1] * k;
+        int64_t index;
         int64_t index2 = 0;
         for (int j = 0; j < m_dims[1]; ++j)
         {
+            index = boxStart[0] + framedims[0] * (boxStart[1] + j + framedims[1] * (boxStart[2] + k));//the box rows aren't contiguous in the frame unless it is the whole frame
             for (int i = 0; i < m_dims[0]; ++i)
             {
                 float tempf = frame[index];
@@ -33,12 +33,19 @@ namespace caret {
         CaretArray<float> m_deconv;//don't do lazy deconvolution, it doesn't save much time, and takes more memory and slightly longer if you have to do the whole volume anyway
         void deconvolve(float* data, const float* backsubs, const int64_t& length);//use CaretArray so that it doesn't reallocate like a vector on copy, and the data is static once computed
         void predeconvolve(float* backsubs, const int64_t& length);//since the back substitution on the same size array uses the same coefficients, precompute them
+        void compute(const float* frame, const int64_t framedims[3], const int64_t boxStart[3], const int64_t boxDims[3]);
     public:
         VolumeSpline();
         VolumeSpline(const float* frame, const int64_t framedims[3]);
+        ///deconvolve only a box of the frame, its coefficients are indexed within the box, and sample() treats the box edges as the volume edges
+        VolumeSpline(const float* frame, const int64_t framedims[3], const int64_t boxStart[3], const int64_t boxDims[3]);
+        ///box to deconvolve so that the coefficients of voxels [regionStart, regionEnd) match those of the whole frame to within float rounding
+        static void getPartialBox(const int64_t framedims[3], const int64_t regionStart[3], const int64_t regionEnd[3], int64_t boxStartOut[3], int64_t boxDimsOut[3]);
         float sample(const float& i, const float& j, const float& k);
         float sample(const float ijk[3]) { return sample(ijk[0], ijk[1], ijk[2]); }
         bool ignoredNonNumeric() const { return m_ignoredNonNumeric; }
+        ///the deconvolved frame, for sampling via precomputed weights
+        const float* getCoefficients() const { return m_deconv.getArray(); }
     };
     
 }
@@ -396,6 +396,16 @@ void VolumeBase::VolumeStorage::setFrame(const float* frameIn, const int64_t bri
     }
 }
 
+void VolumeBase::VolumeStorage::setFrameRange(const float* valuesIn, const int64_t& firstVoxel, const int64_t& numVoxels, const int64_t brickIndex, const int64_t component)
+{
+    CaretAssert(firstVoxel >= 0 && numVoxels >= 0 && firstVoxel + numVoxels <= m_mult[2]);
+    int64_t start = brickIndex * m_mult[2] + component * m_mult[3] + firstVoxel;
+    for (int64_t i = 0; i < numVoxels; ++i)
+    {
+        m_data[i + start] = valuesIn[i];
+    }
+}
+
 void VolumeBase::VolumeStorage::setValueAllVoxels(const float value)
 {
     for (int64_t i = 0; i < m_mult[4]; ++i)
@@ -122,6 +122,9 @@ namespace caret {
             
             ///set a frame
             void setFrame(const float* frameIn, const int64_t brickIndex = 0, const int64_t component = 0);
+            
+            ///set consecutive voxels of a frame, starting at a voxel index within the frame
+            void setFrameRange(const float* valuesIn, const int64_t& firstVoxel, const int64_t& numVoxels, const int64_t brickIndex = 0, const int64_t component = 0);
         };
         
         VolumeStorage m_storage;
@@ -327,6 +330,13 @@ namespace caret {
         
         ///set a frame
         void setFrame(const float* frameIn, const int64_t brickIndex = 0, const int64_t component = 0) { m_storage.setFrame(frameIn, brickIndex, component); setModified(); }
+        
+        ///set consecutive voxels of a frame, for writing a frame in pieces without calling setModified per voxel
+        void setFrameRange(const float* valuesIn, const int64_t& firstVoxel, const int64_t& numVoxels, const int64_t brickIndex = 0, const int64_t component = 0)
+        {
+            m_storage.setFrameRange(valuesIn, firstVoxel, numVoxels, brickIndex, component);
+            setModified();
+        }
 
         ///gets dimensions as a vector of 5 integers, 3 spatial, time, components
         void getDimensions(std::vector<int64_t>& dimOut) const { m_storage.getDimensions(dimOut); }
@@ -25,11 +25,11 @@
 #include <sstream>
 
 #include "Base64.h"
+#include "Base64StreamDecoder.h"
 #include "ByteOrderEnum.h"
 #include "ByteSwapping.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
-#include "DataCompressZLib.h"
 
 //#include "FileUtilities.h"
 #include "FastStatistics.h"
@@ -38,11 +38,15 @@
 #include "GiftiMetaDataXmlElements.h"
 #include "GiftiXmlElements.h"
 #include "Histogram.h"
+#include "MappedFileRegion.h"
 #include "NiftiEnums.h"
 #include "PaletteColorMapping.h"
+#include "PerformanceStatistics.h"
 #include "SystemUtilities.h"
 #include "XmlWriter.h"
 
+#include "zlib.h"
+
 using namespace caret;
 
 /**
@@ -169,8 +173,15 @@ GiftiDataArray::copyHelperGiftiDataArray(const GiftiDataArray& nda)
    dataTypeSize = nda.dataTypeSize;
    endian = nda.endian;
    dimensions = nda.dimensions;
+   m_mappedData.grabNew(NULL);//about to be replaced, so don't copy it into memory
    allocateData();
-   data = nda.data;
+   if (nda.m_mappedData.getPointer() != NULL) {
+       data.assign(nda.m_mappedData->getData(),
+                   nda.m_mappedData->getData() + nda.m_mappedData->getNumberOfBytes());
+   }
+   else {
+       data = nda.data;
+   }
    metaData = nda.metaData;
    nonWrittenMetaData = nda.nonWrittenMetaData;
    externalFileName = nda.externalFileName;
@@ -282,6 +293,7 @@ GiftiDataArray::deleteRows(const std::vector<int32_t>& rowsToDeleteIn)
    //
    // Remove the unneeded rows
    //
+   copyMappedDataToMemory();
    for (uint32_t i = 0; i < rowsToDelete.size(); i++) {
       const int32_t offset = rowsToDelete[i] * numBytesInRow;
       data.erase(data.begin() + offset, data.begin() + offset + numBytesInRow);
@@ -346,6 +358,18 @@ GiftiDataArray::allocateData()
    
    dataSizeInBytes *= dataTypeSize;
    
+   //
+   // Mapped data is kept if it is the right size, it is writable
+   //
+   if (m_mappedData.getPointer() != NULL) {
+       if (m_mappedData->getNumberOfBytes() == dataSizeInBytes) {
+           updateDataPointers();
+           setModified();
+           return;
+       }
+       copyMappedDataToMemory();
+   }
+   
    //
    // Does data need to be allocated
    //
@@ -376,16 +400,23 @@ GiftiDataArray::updateDataPointers()
    dataPointerFloat = NULL;
    dataPointerInt = NULL;
    dataPointerUByte = NULL;
-   if (data.empty() == false) {
+   uint8_t* dataBytes = NULL;
+   if (m_mappedData.getPointer() != NULL) {
+      dataBytes = m_mappedData->getData();
+   }
+   else if (data.empty() == false) {
+      dataBytes = &data[0];
+   }
+   if (dataBytes != NULL) {
       switch (dataType) {
          case NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32:
-            dataPointerFloat = (float*)&data[0];
+            dataPointerFloat = (float*)dataBytes;
             break;
          case NiftiDataTypeEnum::NIFTI_TYPE_INT32:
-            dataPointerInt   = (int32_t*)&data[0];
+            dataPointerInt   = (int32_t*)dataBytes;
             break;
          case NiftiDataTypeEnum::NIFTI_TYPE_UINT8:
-            dataPointerUByte = (uint8_t*)&data[0];
+            dataPointerUByte = (uint8_t*)dataBytes;
             break;
           default:
               CaretAssertMessage(0, "Unsupported GIFTI Data Type");
@@ -408,11 +439,16 @@ GiftiDataArray::clear()
    metaData.clear();
    nonWrittenMetaData.clear();
    dimensions.clear();
+   m_mappedData.grabNew(NULL);
    setDimensions(dimensions);
    externalFileName = "";
    externalFileOffset = 0;
    minMaxFloatValuesValid = false;
    minMaxPercentageValuesValid = false;
+    m_base64Decoder.grabNew(NULL);
+    m_compressedDataForReading.clear();
+    m_numberOfBytesDecoded = 0;
+    m_dataTypeBeforeReading = dataType;
    
     if (this->paletteColorMapping != NULL) {
         delete this->paletteColorMapping;
@@ -590,14 +626,28 @@ GiftiDataArray::readFromText(const AString text,
                              const bool isReadOnlyMetaData)
 {
    const NiftiDataTypeEnum::Enum requiredDataType = dataType;
-   dataType = dataTypeForReading;
-   encoding = encodingForReading;
-   endian   = dataEndianForReading;
-   arraySubscriptingOrder = arraySubscriptingOrderForReading;
-   setDimensions(dimensionsForReading);
-   if (dimensionsForReading.size() == 0) {
-      throw GiftiException("Data array has no dimensions.");
+   m_mappedData.grabNew(NULL);
+   if ((isReadOnlyMetaData == false)
+       && (encodingForReading == GiftiEncodingEnum::EXTERNAL_FILE_BINARY)
+       && ((arraySubscriptingOrderForReading == GiftiArrayIndexingOrderEnum::ROW_MAJOR_ORDER)
+           || (dimensionsForReading.size() == 1))) {
+       /*
+        * Map before the attributes are set so that memory is not
+        * allocated for data that is then mapped.  Column major data
+        * is transposed after reading, so it is not mapped.
+        */
+       mapExternalData(externalFileNameForReading,
+                       externalFileOffsetForReading,
+                       dataEndianForReading,
+                       dataTypeForReading,
+                       dimensionsForReading,
+                       requiredDataType);
    }
+   setAttributesForReading(dataEndianForReading,
+                           arraySubscriptingOrderForReading,
+                           dataTypeForReading,
+                           dimensionsForReading,
+                           encodingForReading);
    //setExternalFileInformation(externalFileNameForReading,
    //                           externalFileOffsetForReading);//TSC: don't set the external filename on the array, because that is what it uses when writing the array
                               
@@ -651,88 +701,26 @@ GiftiDataArray::readFromText(const AString text,
             }
             break;
           case GiftiEncodingEnum::BASE64_BINARY:
-            {
-               //
-               // Decode the Base64 data using VTK's algorithm
-               //
-               const uint64_t numDecoded =
-                     Base64::decode((const unsigned char*)(text.toStdString().c_str()),
-                                                data.size(),
-                                                &data[0]);
-               if (numDecoded != data.size()) {
-                  std::ostringstream str;
-                  str << "Decoding of Base64 Binary data failed.\n"
-                   << "Decoded " << AString::number(numDecoded).toStdString() << " bytes but should be "
-                      << AString::number(static_cast<int>(data.size())).toStdString() << " bytes.";
-                  throw GiftiException(AString::fromStdString(str.str()));
-               }
-               
-               //
-               // Is byte swapping needed ?
-               //
-               if (endian != getSystemEndian()) {
-                  byteSwapData(getSystemEndian());
-               }
-            }
-            break;
           case GiftiEncodingEnum::GZIP_BASE64_BINARY:
             {
-               //
-               // Decode the Base64 data using VTK's algorithm
-               //
-               unsigned char* dataBuffer = new unsigned char[data.size()];
-               //const char* textChars = text.toAscii().constData();
-               const uint64_t numDecoded =
-                     Base64::decode((unsigned char*)text.toStdString().c_str(),
-                                                data.size(),
-                                                dataBuffer);
-               if (numDecoded == 0) {
-                   std::ostringstream str;
-                   str << "Decoding of GZip Base64 Binary data failed."
-                   << "Decoded " << AString::number(numDecoded).toStdString() << " bytes but should be "
-                   << AString::number(static_cast<int>(data.size())).toStdString() << " bytes.";
-                   throw GiftiException(AString::fromStdString(str.str()));
-               }
-               
-               
-               //
-               // Uncompress the data using VTK's algorithm
-               // 
-                DataCompressZLib compressor;
-                const uint64_t uncompressedDataLength = 
-                                   compressor.uncompressData(dataBuffer,
-                                                          numDecoded,
-                                                          (unsigned char*)&data[0],
-                                                          data.size());
-               if (uncompressedDataLength != data.size()) {
-                  std::ostringstream str;
-                  str << "Decompression of Binary data failed.\n"
-                   << "Uncompressed " << AString::number(uncompressedDataLength).toStdString() << " bytes but should be "
-                   << AString::number(static_cast<uint64_t>(data.size())).toStdString() << " bytes.";
-                  throw GiftiException(AString::fromStdString(str.str()));
-               }
-               
-               //
-               // Free memory
-               //
-               delete[] dataBuffer;
-               
-               //
-               // Is byte swapping needed ? 
-               //
-               if (endian != getSystemEndian()) {
-                  byteSwapData(getSystemEndian());
-               }
+               const QByteArray textBytes = text.toLatin1();
+               startDecodingText();
+               addEncodedText(textBytes.constData(),
+                              textBytes.size());
+               decodeEncodedData();
             }
             break;
           case GiftiEncodingEnum::EXTERNAL_FILE_BINARY:
             {
+               if (m_mappedData.getPointer() != NULL) {
+                  break;
+               }
                if (externalFileNameForReading.length() <= 0) {
                   throw GiftiException("External file name is empty.");
                }
                
                 std::ifstream extBinFile(externalFileNameForReading.toStdString().c_str(),
-                                         std::ifstream::in);
+                                         std::ifstream::in | std::ifstream::binary);
                 if (extBinFile.good() == false) {
                         throw GiftiException("Error opening \""
                                             + externalFileNameForReading
@@ -781,9 +769,14 @@ GiftiDataArray::readFromText(const AString text,
                   if(extBinFile.good() == false) {
                      throw GiftiException("Tried to read "
                                          + AString::number((int64_t)numberOfBytesToRead)
-                                         + " from "
-                                         + externalFileOffsetForReading
-                                         + " but failed");
+                                         + " bytes at offset "
+                                         + AString::number(externalFileOffsetForReading)
+                                         + " of \""
+                                         + externalFileNameForReading
+                                         + "\" but failed");
+                  }
+                  if (PerformanceStatistics::isEnabled()) {
+                     PerformanceStatistics::addBytesRead(numberOfBytesToRead);
                   }
                   
                   //
@@ -797,32 +790,362 @@ GiftiDataArray::readFromText(const AString text,
             break;
       }
    
-      //
-      // Check if data type needs to be converted
-      //
-      if (requiredDataType != dataType) {
-          if (intent != NiftiIntentEnum::NIFTI_INTENT_POINTSET) {
-            convertToDataType(requiredDataType);
-         }
-      }
-      
-       //
-       // Are array indices in opposite order
-       //
-       if (arraySubscriptingOrderForReading == GiftiArrayIndexingOrderEnum::COLUMN_MAJOR_ORDER) {
-           convertArrayIndexingOrder();
-       }
+      convertDataAfterReading(requiredDataType);
    } // If NOT metadata only
    
    setModified();
 }
 
+/**
+ * Set the attributes of data that is about to be read and
+ * allocate the data.
+ */
+void
+GiftiDataArray::setAttributesForReading(const GiftiEndianEnum::Enum dataEndianForReading,
+                                        const GiftiArrayIndexingOrderEnum::Enum arraySubscriptingOrderForReading,
+                                        const NiftiDataTypeEnum::Enum dataTypeForReading,
+                                        const std::vector<int64_t>& dimensionsForReading,
+                                        const GiftiEncodingEnum::Enum encodingForReading)
+{
+   dataType = dataTypeForReading;
+   encoding = encodingForReading;
+   endian   = dataEndianForReading;
+   arraySubscriptingOrder = arraySubscriptingOrderForReading;
+   setDimensions(dimensionsForReading);
+   if (dimensionsForReading.size() == 0) {
+      throw GiftiException("Data array has no dimensions.");
+   }
+}
+
+/**
+ * Convert the data type and indexing order of data that was read
+ * to what this array uses.
+ *
+ * @param requiredDataType
+ *    Data type of the array before the data was read.
+ */
+void
+GiftiDataArray::convertDataAfterReading(const NiftiDataTypeEnum::Enum requiredDataType)
+{
+    //
+    // Check if data type needs to be converted
+    //
+    if (requiredDataType != dataType) {
+        if (intent != NiftiIntentEnum::NIFTI_INTENT_POINTSET) {
+            convertToDataType(requiredDataType);
+        }
+    }
+    
+    //
+    // Are array indices in opposite order
+    //
+    if (arraySubscriptingOrder == GiftiArrayIndexingOrderEnum::COLUMN_MAJOR_ORDER) {
+        convertArrayIndexingOrder();
+    }
+}
+
+/**
+ * Map the data of an external binary file instead of reading it, when it
+ * needs no byte swapping or data type conversion.  The mapping is
+ * copy-on-write, so pages are shared with other processes using the file
+ * until the array is modified.  If the data cannot be mapped, nothing is
+ * done and the data is read normally.
+ *
+ * @param externalFileNameForReading
+ *    Name of the external file.
+ * @param externalFileOffsetForReading
+ *    Offset of the data in the external file.
+ * @param dataEndianForReading
+ *    Endian of the data.
+ * @param dataTypeForReading
+ *    Data type of the data.
+ * @param dimensionsForReading
+ *    Dimensions of the data.
+ * @param requiredDataType
+ *    Data type of the array before the data is read.
+ */
+void
+GiftiDataArray::mapExternalData(const AString& externalFileNameForReading,
+                                const int64_t externalFileOffsetForReading,
+                                const GiftiEndianEnum::Enum dataEndianForReading,
+                                const NiftiDataTypeEnum::Enum dataTypeForReading,
+                                const std::vector<int64_t>& dimensionsForReading,
+                                const NiftiDataTypeEnum::Enum requiredDataType)
+{
+    if (dimensionsForReading.empty()
+        || (dataEndianForReading != getSystemEndian())
+        || ((dataTypeForReading != requiredDataType)
+            && (intent != NiftiIntentEnum::NIFTI_INTENT_POINTSET))) {
+        return;
+    }
+    int64_t elementSize = 0;
+    switch (dataTypeForReading) {
+        case NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32:
+            elementSize = sizeof(float);
+            break;
+        case NiftiDataTypeEnum::NIFTI_TYPE_INT32:
+            elementSize = sizeof(int32_t);
+            break;
+        case NiftiDataTypeEnum::NIFTI_TYPE_UINT8:
+            elementSize = sizeof(uint8_t);
+            break;
+        default:
+            return;
+    }
+    
+    /*
+     * Mappings start on a page boundary, so an offset that is not
+     * a multiple of the element size would give misaligned elements
+     */
+    if ((externalFileOffsetForReading % elementSize) != 0) {
+        return;
+    }
+    int64_t numberOfBytes = elementSize;
+    for (int64_t i = 0; i < static_cast<int64_t>(dimensionsForReading.size()); i++) {
+        numberOfBytes *= dimensionsForReading[i];
+    }
+    
+    CaretPointer<MappedFileRegion> mappedData(new MappedFileRegion());
+    if (mappedData->map(externalFileNameForReading,
+                        externalFileOffsetForReading,
+                        numberOfBytes)) {
+        std::vector<uint8_t>().swap(data);
+        m_mappedData = mappedData;
+        if (PerformanceStatistics::isEnabled()) {
+            /*
+             * Pages are read on demand, but the array is used
+             * as a whole, so count all of it
+             */
+            PerformanceStatistics::addBytesRead(numberOfBytes);
+        }
+    }
+    else {
+        CaretLogFine("unable to memory map GIFTI external file '" + externalFileNameForReading + "', using normal reading");
+    }
+}
+
+/**
+ * If the data is mapped, copy it into memory and unmap it.
+ */
+void
+GiftiDataArray::copyMappedDataToMemory()
+{
+    if (m_mappedData.getPointer() == NULL) {
+        return;
+    }
+    data.assign(m_mappedData->getData(),
+                m_mappedData->getData() + m_mappedData->getNumberOfBytes());
+    m_mappedData.grabNew(NULL);
+    updateDataPointers();
+}
+
+/**
+ * @return The data's bytes, mapped or in memory, NULL if there is no data.
+ */
+const uint8_t*
+GiftiDataArray::getDataBytes() const
+{
+    if (m_mappedData.getPointer() != NULL) {
+        return m_mappedData->getData();
+    }
+    if (data.empty()) {
+        return NULL;
+    }
+    return &data[0];
+}
+
+/**
+ * @return Current size of the data (in bytes).
+ */
+int64_t
+GiftiDataArray::getDataSizeInBytes() const
+{
+    if (m_mappedData.getPointer() != NULL) {
+        return m_mappedData->getNumberOfBytes();
+    }
+    return data.size();
+}
+
+/**
+ * Start reading data encoded as Base64 (possibly compressed) that is
+ * added in pieces with addEncodedText(), for instance as it arrives from
+ * an XML parser, so that the text itself is never stored.  Once all text
+ * is added, call decodeEncodedData() and then finishReadingEncodedData().
+ *
+ * @param dataEndianForReading
+ *    Endian of the data.
+ * @param arraySubscriptingOrderForReading
+ *    Indexing order of the data.
+ * @param dataTypeForReading
+ *    Data type of the data.
+ * @param dimensionsForReading
+ *    Dimensions of the data.
+ * @param encodingForReading
+ *    Encoding of the data, must be BASE64_BINARY or GZIP_BASE64_BINARY.
+ * @throws GiftiException
+ *    If the attributes are invalid.
+ */
+void
+GiftiDataArray::startReadingEncodedData(const GiftiEndianEnum::Enum dataEndianForReading,
+                                        const GiftiArrayIndexingOrderEnum::Enum arraySubscriptingOrderForReading,
+                                        const NiftiDataTypeEnum::Enum dataTypeForReading,
+                                        const std::vector<int64_t>& dimensionsForReading,
+                                        const GiftiEncodingEnum::Enum encodingForReading)
+{
+    CaretAssert((encodingForReading == GiftiEncodingEnum::BASE64_BINARY)
+                || (encodingForReading == GiftiEncodingEnum::GZIP_BASE64_BINARY));
+    m_dataTypeBeforeReading = dataType;
+    m_mappedData.grabNew(NULL);
+    setAttributesForReading(dataEndianForReading,
+                            arraySubscriptingOrderForReading,
+                            dataTypeForReading,
+                            dimensionsForReading,
+                            encodingForReading);
+    startDecodingText();
+}
+
+/**
+ * Start decoding Base64 text.  Uncompressed data is decoded directly
+ * into the array's data, compressed data is decoded into a buffer that
+ * is inflated by decodeEncodedData().
+ */
+void
+GiftiDataArray::startDecodingText()
+{
+    m_base64Decoder.grabNew(new Base64StreamDecoder());
+    m_compressedDataForReading.clear();
+    m_numberOfBytesDecoded = 0;
+}
+
+/**
+ * Add a piece of the Base64 text.
+ *
+ * @param text
+ *    The text, need not be null terminated.
+ * @param textLength
+ *    Number of characters in the text.
+ * @throws GiftiException
+ *    If the text is not valid Base64 or contains too much data.
+ */
+void
+GiftiDataArray::addEncodedText(const char* text,
+                               const int64_t textLength)
+{
+    CaretAssert(m_base64Decoder.getPointer() != NULL);
+    if (encoding == GiftiEncodingEnum::GZIP_BASE64_BINARY) {
+        /*
+         * The XML parser usually passes all of the text at once, so size
+         * the buffer for the text rather than letting the vector grow
+         * geometrically (reserve() allocates exactly what is asked for)
+         */
+        const int64_t maximumLength = m_numberOfBytesDecoded + Base64StreamDecoder::getMaximumDecodedLength(textLength);
+        if (static_cast<int64_t>(m_compressedDataForReading.size()) < maximumLength) {
+            m_compressedDataForReading.reserve(maximumLength);
+            m_compressedDataForReading.resize(maximumLength);
+        }
+        m_numberOfBytesDecoded += m_base64Decoder->decode(text,
+                                                          textLength,
+                                                          &m_compressedDataForReading[m_numberOfBytesDecoded],
+                                                          m_compressedDataForReading.size() - m_numberOfBytesDecoded);
+    }
+    else {
+        m_numberOfBytesDecoded += m_base64Decoder->decode(text,
+                                                          textLength,
+                                                          data.data() + m_numberOfBytesDecoded,
+                                                          data.size() - m_numberOfBytesDecoded);
+    }
+    if (m_base64Decoder->hasError()) {
+        throw GiftiException("Decoding of Base64 Binary data failed, the text contains invalid "
+                             "characters or more than the "
+                             + AString::number(static_cast<int64_t>(data.size()))
+                             + " bytes of data for the array dimensions.");
+    }
+}
+
+/**
+ * Decode the data after all text has been added: uncompress if needed
+ * and byte swap.  Uses no shared state, so different arrays may be
+ * decoded in parallel.
+ *
+ * @throws GiftiException
+ *    If the data is incomplete or cannot be uncompressed.
+ */
+void
+GiftiDataArray::decodeEncodedData()
+{
+    CaretAssert(m_base64Decoder.getPointer() != NULL);
+    if (encoding == GiftiEncodingEnum::GZIP_BASE64_BINARY) {
+        if (static_cast<int64_t>(m_compressedDataForReading.size()) < m_numberOfBytesDecoded + 3) {
+            m_compressedDataForReading.reserve(m_numberOfBytesDecoded + 3);
+            m_compressedDataForReading.resize(m_numberOfBytesDecoded + 3);
+        }
+        m_numberOfBytesDecoded += m_base64Decoder->finish(&m_compressedDataForReading[m_numberOfBytesDecoded],
+                                                          m_compressedDataForReading.size() - m_numberOfBytesDecoded);
+        if (m_base64Decoder->hasError()
+            || (m_numberOfBytesDecoded == 0)) {
+            throw GiftiException("Decoding of GZip Base64 Binary data failed.");
+        }
+        
+        /*
+         * Inflate directly into the array's data
+         */
+        uLongf uncompressedLength = data.size();
+        const int status = uncompress(reinterpret_cast<Bytef*>(data.data()),
+                                      &uncompressedLength,
+                                      reinterpret_cast<const Bytef*>(&m_compressedDataForReading[0]),
+                                      m_numberOfBytesDecoded);
+        std::vector<uint8_t>().swap(m_compressedDataForReading);
+        if ((status != Z_OK)
+            || (uncompressedLength != data.size())) {
+            throw GiftiException("Decompression of Binary data failed.\n"
+                                 "Uncompressed " + AString::number(static_cast<uint64_t>(uncompressedLength))
+                                 + " bytes but should be "
+                                 + AString::number(static_cast<uint64_t>(data.size())) + " bytes.");
+        }
+    }
+    else {
+        m_numberOfBytesDecoded += m_base64Decoder->finish(data.data() + m_numberOfBytesDecoded,
+                                                          data.size() - m_numberOfBytesDecoded);
+        if (m_base64Decoder->hasError()
+            || (m_numberOfBytesDecoded != static_cast<int64_t>(data.size()))) {
+            throw GiftiException("Decoding of Base64 Binary data failed.\n"
+                                 "Decoded " + AString::number(m_numberOfBytesDecoded)
+                                 + " bytes but should be "
+                                 + AString::number(static_cast<int64_t>(data.size())) + " bytes.");
+        }
+    }
+    m_base64Decoder.grabNew(NULL);
+    
+    //
+    // Is byte swapping needed ?
+    //
+    if (endian != getSystemEndian()) {
+        byteSwapData(getSystemEndian());
+    }
+}
+
+/**
+ * Finish reading data after decodeEncodedData() by converting it
+ * to the data type and indexing order used by this array.
+ *
+ * @throws GiftiException
+ *    If the data cannot be converted.
+ */
+void
+GiftiDataArray::finishReadingEncodedData()
+{
+    convertDataAfterReading(m_dataTypeBeforeReading);
+    setModified();
+}
+
 /**
  * convert array indexing order of data.
  */
 void
 GiftiDataArray::convertArrayIndexingOrder()
 {
+    copyMappedDataToMemory();
+    
     const int32_t numDim = static_cast<int32_t>(dimensions.size());
 
     if (numDim > 2) {
@@ -1008,11 +1331,15 @@ GiftiDataArray::convertArrayIndexingOrder()
  *    Stream for external binary file.
  * @param encodingForWriting
  *    GIFTI encoding used when writing the data.
+ * @param encodedData
+ *    For Base64 encodings, the data from encodeDataForWriting() or NULL
+ *    to encode the data here with the default compression level.
  */
 void 
 GiftiDataArray::writeAsXML(std::ostream& stream, 
                            std::ostream* externalBinaryOutputStream,
-                           GiftiEncodingEnum::Enum encodingForWriting) 
+                           GiftiEncodingEnum::Enum encodingForWriting,
+                           const std::vector<char>* encodedData)
                                                
 {
     this->encoding = encodingForWriting;
@@ -1169,78 +1496,28 @@ GiftiDataArray::writeAsXML(std::ostream& stream,
          }
          break;
        case GiftiEncodingEnum::BASE64_BINARY:
-         {
-            //
-            // Encode the data with VTK's Base64 algorithm
-            //
-            const uint64_t bufferLength = static_cast<uint64_t>(data.size() * 1.5);
-            char* buffer = new char[bufferLength];
-            const uint64_t compressedLength =
-               Base64::encode(&data[0],
-                                          data.size(),
-                                          (unsigned char*)buffer);
-            if (compressedLength >= bufferLength) {
-               throw GiftiException(
-                     "Base64 encoding buffer length ("
-                     + AString::number(bufferLength)
-                     + ") is too small but needs to be "
-                                    + AString::number(compressedLength));
-            }
-            buffer[compressedLength] = '\0';
-            
-            //
-            // Write the data  MUST BE NO space around data
-            //
-            xmlWriter.writeElementNoSpace(GiftiXmlElements::TAG_DATA, buffer);
-            
-            //
-            // Free memory
-            //
-            delete[] buffer;
-         }
-         break;
        case GiftiEncodingEnum::GZIP_BASE64_BINARY:
          {
-            //
-            // Compress the data with VTK's ZLIB algorithm
-            //
-             DataCompressZLib compressor;
-             unsigned long compressedDataBufferLength = 
-                              compressor.getMaximumCompressionSpace(data.size());
-            unsigned char* compressedDataBuffer = new unsigned char[compressedDataBufferLength];
-            unsigned long compressedDataLength =
-                          compressor.compressData(&data[0], 
-                                               data.size(),
-                                               compressedDataBuffer,
-                                               compressedDataBufferLength);
-            
-            //
-            // Encode the data with VTK's Base64 algorithm
-            //
-            char* buffer = new char[static_cast<int64_t>(compressedDataLength * 1.5)];
-            const uint64_t compressedLength =
-               Base64::encode(compressedDataBuffer,
-                                          compressedDataLength,
-                                          (unsigned char*)buffer);
-            buffer[compressedLength] = '\0';
-            
+             std::vector<char> localEncodedData;
+             if (encodedData == NULL) {
+                 encodeDataForWriting(encoding,
+                                      Z_DEFAULT_COMPRESSION,
+                                      localEncodedData);
+                 encodedData = &localEncodedData;
+             }
+             
              //
              // Write the data  MUST BE NO space around data
              //
-             xmlWriter.writeElementNoSpace(GiftiXmlElements::TAG_DATA, buffer);
-             
-            
-            //
-            // Free memory
-            //
-            delete[] buffer;
-            delete[] compressedDataBuffer;
+             xmlWriter.writeElementNoSpace(GiftiXmlElements::TAG_DATA,
+                                           encodedData->data(),
+                                           encodedData->size());
          }
          break;
        case GiftiEncodingEnum::EXTERNAL_FILE_BINARY:
          {
-            const int64_t dataLength = data.size();
-            externalBinaryOutputStream->write((const char*)&data[0], dataLength);
+            const int64_t dataLength = getDataSizeInBytes();
+            externalBinaryOutputStream->write((const char*)getDataBytes(), dataLength);
             if (externalBinaryOutputStream->bad()) {
                throw GiftiException("Output stream for external file reports its status as bad.");
             }
@@ -1259,6 +1536,62 @@ GiftiDataArray::writeAsXML(std::ostream& stream,
    xmlWriter.writeEndElement();
 }                      
 
+/**
+ * Encode the data for writing with a Base64 encoding, the text that goes
+ * between the DATA tags.  Only reads this array, so different arrays
+ * may be encoded in parallel.
+ *
+ * @param encodingForWriting
+ *    BASE64_BINARY or GZIP_BASE64_BINARY.
+ * @param compressionLevel
+ *    zlib compression level for GZIP_BASE64_BINARY, 1 (fastest) to 9
+ *    (smallest), or -1 (Z_DEFAULT_COMPRESSION).
+ * @param encodedDataOut
+ *    Output with the Base64 text.
+ * @throws GiftiException
+ *    If compressing fails.
+ */
+void
+GiftiDataArray::encodeDataForWriting(const GiftiEncodingEnum::Enum encodingForWriting,
+                                     const int32_t compressionLevel,
+                                     std::vector<char>& encodedDataOut) const
+{
+    CaretAssert((encodingForWriting == GiftiEncodingEnum::BASE64_BINARY)
+                || (encodingForWriting == GiftiEncodingEnum::GZIP_BASE64_BINARY));
+    
+    const unsigned char* bytesToEncode = getDataBytes();
+    uint64_t numberOfBytesToEncode = getDataSizeInBytes();
+    std::vector<unsigned char> compressedData;
+    if (encodingForWriting == GiftiEncodingEnum::GZIP_BASE64_BINARY) {
+        uLongf compressedLength = compressBound(numberOfBytesToEncode);
+        compressedData.resize(compressedLength);
+        const int status = compress2(reinterpret_cast<Bytef*>(compressedData.data()),
+                                     &compressedLength,
+                                     reinterpret_cast<const Bytef*>(bytesToEncode),
+                                     numberOfBytesToEncode,
+                                     compressionLevel);
+        if (status != Z_OK) {
+            throw GiftiException("Compression of data array failed with zlib error "
+                                 + AString::number(status));
+        }
+        bytesToEncode = compressedData.data();
+        numberOfBytesToEncode = compressedLength;
+    }
+    
+    /*
+     * Base64 is four characters for each three bytes, including
+     * the last partial group
+     */
+    encodedDataOut.resize(((numberOfBytesToEncode + 2) / 3) * 4);
+    if (numberOfBytesToEncode > 0) {
+        const uint64_t encodedLength = Base64::encode(bytesToEncode,
+                                                      numberOfBytesToEncode,
+                                                      reinterpret_cast<unsigned char*>(encodedDataOut.data()));
+        CaretAssert(encodedLength == encodedDataOut.size());
+        encodedDataOut.resize(encodedLength);
+    }
+}
+
 /**
  * convert to data type.
  */
@@ -1278,7 +1611,7 @@ GiftiDataArray::convertToDataType(const NiftiDataTypeEnum::Enum newDataType)
       dataType = newDataType;
       allocateData();
       
-      if (data.empty() == false) {
+      if (getDataSizeInBytes() > 0) {
          //
          //  Get total number of elements
          //
@@ -1482,6 +1815,7 @@ GiftiDataArray::getMinMaxValuesFloat(float& minValue,
 void 
 GiftiDataArray::zeroize()
 {
+   copyMappedDataToMemory();
    if (data.empty() == false) {
       std::fill(data.begin(), data.end(), 0);
    }
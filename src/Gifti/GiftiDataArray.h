@@ -47,8 +47,10 @@
 
 namespace caret {
     
+    class Base64StreamDecoder;
     class GiftiFile;
     class GiftiException;
+    class MappedFileRegion;
     class PaletteColorMapping;
     
     /// class GiftiDataArray.
@@ -95,7 +97,7 @@ namespace caret {
         std::vector<int64_t> getDimensions() const { return dimensions; }
         
         /// current size of the data (in bytes)
-        int64_t getDataSizeInBytes() const { return data.size(); }
+        int64_t getDataSizeInBytes() const;
         
         /// get a dimension
         int32_t getDimension(const int32_t dimIndex) const { return dimensions[dimIndex]; }
@@ -123,10 +125,33 @@ namespace caret {
                           const int64_t externalFileOffsetForReading,
                           const bool isReadOnlyMetaData);
         
+        // start reading Base64 encoded data that arrives in pieces
+        void startReadingEncodedData(const GiftiEndianEnum::Enum dataEndianForReading,
+                                     const GiftiArrayIndexingOrderEnum::Enum arraySubscriptingOrderForReading,
+                                     const NiftiDataTypeEnum::Enum dataTypeForReading,
+                                     const std::vector<int64_t>& dimensionsForReading,
+                                     const GiftiEncodingEnum::Enum encodingForReading);
+        
+        // add a piece of the Base64 encoded data
+        void addEncodedText(const char* text,
+                            const int64_t textLength);
+        
+        // decode the data, safe to run in parallel for different arrays
+        void decodeEncodedData();
+        
+        // finish reading the data after it is decoded
+        void finishReadingEncodedData();
+        
         // write the data as XML
         void writeAsXML(std::ostream& stream, 
                         std::ostream* externalBinaryOutputStream,
-                        GiftiEncodingEnum::Enum encodingForWriting);
+                        GiftiEncodingEnum::Enum encodingForWriting,
+                        const std::vector<char>* encodedData = NULL);
+        
+        // encode the data for writing, safe to run in parallel for different arrays
+        void encodeDataForWriting(const GiftiEncodingEnum::Enum encodingForWriting,
+                                  const int32_t compressionLevel,
+                                  std::vector<char>& encodedDataOut) const;
         
         /// get endian
         GiftiEndianEnum::Enum getEndian() const { return endian; }
@@ -225,6 +250,9 @@ namespace caret {
         /// get pointer for unsigned byte data (const method) (valid only if data type is UBYTE)
         const uint8_t* getDataPointerUByte() const { return dataPointerUByte; }
         
+        /// true if the data is mapped (copy-on-write) from an external file instead of held in memory
+        bool isDataMapped() const { return m_mappedData.getPointer() != NULL; }
+        
         // set all elements of array to zero
         void zeroize();
         
@@ -320,12 +348,42 @@ namespace caret {
         // byte swap the data (data read is different endian than this system)
         void byteSwapData(const GiftiEndianEnum::Enum newEndian);
         
+        // set the attributes of data that is about to be read
+        void setAttributesForReading(const GiftiEndianEnum::Enum dataEndianForReading,
+                                     const GiftiArrayIndexingOrderEnum::Enum arraySubscriptingOrderForReading,
+                                     const NiftiDataTypeEnum::Enum dataTypeForReading,
+                                     const std::vector<int64_t>& dimensionsForReading,
+                                     const GiftiEncodingEnum::Enum encodingForReading);
+        
+        // start decoding Base64 text into the data
+        void startDecodingText();
+        
+        // convert data type and indexing order of data that was read
+        void convertDataAfterReading(const NiftiDataTypeEnum::Enum requiredDataType);
+        
         /// convert array indexing order of data
         void convertArrayIndexingOrder();
         
-        /// the data
+        // map the data from an external binary file if it can be used as is
+        void mapExternalData(const AString& externalFileNameForReading,
+                             const int64_t externalFileOffsetForReading,
+                             const GiftiEndianEnum::Enum dataEndianForReading,
+                             const NiftiDataTypeEnum::Enum dataTypeForReading,
+                             const std::vector<int64_t>& dimensionsForReading,
+                             const NiftiDataTypeEnum::Enum requiredDataType);
+        
+        // copy mapped data into memory so that it can be resized
+        void copyMappedDataToMemory();
+        
+        // get the data's bytes, mapped or in memory
+        const uint8_t* getDataBytes() const;
+        
+        /// the data, unless it is mapped
         std::vector<uint8_t> data;
         
+        /// the data mapped (copy-on-write) from an external file, replaces "data" when valid
+        CaretPointer<MappedFileRegion> m_mappedData;
+        
         /// size of one data type element
         uint32_t dataTypeSize;
         
@@ -417,6 +475,19 @@ namespace caret {
         mutable CaretPointer<Histogram> m_histogramLimitedValues;
         
         bool modifiedFlag; // DO NOT COPY
+        
+        /// decodes Base64 text while reading (DO NOT COPY)
+        CaretPointer<Base64StreamDecoder> m_base64Decoder;
+        
+        /// compressed bytes decoded from Base64 text while reading (DO NOT COPY)
+        std::vector<uint8_t> m_compressedDataForReading;
+        
+        /// number of bytes decoded from Base64 text while reading (DO NOT COPY)
+        int64_t m_numberOfBytesDecoded;
+        
+        /// data type of the array before reading replaced it (DO NOT COPY)
+        NiftiDataTypeEnum::Enum m_dataTypeBeforeReading;
+        
         // ***** BE SURE TO UPDATE copyHelper() if elements are added ******
         
         /// allow NodeDataFile access to protected elements
@@ -56,6 +56,7 @@ GiftiFile::GiftiFile(const AString& descriptiveName,
     this->defaultExtension = defaultExtension;
    numberOfNodesForSparseNodeIndexFile = 0;
     this->encodingForWriting = GiftiFile::defaultEncodingForWriting;
+    this->compressionLevelForWriting = GiftiFile::defaultCompressionLevelForWriting;
 }
 
 /**
@@ -71,6 +72,7 @@ GiftiFile::GiftiFile()
     numberOfNodesForSparseNodeIndexFile = 0;
     this->defaultExtension = ".gii";
     this->encodingForWriting = GiftiFile::defaultEncodingForWriting;
+    this->compressionLevelForWriting = GiftiFile::defaultCompressionLevelForWriting;
 }
 
 /**
@@ -118,6 +120,7 @@ GiftiFile::copyHelperGiftiFile(const GiftiFile& nndf)
       addDataArray(new GiftiDataArray(*nndf.dataArrays[i]));
    }
     this->encodingForWriting = nndf.encodingForWriting;
+    this->compressionLevelForWriting = nndf.compressionLevelForWriting;
 }
       
 /**
@@ -906,7 +909,8 @@ GiftiFile::writeFile(const AString& filename)
         // Create a GIFTI Data Array File Writer
         //
         GiftiFileWriter giftiFileWriter(filename,
-                            this->encodingForWriting);
+                            this->encodingForWriting,
+                            this->compressionLevelForWriting);
         
         //
         // Start writing the file
@@ -919,9 +923,7 @@ GiftiFile::writeFile(const AString& filename)
         //
         // Write the data arrays
         //
-        for (int i = 0; i < numberOfDataArrays; i++) {
-            giftiFileWriter.writeDataArray(this->getDataArray(i));
-        }
+        giftiFileWriter.writeDataArrays(this->dataArrays);
         
         //
         // Finish writing the file
@@ -1236,6 +1238,31 @@ GiftiFile::setEncodingForWriting(const GiftiEncodingEnum::Enum encoding)
     this->encodingForWriting = encoding;
 }
 
+/**
+ * Set the zlib compression level used when writing the file
+ * with GZIP_BASE64_BINARY encoding.
+ * @param compressionLevel
+ *    1 (fastest) to 9 (smallest), -1 for zlib's default, or 0
+ *    to write uncompressed BASE64_BINARY.
+ */
+void
+GiftiFile::setCompressionLevelForWriting(const int32_t compressionLevel)
+{
+    this->compressionLevelForWriting = compressionLevel;
+}
+
+/**
+ * Set the compression level used for writing GIFTI files
+ * that are created after this call.
+ * @param compressionLevel
+ *    See setCompressionLevelForWriting().
+ */
+void
+GiftiFile::setDefaultCompressionLevelForWriting(const int32_t compressionLevel)
+{
+    GiftiFile::defaultCompressionLevelForWriting = compressionLevel;
+}
+
 
     
 /**
@@ -191,6 +191,13 @@ class GiftiFile : public DataFile {
     
     void setEncodingForWriting(const GiftiEncodingEnum::Enum encoding);
     
+    /** @return The zlib compression level used to write the file with GZIP_BASE64_BINARY encoding. */
+    int32_t getCompressionLevelForWriting() const { return this->compressionLevelForWriting; }
+    
+    void setCompressionLevelForWriting(const int32_t compressionLevel);
+    
+    static void setDefaultCompressionLevelForWriting(const int32_t compressionLevel);
+    
     virtual void clearModified();
     
     virtual bool isModified() const;
@@ -224,6 +231,9 @@ class GiftiFile : public DataFile {
       
       GiftiEncodingEnum::Enum encodingForWriting;
     
+      /// zlib compression level for writing
+      int32_t compressionLevelForWriting;
+    
       /// the default data type
       NiftiDataTypeEnum::Enum defaultDataType;
       
@@ -242,6 +252,9 @@ class GiftiFile : public DataFile {
     /** The default encoding for writing a GIFTI file. */
     static GiftiEncodingEnum::Enum defaultEncodingForWriting;
     
+    /** The default zlib compression level for writing a GIFTI file. */
+    static int32_t defaultCompressionLevelForWriting;
+    
       /*!!!! be sure to update copyHelperGiftiFile if new member added !!!!*/
    
    // 
@@ -251,6 +264,7 @@ class GiftiFile : public DataFile {
 
 #ifdef __GIFTI_FILE_MAIN__
     GiftiEncodingEnum::Enum GiftiFile::defaultEncodingForWriting = GiftiEncodingEnum::GZIP_BASE64_BINARY;
+    int32_t GiftiFile::defaultCompressionLevelForWriting = -1;//Z_DEFAULT_COMPRESSION
 #endif // __GIFTI_FILE_MAIN__
     
 
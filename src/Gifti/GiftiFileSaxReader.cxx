@@ -18,9 +18,11 @@
  */
 /*LICENSE_END*/
 
+#include <cstring>
 #include <sstream>
 
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "FileInformation.h"
 #include "GiftiEndianEnum.h"
 #include "GiftiLabel.h"
@@ -50,6 +52,11 @@ GiftiFileSaxReader::GiftiFileSaxReader(GiftiFile* giftiFileIn)
     this->labelTableSaxReader = NULL;
     this->metaDataSaxReader = NULL;
     this->dataArrayDataHasBeenRead = false;
+    this->m_decodingDataArrayText = false;
+    this->m_dataArraysPerBatch = 1;
+#ifdef CARET_OMP
+    this->m_dataArraysPerBatch = omp_get_max_threads();//limits memory used by compressed arrays waiting to be decoded
+#endif // CARET_OMP
 }
 
 /**
@@ -138,6 +145,21 @@ GiftiFileSaxReader::startElement(const AString& namespaceURI,
          }
          else if (qName == GiftiXmlElements::TAG_DATA) {
             this->state = STATE_DATA_ARRAY_DATA;
+             if (((this->encodingForReadingArrayData == GiftiEncodingEnum::BASE64_BINARY)
+                  || (this->encodingForReadingArrayData == GiftiEncodingEnum::GZIP_BASE64_BINARY))
+                 && (this->giftiFile->getReadMetaDataOnlyFlag() == false)) {
+                 try {
+                     this->dataArray->startReadingEncodedData(this->endianForReadingArrayData,
+                                                              this->arraySubscriptingOrderForReadingArrayData,
+                                                              this->dataTypeForReadingArrayData,
+                                                              this->dimensionsForReadingArrayData,
+                                                              this->encodingForReadingArrayData);
+                 }
+                 catch (const GiftiException& e) {
+                     throw XmlSaxParserException(e.whatString());
+                 }
+                 this->m_decodingDataArrayText = true;
+             }
          }
          else if (qName == GiftiXmlElements::TAG_COORDINATE_TRANSFORMATION_MATRIX) {
             this->state = STATE_DATA_ARRAY_MATRIX;
@@ -260,7 +282,21 @@ GiftiFileSaxReader::endElement(const AString& namespaceURI,
          }
          break;
       case STATE_DATA_ARRAY_DATA:
-           this->processArrayData();
+           if (this->m_decodingDataArrayText) {
+               /*
+                * Compressed data is uncompressed in batches,
+                * in parallel with other data arrays
+                */
+               this->m_decodingDataArrayText = false;
+               this->dataArrayDataHasBeenRead = true;
+               this->m_dataArraysToDecode.push_back(this->dataArray.getPointer());
+               if (static_cast<int32_t>(this->m_dataArraysToDecode.size()) >= this->m_dataArraysPerBatch) {
+                   this->decodeDataArrays();
+               }
+           }
+           else {
+               this->processArrayData();
+           }
            break;
       case STATE_DATA_ARRAY_MATRIX:
          this->matrix = NULL;
@@ -543,6 +579,15 @@ GiftiFileSaxReader::characters(const char* ch)
     else if (this->labelTableSaxReader != NULL) {
         this->labelTableSaxReader->characters(ch);
     }
+    else if (this->m_decodingDataArrayText) {
+        try {
+            this->dataArray->addEncodedText(ch,
+                                            std::strlen(ch));
+        }
+        catch (const GiftiException& e) {
+            throw XmlSaxParserException(e.whatString());
+        }
+    }
     else {
         elementText += ch;
     }
@@ -594,5 +639,40 @@ GiftiFileSaxReader::startDocument()
 void 
 GiftiFileSaxReader::endDocument()
 {
+    decodeDataArrays();
+}
+
+/**
+ * Decode the data arrays whose Base64 text has been read.  Data arrays
+ * are independent and uncompressing is most of the time spent reading
+ * compressed arrays, so they are decoded in parallel.
+ */
+void
+GiftiFileSaxReader::decodeDataArrays()
+{
+    const int32_t numberOfArrays = static_cast<int32_t>(m_dataArraysToDecode.size());
+    std::vector<AString> errorMessages(numberOfArrays);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int32_t i = 0; i < numberOfArrays; i++) {
+        try {
+            m_dataArraysToDecode[i]->decodeEncodedData();
+        }
+        catch (const GiftiException& e) {
+            errorMessages[i] = e.whatString();
+        }
+    }
+    
+    for (int32_t i = 0; i < numberOfArrays; i++) {
+        if (errorMessages[i].isEmpty() == false) {
+            throw XmlSaxParserException(errorMessages[i]);
+        }
+        try {
+            m_dataArraysToDecode[i]->finishReadingEncodedData();
+        }
+        catch (const GiftiException& e) {
+            throw XmlSaxParserException(e.whatString());
+        }
+    }
+    m_dataArraysToDecode.clear();
 }
 
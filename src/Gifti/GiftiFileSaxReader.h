@@ -23,6 +23,7 @@
 /*LICENSE_END*/
 
 #include <stack>
+#include <vector>
 #include <AString.h>
 #include <stdint.h>
 
@@ -103,6 +104,9 @@ namespace caret {
         // process the array data into numbers
         void processArrayData();
         
+        // decode the data arrays waiting to be decoded
+        void decodeDataArrays();
+        
         // create a data array
         void createDataArray(const XmlAttributes& attributes);
         
@@ -162,6 +166,15 @@ namespace caret {
         
         /// tracks if data has been read since external binary may not have DATA tag
         bool dataArrayDataHasBeenRead;
+        
+        /// Base64 text of the DATA tag is decoded as it arrives instead of stored
+        bool m_decodingDataArrayText;
+        
+        /// data arrays with Base64 text that are decoded together, in parallel
+        std::vector<GiftiDataArray*> m_dataArraysToDecode;
+        
+        /// number of data arrays to decode together
+        int32_t m_dataArraysPerBatch;
     };
 
 } // namespace
@@ -19,6 +19,7 @@
  */
 /*LICENSE_END*/
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
 
@@ -26,6 +27,7 @@
 #include "GiftiFileWriter.h"
 #undef __GIFTI_FILE_WRITER_DECLARE__
 
+#include "CaretOMP.h"
 #include "FileInformation.h"
 #include "GiftiDataArray.h"
 #include "GiftiXmlElements.h"
@@ -51,9 +53,14 @@ using namespace caret;
  * 
  * @param filename - name of the file.
  * @param encoding - encoding of the file.
+ * @param compressionLevel - zlib compression level for GZIP_BASE64_BINARY,
+ *    1 (fastest) to 9 (smallest) or -1 for zlib's default.  Zero writes
+ *    BASE64_BINARY instead, since uncompressed zlib data is larger and
+ *    slower to read than plain Base64.
  */
 GiftiFileWriter::GiftiFileWriter(const AString& filename,
-                                 const GiftiEncodingEnum::Enum encoding)
+                                 const GiftiEncodingEnum::Enum encoding,
+                                 const int32_t compressionLevel)
 : CaretObject()
 {
     this->xmlFileOutputStream = NULL;
@@ -61,6 +68,11 @@ GiftiFileWriter::GiftiFileWriter(const AString& filename,
     this->maximumExternalFileSize = 1024 * 1024 * 1024;
     this->filename = filename;
     this->encoding = encoding;
+    this->compressionLevel = compressionLevel;
+    if ((this->encoding == GiftiEncodingEnum::GZIP_BASE64_BINARY)
+        && (this->compressionLevel == 0)) {
+        this->encoding = GiftiEncodingEnum::BASE64_BINARY;
+    }
     this->xmlWriter = NULL;
     this->dataArraysWrittenCounter = 0;
 }
@@ -179,6 +191,101 @@ GiftiFileWriter::start(const int numberOfDataArrays,
  */
 void 
 GiftiFileWriter::writeDataArray(GiftiDataArray* gda)
+{
+    if (this->isBase64Encoding()) {
+        std::vector<char> encodedData;
+        try {
+            gda->encodeDataForWriting(this->encoding,
+                                      this->compressionLevel,
+                                      encodedData);
+        }
+        catch (const GiftiException& e) {
+            this->closeFiles();
+            throw e;
+        }
+        this->writeEncodedDataArray(gda,
+                                    &encodedData);
+    }
+    else {
+        this->writeEncodedDataArray(gda,
+                                    NULL);
+    }
+}
+
+/**
+ * Write GIFTI Data Arrays, in order.  With Base64 encodings, several
+ * arrays are compressed and encoded in parallel before they are written.
+ *
+ * @param dataArrays - The data arrays.
+ * @throws GiftiException - If an error occurs.
+ */
+void
+GiftiFileWriter::writeDataArrays(const std::vector<GiftiDataArray*>& dataArrays)
+{
+    const int32_t numberOfArrays = static_cast<int32_t>(dataArrays.size());
+    int32_t arraysPerBatch = 1;
+#ifdef CARET_OMP
+    arraysPerBatch = omp_get_max_threads() * 2;//limits memory used by encoded arrays waiting to be written
+#endif // CARET_OMP
+    if (( ! this->isBase64Encoding())
+        || (arraysPerBatch <= 1)
+        || (numberOfArrays <= 1)) {
+        for (int32_t i = 0; i < numberOfArrays; i++) {
+            this->writeDataArray(dataArrays[i]);
+        }
+        return;
+    }
+    
+    std::vector<std::vector<char> > encodedData(arraysPerBatch);
+    std::vector<AString> errorMessages(arraysPerBatch);
+    for (int32_t batchStart = 0; batchStart < numberOfArrays; batchStart += arraysPerBatch) {
+        const int32_t batchCount = std::min(arraysPerBatch,
+                                            numberOfArrays - batchStart);
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int32_t i = 0; i < batchCount; i++) {
+            try {
+                dataArrays[batchStart + i]->encodeDataForWriting(this->encoding,
+                                                                 this->compressionLevel,
+                                                                 encodedData[i]);
+            }
+            catch (const GiftiException& e) {
+                errorMessages[i] = e.whatString();
+            }
+        }
+        
+        for (int32_t i = 0; i < batchCount; i++) {
+            if ( ! errorMessages[i].isEmpty()) {
+                this->closeFiles();
+                throw GiftiException(errorMessages[i]);
+            }
+            this->writeEncodedDataArray(dataArrays[batchStart + i],
+                                        &encodedData[i]);
+            std::vector<char>().swap(encodedData[i]);
+        }
+    }
+}
+
+/**
+ * @return True if the data arrays are written as Base64 text.
+ */
+bool
+GiftiFileWriter::isBase64Encoding() const
+{
+    return ((this->encoding == GiftiEncodingEnum::BASE64_BINARY)
+            || (this->encoding == GiftiEncodingEnum::GZIP_BASE64_BINARY));
+}
+
+/**
+ * Write a GIFTI Data Array.
+ *
+ * @param gda - The data array.
+ * @param encodedData - For Base64 encodings, the data from
+ *    GiftiDataArray::encodeDataForWriting(), otherwise NULL.
+ * @throws GiftiException - If an error occurs.
+ */
+void
+GiftiFileWriter::writeEncodedDataArray(GiftiDataArray* gda,
+                                       const std::vector<char>* encodedData)
 {
     this->verifyOpened();
     
@@ -210,7 +317,17 @@ GiftiFileWriter::writeDataArray(GiftiDataArray* gda)
                     throw GiftiException(msg);
                 }
             }
-            const int64_t fileOffset = this->externalFileOutputStream->tellp();
+            /*
+             * Start each array on an eight byte boundary so that its
+             * elements are aligned when a reader maps the file
+             */
+            int64_t fileOffset = this->externalFileOutputStream->tellp();
+            const int64_t paddingLength = (8 - (fileOffset % 8)) % 8;
+            if (paddingLength > 0) {
+                const char padding[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+                this->externalFileOutputStream->write(padding, paddingLength);
+                fileOffset += paddingLength;
+            }
             FileInformation myInfo(this->getExternalFileNameForWriting());//TODO: get filename only without doing a stat?
             gda->setExternalFileInformation(myInfo.getFileName(),
                                             fileOffset);
@@ -221,7 +338,8 @@ GiftiFileWriter::writeDataArray(GiftiDataArray* gda)
         //
         gda->writeAsXML(*this->xmlFileOutputStream, 
                         this->externalFileOutputStream,
-                        this->encoding);
+                        this->encoding,
+                        encodedData);
         
         //
         // Increment counter of data arrays written
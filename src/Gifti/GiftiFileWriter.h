@@ -38,7 +38,8 @@ namespace caret {
         
     public:
         GiftiFileWriter(const AString& filename,
-                        const GiftiEncodingEnum::Enum encoding);
+                        const GiftiEncodingEnum::Enum encoding,
+                        const int32_t compressionLevel = -1);
         
         virtual ~GiftiFileWriter();
          
@@ -47,6 +48,8 @@ namespace caret {
                    GiftiLabelTable* labelTable);
         void writeDataArray(GiftiDataArray* gda);
         
+        void writeDataArrays(const std::vector<GiftiDataArray*>& dataArrays);
+        
         void finish();
         
         long getMaximumExternalFileSize() const;
@@ -60,6 +63,11 @@ namespace caret {
         
         void closeFiles();
         
+        void writeEncodedDataArray(GiftiDataArray* gda,
+                                   const std::vector<char>* encodedData);
+        
+        bool isBase64Encoding() const;
+        
         void verifyOpened();
         
         void removeExternalFiles();
@@ -90,6 +98,9 @@ namespace caret {
         /** encoding of file. */
         GiftiEncodingEnum::Enum encoding;
         
+        /** zlib compression level for GZIP_BASE64_BINARY */
+        int32_t compressionLevel;
+        
         /** The XML writer. */
         XmlWriter* xmlWriter;
         
@@ -40,6 +40,7 @@
 #include "CaretAssert.h"
 #include "CaretLogger.h"
 #include "CaretPreferences.h"
+#include "CiftiMappableDataFile.h"
 #include "EnumComboBoxTemplate.h"
 #include "EventGraphicsUpdateAllWindows.h"
 #include "EventManager.h"
@@ -364,6 +365,19 @@ PreferencesDialog::createMiscellaneousWidget()
                      this, SLOT(miscDevelopMenuEnabledComboBoxChanged(bool)));
     m_allWidgets->add(m_miscDevelopMenuEnabledComboBox);
     
+    /*
+     * CIFTI matrix column cache
+     */
+    m_miscCiftiColumnCacheComboBox = new WuQTrueFalseComboBox("On",
+                                                              "Off",
+                                                              this);
+    m_miscCiftiColumnCacheComboBox->getWidget()->setToolTip("When on, loading a column from a large matrix file (such as a dconn)\n"
+                                                            "first writes a transposed copy of the matrix, as large as the file,\n"
+                                                            "next to the file or in the temporary directory");
+    QObject::connect(m_miscCiftiColumnCacheComboBox, SIGNAL(statusChanged(bool)),
+                     this, SLOT(miscCiftiColumnCacheComboBoxToggled(bool)));
+    m_allWidgets->add(m_miscCiftiColumnCacheComboBox);
+    
     /*
      * Manage Files View Files Type
      */
@@ -383,6 +397,9 @@ PreferencesDialog::createMiscellaneousWidget()
     addWidgetToLayout(gridLayout,
                       "New Tabs Yoked to Group A: ",
                       m_yokingDefaultComboBox->getWidget());
+    addWidgetToLayout(gridLayout,
+                      "Cache Matrix Columns on Disk: ",
+                      m_miscCiftiColumnCacheComboBox->getWidget());
     addWidgetToLayout(gridLayout,
                       "Show Develop Menu in Menu Bar: ",
                       m_miscDevelopMenuEnabledComboBox->getWidget());
@@ -418,6 +435,8 @@ PreferencesDialog::updateMiscellaneousWidget(CaretPreferences* prefs)
     
     m_yokingDefaultComboBox->setStatus(prefs->isYokingDefaultedOn());
     
+    m_miscCiftiColumnCacheComboBox->setStatus(prefs->isCiftiMatrixColumnCacheEnabled());
+    
     m_miscSpecFileDialogViewFilesTypeEnumComboBox->setSelectedItem<SpecFileDialogViewFilesTypeEnum,SpecFileDialogViewFilesTypeEnum::Enum>(prefs->getManageFilesViewFileType());
 
 }
@@ -907,6 +926,19 @@ PreferencesDialog::yokingComboBoxToggled(bool value)
     prefs->setYokingDefaultedOn(value);
 }
 
+/**
+ * Called when the CIFTI matrix column cache option is changed.
+ * @param value
+ *   New value.
+ */
+void
+PreferencesDialog::miscCiftiColumnCacheComboBoxToggled(bool value)
+{
+    CaretPreferences* prefs = SessionManager::get()->getCaretPreferences();
+    prefs->setCiftiMatrixColumnCacheEnabled(value);
+    CiftiMappableDataFile::setMatrixColumnCacheEnabled(value);
+}
+
 /**
  * Called when show splash screen option changed.
  * @param value
@@ -72,6 +72,8 @@ namespace caret {
         
         void yokingComboBoxToggled(bool value);
         
+        void miscCiftiColumnCacheComboBoxToggled(bool value);
+        
         
     private:
         enum PREF_COLOR {
@@ -144,6 +146,8 @@ namespace caret {
         
         WuQTrueFalseComboBox* m_yokingDefaultComboBox;
         
+        WuQTrueFalseComboBox* m_miscCiftiColumnCacheComboBox;
+        
         WuQWidgetObjectGroup* m_allWidgets;
     };
     
@@ -230,8 +230,9 @@ void OperationCiftiMath::useParameters(OperationParameters* myParams, ProgressOb
     }
     if (outXML.getNumberOfDimensions() < 1) throw OperationException("output must have at least 1 dimension");
     myCiftiOut->setCiftiXML(outXML);
-    vector<float> values(numVars), scratchRow(outDims[0]);
-    vector<vector<float> > inputRows(numVars);
+    vector<float> scratchRow(outDims[0]);
+    vector<vector<float> > inputRows(numVars), selectedRows(numVars);//selectedRows repeats the selected element, for variables with -select along the row
+    vector<const float*> rowPointers(numVars);
     vector<vector<int64_t> > loadedRow(numVars);//to detect and prevent rereading the same row
     for (int v = 0; v < numVars; ++v)
     {
@@ -262,24 +263,28 @@ void OperationCiftiMath::useParameters(OperationParameters* myParams, ProgressOb
             if (needToLoad)
             {
                 varCiftiFiles[v]->getRow(inputRows[v].data(), loadedRow[v]);
+                if (selectInfo[v][0] != -1)//now we check for select along row
+                {
+                    selectedRows[v].assign(outDims[0], inputRows[v][selectInfo[v][0]]);
+                }
+            }
+            if (selectInfo[v][0] == -1)
+            {
+                rowPointers[v] = inputRows[v].data();
+            } else {
+                rowPointers[v] = selectedRows[v].data();
             }
         }
-        for (int j = 0; j < outDims[0]; ++j)
+        myExpr.evaluateArrays(rowPointers, scratchRow.data(), outDims[0]);//whole row at once, rather than walking the expression tree per element
+        if (nanfix)
         {
-            for (int v = 0; v < numVars; ++v)//now we check for select along row
+            for (int j = 0; j < outDims[0]; ++j)
             {
-                if (selectInfo[v][0] == -1)
+                if (scratchRow[j] != scratchRow[j])
                 {
-                    values[v] = inputRows[v][j];
-                } else {
-                    values[v] = inputRows[v][selectInfo[v][0]];
+                    scratchRow[j] = nanfixval;
                 }
             }
-            scratchRow[j] = (float)myExpr.evaluate(values);
-            if (nanfix && scratchRow[j] != scratchRow[j])
-            {
-                scratchRow[j] = nanfixval;
-            }
         }
         myCiftiOut->setRow(scratchRow.data(), *iter);
     }
@@ -168,7 +168,7 @@ void OperationMetricMath::useParameters(OperationParameters* myParams, ProgressO
     {
         if (varMetrics[i] == NULL) throw OperationException("no -var option specified for variable '" + myVarNames[i] + "'");
     }
-    vector<float> values(numVars), colScratch(numNodes);
+    vector<float> colScratch(numNodes);
     vector<const float*> columnPointers(numVars);
     myMetricOut->setNumberOfNodesAndColumns(numNodes, numColumns);
     myMetricOut->setStructure(myStructure);
@@ -183,16 +183,15 @@ void OperationMetricMath::useParameters(OperationParameters* myParams, ProgressO
                 columnPointers[v] = varMetrics[v]->getValuePointerForColumn(metricColumns[v]);
             }
         }
-        for (int i = 0; i < numNodes; ++i)
+        myExpr.evaluateArrays(columnPointers, colScratch.data(), numNodes);//whole column at once, rather than walking the expression tree per vertex
+        if (nanfix)
         {
-            for (int v = 0; v < numVars; ++v)
+            for (int i = 0; i < numNodes; ++i)
             {
-                values[v] = columnPointers[v][i];
-            }
-            colScratch[i] = (float)myExpr.evaluate(values);
-            if (nanfix && colScratch[i] != colScratch[i])
-            {
-                colScratch[i] = nanfixval;
+                if (colScratch[i] != colScratch[i])
+                {
+                    colScratch[i] = nanfixval;
+                }
             }
         }
         myMetricOut->setValuesForColumn(j, colScratch.data());
@@ -19,8 +19,16 @@
  */
 /*LICENSE_END*/
 
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // _WIN32
 
 #ifdef HAVE_OSMESA
 #include <GL/osmesa.h>
@@ -34,8 +42,10 @@
 #include "BrainOpenGLFixedPipeline.h"
 #include "BrainOpenGLViewportContent.h"
 #include "CaretAssert.h"
+#include "CaretException.h"
 #include "CaretLogger.h"
 #include "DataFileException.h"
+#include "DataFileTypeEnum.h"
 #include "EventBrowserTabGet.h"
 #include "EventManager.h"
 #include "FileInformation.h"
@@ -50,6 +60,7 @@
 #include "SceneClassArray.h"
 #include "SceneFile.h"
 #include "SessionManager.h"
+#include "StructureEnum.h"
 #include "VolumeFile.h"
 
 //#include "workbench_png.h"
@@ -99,6 +110,15 @@ OperationShowScene::getParameters()
 
     ret->addIntegerParameter(5, "image-height", "height of output image(s)");
     
+    ParameterComponent* alsoSceneOpt = ret->createRepeatableParameter(6, "-also-scene", "render another scene from the same scene file");
+    alsoSceneOpt->addStringParameter(1, "scene-name-or-number", "name or number (starting at one) of the scene in the scene file");
+    alsoSceneOpt->addStringParameter(2, "image-file-name", "output image file name for this scene");
+    
+    OptionalParameter* jobsOpt = ret->createOptionalParameter(7, "-jobs", "render scenes in parallel worker processes");
+    jobsOpt->addIntegerParameter(1, "count", "maximum number of worker processes");
+    
+    ret->createOptionalParameter(8, "-check-batch", "also render each scene that reuses loaded data files with its files reloaded, and fail if the images differ");
+    
     AString helpText("Render content of browser windows displayed in a scene "
                      "into image file(s).  The image file name should be "
                      "similar to \"capture.png\".  If there is only one image "
@@ -107,6 +127,17 @@ OperationShowScene::getParameters()
                      "into the image name: \"capture_01.png\", \"capture_02.png\" "
                      "etc.\n"
                      "\n"
+                     "Use -also-scene to render more scenes from the same scene file "
+                     "in one run.  The scene file is read only once, and scenes that "
+                     "use the same data files are rendered one after another so that "
+                     "the data files are loaded only once for all of them.  Use -jobs "
+                     "to render the scenes in several worker processes at the same "
+                     "time, each with its own offscreen context.  Images are written "
+                     "as soon as they are rendered.  A scene that reuses loaded data "
+                     "files first puts the files back in the state they had when "
+                     "loaded, so that it renders the same as when rendered alone, "
+                     "-check-batch verifies this at the cost of reloading the files.\n"
+                     "\n"
                      "The image format is determined by the image file extension.\n"
                      "Image formats available on this system are:\n");
     
@@ -158,28 +189,157 @@ OperationShowScene::useParameters(OperationParameters* myParams,
     if (imageHeight < 0) {
         throw OperationException("image height is invalid");
     }
+    int32_t numberOfJobs = 1;
+    OptionalParameter* jobsOpt = myParams->getOptionalParameter(7);
+    if (jobsOpt->m_present) {
+        numberOfJobs = (int32_t)jobsOpt->getInteger(1);
+        if (numberOfJobs < 1) {
+            throw OperationException("number of jobs must be at least 1");
+        }
+    }
+    
+    const bool checkBatch = myParams->getOptionalParameter(8)->m_present;
     
+    /*
+     * The scene file is read once, all scenes to render come from it
+     */
     SceneFile sceneFile;
     sceneFile.readFile(sceneFileName);
     
-    Scene* scene = sceneFile.getSceneWithName(sceneNameOrNumber);
-    if (scene == NULL) {
-        bool valid = false;
-        const int32_t sceneIndexStartAtOne = sceneNameOrNumber.toInt(&valid);
-        if (valid) {
-            const int32_t sceneIndex = sceneIndexStartAtOne - 1;
-            if ((sceneIndex >= 0)
-                && (sceneIndex < sceneFile.getNumberOfScenes())) {
-                scene = sceneFile.getSceneAtIndex(sceneIndex);
+    std::vector<const Scene*> scenes;
+    std::vector<AString> imageFileNames;
+    scenes.push_back(findScene(sceneFile, sceneNameOrNumber));
+    imageFileNames.push_back(imageFileName);
+    const std::vector<ParameterComponent*>& alsoSceneInstances = *(myParams->getRepeatableParameterInstances(6));
+    for (int32_t i = 0; i < (int32_t)alsoSceneInstances.size(); i++) {
+        scenes.push_back(findScene(sceneFile, alsoSceneInstances[i]->getString(1)));
+        imageFileNames.push_back(FileInformation(alsoSceneInstances[i]->getString(2)).getAbsoluteFilePath());
+    }
+    
+    /*
+     * Order the scenes so that scenes using the same data files are
+     * rendered one after another, the data files are then loaded only
+     * once for each run of scenes (stable sort keeps the command line
+     * order within a run).
+     */
+    const int32_t numScenes = (int32_t)scenes.size();
+    std::vector<std::pair<AString, int32_t> > sceneOrder(numScenes);
+    for (int32_t i = 0; i < numScenes; i++) {
+        sceneOrder[i] = std::make_pair(getSceneDataFilesKey(scenes[i]), i);
+    }
+    std::stable_sort(sceneOrder.begin(), sceneOrder.end());
+    
+    /**
+     * Enable voxel coloring since it is defaulted off for commands
+     */
+    VolumeFile::setVoxelColoringEnabled(true);    
+    
+    if (numberOfJobs > numScenes) {
+        numberOfJobs = numScenes;
+    }
+#ifdef _WIN32
+    if (numberOfJobs > 1) {
+        CaretLogWarning("-jobs is not supported on this platform, scenes will be rendered sequentially");
+        numberOfJobs = 1;
+    }
+#endif // _WIN32
+    if (numberOfJobs == 1) {
+        std::vector<const Scene*> jobScenes;
+        std::vector<AString> jobImageFileNames;
+        for (int32_t i = 0; i < numScenes; i++) {
+            jobScenes.push_back(scenes[sceneOrder[i].second]);
+            jobImageFileNames.push_back(imageFileNames[sceneOrder[i].second]);
+        }
+        renderScenes(jobScenes, jobImageFileNames, imageWidth, imageHeight, checkBatch);
+        return;
+    }
+#ifndef _WIN32
+    /*
+     * The Brain and SessionManager are process-wide singletons, so scenes are
+     * rendered in parallel by worker processes, each with its own Mesa context.
+     * Each worker gets a contiguous piece of the sorted scenes so that scenes
+     * sharing data files stay in the same worker.
+     */
+    std::cout.flush();
+    std::cerr.flush();
+    std::vector<pid_t> workers;
+    for (int32_t job = 0; job < numberOfJobs; job++) {
+        const int32_t jobStart = (int32_t)((int64_t)numScenes * job / numberOfJobs);
+        const int32_t jobEnd = (int32_t)((int64_t)numScenes * (job + 1) / numberOfJobs);
+        const pid_t pid = fork();
+        if (pid < 0) {
+            CaretLogSevere("failed to start worker process for scene rendering");
+            break;
+        }
+        if (pid == 0) {
+            int exitStatus = 0;
+            try {
+                std::vector<const Scene*> jobScenes;
+                std::vector<AString> jobImageFileNames;
+                for (int32_t i = jobStart; i < jobEnd; i++) {
+                    jobScenes.push_back(scenes[sceneOrder[i].second]);
+                    jobImageFileNames.push_back(imageFileNames[sceneOrder[i].second]);
+                }
+                renderScenes(jobScenes, jobImageFileNames, imageWidth, imageHeight, checkBatch);
             }
-            else {
-                throw OperationException("Scene index is invalid");
+            catch (const CaretException& e) {
+                std::cerr << "scene rendering failed: " << e.whatString() << std::endl;
+                exitStatus = 1;
+            }
+            catch (const std::exception& e) {
+                std::cerr << "scene rendering failed: " << e.what() << std::endl;
+                exitStatus = 1;
             }
+            std::cout.flush();
+            std::cerr.flush();
+            _exit(exitStatus);//do not run the parent's exit handlers or singleton destructors
         }
-        else {
-            throw OperationException("Scene name is invalid");
+        workers.push_back(pid);
+    }
+    bool allSucceeded = ((int32_t)workers.size() == numberOfJobs);
+    for (int32_t i = 0; i < (int32_t)workers.size(); i++) {
+        int status = 0;
+        if (waitpid(workers[i], &status, 0) < 0
+            || ! WIFEXITED(status)
+            || WEXITSTATUS(status) != 0) {
+            allSucceeded = false;
         }
     }
+    if ( ! allSucceeded) {
+        throw OperationException("one or more scene rendering processes failed");
+    }
+#endif // _WIN32
+}
+
+/**
+ * Render scenes into image files, using one Mesa context for all of them.
+ * When consecutive scenes reference the same data files, the files are
+ * loaded by the first scene only, and the following scenes put the files
+ * back in their loaded state and then restore their display state.
+ *
+ * @param scenes
+ *     Scenes to render.
+ * @param imageFileNames
+ *     Output image file name for each scene.
+ * @param imageWidth
+ *     width of images.
+ * @param imageHeight
+ *     height of images.
+ * @param checkBatch
+ *     If true, render each generic scene again as a full scene and
+ *     throw an exception if the images differ.
+ */
+void
+OperationShowScene::renderScenes(const std::vector<const Scene*>& scenes,
+                                 const std::vector<AString>& imageFileNames,
+                                 const int32_t imageWidth,
+                                 const int32_t imageHeight,
+                                 const bool checkBatch)
+{
+    CaretAssert(scenes.size() == imageFileNames.size());
+    if (scenes.empty()) {
+        return;
+    }
     
     //
     // Create the Mesa Context
@@ -224,29 +384,6 @@ OperationShowScene::useParameters(OperationParameters* myParams,
      */
     const int viewport[4] = { 0, 0, imageWidth, imageHeight };
 
-    /**
-     * Enable voxel coloring since it is defaulted off for commands
-     */
-    VolumeFile::setVoxelColoringEnabled(true);    
-    
-    SceneAttributes sceneAttributes(SceneTypeEnum::SCENE_TYPE_FULL);
-    
-    const SceneClass* guiManagerClass = scene->getClassWithName("guiManager");
-    if (guiManagerClass->getName() != "guiManager") {
-        throw OperationException("Top level scene class should be guiManager but it is: "
-                               + guiManagerClass->getName());
-    }
-    
-    SessionManager* sessionManager = SessionManager::get();
-    sessionManager->restoreFromScene(&sceneAttributes,
-                                            guiManagerClass->getClass("m_sessionManager"));
-
-    
-    if (sessionManager->getNumberOfBrains() <= 0) {
-        throw OperationException("Scene loading failure, SessionManager contains no Brains");
-    }
-    Brain* brain = SessionManager::get()->getBrain(0);
-    
     /*
      * Renders text
      */
@@ -275,12 +412,162 @@ OperationShowScene::useParameters(OperationParameters* myParams,
     BrainOpenGLFixedPipeline* brainOpenGL = new BrainOpenGLFixedPipeline(textRenderer);
     brainOpenGL->initializeOpenGL();
     
+    try {
+        AString loadedDataFilesKey;
+        bool haveLoadedDataFiles = false;
+        const int32_t numScenes = (int32_t)scenes.size();
+        for (int32_t iScene = 0; iScene < numScenes; iScene++) {
+            const Scene* scene = scenes[iScene];
+            const AString& imageFileName = imageFileNames[iScene];
+            
+            /*
+             * A generic scene restores everything except the data files,
+             * so it is used when the needed files are already loaded
+             */
+            const AString dataFilesKey = getSceneDataFilesKey(scene);
+            SceneTypeEnum::Enum sceneType = SceneTypeEnum::SCENE_TYPE_FULL;
+            if (haveLoadedDataFiles
+                && (dataFilesKey == loadedDataFilesKey)) {
+                sceneType = SceneTypeEnum::SCENE_TYPE_GENERIC;
+            }
+            std::vector<std::vector<unsigned char> > windowImages;
+            renderScene(scene,
+                        sceneType,
+                        brainOpenGL,
+                        viewport,
+                        imageBuffer,
+                        imageWidth,
+                        imageHeight,
+                        windowImages);
+            loadedDataFilesKey = dataFilesKey;
+            haveLoadedDataFiles = true;
+            
+            if (checkBatch
+                && (sceneType == SceneTypeEnum::SCENE_TYPE_GENERIC)) {
+                /*
+                 * Render the scene again with its files reloaded, as
+                 * when it is the only scene rendered
+                 */
+                std::vector<std::vector<unsigned char> > aloneWindowImages;
+                renderScene(scene,
+                            SceneTypeEnum::SCENE_TYPE_FULL,
+                            brainOpenGL,
+                            viewport,
+                            imageBuffer,
+                            imageWidth,
+                            imageHeight,
+                            aloneWindowImages);
+                if (aloneWindowImages != windowImages) {
+                    throw OperationException("Scene \""
+                                             + scene->getName()
+                                             + "\" renders differently after other scenes than when rendered alone");
+                }
+            }
+            
+            /*
+             * Images are written as soon as each scene is drawn
+             */
+            const int32_t numWindows = (int32_t)windowImages.size();
+            for (int32_t i = 0; i < numWindows; i++) {
+                if (windowImages[i].empty()) {
+                    continue;
+                }
+                const int32_t outputImageIndex = ((numWindows > 1)
+                                                  ? i
+                                                  : -1);
+                writeImage(imageFileName,
+                           outputImageIndex,
+                           &windowImages[i][0],
+                           imageWidth,
+                           imageHeight);
+            }
+        }
+    }
+    catch (...) {
+        delete textRenderer;
+        delete brainOpenGL;
+        delete[] imageBuffer;
+        OSMesaDestroyContext(mesaContext);
+        throw;
+    }
+    
+    if (textRenderer != NULL) {
+        delete textRenderer;
+    }
+    
+    delete brainOpenGL;
+    
+    /*
+     * Free image memory and Mesa context
+     */
+    delete[] imageBuffer;
+    OSMesaDestroyContext(mesaContext);
+}
+
+/**
+ * Restore a scene and draw each of its browser windows.
+ *
+ * @param scene
+ *     Scene to render.
+ * @param sceneType
+ *     Full to load the scene's data files, generic to use the loaded files.
+ * @param brainOpenGL
+ *     Renderer using the current Mesa context.
+ * @param viewport
+ *     Viewport of the image.
+ * @param imageBuffer
+ *     Buffer of the Mesa context.
+ * @param imageWidth
+ *     width of images.
+ * @param imageHeight
+ *     height of images.
+ * @param windowImagesOut
+ *     Image of each browser window, empty for a window that has no toolbar.
+ */
+void
+OperationShowScene::renderScene(const Scene* scene,
+                                const SceneTypeEnum::Enum sceneType,
+                                BrainOpenGLFixedPipeline* brainOpenGL,
+                                const int viewport[4],
+                                const unsigned char* imageBuffer,
+                                const int32_t imageWidth,
+                                const int32_t imageHeight,
+                                std::vector<std::vector<unsigned char> >& windowImagesOut)
+{
+    windowImagesOut.clear();
+    
+    const SceneClass* guiManagerClass = scene->getClassWithName("guiManager");
+    if (guiManagerClass->getName() != "guiManager") {
+        throw OperationException("Top level scene class should be guiManager but it is: "
+                                 + guiManagerClass->getName());
+    }
+    
+    /*
+     * A scene does not restore all of the state of the data files, so a
+     * generic scene first puts the files back in the state they had when
+     * loaded, otherwise state set by the previous scene would carry over
+     */
+    SessionManager* sessionManager = SessionManager::get();
+    for (int32_t i = 0; i < sessionManager->getNumberOfBrains(); i++) {
+        sessionManager->getBrain(i)->setResetFilesToLoadedStateInGenericScenes(true);
+    }
+    
+    SceneAttributes sceneAttributes(sceneType);
+    sessionManager->restoreFromScene(&sceneAttributes,
+                                     guiManagerClass->getClass("m_sessionManager"));
+    
+    if (sessionManager->getNumberOfBrains() <= 0) {
+        throw OperationException("Scene loading failure, SessionManager contains no Brains");
+    }
+    Brain* brain = sessionManager->getBrain(0);
+    
     /*
      * Restore windows
      */
     const SceneClassArray* browserWindowArray = guiManagerClass->getClassArray("m_brainBrowserWindows");
     if (browserWindowArray != NULL) {
         const int32_t numBrowserClasses = browserWindowArray->getNumberOfArrayElements();
+        windowImagesOut.resize(numBrowserClasses);
         for (int32_t i = 0; i < numBrowserClasses; i++) {
             const SceneClass* browserClass = browserWindowArray->getClassAtIndex(i);
             
@@ -293,7 +580,7 @@ OperationShowScene::useParameters(OperationParameters* myParams,
                  * Index of selected browser tab (NOT the tabBar)
                  */
                 const int32_t selectedTabIndex = toolbarClass->getIntegerValue("selectedTabIndex", -1);
-
+                
                 EventBrowserTabGet getTabContent(selectedTabIndex);
                 EventManager::get()->sendEvent(getTabContent.getPointer());
                 BrowserTabContent* tabContent = getTabContent.getBrowserTab();
@@ -314,33 +601,104 @@ OperationShowScene::useParameters(OperationParameters* myParams,
                 
                 brainOpenGL->drawModels(viewportContents);
                 
-                const int32_t outputImageIndex = ((numBrowserClasses > 1)
-                                             ? i
-                                             : -1);
-                
-                writeImage(imageFileName,
-                           outputImageIndex,
-                           imageBuffer,
-                           imageWidth,
-                           imageHeight);
+                windowImagesOut[i].assign(imageBuffer,
+                                          imageBuffer + (imageWidth * imageHeight * 4));
             }
         }
     }
-    
-    if (textRenderer != NULL) {
-        delete textRenderer;
-    }
-    
-    delete brainOpenGL;
-    
-    /*
-     * Free image memory and Mesa context
-     */
-    delete[] imageBuffer;
-    OSMesaDestroyContext(mesaContext);
 }
 #endif // HAVE_OSMESA
 
+/**
+ * Find a scene by name or by number (starting at one).
+ *
+ * @param sceneFile
+ *     Scene file containing the scene.
+ * @param sceneNameOrNumber
+ *     Name or number of the scene.
+ * @return
+ *     The scene, an exception is thrown if not found.
+ */
+const Scene*
+OperationShowScene::findScene(SceneFile& sceneFile,
+                              const AString& sceneNameOrNumber)
+{
+    const Scene* scene = sceneFile.getSceneWithName(sceneNameOrNumber);
+    if (scene == NULL) {
+        bool valid = false;
+        const int32_t sceneIndexStartAtOne = sceneNameOrNumber.toInt(&valid);
+        if (valid) {
+            const int32_t sceneIndex = sceneIndexStartAtOne - 1;
+            if ((sceneIndex >= 0)
+                && (sceneIndex < sceneFile.getNumberOfScenes())) {
+                scene = sceneFile.getSceneAtIndex(sceneIndex);
+            }
+            else {
+                throw OperationException("Scene index is invalid: " + sceneNameOrNumber);
+            }
+        }
+        else {
+            throw OperationException("Scene name is invalid: " + sceneNameOrNumber);
+        }
+    }
+    return scene;
+}
+
+/**
+ * Get a key identifying the data files loaded by a scene.  Scenes with
+ * the same key load the same files with the same selections.
+ *
+ * @param scene
+ *     The scene.
+ * @return
+ *     Key made from the spec file name and the data files of each brain.
+ */
+AString
+OperationShowScene::getSceneDataFilesKey(const Scene* scene)
+{
+    AString key;
+    const SceneClass* guiManagerClass = scene->getClassWithName("guiManager");
+    if (guiManagerClass == NULL) {
+        return key;
+    }
+    const SceneClass* sessionManagerClass = guiManagerClass->getClass("m_sessionManager");
+    if (sessionManagerClass == NULL) {
+        return key;
+    }
+    const SceneClassArray* brainArray = sessionManagerClass->getClassArray("m_brains");
+    if (brainArray == NULL) {
+        return key;
+    }
+    const int32_t numBrains = brainArray->getNumberOfArrayElements();
+    for (int32_t i = 0; i < numBrains; i++) {
+        key += "brain\n";
+        const SceneClass* specFileClass = brainArray->getClassAtIndex(i)->getClass("specFile");
+        if (specFileClass == NULL) {
+            continue;
+        }
+        key += specFileClass->getPathNameValue("specFileName", "") + "\n";
+        const SceneClassArray* dataFileClassArray = specFileClass->getClassArray("dataFilesArray");
+        if (dataFileClassArray != NULL) {
+            const int32_t numberOfFiles = dataFileClassArray->getNumberOfArrayElements();
+            for (int32_t j = 0; j < numberOfFiles; j++) {
+                const SceneClass* dataFileClass = dataFileClassArray->getClassAtIndex(j);
+                const DataFileTypeEnum::Enum dataFileType = dataFileClass->getEnumeratedTypeValue<DataFileTypeEnum,
+                                                                                                  DataFileTypeEnum::Enum>("dataFileType",
+                                                                                                                          DataFileTypeEnum::UNKNOWN);
+                const StructureEnum::Enum structure = dataFileClass->getEnumeratedTypeValue<StructureEnum,
+                                                                                            StructureEnum::Enum>("structure",
+                                                                                                                 StructureEnum::INVALID);
+                key += (DataFileTypeEnum::toName(dataFileType)
+                        + " " + StructureEnum::toName(structure)
+                        + " " + (dataFileClass->getBooleanValue("selected") ? "1" : "0")
+                        + " " + dataFileClass->getPathNameValue("fileName")
+                        + "\n");
+            }
+        }
+    }
+    return key;
+}
+
 /**
  * Write the image data to a Image File.
  *
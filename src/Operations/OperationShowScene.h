@@ -23,9 +23,14 @@
 
 
 #include "AbstractOperation.h"
+#include "SceneTypeEnum.h"
 
 namespace caret {
 
+    class BrainOpenGLFixedPipeline;
+    class Scene;
+    class SceneFile;
+
     class OperationShowScene : public AbstractOperation {
 
     public:
@@ -41,6 +46,26 @@ namespace caret {
         static bool isShowSceneCommandAvailable();
         
     private:
+        static const Scene* findScene(SceneFile& sceneFile,
+                                      const AString& sceneNameOrNumber);
+        
+        static AString getSceneDataFilesKey(const Scene* scene);
+        
+        static void renderScenes(const std::vector<const Scene*>& scenes,
+                                 const std::vector<AString>& imageFileNames,
+                                 const int32_t imageWidth,
+                                 const int32_t imageHeight,
+                                 const bool checkBatch);
+        
+        static void renderScene(const Scene* scene,
+                                const SceneTypeEnum::Enum sceneType,
+                                BrainOpenGLFixedPipeline* brainOpenGL,
+                                const int viewport[4],
+                                const unsigned char* imageBuffer,
+                                const int32_t imageWidth,
+                                const int32_t imageHeight,
+                                std::vector<std::vector<unsigned char> >& windowImagesOut);
+        
         static void writeImage(const AString& imageFileName,
                                   const int32_t imageIndex,
                                   const unsigned char* imageContent,
@@ -74,9 +74,11 @@ void OperationSurfaceClosestVertex::useParameters(OperationParameters* myParams,
         coords.push_back(y);
         coords.push_back(z);
     }
-    for (int i = 0; i < (int)coords.size(); i += 3)
+    int64_t numCoords = (int64_t)coords.size() / 3;
+    vector<int32_t> nodes(numCoords);
+    mySurf->closestNodes(coords.data(), numCoords, nodes.data());
+    for (int64_t i = 0; i < numCoords; ++i)
     {
-        int node = mySurf->closestNode(coords.data() + i);
-        nodeFile << node << endl;
+        nodeFile << nodes[i] << endl;
     }
 }
@@ -161,15 +161,20 @@ void OperationSurfaceGeodesicROIs::useParameters(OperationParameters* myParams,
                                             ", " + AString::number(myCoord[2], 'f', 1) + ")");
         }
     }
+    GeodesicNeighborLists geoLists;
+    {
+        GeodesicHelperPool myGeoPool(mySurf);
+        myGeoPool.getNodesToGeoDist(vector<int32_t>(nodelist.begin(), nodelist.end()), limit, geoLists);//all seeds at once, in parallel
+    }
     switch (overlapType)
     {
         case 1://ALLOW
             for (int i = 0; i < (int)nodelist.size(); ++i)
             {
-                CaretPointer<GeodesicHelper> myhelp = mySurf->getGeodesicHelper();
-                vector<int32_t> roinodes;
-                vector<float> dists;
-                myhelp->getNodesToGeoDist(nodelist[i], limit, roinodes, dists);
+                const int32_t* geoNodes = geoLists.getNodes(i);
+                vector<int32_t> roinodes(geoNodes, geoNodes + geoLists.getNumberOfNeighbors(i));
+                const float* geoDists = geoLists.getDists(i);
+                vector<float> dists(geoDists, geoDists + geoLists.getNumberOfNeighbors(i));
                 if (sigma > 0.0f)
                 {
                     double accum = 0.0;
@@ -199,11 +204,10 @@ void OperationSurfaceGeodesicROIs::useParameters(OperationParameters* myParams,
             vector<float> bestDists(numNodes, -1.0f);
             for (int i = 0; i < (int)nodelist.size(); ++i)
             {
-                CaretPointer<GeodesicHelper> myhelp = mySurf->getGeodesicHelper();
-                vector<int32_t> roinodes;
-                vector<float> dists;
-                myhelp->getNodesToGeoDist(nodelist[i], limit, roinodes, dists);
-                for (int j = 0; j < (int)roinodes.size(); ++j)
+                const int32_t* roinodes = geoLists.getNodes(i);
+                const float* dists = geoLists.getDists(i);
+                int numRoiNodes = (int)geoLists.getNumberOfNeighbors(i);
+                for (int j = 0; j < numRoiNodes; ++j)
                 {
                     ++useCounts[roinodes[j]];
                     if (bestDists[roinodes[j]] < 0.0f || dists[j] < bestDists[roinodes[j]])
@@ -24,11 +24,94 @@
 #include "CaretAssert.h"
 #include "CaretLogger.h"
 #include "CaretMathExpression.h"
+#include "CaretPointer.h"
+#include "DataFile.h"
+#include "FileInformation.h"
+#include "NiftiIO.h"
 #include "VolumeFile.h"
 
+#include <QFile>
+
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    vector<int64_t> getNonSpatialIndexes(const vector<int64_t>& origDims, const int64_t& brickIndex)
+    {//same ordering as VolumeBase
+        vector<int64_t> ret;
+        int64_t remaining = brickIndex;
+        for (int i = 3; i < (int)origDims.size(); ++i)
+        {
+            ret.push_back(remaining % origDims[i]);
+            remaining /= origDims[i];
+        }
+        CaretAssert(remaining == 0);
+        return ret;
+    }
+    
+    class VolumeMathInput
+    {//reads one subvolume at a time, so that inputs never need to be entirely in memory
+        NiftiIO m_io;
+        CaretPointer<VolumeFile> m_loaded;//fallback for things NiftiIO can't do by itself: map names and network files
+        vector<int64_t> m_origDims;
+        vector<float> m_frame;
+        int64_t m_numMaps, m_frameLoaded;
+        int m_fullDims;
+    public:
+        VolumeMathInput(const AString& filename, const bool& needMapNames)
+        {
+            m_frameLoaded = -1;
+            if (needMapNames || DataFile::isFileOnNetwork(filename))
+            {
+                m_loaded.grabNew(new VolumeFile());
+                m_loaded->readFile(filename);
+                m_origDims = m_loaded->getOriginalDimensions();
+                m_numMaps = m_loaded->getNumberOfMaps();
+                if (m_loaded->getNumberOfComponents() != 1) m_numMaps = -1;
+                return;
+            }
+            m_io.openRead(filename);
+            m_origDims = m_io.getDimensions();
+            m_fullDims = min(3, (int)m_origDims.size());//deal with nifti with less than 3 dimensions, same as VolumeFile
+            while (m_origDims.size() < 3) m_origDims.push_back(1);
+            m_numMaps = 1;
+            for (int i = 3; i < (int)m_origDims.size(); ++i)
+            {
+                m_numMaps *= m_origDims[i];
+            }
+            if (m_io.getNumComponents() != 1) m_numMaps = -1;
+        }
+        bool isMultiComponent() const { return m_numMaps == -1; }
+        int64_t getNumberOfMaps() const { return m_numMaps; }
+        const vector<int64_t>& getOriginalDimensions() const { return m_origDims; }
+        VolumeSpace getVolumeSpace() const
+        {
+            if (m_loaded != NULL) return m_loaded->getVolumeSpace();
+            return VolumeSpace(m_origDims.data(), m_io.getHeader().getSForm());
+        }
+        int64_t getMapIndexFromNameOrNumber(const AString& mapName) const
+        {
+            if (m_loaded != NULL) return m_loaded->getMapIndexFromNameOrNumber(mapName);
+            bool ok = false;
+            int64_t ret = mapName.toLongLong(&ok) - 1;//only called without map names when the string is a number
+            if (!ok || ret < 0 || ret >= m_numMaps) return -1;
+            return ret;
+        }
+        const float* getFrame(const int64_t& brickIndex)
+        {
+            if (m_loaded != NULL) return m_loaded->getFrame(brickIndex);
+            if (brickIndex != m_frameLoaded)
+            {
+                m_frame.resize(m_origDims[0] * m_origDims[1] * m_origDims[2]);
+                m_io.readData(m_frame.data(), m_fullDims, getNonSpatialIndexes(m_origDims, brickIndex));
+                m_frameLoaded = brickIndex;
+            }
+            return m_frame.data();
+        }
+    };
+}
+
 AString OperationVolumeMath::getCommandSwitch()
 {
     return "-volume-math";
@@ -45,11 +128,11 @@ OperationParameters* OperationVolumeMath::getParameters()
     
     ret->addStringParameter(1, "expression", "the expression to evaluate, in quotes");
     
-    ret->addVolumeOutputParameter(2, "volume-out", "the output volume");
+    ret->addStringParameter(2, "volume-out", "the output volume file");//written one subvolume at a time by VolumeFile::openFileForWritingFrames, so not a volume output parameter
     
     ParameterComponent* varOpt = ret->createRepeatableParameter(3, "-var", "a volume file to use as a variable");
     varOpt->addStringParameter(1, "name", "the name of the variable, as used in the expression");
-    varOpt->addVolumeParameter(2, "volume", "the volume file to use as this variable");
+    varOpt->addStringParameter(2, "volume", "the volume file to use as this variable");//read one subvolume at a time, so not a volume parameter
     OptionalParameter* subvolSelect = varOpt->createOptionalParameter(3, "-subvolume", "select a single subvolume");
     subvolSelect->addStringParameter(1, "subvol", "the subvolume number or name");
     varOpt->createOptionalParameter(4, "-repeat", "reuse a single subvolume for each subvolume of calculation");
@@ -64,6 +147,8 @@ OperationParameters* OperationVolumeMath::getParameters()
                         "If the -subvolume option is given to any -var option, only one subvolume is used from that file.  " +
                         "If -repeat is specified, the file must either have only one subvolume, or have the -subvolume option specified.  " +
                         "All files that don't use -repeat must have the same number of subvolumes requested to be used.  " +
+                        "Input files are read, and the output written, one subvolume at a time, so memory usage does not grow with the number of subvolumes " +
+                        "(except for an input that uses -subvolume with a subvolume name rather than a number, which must be read entirely to find the name).  " +
                         "The format of <expression> is as follows:\n\n";
     myText += CaretMathExpression::getExpressionHelpInfo();
     ret->setHelpText(myText);
@@ -76,7 +161,7 @@ void OperationVolumeMath::useParameters(OperationParameters* myParams, ProgressO
     AString expression = myParams->getString(1);
     CaretMathExpression myExpr(expression);
     vector<AString> myVarNames = myExpr.getVarNames();
-    VolumeFile* myVolOut = myParams->getOutputVolume(2);
+    AString outFileName = myParams->getString(2);
     const vector<ParameterComponent*>& myVarOpts = *(myParams->getRepeatableParameterInstances(3));
     OptionalParameter* fixNanOpt = myParams->getOptionalParameter(4);
     bool nanfix = false;
@@ -88,13 +173,16 @@ void OperationVolumeMath::useParameters(OperationParameters* myParams, ProgressO
     }
     int numInputs = myVarOpts.size();
     int numVars = myVarNames.size();
-    vector<VolumeFile*> varVolumes(numVars, (VolumeFile*)NULL);
-    vector<int> varSubvolumes(numVars, -1);
+    vector<CaretPointer<VolumeMathInput> > inputs(numInputs);
+    vector<VolumeMathInput*> varVolumes(numVars, (VolumeMathInput*)NULL);
+    vector<int64_t> varSubvolumes(numVars, -1);
     if (numInputs == 0) throw OperationException("you must specify at least one input volume (-var), even if the expression doesn't use a variable");
-    VolumeFile* first = myVarOpts[0]->getVolume(2);
-    const VolumeSpace& mySpace = first->getVolumeSpace();
     vector<int64_t> outDims;
-    int numSubvols = -1;
+    vector<vector<float> > outSform;
+    VolumeSpace mySpace;
+    int64_t numSubvols = -1;
+    bool outputIsInput = false;
+    AString outCanonical = FileInformation(outFileName).getCanonicalFilePath();//empty if it doesn't exist yet
     for (int i = 0; i < numInputs; ++i)
     {
         AString varName = myVarOpts[i]->getString(1);
@@ -103,14 +191,32 @@ void OperationVolumeMath::useParameters(OperationParameters* myParams, ProgressO
         {
             throw OperationException("'" + varName + "' is a named constant equal to " + AString::number(constVal, 'g', 15) + ", please use a different variable name");
         }
-        VolumeFile* thisVolume = myVarOpts[i]->getVolume(2);
-        if (thisVolume->getNumberOfComponents() != 1)
+        AString inFileName = myVarOpts[i]->getString(2);
+        if (!outCanonical.isEmpty() && FileInformation(inFileName).getCanonicalFilePath() == outCanonical)
         {
-            throw OperationException("volume file for variable '" + varName + "' has multiple components, this is not currently supported in -volume-math");
+            outputIsInput = true;
         }
-        int thisSubvols = thisVolume->getNumberOfMaps();
         OptionalParameter* subvolSelect = myVarOpts[i]->getOptionalParameter(3);
-        int useSubvolume = -1;
+        bool needMapNames = false;
+        if (subvolSelect->m_present)
+        {
+            bool isNumber = false;
+            subvolSelect->getString(1).toLongLong(&isNumber);
+            needMapNames = !isNumber;
+        }
+        inputs[i].grabNew(new VolumeMathInput(inFileName, needMapNames));
+        VolumeMathInput* thisVolume = inputs[i];
+        if (thisVolume->isMultiComponent())
+        {
+            throw OperationException("volume file for variable '" + varName + "' has multiple components, this is not currently supported in -volume-math");
+        }
+        if (i == 0)
+        {
+            mySpace = thisVolume->getVolumeSpace();
+            outSform = mySpace.getSform();
+        }
+        int64_t thisSubvols = thisVolume->getNumberOfMaps();
+        int64_t useSubvolume = -1;
         if (subvolSelect->m_present)
         {
             thisSubvols = 1;
@@ -119,7 +225,7 @@ void OperationVolumeMath::useParameters(OperationParameters* myParams, ProgressO
                                                                 "' in volume file for '" + varName + "'");
         }
         bool repeat = myVarOpts[i]->getOptionalParameter(4)->m_present;
-        if (!thisVolume->matchesVolumeSpace(mySpace))
+        if (!thisVolume->getVolumeSpace().matches(mySpace))
         {
             throw OperationException("volume file for variable '" + varName + "' has different volume space than the first volume file");
         }
@@ -178,11 +284,18 @@ void OperationVolumeMath::useParameters(OperationParameters* myParams, ProgressO
     {
         if (varVolumes[i] == NULL) throw OperationException("no -var option specified for variable '" + myVarNames[i] + "'");
     }
+    AString writeName = outFileName;
+    if (outputIsInput)
+    {//we are still reading the input while writing, so write elsewhere and replace it at the end - keep the extension, NiftiIO uses it to decide on compression
+        FileInformation outInfo(outFileName);
+        writeName = outInfo.getPathName() + "/.wb_tmp_" + outInfo.getFileName();
+    }
+    NiftiIO outIO;
+    VolumeFile::openFileForWritingFrames(outIO, writeName, outDims, outSform);//same header and caret extension as writing a volume output parameter
     int64_t frameSize = outDims[0] * outDims[1] * outDims[2];
-    vector<float> values(numVars), outFrame(frameSize);
+    vector<float> outFrame(frameSize);
     vector<const float*> inputFrames(numVars);
-    myVolOut->reinitialize(outDims, first->getSform());//DO NOT take volume type from first volume, because we don't check for or copy label tables, nor do we want to
-    for (int s = 0; s < numSubvols; ++s)
+    for (int64_t s = 0; s < numSubvols; ++s)
     {
         for (int v = 0; v < numVars; ++v)
         {
@@ -190,22 +303,30 @@ void OperationVolumeMath::useParameters(OperationParameters* myParams, ProgressO
             {
                 inputFrames[v] = varVolumes[v]->getFrame(s);
             } else {
-                inputFrames[v] = varVolumes[v]->getFrame(varSubvolumes[v]);
+                inputFrames[v] = varVolumes[v]->getFrame(varSubvolumes[v]);//doesn't reread if it is the same as last time
             }
         }
-        for (int64_t i = 0; i < frameSize; ++i)
+        myExpr.evaluateArrays(inputFrames, outFrame.data(), frameSize);//whole frame at once, rather than walking the expression tree per voxel
+        if (nanfix)
         {
-            for (int v = 0; v < numVars; ++v)
+            for (int64_t i = 0; i < frameSize; ++i)
             {
-                values[v] = inputFrames[v][i];
-            }
-            float tempf = (float)myExpr.evaluate(values);
-            if (nanfix && tempf != tempf)
-            {
-                tempf = nanfixval;
+                if (outFrame[i] != outFrame[i])
+                {
+                    outFrame[i] = nanfixval;
+                }
             }
-            outFrame[i] = tempf;
         }
-        myVolOut->setFrame(outFrame.data(), s);
+        outIO.writeData(outFrame.data(), 3, getNonSpatialIndexes(outDims, s));
+    }
+    outIO.close();
+    if (outputIsInput)
+    {
+        inputs.clear();//close the inputs before replacing one
+        varVolumes.clear();
+        if (!QFile::remove(outFileName) || !QFile::rename(writeName, outFileName))
+        {
+            throw OperationException("failed to replace '" + outFileName + "' with temporary output file '" + writeName + "'");
+        }
     }
 }
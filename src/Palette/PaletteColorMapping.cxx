@@ -1256,6 +1256,7 @@ PaletteColorMapping::mapDataToPaletteNormalizedValues(const FastStatistics* stat
         mappingNegativeDenominator = 1.0;
     }
     
+#pragma omp CARET_PARFOR if (numberOfData > 10000)
     for (int64_t i = 0; i < numberOfData; i++) {
         float scalar    = dataValues[i];
         
@@ -0,0 +1,185 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "GiftiFileTest.h"
+
+#include "GiftiDataArray.h"
+#include "GiftiFile.h"
+
+#include <QDir>
+#include <QTemporaryFile>
+
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    AString getExternalArrayXml(const AString& binFileName, const AString& indexingOrder, const int64_t& dimI, const int64_t& dimJ, const int64_t& offset)
+    {
+        return AString("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n") +
+               "<GIFTI Version=\"1.0\" NumberOfDataArrays=\"1\">\n" +
+               "<MetaData/>\n" +
+               "<DataArray Intent=\"NIFTI_INTENT_NONE\" DataType=\"NIFTI_TYPE_FLOAT32\" ArrayIndexingOrder=\"" + indexingOrder + "\"" +
+               " Dimensionality=\"2\" Dim0=\"" + AString::number(dimI) + "\" Dim1=\"" + AString::number(dimJ) + "\"" +
+               " Encoding=\"ExternalFileBinary\" Endian=\"" + GiftiEndianEnum::toGiftiName(GiftiDataArray::getSystemEndian()) + "\"" +
+               " ExternalFileName=\"" + binFileName + "\" ExternalFileOffset=\"" + AString::number(offset) + "\">\n" +
+               "<MetaData/>\n" +
+               "<Data></Data>\n" +
+               "</DataArray>\n" +
+               "</GIFTI>\n";
+    }
+}
+
+GiftiFileTest::GiftiFileTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void GiftiFileTest::execute()
+{
+    testExternalColumnMajor();
+    testExternalRowMajorMapped();
+}
+
+void GiftiFileTest::testExternalColumnMajor()
+{//non-square, so that the transpose can't be done in place
+    const int64_t dimI = 3, dimJ = 2, offset = 8;
+    vector<float> colMajor(offset / sizeof(float) + dimI * dimJ, -1.0f);
+    for (int64_t i = 0; i < dimI; ++i)
+    {
+        for (int64_t j = 0; j < dimJ; ++j)
+        {
+            colMajor[offset / sizeof(float) + j * dimI + i] = 10 * i + j;
+        }
+    }
+    QTemporaryFile binFile(QDir::tempPath() + "/wb_gifti_test_XXXXXX.bin");
+    if (!binFile.open())
+    {
+        setFailed("failed to create temporary external binary file");
+        return;
+    }
+    binFile.write((const char*)colMajor.data(), colMajor.size() * sizeof(float));
+    binFile.close();
+    QTemporaryFile xmlFile(QDir::tempPath() + "/wb_gifti_test_XXXXXX.gii");
+    if (!xmlFile.open())
+    {
+        setFailed("failed to create temporary gifti file");
+        return;
+    }
+    xmlFile.write(getExternalArrayXml(binFile.fileName(), "ColumnMajorOrder", dimI, dimJ, offset).toUtf8());
+    xmlFile.close();
+    GiftiFile myFile;
+    myFile.readFile(xmlFile.fileName());
+    if (myFile.getNumberOfDataArrays() != 1)
+    {
+        setFailed("wrong number of data arrays read from external column major file");
+        return;
+    }
+    const GiftiDataArray* myArray = myFile.getDataArray(0);
+    if (myArray->getNumberOfDimensions() != 2 || myArray->getDimension(0) != dimI || myArray->getDimension(1) != dimJ)
+    {
+        setFailed("wrong dimensions read from external column major file");
+        return;
+    }
+    const float* data = myArray->getDataPointerFloat();
+    for (int64_t i = 0; i < dimI; ++i)
+    {
+        for (int64_t j = 0; j < dimJ; ++j)
+        {
+            if (data[i * dimJ + j] != 10 * i + j)
+            {
+                setFailed("element (" + AString::number(i) + ", " + AString::number(j) + ") of external column major array should be " +
+                          AString::number(10 * i + j) + ", got " + AString::number(data[i * dimJ + j]));
+                return;
+            }
+        }
+    }
+}
+
+void GiftiFileTest::testExternalRowMajorMapped()
+{//offset isn't page aligned, to test the mapping's alignment handling
+    const int64_t dimI = 3, dimJ = 2, offset = 12;
+    vector<float> rowMajor(offset / sizeof(float) + dimI * dimJ, -1.0f);
+    for (int64_t i = 0; i < dimI; ++i)
+    {
+        for (int64_t j = 0; j < dimJ; ++j)
+        {
+            rowMajor[offset / sizeof(float) + i * dimJ + j] = 10 * i + j;
+        }
+    }
+    QTemporaryFile binFile(QDir::tempPath() + "/wb_gifti_test_XXXXXX.bin");
+    if (!binFile.open())
+    {
+        setFailed("failed to create temporary external binary file");
+        return;
+    }
+    binFile.write((const char*)rowMajor.data(), rowMajor.size() * sizeof(float));
+    binFile.close();
+    QTemporaryFile xmlFile(QDir::tempPath() + "/wb_gifti_test_XXXXXX.gii");
+    if (!xmlFile.open())
+    {
+        setFailed("failed to create temporary gifti file");
+        return;
+    }
+    xmlFile.write(getExternalArrayXml(binFile.fileName(), "RowMajorOrder", dimI, dimJ, offset).toUtf8());
+    xmlFile.close();
+    GiftiFile myFile;
+    myFile.readFile(xmlFile.fileName());
+    if (myFile.getNumberOfDataArrays() != 1)
+    {
+        setFailed("wrong number of data arrays read from external row major file");
+        return;
+    }
+    GiftiDataArray* myArray = myFile.getDataArray(0);
+    if (myArray->getNumberOfDimensions() != 2 || myArray->getDimension(0) != dimI || myArray->getDimension(1) != dimJ)
+    {
+        setFailed("wrong dimensions read from external row major file");
+        return;
+    }
+    if (!myArray->isDataMapped())
+    {
+        setFailed("external row major array was not memory mapped");
+        return;
+    }
+    float* data = myArray->getDataPointerFloat();
+    for (int64_t i = 0; i < dimI; ++i)
+    {
+        for (int64_t j = 0; j < dimJ; ++j)
+        {
+            if (data[i * dimJ + j] != 10 * i + j)
+            {
+                setFailed("element (" + AString::number(i) + ", " + AString::number(j) + ") of mapped external array should be " +
+                          AString::number(10 * i + j) + ", got " + AString::number(data[i * dimJ + j]));
+                return;
+            }
+        }
+    }
+    data[0] = 1000.0f;//the mapping is copy-on-write, so this must not reach the external file
+    vector<float> fileData(rowMajor.size());
+    if (!binFile.open() || binFile.read((char*)fileData.data(), fileData.size() * sizeof(float)) != (qint64)(fileData.size() * sizeof(float)))
+    {
+        setFailed("failed to read back temporary external binary file");
+        return;
+    }
+    if (fileData != rowMajor)
+    {
+        setFailed("modifying a mapped external array changed the external file");
+    }
+}
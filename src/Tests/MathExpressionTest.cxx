@@ -55,4 +55,30 @@ void MathExpressionTest::execute()
     {
         setFailed("output value incorrect, expected " + AString::number(correctresult) + ", got " + AString::number(testresult));
     }
+    CaretMathExpression arrayExpr("x * (y > 0) + min(x, y) ^ 2 - clamp(y, -1, 1) * PI + (x == y)");//compiled array evaluation must match the tree exactly
+    vector<AString> arrayNames = arrayExpr.getVarNames();
+    const int ARRAY_SIZE = 1000;//more than one chunk
+    vector<float> xvals(ARRAY_SIZE), yvals(ARRAY_SIZE), arrayOut(ARRAY_SIZE);
+    for (int i = 0; i < ARRAY_SIZE; ++i)
+    {
+        xvals[i] = (i % 37) * 0.25f - 4.0f;
+        yvals[i] = (i % 11 == 0) ? xvals[i] : (i % 23) * 0.5f - 5.0f;
+    }
+    vector<const float*> arrayInputs(2);
+    if (arrayNames.size() != 2) setFailed("incorrect number of variables found in array expression");
+    arrayInputs[0] = (arrayNames[0] == "x" ? xvals.data() : yvals.data());
+    arrayInputs[1] = (arrayNames[0] == "x" ? yvals.data() : xvals.data());
+    arrayExpr.evaluateArrays(arrayInputs, arrayOut.data(), ARRAY_SIZE);
+    for (int i = 0; i < ARRAY_SIZE; ++i)
+    {
+        vector<float> elemVars(2);
+        elemVars[0] = arrayInputs[0][i];
+        elemVars[1] = arrayInputs[1][i];
+        float treeResult = (float)arrayExpr.evaluate(elemVars);
+        if (treeResult != arrayOut[i])
+        {
+            setFailed("array evaluation differs from tree at index " + AString::number(i) + ", expected " + AString::number(treeResult) + ", got " + AString::number(arrayOut[i]));
+            break;
+        }
+    }
 }
@@ -20,9 +20,17 @@
 
 #include "NiftiTest.h"
 
+#include "CaretBinaryFile.h"
+#include "CaretException.h"
 #include "MultiDimIterator.h"
 #include "NiftiIO.h"
 
+#include <QDir>
+#include <QFile>
+#include <QTemporaryFile>
+#include "zlib.h"
+
+#include <algorithm>
 #include <vector>
 
 using namespace std;
@@ -159,3 +167,158 @@ void NiftiHeaderTest::writeNifti2Header(AString filename, NiftiHeader &header)
     myFile.open(filename, CaretBinaryFile::WRITE_TRUNCATE);
     header.write(myFile, 2);
 }
+
+//Tests for the BGZF reader/writer used for .gz files, no input files needed
+
+namespace
+{
+    vector<uint8_t> makeTestData(const int64_t& size, const int& seed)
+    {
+        vector<uint8_t> ret(size);
+        for (int64_t i = 0; i < size; ++i)
+        {
+            ret[i] = (uint8_t)((i * 7 + i / 1000 + seed) & 0xff);//compressible, but not constant within a block
+        }
+        return ret;
+    }
+    
+    bool readAll(const AString& filename, vector<uint8_t>& dataOut)
+    {
+        QFile myFile(filename);
+        if (!myFile.open(QIODevice::ReadOnly)) return false;
+        QByteArray contents = myFile.readAll();
+        dataOut.assign(contents.constData(), contents.constData() + contents.size());
+        return true;
+    }
+}
+
+BgzfFileTest::BgzfFileTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void BgzfFileTest::execute()
+{
+#ifdef ZLIB_VERSION
+    testRoundTripAndSeek();
+    if (failed()) return;
+    testMixedGzipFallback();
+#endif
+}
+
+void BgzfFileTest::testRoundTripAndSeek()
+{
+    const int64_t dataSize = 200000;//several 0xff00 byte blocks, the last one partial
+    vector<uint8_t> data = makeTestData(dataSize, 0);
+    QTemporaryFile tempFile(QDir::tempPath() + "/wb_bgzf_test_XXXXXX.gz");
+    if (!tempFile.open())
+    {
+        setFailed("failed to create temporary file");
+        return;
+    }
+    tempFile.close();
+    try
+    {
+        CaretBinaryFile writer(tempFile.fileName(), CaretBinaryFile::WRITE_TRUNCATE);
+        const int64_t writeSizes[] = { 1000, 70000, 1, 0xff00 };//uneven writes that don't line up with blocks
+        int64_t written = 0;
+        for (int i = 0; written < dataSize; i = (i + 1) % 4)
+        {
+            int64_t count = min(writeSizes[i], dataSize - written);
+            writer.write(data.data() + written, count);
+            written += count;
+        }
+        writer.close();
+        CaretBinaryFile reader(tempFile.fileName());
+        vector<uint8_t> readBack(dataSize);
+        reader.read(readBack.data(), dataSize);
+        if (readBack != data)
+        {
+            setFailed("BGZF round trip data does not match");
+            return;
+        }
+        int64_t numRead = -1;
+        uint8_t extra;
+        reader.read(&extra, 1, &numRead);
+        if (numRead != 0)
+        {
+            setFailed("BGZF read past the end of the data");
+            return;
+        }
+        const int64_t seekPositions[] = { 150000, 10, 0xff00 - 5, 0xff00, 2 * 0xff00 - 1, dataSize - 10 };//backwards, forwards, and across block boundaries
+        const int64_t chunkSize = 10;
+        for (int i = 0; i < 6; ++i)
+        {
+            reader.seek(seekPositions[i]);
+            uint8_t chunk[chunkSize];
+            reader.read(chunk, chunkSize);
+            if (!equal(chunk, chunk + chunkSize, data.begin() + seekPositions[i]))
+            {
+                setFailed("BGZF read after seek to " + AString::number(seekPositions[i]) + " does not match");
+                return;
+            }
+            if (reader.pos() != seekPositions[i] + chunkSize)
+            {
+                setFailed("BGZF position after seek and read is wrong");
+                return;
+            }
+        }
+    } catch (CaretException& e) {
+        setFailed("exception in BGZF round trip: " + e.whatString());
+    }
+}
+
+void BgzfFileTest::testMixedGzipFallback()
+{//BGZF followed by an ordinary gzip member, like concatenating two .gz files, the first header looks like BGZF but the second doesn't
+    const int64_t bgzfSize = 100000, plainSize = 30000;
+    vector<uint8_t> bgzfData = makeTestData(bgzfSize, 0), plainData = makeTestData(plainSize, 3);
+    QTemporaryFile bgzfFile(QDir::tempPath() + "/wb_bgzf_test_XXXXXX.gz"), plainFile(QDir::tempPath() + "/wb_bgzf_test_XXXXXX.gz"), mixedFile(QDir::tempPath() + "/wb_bgzf_test_XXXXXX.gz");
+    if (!bgzfFile.open() || !plainFile.open() || !mixedFile.open())
+    {
+        setFailed("failed to create temporary file");
+        return;
+    }
+    bgzfFile.close();
+    plainFile.close();
+    try
+    {
+        CaretBinaryFile writer(bgzfFile.fileName(), CaretBinaryFile::WRITE_TRUNCATE);
+        writer.write(bgzfData.data(), bgzfSize);
+        writer.close();
+        gzFile plainWriter = gzopen(plainFile.fileName().toLocal8Bit().constData(), "wb");
+        if (plainWriter == NULL || gzwrite(plainWriter, plainData.data(), plainSize) != plainSize || gzclose(plainWriter) != Z_OK)
+        {
+            setFailed("failed to write ordinary gzip file");
+            return;
+        }
+        vector<uint8_t> bgzfBytes, plainBytes;
+        if (!readAll(bgzfFile.fileName(), bgzfBytes) || !readAll(plainFile.fileName(), plainBytes))
+        {
+            setFailed("failed to read back compressed files");
+            return;
+        }
+        mixedFile.write((const char*)bgzfBytes.data(), bgzfBytes.size());
+        mixedFile.write((const char*)plainBytes.data(), plainBytes.size());
+        mixedFile.close();
+        vector<uint8_t> expected(bgzfData);
+        expected.insert(expected.end(), plainData.begin(), plainData.end());
+        vector<uint8_t> readBack(expected.size());
+        CaretBinaryFile reader(mixedFile.fileName());
+        reader.read(readBack.data(), readBack.size());
+        if (readBack != expected)
+        {
+            setFailed("mixed BGZF and gzip file data does not match");
+            return;
+        }
+        reader.close();
+        reader.open(plainFile.fileName());
+        readBack.resize(plainSize);
+        reader.read(readBack.data(), plainSize);
+        if (readBack != plainData)
+        {
+            setFailed("ordinary gzip file data does not match");
+            return;
+        }
+    } catch (CaretException& e) {
+        setFailed("exception in mixed gzip test: " + e.whatString());
+    }
+}
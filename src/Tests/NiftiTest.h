@@ -44,6 +44,15 @@ public:
     void writeNifti2Header(AString filename, NiftiHeader &header);
 };
 
+class BgzfFileTest : public TestInterface
+{
+public:
+    BgzfFileTest(const AString& identifier);
+    virtual void execute();
+    void testRoundTripAndSeek();
+    void testMixedGzipFallback();
+};
+
 
 }
 
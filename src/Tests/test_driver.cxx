@@ -34,6 +34,7 @@
 
 //tests
 #include "CiftiFileTest.h"
+#include "GiftiFileTest.h"
 #include "HttpTest.h"
 #include "HeapTest.h"
 #include "LookupTest.h"
@@ -67,7 +68,9 @@ int main(int argc, char** argv)
         caret_global_commandLine_init(argc, argv);
         SessionManager::createSessionManager(ApplicationTypeEnum::APPLICATION_TYPE_COMMAND_LINE);
         vector<TestInterface*> mytests;
+        mytests.push_back(new BgzfFileTest("bgzffile"));
         mytests.push_back(new CiftiFileTest("ciftifile"));
+        mytests.push_back(new GiftiFileTest("giftifile"));
         mytests.push_back(new HeapTest("heap"));
         mytests.push_back(new HttpTest("http"));
         mytests.push_back(new LookupTest("lookup"));